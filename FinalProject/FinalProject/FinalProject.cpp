@@ -12,6 +12,7 @@
 #define _CRT_SECURE_NO_WARNINGS 1 
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 // Include OpenGL support
@@ -41,6 +42,21 @@ extern TriSurface* ConstructBuckyball(const int position_loc, const int normal_l
 
 const float FRAMES_PER_SEC = 60.0f;
 
+#ifdef COUNT_ALLOCATIONS
+// Replace the global allocator so AllocationCounter sees every heap
+// allocation. display() reports any made while drawing a frame.
+void* operator new(size_t bytes) {
+  AllocationCounter::Add(bytes);
+  void* p = malloc(bytes > 0 ? bytes : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept {
+  free(p);
+}
+#endif
+
 LightingShaderNode* lightingShader;
 Color4 fogColor = Color4(0.25f, 0.25f, 0.25f, 1.0f);
 
@@ -70,6 +86,13 @@ public:
 		m_nodes[m_current]->Draw(sceneState);
 	}
 
+   // Only the current node is drawn, so a render list draws this node
+   // with Draw rather than flattening all of the choices
+   virtual void Compile(RenderList& list)
+   {
+      list.AddNode(this);
+   }
+
    virtual void SetCurrent(const uint32_t current)
    {
       if (current < m_nodes.size())
@@ -82,9 +105,10 @@ protected:
 
 
 // Default lighting: fixed world coordinate
-int LightRotation = 0;
+float LightRotation = 0.0f;     // Moving light angle (degrees) about z
+const float LightStep = 2.0f;   // Moving light step (degrees)
 HPoint3 WorldLightPosition;
-Matrix4x4 LightTransform;
+Point3 WorldLightStart;         // Moving light position at angle 0
 LightType CurrentLight = FIXED_WORLD;
 
 // Global scene state
@@ -104,6 +128,22 @@ CameraNode* MyCamera;                     // Camera
 LightNode* MinersLight;                   // View dependent light
 LightNode* WorldLight;                    // World coordiante light (fixed or moving)
 LightNode* Spotlight;					  // Keep the spotlight global so we can update its poisition
+RenderListNode* SceneRenderList;          // Draws the scene (with view frustum culling)
+bool CullingEnabled = true;
+
+// Memory for per-frame scene traversal temporaries
+FrameArena FrameMemory;
+
+// OpenGL calls made through the state cache in the last frame
+GLStateStats FrameGLStats;
+
+// Threads that update independent parts of the scene graph
+TaskPool UpdatePool;
+
+// Particle transforms published by the simulation thread, and the thread.
+// Declared after the pool so the thread is stopped before the pool goes.
+TransformSnapshot ParticleTransforms;
+std::unique_ptr<SimulationThread> Simulation;
 
 // Creating a starting camera height constant to easily change the height of the 'player'
 const float startingCameraHeight = 5.0f;
@@ -167,11 +207,14 @@ void UpdateView(const int x, const int y, bool forward) {
 void AnimateView(int val) {
 	bool redisplay = false;
 	if (CurrentLight == MOVING_LIGHT) {
-    WorldLightPosition = LightTransform * WorldLightPosition;
+    // Rotate the starting position by the total angle (rather than
+    // accumulating a rotation each step) so the light does not drift
+    LightRotation += LightStep;
+    if (LightRotation >= 360.0f)
+      LightRotation -= 360.0f;
+    Point3 p = Quaternion(LightRotation, Vector3(0.0f, 0.0f, 1.0f)).Rotate(WorldLightStart);
+    WorldLightPosition = HPoint3(p.x, p.y, p.z, 1.0f);
     WorldLight->SetPosition(WorldLightPosition);
-    LightRotation += 5;
-    if (LightRotation > 360)
-      LightRotation = 0;
     redisplay = true;
   }
 
@@ -194,24 +237,23 @@ void AnimateView(int val) {
 }
 
 /*
- * In this project, this function is required to animate particle systems by calling into update
+ * Animates the particle systems. The simulation thread updates the scene
+ * graph; this redraws the scene when it has published a new step.
  */
 void AnimateParticles(int value) 
 {
-	// Update the scene graph
-	SceneState scene_state;
-	SceneRoot->Update(scene_state);
+	if (ParticleTransforms.IsFresh())
+		glutPostRedisplay();
 
 	// Set update to specified frames per second
 	glutTimerFunc((int)(1000.0f / FRAMES_PER_SEC), AnimateParticles, 0);
-
-	glutPostRedisplay();
 }
 
 /**
 * Construct the terrain for the scene.
 */
-SceneNode* ConstructTrees(TexturedUnitSquareSurface* tree_square)
+SceneNode* ConstructTrees(TexturedUnitSquareSurface* tree_square, const int position_loc,
+                          const int normal_loc, const int texture_loc)
 {
     // Number of trees to generate
     const int NUM_TREES = 1000;
@@ -245,13 +287,18 @@ SceneNode* ConstructTrees(TexturedUnitSquareSurface* tree_square)
     // Add the material as the parent of the trees
     trees->AddChild(tree_material);
 
+    // Draw all the trees with one instanced draw call
+    InstancedGeometryNode* tree_instances = new InstancedGeometryNode(tree_square,
+        position_loc, normal_loc, texture_loc, lightingShader->GetInstanceLoc(),
+        lightingShader->GetInstanceScaleLoc());
+    tree_material->AddChild(tree_instances);
+
     // Create NUM_TREES trees
     int randomX = 0;
     int randomY = 0;
     int randomHeight = 0;
     int randomWidth = 0;
-    TransformNode* treeFront_transform;
-    //TransformNode* treeBack_transform;
+    Matrix4x4 tree_transform;
     for (int treeNum = 0; treeNum < NUM_TREES; ++treeNum)
     {
         // Create random x,y
@@ -271,14 +318,13 @@ SceneNode* ConstructTrees(TexturedUnitSquareSurface* tree_square)
         }
 
         // Create a new transform (otherwise we'll translate again)
-        treeFront_transform = new TransformNode();
-        treeFront_transform->Translate(randomX, randomY, randomHeight * 0.4);
-        treeFront_transform->RotateX(90.0f);
-        treeFront_transform->Scale(randomWidth, randomHeight, 1.0f);
-
-        // Add this tree to the tree material
-        tree_material->AddChild(treeFront_transform);
-        treeFront_transform->AddChild(tree_square);
+        tree_transform.SetIdentity();
+        tree_transform.Translate(randomX, randomY, randomHeight * 0.4);
+        tree_transform.RotateX(90.0f);
+        tree_transform.Scale(randomWidth, randomHeight, 1.0f);
+
+        // Add this tree as an instance
+        tree_instances->AddInstance(tree_transform);
     }
 
     return trees;
@@ -397,6 +443,30 @@ SceneNode* ConstructFirewood(SceneNode* box) {
 	return firewood;
 }
 
+/**
+* Form a fixed modeling matrix: translate, then rotate by whole quarter turns
+* about x, y and z (in that order), then scale. Uses only constexpr matrix
+* operations so the matrices below are formed at compile time.
+* @param  tx, ty, tz  Translation
+* @param  qx, qy, qz  Number of counterclockwise quarter turns about x, y, z
+* @param  sx, sy, sz  Scale factors
+* @return Returns the modeling matrix.
+*/
+constexpr Matrix4x4 FixedTransform(const float tx, const float ty, const float tz,
+	const int qx = 0, const int qy = 0, const int qz = 0,
+	const float sx = 1.0f, const float sy = 1.0f, const float sz = 1.0f) {
+	Matrix4x4 m;
+	m.Translate(tx, ty, tz);
+	if (qx != 0)
+		m.RotateX90(qx);
+	if (qy != 0)
+		m.RotateY90(qy);
+	if (qz != 0)
+		m.RotateZ90(qz);
+	m.Scale(sx, sy, sz);
+	return m;
+}
+
 /**
 * Construct a unit tent with outward facing normals.
 * @param  textured_triangle  Geometry node to use for front/back
@@ -404,18 +474,18 @@ SceneNode* ConstructFirewood(SceneNode* box) {
 */
 SceneNode* ConstructUnitTent(TexturedUnitTriangleSurface* textured_triangle, TexturedUnitSquareSurface* textured_square) {
 	// Contruct transform nodes for the tent faces
+	constexpr Matrix4x4 kBottom = FixedTransform(0.0f, 0.0f, -0.5f, 2);
+	constexpr Matrix4x4 kBack   = FixedTransform(0.0f, 0.5f, 0.0f, -1, 0, 2);
+	constexpr Matrix4x4 kFront  = FixedTransform(0.0f, -0.5f, 0.0f, 1);
+
 	TransformNode* bottom_transform = new TransformNode;
-	bottom_transform->Translate(0.0f, 0.0f, -0.5f);
-	bottom_transform->RotateX(180.0f);
+	bottom_transform->LoadMatrix(kBottom);
 
 	TransformNode* back_transform = new TransformNode;
-	back_transform->Translate(0.0f, 0.5f, 0.0f);
-	back_transform->RotateX(-90.0f);
-	back_transform->RotateZ(180.0f);
+	back_transform->LoadMatrix(kBack);
 
 	TransformNode* front_transform = new TransformNode;
-	front_transform->Translate(0.0f, -0.5f, 0.0f);
-	front_transform->RotateX(90.0f);
+	front_transform->LoadMatrix(kFront);
 
 	TransformNode* left_transform = new TransformNode;
 	left_transform->Translate(-0.25f, 0.0f, 00.0f);
@@ -459,36 +529,38 @@ SceneNode* ConstructUnitTent(TexturedUnitTriangleSurface* textured_triangle, Tex
 */
 SceneNode* ConstructTexturedUnitBox(TexturedUnitSquareSurface* textured_square) {
 	// Contruct transform nodes for the sides of the box.
-	// Perform rotations so the sides face outwards
+	// Perform rotations so the sides face outwards. The matrices are
+	// formed at compile time.
 
 	// Bottom is rotated 180 degrees so it faces outwards
+	constexpr Matrix4x4 kBottom = FixedTransform(0.0f, 0.0f, -0.5f, 2);
 	TransformNode* bottom_transform = new TransformNode;
-	bottom_transform->Translate(0.0f, 0.0f, -0.5f);
-	bottom_transform->RotateX(180.0f);
+	bottom_transform->LoadMatrix(kBottom);
 
 	// Back is rotated -90 degrees about x: (z -> y)
+	constexpr Matrix4x4 kBack = FixedTransform(0.0f, 0.5f, 0.0f, -1);
 	TransformNode* back_transform = new TransformNode;
-	back_transform->Translate(0.0f, 0.5f, 0.0f);
-	back_transform->RotateX(-90.0f);
+	back_transform->LoadMatrix(kBack);
 
 	// Front wall is rotated 90 degrees about x: (y -> z)
+	constexpr Matrix4x4 kFront = FixedTransform(0.0f, -0.5f, 0.0f, 1);
 	TransformNode* front_transform = new TransformNode;
-	front_transform->Translate(0.0f, -0.5f, 0.0f);
-	front_transform->RotateX(90.0f);
+	front_transform->LoadMatrix(kFront);
 
 	// Left wall is rotated -90 about y: (z -> -x)
+	constexpr Matrix4x4 kLeft = FixedTransform(-0.5f, 0.0f, 0.0f, 0, -1);
 	TransformNode* left_transform = new TransformNode;
-	left_transform->Translate(-0.5f, 0.0f, 00.0f);
-	left_transform->RotateY(-90.0f);
+	left_transform->LoadMatrix(kLeft);
 
 	// Right wall is rotated 90 degrees about y: (z -> x)
+	constexpr Matrix4x4 kRight = FixedTransform(0.5f, 0.0f, 0.0f, 0, 1);
 	TransformNode* right_transform = new TransformNode;
-	right_transform->Translate(0.5f, 0.0f, 0.0f);
-	right_transform->RotateY(90.0f);
+	right_transform->LoadMatrix(kRight);
 
 	// Top 
+	constexpr Matrix4x4 kTop = FixedTransform(0.0f, 0.0f, 0.5f);
 	TransformNode* top_transform = new TransformNode;
-	top_transform->Translate(0.0f, 0.0f, 0.50f);
+	top_transform->LoadMatrix(kTop);
 
 	// Create a SceneNode and add the 6 sides of the box.
 	SceneNode* box = new SceneNode;
@@ -517,39 +589,36 @@ SceneNode* ConstructTexturedUnitBox(TexturedUnitSquareSurface* textured_square)
 SceneNode* ConstructSkyBox(UnitSquareSurface* unit_square,
 	TexturedUnitSquareSurface* textured_square)
 {
+	// Wall transforms are formed at compile time.
 	// Back wall is rotated +90 degrees about x: (y -> z)
+	constexpr Matrix4x4 kBackWall = FixedTransform(0.0f, 10000.0f, 0.0f,
+		1, 0, 0, 20000.0f, 20000.0f, 1.0f);
 	TransformNode* backwall_transform = new TransformNode;
-	backwall_transform->Translate(0.0f, 10000.0f, 0.0f);
-	backwall_transform->RotateX(90.0f);
-	backwall_transform->Scale(20000.0f, 20000.0f, 1.0f);
+	backwall_transform->LoadMatrix(kBackWall);
 
-	// Front wall is rotated -90 degrees about x: (z -> y)
+	// Front wall is rotated -90 degrees about x: (z -> y), then 180 about z
+	constexpr Matrix4x4 kFrontWall = FixedTransform(0.0f, -10000.0f, 0.0f,
+		-1, 0, -2, 20000.0f, 20000.0f, 1.0f);
 	TransformNode* frontwall_transform = new TransformNode;
-	frontwall_transform->Translate(0.0f, -10000.0f, 0.0f);
-	frontwall_transform->RotateX(-90.0f);
-	frontwall_transform->RotateZ(-180.0f);
-	frontwall_transform->Scale(20000.0f, 20000.0f, 1.0f);
+	frontwall_transform->LoadMatrix(kFrontWall);
 
-	// Left wall is rotated 90 degrees about y: (z -> x)
+	// Left wall is rotated 90 degrees about y: (z -> x), then 90 about z
+	constexpr Matrix4x4 kLeftWall = FixedTransform(-10000.0f, 0.0f, 0.0f,
+		0, 1, 1, 20000.0f, 20000.0f, 1.0f);
 	TransformNode* leftwall_transform = new TransformNode;
-	leftwall_transform->Translate(-10000.0f, 0.0f, 0.0f);
-	leftwall_transform->RotateY(90.0f);
-	leftwall_transform->RotateZ(90.0f);
-	leftwall_transform->Scale(20000.0f, 20000.0f, 1.0f);
+	leftwall_transform->LoadMatrix(kLeftWall);
 
-	// Right wall is rotated -90 about y: (z -> -x)
+	// Right wall is rotated -90 about y: (z -> -x), then -90 about z
+	constexpr Matrix4x4 kRightWall = FixedTransform(10000.0f, 0.0f, 0.0f,
+		0, -1, -1, 20000.0f, 20000.0f, 1.0f);
 	TransformNode* rightwall_transform = new TransformNode;
-	rightwall_transform->Translate(10000.0f, 0.0f, 0.0f);
-	rightwall_transform->RotateY(-90.0f);
-	rightwall_transform->RotateZ(-90.0f);
-	rightwall_transform->Scale(20000.0f, 20000.0f, 1.0f);
+	rightwall_transform->LoadMatrix(kRightWall);
 
 	// Ceiling is rotated 180 about x so it faces inwards
+	constexpr Matrix4x4 kCeiling = FixedTransform(0.0f, 0.0f, 10000.0f,
+		2, 0, 0, 20500.0f, 20000.0f, 1.0f);
 	TransformNode* ceiling_transform = new TransformNode;
-	ceiling_transform->Translate(0.0f, 0.0f, 10000.0f);
-	ceiling_transform->RotateX(180.0f);
-	ceiling_transform->RotateZ(0.0f);
-	ceiling_transform->Scale(20500.0f, 20000.0f, 1.0f);
+	ceiling_transform->LoadMatrix(kCeiling);
 
 	PresentationNode* backwall_material = new PresentationNode(Color4(0.5f, 0.5f, 0.5f),
 		Color4(0.0f, 0.0f, 0.0f), Color4(0.0f, 0.0f, 0.0f), Color4(0.3f, 0.3f, 0.3f), 0.0f);
@@ -615,6 +684,7 @@ SceneNode* ConstructFire(TexturedUnitSquareSurface* textured_square)
 	for (int i = 0; i < 50; i++)
 	{
 		ParticleNode* fire_particle_effect = new ParticleNode(FRAMES_PER_SEC);
+		fire_particle_effect->SetSnapshot(&ParticleTransforms);
 		fire_particle_material->AddChild(fire_particle_effect);
 		fire_particle_effect->AddChild(firebox);
 	}
@@ -648,9 +718,9 @@ void ConstructScene() {
   // Scene is outdoor, so set far clipping to very far
   MyCamera->SetPerspective(50.0, 1.0, 1.0, 25000.0);
 
-  // Set world light default position and a light rotation matrix
+  // Set world light default position
+  WorldLightStart.Set(50.0f, -50.0f, 50.0f);
   WorldLightPosition = { 50.0f, -50.0f, 50.f, 1.0f };
-  LightTransform.Rotate(2.0f, 0.0f, 0.0f, 1.0f);
 
   // Construct scene lighting - make lighting nodes children of the camera node
   ConstructLighting(lightingShader);
@@ -685,7 +755,7 @@ void ConstructScene() {
   SceneNode* ground = ConstructGround(textured_square);
 
   // Construct the trees
-  SceneNode* trees = ConstructTrees(tree_textured_square);
+  SceneNode* trees = ConstructTrees(tree_textured_square, position_loc, normal_loc, texture_loc);
 
   // Fire transform
   TransformNode* fire_transform = new TransformNode;
@@ -714,7 +784,13 @@ void ConstructScene() {
   // of the last light node (so entire scene is under influence of all 
   // lights)
   SceneNode* myscene = new SceneNode;
-  Spotlight->AddChild(myscene);
+
+  // Draw the scene through a render list: the graph is flattened once
+  // (and again only if nodes are added or removed) rather than walked
+  // every frame
+  SceneRenderList = new RenderListNode;
+  Spotlight->AddChild(SceneRenderList);
+  SceneRenderList->AddChild(myscene);
 
   // Changing where the moon is oriented
   TransformNode* skybox_transform = new TransformNode();
@@ -765,13 +841,29 @@ void ConstructScene() {
 void display() {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  // Draw the scene graph
-  SceneState MySceneState;
+  // Draw the scene graph. Static so the transform stack is not rebuilt
+  // on the program stack each frame.
+  static SceneState MySceneState;
   MySceneState.Init();
+  FrameMemory.Reset();
+  MySceneState.arena = &FrameMemory;
+
+  // Draw the newest complete simulation step
+  ParticleTransforms.Apply();
   SceneRoot->Draw(MySceneState);
 
   // Swap buffers
   glutSwapBuffers();
+  FrameGLStats = GLStateCache::Get().EndFrame();
+
+#ifdef COUNT_ALLOCATIONS
+  // Steady state frames should not allocate
+  size_t bytes;
+  size_t count = AllocationCounter::EndFrame(&bytes);
+  if (count > 0)
+    logmsg("Frame made %u heap allocations (%u bytes)\n",
+           static_cast<uint32_t>(count), static_cast<uint32_t>(bytes));
+#endif
 }
 
 /**
@@ -863,6 +955,21 @@ void keyboard(unsigned char key, int x, int y) {
 		lightingShader->EnableFog(fogColor);
 		break;
 
+        // Toggle view frustum culling and log the last frame's statistics
+    case 'c': {
+        const CullStats& stats = SceneRenderList->GetRenderList().GetCullStats();
+        const SortStats& sort_stats = SceneRenderList->GetRenderList().GetSortStats();
+        logmsg("Culling %s: %u volumes tested, %u subtrees culled, %u draws\n",
+               CullingEnabled ? "on" : "off", stats.visited, stats.culled, stats.drawn);
+        logmsg("State sorting: %u state changes (%d saved)\n", sort_stats.state_changes,
+               (int)sort_stats.unsorted_state_changes - (int)sort_stats.state_changes);
+        logmsg("GL state cache: %u calls issued, %u redundant calls skipped\n",
+               FrameGLStats.issued, FrameGLStats.elided);
+        CullingEnabled = !CullingEnabled;
+        SceneRenderList->GetRenderList().SetCulling(CullingEnabled);
+        break;
+    }
+
     default:
         break;
     }
@@ -945,11 +1052,12 @@ int main(int argc, char** argv) {
     std::cout << "p,P - Change camera pitch" << std::endl;
     std::cout << "h,H - Change camera heading" << std::endl;
     std::cout << "b   - View back of object" << std::endl;
-    std::cout << "i   - Initialize view" << std::endl << std::endl;
+    std::cout << "i   - Initialize view" << std::endl;
+    std::cout << "c   - Toggle view frustum culling" << std::endl << std::endl;
 
   // Initialize free GLUT
   glutInit(&argc, argv);
-  glutInitContextVersion(3, 2);
+  glutInitContextVersion(3, 3);
   glutInitContextProfile(GLUT_CORE_PROFILE);
 
   // Set up depth buffer and double buffering
@@ -981,13 +1089,17 @@ int main(int argc, char** argv) {
   // Set the clear color to white
   glClearColor(0.3f, 0.3f, 0.5f, 0.0f);
 
+  // All state changes of the scene go through the state cache, so it
+  // can skip the redundant ones
+  GLStateCache::Get().SetEnabled(true);
+
   // Enable the depth buffer
-  glEnable(GL_DEPTH_TEST);
+  GLStateCache::Get().Enable(GL_DEPTH_TEST);
 
   // Enable back face polygon removal
   glFrontFace(GL_CCW);
   glCullFace(GL_BACK);
-  glEnable(GL_CULL_FACE);
+  GLStateCache::Get().Enable(GL_CULL_FACE);
 
   // Enable multisample anti-aliasing
   glEnable(GL_MULTISAMPLE);
@@ -995,7 +1107,10 @@ int main(int argc, char** argv) {
   // Construct the scene.
   ConstructScene();
 
-  // Set update rate and set initial timer callback
+  // Start the simulation and set the initial redisplay timer callback
+  Simulation.reset(new SimulationThread(SceneRoot, &ParticleTransforms, FRAMES_PER_SEC,
+                                        &UpdatePool));
+  Simulation->Start();
   glutTimerFunc((int)(1000.0f / FRAMES_PER_SEC), AnimateParticles, 0);
 
   glutMainLoop();
@@ -102,7 +102,7 @@ private:
 
   // Place a point on a unit sphere
   void Normalize(Point3& p) {
-    float inv = FastInvSqrt(p.x * p.x  + p.y * p.y + p.z * p.z);
+    float inv = FastRsqrt(p.x * p.x  + p.y * p.y + p.z * p.z);
     p.x *= inv;
     p.y *= inv;
     p.z *= inv;
@@ -39,7 +39,7 @@ std::vector<Point3> FormPentagon(const Point3& v0, const Point3& v1,
  * @param  v2   Vertex 0 of the triangle.
  * @return Returns the center of the triangle.
  */
-Point3 dual(const Point3& v0, const Point3& v1, const Point3& v2) {
+constexpr Point3 dual(const Point3& v0, const Point3& v1, const Point3& v2) {
    return Point3((v0.x + v1.x + v2.x) * 0.33333f,
                  (v0.y + v1.y + v2.y) * 0.33333f,
                  (v0.z + v1.z + v2.z) * 0.33333f);
@@ -108,10 +108,10 @@ SceneNode* ConstructCube(int n, const int position_loc, const int normal_loc,
  */
 TriSurface* ConstructTetrahedron(const int position_loc, const int normal_loc) {
    // Vertices of the tetrahedron
-   Point3 v0( 1.0f,  1.0f,  1.0f);
-   Point3 v1( 1.0f, -1.0f, -1.0f);
-   Point3 v2(-1.0f, -1.0f,  1.0f);
-   Point3 v3(-1.0f,  1.0f, -1.0f);
+   constexpr Point3 v0( 1.0f,  1.0f,  1.0f);
+   constexpr Point3 v1( 1.0f, -1.0f, -1.0f);
+   constexpr Point3 v2(-1.0f, -1.0f,  1.0f);
+   constexpr Point3 v3(-1.0f,  1.0f, -1.0f);
 
    // Create faces as children of a base scene node
    TriSurface* tetrahedron = new TriSurface();
@@ -128,12 +128,12 @@ TriSurface* ConstructTetrahedron(const int position_loc, const int normal_loc) {
  */
 TriSurface* ConstructOctahedron(const int position_loc, const int normal_loc) {
    // 6 vertices of the octahedron
-   Point3 v0( 0.0f,  0.0f,  0.5f);
-   Point3 v1( 0.0f,  0.0f, -0.5f);
-   Point3 v2(-0.5f,  0.0f,  0.0f);
-   Point3 v3( 0.5f,  0.0f,  0.0f);
-   Point3 v4( 0.0f,  0.5f,  0.0f);
-   Point3 v5( 0.0f, -0.5f,  0.0f);
+   constexpr Point3 v0( 0.0f,  0.0f,  0.5f);
+   constexpr Point3 v1( 0.0f,  0.0f, -0.5f);
+   constexpr Point3 v2(-0.5f,  0.0f,  0.0f);
+   constexpr Point3 v3( 0.5f,  0.0f,  0.0f);
+   constexpr Point3 v4( 0.0f,  0.5f,  0.0f);
+   constexpr Point3 v5( 0.0f, -0.5f,  0.0f);
 
    // Create faces as children of a base scene node
    TriSurface* octahedron = new TriSurface;
@@ -154,19 +154,19 @@ TriSurface* ConstructOctahedron(const int position_loc, const int normal_loc) {
  */
 TriSurface* ConstructIcosahedron(const int position_loc, const int normal_loc) {
    // Vertices of the icosahedron
-   float t = 0.618f;
-   Point3 v0( 0.0f,  1.0f,  t);
-   Point3 v1( 0.0f,  1.0f, -t);
-   Point3 v2( 1.0f,   t,  0.0f);
-   Point3 v3( 1.0f,  -t,  0.0f);
-   Point3 v4( 0.0f, -1.0f,  -t);
-   Point3 v5( 0.0f, -1.0f,   t);
-   Point3 v6(  t, 0.0f,  1.0f);
-   Point3 v7( -t, 0.0f,  1.0f);
-   Point3 v8(  t, 0.0f,  -1.0f);
-   Point3 v9( -t, 0.0f,  -1.0f);
-   Point3 v10(-1.0f,  t,  0.0f);
-   Point3 v11(-1.0f, -t,  0.0f);
+   constexpr float t = 0.618f;
+   constexpr Point3 v0( 0.0f,  1.0f,  t);
+   constexpr Point3 v1( 0.0f,  1.0f, -t);
+   constexpr Point3 v2( 1.0f,   t,  0.0f);
+   constexpr Point3 v3( 1.0f,  -t,  0.0f);
+   constexpr Point3 v4( 0.0f, -1.0f,  -t);
+   constexpr Point3 v5( 0.0f, -1.0f,   t);
+   constexpr Point3 v6(  t, 0.0f,  1.0f);
+   constexpr Point3 v7( -t, 0.0f,  1.0f);
+   constexpr Point3 v8(  t, 0.0f,  -1.0f);
+   constexpr Point3 v9( -t, 0.0f,  -1.0f);
+   constexpr Point3 v10(-1.0f,  t,  0.0f);
+   constexpr Point3 v11(-1.0f, -t,  0.0f);
 
    // Create faces as children of a base scene node
    TriSurface* icosahedron = new TriSurface;
@@ -199,41 +199,41 @@ TriSurface* ConstructIcosahedron(const int position_loc, const int normal_loc) {
  */
 TriSurface* ConstructDodecahedron(const int position_loc, const int normal_loc) {
    // Vertices of the icosahedron
-   float t = 0.618f;
-   Point3 iv0( 0.0f,  1.0f,  t);
-   Point3 iv1( 0.0f,  1.0f, -t);
-   Point3 iv2( 1.0f,   t,  0.0f);
-   Point3 iv3( 1.0f,  -t,  0.0f);
-   Point3 iv4( 0.0f, -1.0f,  -t);
-   Point3 iv5( 0.0f, -1.0f,   t);
-   Point3 iv6(  t, 0.0f,  1.0f);
-   Point3 iv7( -t, 0.0f,  1.0f);
-   Point3 iv8(  t, 0.0f,  -1.0f);
-   Point3 iv9( -t, 0.0f,  -1.0f);
-   Point3 iv10(-1.0f,  t,  0.0f);
-   Point3 iv11(-1.0f, -t,  0.0f);
+   constexpr float t = 0.618f;
+   constexpr Point3 iv0( 0.0f,  1.0f,  t);
+   constexpr Point3 iv1( 0.0f,  1.0f, -t);
+   constexpr Point3 iv2( 1.0f,   t,  0.0f);
+   constexpr Point3 iv3( 1.0f,  -t,  0.0f);
+   constexpr Point3 iv4( 0.0f, -1.0f,  -t);
+   constexpr Point3 iv5( 0.0f, -1.0f,   t);
+   constexpr Point3 iv6(  t, 0.0f,  1.0f);
+   constexpr Point3 iv7( -t, 0.0f,  1.0f);
+   constexpr Point3 iv8(  t, 0.0f,  -1.0f);
+   constexpr Point3 iv9( -t, 0.0f,  -1.0f);
+   constexpr Point3 iv10(-1.0f,  t,  0.0f);
+   constexpr Point3 iv11(-1.0f, -t,  0.0f);
 
    // Vertices of the dodecahecdron are formed by the dual of the icosahedron
-   Point3 v0  = dual(iv0, iv6, iv2);
-   Point3 v1  = dual(iv6, iv3, iv2);
-   Point3 v2  = dual(iv6, iv5, iv3);
-   Point3 v3  = dual(iv7, iv5, iv6);
-   Point3 v4  = dual(iv7, iv6, iv0);
-   Point3 v5  = dual(iv2, iv3, iv8);
-   Point3 v6  = dual(iv1, iv2, iv8);
-   Point3 v7  = dual(iv0, iv2, iv1);
-   Point3 v8  = dual(iv10, iv0, iv1);
-   Point3 v9  = dual(iv10, iv1, iv9);
-   Point3 v10 = dual(iv1, iv8, iv9);
-   Point3 v11 = dual(iv3, iv4, iv8);
-   Point3 v12 = dual(iv5, iv4, iv3);
-   Point3 v13 = dual(iv11, iv4, iv5);
-   Point3 v14 = dual(iv11, iv7, iv10);
-   Point3 v15 = dual(iv7, iv0, iv10);
-   Point3 v16 = dual(iv9, iv4, iv11);
-   Point3 v17 = dual(iv9, iv8, iv4);
-   Point3 v18 = dual(iv11, iv5, iv7);
-   Point3 v19 = dual(iv11, iv10, iv9);
+   constexpr Point3 v0  = dual(iv0, iv6, iv2);
+   constexpr Point3 v1  = dual(iv6, iv3, iv2);
+   constexpr Point3 v2  = dual(iv6, iv5, iv3);
+   constexpr Point3 v3  = dual(iv7, iv5, iv6);
+   constexpr Point3 v4  = dual(iv7, iv6, iv0);
+   constexpr Point3 v5  = dual(iv2, iv3, iv8);
+   constexpr Point3 v6  = dual(iv1, iv2, iv8);
+   constexpr Point3 v7  = dual(iv0, iv2, iv1);
+   constexpr Point3 v8  = dual(iv10, iv0, iv1);
+   constexpr Point3 v9  = dual(iv10, iv1, iv9);
+   constexpr Point3 v10 = dual(iv1, iv8, iv9);
+   constexpr Point3 v11 = dual(iv3, iv4, iv8);
+   constexpr Point3 v12 = dual(iv5, iv4, iv3);
+   constexpr Point3 v13 = dual(iv11, iv4, iv5);
+   constexpr Point3 v14 = dual(iv11, iv7, iv10);
+   constexpr Point3 v15 = dual(iv7, iv0, iv10);
+   constexpr Point3 v16 = dual(iv9, iv4, iv11);
+   constexpr Point3 v17 = dual(iv9, iv8, iv4);
+   constexpr Point3 v18 = dual(iv11, iv5, iv7);
+   constexpr Point3 v19 = dual(iv11, iv10, iv9);
 
    // Form pentagonal faces
    TriSurface* dodecahedron = new TriSurface;
@@ -288,19 +288,19 @@ std::vector<Point3> divideFace(const Point3& v0, const Point3& v1, const Point3&
  */
 TriSurface* ConstructBuckyball(const int position_loc, const int normal_loc) {
    // Vertices of the icosahedron
-   float t = 0.618f;
-   Point3 v0( 0.0f,  1.0f,  t);
-   Point3 v1( 0.0f,  1.0f, -t);
-   Point3 v2( 1.0f,   t,  0.0f);
-   Point3 v3( 1.0f,  -t,  0.0f);
-   Point3 v4( 0.0f, -1.0f,  -t);
-   Point3 v5( 0.0f, -1.0f,   t);
-   Point3 v6(  t, 0.0f,  1.0f);
-   Point3 v7( -t, 0.0f,  1.0f);
-   Point3 v8(  t, 0.0f,  -1.0f);
-   Point3 v9( -t, 0.0f,  -1.0f);
-   Point3 v10(-1.0f,  t,  0.0f);
-   Point3 v11(-1.0f, -t,  0.0f);
+   constexpr float t = 0.618f;
+   constexpr Point3 v0( 0.0f,  1.0f,  t);
+   constexpr Point3 v1( 0.0f,  1.0f, -t);
+   constexpr Point3 v2( 1.0f,   t,  0.0f);
+   constexpr Point3 v3( 1.0f,  -t,  0.0f);
+   constexpr Point3 v4( 0.0f, -1.0f,  -t);
+   constexpr Point3 v5( 0.0f, -1.0f,   t);
+   constexpr Point3 v6(  t, 0.0f,  1.0f);
+   constexpr Point3 v7( -t, 0.0f,  1.0f);
+   constexpr Point3 v8(  t, 0.0f,  -1.0f);
+   constexpr Point3 v9( -t, 0.0f,  -1.0f);
+   constexpr Point3 v10(-1.0f,  t,  0.0f);
+   constexpr Point3 v11(-1.0f, -t,  0.0f);
 
    // Replace each triangular face with a hexagon
    TriSurface* buckyball = new TriSurface;
@@ -16,10 +16,20 @@
 #include "scene/scene.h"
 
 /**
- * Lighting shader node.
+ * Lighting shader node. The shader reads its uniforms from std140
+ * uniform blocks (see uniformring.h): the frame block (camera, lights,
+ * fog), the material block and the draw block (transform). The nodes
+ * below write them to a uniform ring owned by this node.
  */
 class LightingShaderNode: public ShaderNode {
 public:
+   /**
+    * Constructor. No lights, no fog and black global ambient.
+    */
+   LightingShaderNode()
+     : frame_defaults() {
+   }
+
    /**
     * Gets uniform and attribute locations.
     */
@@ -39,79 +49,32 @@ public:
       std::cout << "LightingShaderNode: Error getting vertex texture location" << std::endl;
       return false;
     }
-
-    globalambient_loc = glGetUniformLocation(shader_program.GetProgram(), "globalLightAmbient");
-    if (globalambient_loc < 0) {
-      std::cout << "LightingShaderNode: Error getting global ambient location" << std::endl;
+    instance_loc = glGetAttribLocation(shader_program.GetProgram(), "instanceMatrix");
+    if (instance_loc < 0) {
+      std::cout << "LightingShaderNode: Error getting instance matrix location" << std::endl;
       return false;
     }
-
-    // Set the number of lights to 3
-    light_count = 3;
-    lightcount_loc = glGetUniformLocation(shader_program.GetProgram(), "numLights");
-    if (lightcount_loc < 0) {
-      std::cout << "LightingShaderNode: Error getting numLights Loc location" << std::endl;
+    instancescale_loc = glGetAttribLocation(shader_program.GetProgram(), "instanceScale");
+    if (instancescale_loc < 0) {
+      std::cout << "LightingShaderNode: Error getting instance scale location" << std::endl;
       return false;
     }
 
-    // Get light uniforms
-    char name[128];
-    for (int i = 0; i < light_count; i++) {
-      sprintf(name, "lights[%d].enabled", i);
-      lights[i].enabled = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].spotlight", i);
-      lights[i].spotlight = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].position", i);
-      lights[i].position = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].ambient", i);
-      lights[i].ambient = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].diffuse", i);
-      lights[i].diffuse = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].specular", i);
-      lights[i].specular = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].constantAttenuation", i);
-      lights[i].att_constant = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].linearAttenuation", i);
-      lights[i].att_linear = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].quadraticAttenuation", i);
-      lights[i].att_quadratic = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].spotCosCutoff", i);
-      lights[i].spot_cutoffcos = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].spotExponent", i);
-      lights[i].spot_exponent = glGetUniformLocation(shader_program.GetProgram(), name);
-      sprintf(name, "lights[%d].spotDirection", i);
-      lights[i].spot_direction = glGetUniformLocation(shader_program.GetProgram(), name);
-    }
-      
-    // Populate matrix uniform locations in scene state
-    pvm_loc = glGetUniformLocation(shader_program.GetProgram(), "pvm");
-	projectmatrix_loc = glGetUniformLocation(shader_program.GetProgram(), "projectionMatrix");
-    modelmatrix_loc = glGetUniformLocation(shader_program.GetProgram(), "modelMatrix");
-	viewmatrix_loc = glGetUniformLocation(shader_program.GetProgram(), "viewMatrix");
-    normalmatrix_loc = glGetUniformLocation(shader_program.GetProgram(), "normalMatrix");
-  
-    // Populate material uniform locations in scene state 
-    materialambient_loc   = glGetUniformLocation(shader_program.GetProgram(), "materialAmbient");
-    materialdiffuse_loc   = glGetUniformLocation(shader_program.GetProgram(), "materialDiffuse");
-    materialspecular_loc  = glGetUniformLocation(shader_program.GetProgram(), "materialSpecular");
-    materialemission_loc  = glGetUniformLocation(shader_program.GetProgram(), "materialEmission");
-    materialshininess_loc = glGetUniformLocation(shader_program.GetProgram(), "materialShininess");
-
-    // Populate texture locations
-    usetexture_loc = glGetUniformLocation(shader_program.GetProgram(), "useTexture");
-    textureunit_loc = glGetUniformLocation(shader_program.GetProgram(), "texImage");
-
-	// Populate fog locations
-	usefog_loc = glGetUniformLocation(shader_program.GetProgram(), "useFog");
-	fogcolor_loc = glGetUniformLocation(shader_program.GetProgram(), "fogColor");
+    // Uniform blocks. GLSL 1.50 has no binding layout qualifier, so the
+    // binding points are assigned here.
+    if (!BindBlock("FrameBlock", kFrameBlockBinding) ||
+        !BindBlock("MaterialBlock", kMaterialBlockBinding) ||
+        !BindBlock("DrawBlock", kDrawBlockBinding))
+      return false;
 
-	// Billboard uniform locations
-	enablebillboard_loc = glGetUniformLocation(shader_program.GetProgram(), "enableBillboard");
-    scalex_loc = glGetUniformLocation(shader_program.GetProgram(), "scaleX");
-    scaley_loc = glGetUniformLocation(shader_program.GetProgram(), "scaleY");
+    // Uniforms outside the blocks: the texture sampler (always texture
+    // unit 0) and the instanced drawing flag (see InstancedGeometryNode)
+    textureunit_loc = glGetUniformLocation(shader_program.GetProgram(), "texImage");
+    enableinstancing_loc = glGetUniformLocation(shader_program.GetProgram(), "enableInstancing");
+    GLStateCache::Get().UseProgram(shader_program.GetProgram());
+    GLStateCache::Get().Uniform1i(textureunit_loc, 0);
 
-    // Populate camera position uniform location in scene state
-    cameraposition_loc = glGetUniformLocation(shader_program.GetProgram(), "cameraPosition");
+    uniform_ring.Create();
     return true;
   }
 
@@ -122,46 +85,36 @@ public:
   */
   virtual void Draw(SceneState& scene_state) {
     // Enable this program
-    shader_program.Use();
+    GLStateCache::Get().UseProgram(shader_program.GetProgram());
 
     // Set scene state locations to ones needed for this program
-    scene_state.lightcount_loc = lightcount_loc;
     scene_state.position_loc = position_loc;
     scene_state.normal_loc = normal_loc;
-    scene_state.cameraposition_loc = cameraposition_loc;
-    scene_state.pvm_loc = pvm_loc;
-	scene_state.projectmatrix_loc = projectmatrix_loc;
-    scene_state.modelmatrix_loc = modelmatrix_loc;
-	scene_state.viewmatrix_loc = viewmatrix_loc;
-    scene_state.normalmatrix_loc = normalmatrix_loc;
-    scene_state.materialambient_loc = materialambient_loc;
-    scene_state.materialdiffuse_loc = materialdiffuse_loc;
-    scene_state.materialspecular_loc = materialspecular_loc;
-    scene_state.materialemission_loc = materialemission_loc;
-    scene_state.materialshininess_loc = materialshininess_loc;
-    scene_state.usetexture_loc = usetexture_loc;
     scene_state.textureunit_loc = textureunit_loc;
-	scene_state.usefog_loc = usefog_loc;
-	scene_state.fogcolor_loc = fogcolor_loc;
-	scene_state.enablebillboard_loc = enablebillboard_loc;
-	scene_state.scalex_loc = scalex_loc;
-	scene_state.scaley_loc = scaley_loc;
-
-    // Set the light locations
-    for (int i = 0; i < light_count; i++) {
-      scene_state.lights[i] = lights[i];
-    }
+    scene_state.enableinstancing_loc = enableinstancing_loc;
+
+    // Uniforms are set through blocks in the uniform ring. Start the frame
+    // with the global lighting and fog, no material and no modeling
+    // transform, so every block is bound before anything is drawn.
+    uniform_ring.BeginFrame();
+    scene_state.uniform_ring = &uniform_ring;
+    scene_state.frame_uniforms = frame_defaults;
+    scene_state.material_uniforms = MaterialUniforms();
+    scene_state.UploadFrameUniforms();
+    scene_state.UploadMaterialUniforms();
+    Matrix4x4 identity;
+    scene_state.UploadDrawUniforms(identity, identity, identity, 1.0f);
 
     // Draw all children
     SceneNode::Draw(scene_state);
+    scene_state.uniform_ring = nullptr;
   }
 
   /**
    * Set the lighting
    */
   void SetGlobalAmbient(const Color4& global_ambient) {
-    shader_program.Use();
-    glUniform4fv(globalambient_loc, 1, &global_ambient.r);
+    frame_defaults.globalLightAmbient = global_ambient;
   }
 
 
@@ -170,12 +123,16 @@ public:
    */
   void SetLight(const unsigned int n, const HPoint3& position, const Color4& ambient,
                 const Color4& diffuse, const Color4& specular) {
-    shader_program.Use();
-    glUniform1i(lights[n].enabled, 1);
-    glUniform4fv(lights[n].position, 1, &position.x);
-    glUniform4fv(lights[n].ambient, 1, &ambient.r);
-    glUniform4fv(lights[n].diffuse, 1, &diffuse.r);
-    glUniform4fv(lights[n].specular, 1, &specular.r);
+    if (n >= kMaxBlockLights)
+      return;
+    LightBlock& light = frame_defaults.lights[n];
+    light.enabled = 1;
+    light.position = position;
+    light.ambient = ambient;
+    light.diffuse = diffuse;
+    light.specular = specular;
+    if ((int32_t)n >= frame_defaults.numLights)
+      frame_defaults.numLights = n + 1;
   }
 
   /**
@@ -185,9 +142,8 @@ public:
   */
   void EnableFog(const Color4& fogColor)
   {
-	  shader_program.Use();
-	  glUniform1i(usefog_loc, 1);
-	  glUniform4fv(fogcolor_loc, 1, &fogColor.r);
+	  frame_defaults.useFog = 1;
+	  frame_defaults.fogColor = fogColor;
   }
 
   /**
@@ -195,7 +151,7 @@ public:
   */
   void DisableFog()
   {
-	  glUniform1i(usefog_loc, 0);
+	  frame_defaults.useFog = 0;
   }
 
   /**
@@ -222,34 +178,46 @@ public:
     return texture_loc;
   }
 
+  /**
+   * Get the location of the instance transform attribute (3 consecutive
+   * locations, one per row).
+   * @return  Returns the instance transform attribute location.
+   */
+  int GetInstanceLoc() const {
+    return instance_loc;
+  }
+
+  /**
+   * Get the location of the instance billboard scale attribute.
+   * @return  Returns the instance scale attribute location.
+   */
+  int GetInstanceScaleLoc() const {
+    return instancescale_loc;
+  }
+
 protected:
    // Uniform and attribute locations
    GLint position_loc;
    GLint normal_loc;
    GLint texture_loc;
-   GLint pvm_loc;
-   GLint projectmatrix_loc;
-   GLint modelmatrix_loc;
-   GLint viewmatrix_loc;
-   GLint normalmatrix_loc;
-   GLint materialambient_loc;
-   GLint materialdiffuse_loc;
-   GLint materialspecular_loc;
-   GLint materialemission_loc;
-   GLint materialshininess_loc;
-   GLint cameraposition_loc;
-   GLint globalambient_loc;
-   GLint usetexture_loc;
+   GLint instance_loc;
+   GLint instancescale_loc;
    GLint textureunit_loc;
-   GLint usefog_loc;
-   GLint fogcolor_loc;
-   GLint enablebillboard_loc;
-   GLint scalex_loc;
-   GLint scaley_loc;
-
-   int light_count;
-   GLint lightcount_loc;
-   LightUniforms lights[10];
+   GLint enableinstancing_loc;
+
+   UniformRing   uniform_ring;     // Uniform block data
+   FrameUniforms frame_defaults;   // Global lighting and fog (frame block)
+
+   // Assigns a binding point to a uniform block
+   bool BindBlock(const char* name, const GLuint binding) {
+     GLuint block = glGetUniformBlockIndex(shader_program.GetProgram(), name);
+     if (block == GL_INVALID_INDEX) {
+       std::cout << "LightingShaderNode: Error getting " << name << " block index" << std::endl;
+       return false;
+     }
+     glUniformBlockBinding(shader_program.GetProgram(), block, binding);
+     return true;
+   }
 };
 
 #endif
\ No newline at end of file
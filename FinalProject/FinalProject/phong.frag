@@ -11,31 +11,7 @@ smooth in vec2 texPos;  // texture coordinate
 
 in vec4 viewSpace;
 
-// Uniforms for material properties
-uniform vec4   materialAmbient;
-uniform	vec4   materialDiffuse;
-uniform	vec4   materialSpecular;
-uniform	vec4   materialEmission;
-uniform	float  materialShininess;
-
-// Texture uniforms
-uniform int useTexture;
-uniform	sampler2D texImage;
-
-// Fog uniforms
-uniform int useFog;
-uniform vec4 fogColor;
-
-// Global lighting environment ambient intensity
-uniform vec4  globalLightAmbient;
-
-// Camera position in world coordinates
-uniform vec3  cameraPosition;
-
-// Number of active lights
-uniform int numLights;
-
-// Structure for a light source. Allow up to 8 lights.
+// Structure for a light source. Allow up to 3 lights.
 const int MAX_LIGHTS = 3; 
 struct LightSource
 {
@@ -52,7 +28,48 @@ struct LightSource
 	float spotExponent;
 	vec3  spotDirection;
 };
-uniform LightSource lights[MAX_LIGHTS]; 
+
+// Uniform blocks (std140). The application writes them to a uniform
+// buffer (see uniformring.h) and the layouts must match the structures
+// there. Both shaders declare all 3 blocks.
+
+// Per-frame: camera, lights and fog
+layout(std140) uniform FrameBlock
+{
+	mat4 viewMatrix;            // View matrix
+	mat4 projectionMatrix;      // Projection  matrix
+	vec3 cameraPosition;        // Camera position in world coordinates
+	vec4 globalLightAmbient;    // Global lighting environment ambient intensity
+	vec4 fogColor;
+	int  numLights;             // Number of active lights
+	int  useFog;
+	LightSource lights[MAX_LIGHTS];
+};
+
+// Material properties
+layout(std140) uniform MaterialBlock
+{
+	vec4  materialAmbient;
+	vec4  materialDiffuse;
+	vec4  materialSpecular;
+	vec4  materialEmission;
+	float materialShininess;
+	int   useTexture;
+	int   enableBillboard;      // Cylindrical billboard (like a tree)
+};
+
+// Transform of the geometry drawn
+layout(std140) uniform DrawBlock
+{
+	mat4  pvm;                  // Composite projection, view, model matrix
+	mat4  modelMatrix;          // Modeling  matrix
+	mat4  normalMatrix;         // Normal transformation matrix
+	float scaleX;               // Billboard scale
+	float scaleY;
+};
+
+// Texture sampler (texture unit 0)
+uniform	sampler2D texImage;
 
 // Convenience method to compute attenuation for the ith light source
 // given a distance
@@ -10,17 +10,71 @@ in vec3 vertexPosition;		// Vertex position attribute
 in vec3 vertexNormal;		// Vertex normal attribute
 in vec2 texturePosition;     // Texture coordinate
 
-// Uniforms for matrices
-uniform mat4 pvm;					// Composite projection, view, model matrix
-uniform mat4 projectionMatrix;	    // Projection  matrix
-uniform mat4 modelMatrix;			// Modeling  matrix
-uniform mat4 viewMatrix;            // View matrix
-uniform mat4 normalMatrix;			// Normal transformation matrix
-
-// Enable this texture to be a cylindrical billboard (like a tree)
-uniform int enableBillboard;
-uniform float scaleX;
-uniform float scaleY;
+// Per-instance attributes (instanced drawing): rows of the instance's
+// modeling transform and its billboard scale
+in mat3x4 instanceMatrix;
+in vec2   instanceScale;
+
+// Structure for a light source. Allow up to 3 lights.
+const int MAX_LIGHTS = 3; 
+struct LightSource
+{
+	int  enabled;
+	int  spotlight;
+	vec4 position;
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	float constantAttenuation;
+	float linearAttenuation;
+	float quadraticAttenuation;
+	float spotCosCutoff;
+	float spotExponent;
+	vec3  spotDirection;
+};
+
+// Uniform blocks (std140). The application writes them to a uniform
+// buffer (see uniformring.h) and the layouts must match the structures
+// there. Both shaders declare all 3 blocks.
+
+// Per-frame: camera, lights and fog
+layout(std140) uniform FrameBlock
+{
+	mat4 viewMatrix;            // View matrix
+	mat4 projectionMatrix;      // Projection  matrix
+	vec3 cameraPosition;        // Camera position in world coordinates
+	vec4 globalLightAmbient;    // Global lighting environment ambient intensity
+	vec4 fogColor;
+	int  numLights;             // Number of active lights
+	int  useFog;
+	LightSource lights[MAX_LIGHTS];
+};
+
+// Material properties
+layout(std140) uniform MaterialBlock
+{
+	vec4  materialAmbient;
+	vec4  materialDiffuse;
+	vec4  materialSpecular;
+	vec4  materialEmission;
+	float materialShininess;
+	int   useTexture;
+	int   enableBillboard;      // Cylindrical billboard (like a tree)
+};
+
+// Transform of the geometry drawn
+layout(std140) uniform DrawBlock
+{
+	mat4  pvm;                  // Composite projection, view, model matrix
+	mat4  modelMatrix;          // Modeling  matrix
+	mat4  normalMatrix;         // Normal transformation matrix
+	float scaleX;               // Billboard scale
+	float scaleY;
+};
+
+// Set when drawing instances: the modeling transform is modelMatrix times
+// the instance transform and the billboard scale is per instance
+uniform int enableInstancing;
 
 out vec4 viewSpace;
 
@@ -33,18 +87,31 @@ void main()
 	// Output interpolated texture position
 	texPos = texturePosition;
 
+	// Modeling transform, normal transform and billboard scale: from the
+	// uniforms, or per instance when drawing instances
+	mat4 model = modelMatrix;
+	mat3 normalTransform = mat3(normalMatrix);
+	vec2 billboardScale = vec2(scaleX, scaleY);
+	if (enableInstancing == 1)
+	{
+		model = modelMatrix * transpose(mat4(instanceMatrix[0], instanceMatrix[1],
+		                                     instanceMatrix[2], vec4(0.0, 0.0, 0.0, 1.0)));
+		normalTransform = transpose(inverse(mat3(model)));
+		billboardScale = instanceScale;
+	}
+
 	// Transform normal and position to world coords. 
-	normal = normalize(vec3(normalMatrix * vec4(vertexNormal, 0.0)));
-	vertex = vec3((modelMatrix * vec4(vertexPosition, 1.0)));
+	normal = normalize(normalTransform * vertexNormal);
+	vertex = vec3((model * vec4(vertexPosition, 1.0)));
 
-	mat4 modelViewMatrix = viewMatrix * modelMatrix;
+	mat4 modelViewMatrix = viewMatrix * model;
 
 	// If this is a billboard, rotate the x and z axis toward the camera
 	// Scale is used since this method needs to seperate scale from rotation
 	if (enableBillboard == 1)
 	{
 	    // X-axis
-		modelViewMatrix[0][0] = scaleX;
+		modelViewMatrix[0][0] = billboardScale.x;
 		modelViewMatrix[0][1] = 0.0;
 		modelViewMatrix[0][2] = 0.0;
 
@@ -56,7 +123,7 @@ void main()
 		// Y-axis (referenced as Z-axis online)
 		modelViewMatrix[2][0] = 0.0;
 		modelViewMatrix[2][1] = 0.0;
-		modelViewMatrix[2][2] = scaleY;
+		modelViewMatrix[2][2] = billboardScale.y;
 	}
 
 	// Convert position to clip coordinates and pass along
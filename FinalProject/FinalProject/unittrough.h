@@ -32,44 +32,31 @@ public:
    */
   UnitTrough(const uint32_t nsides, const uint32_t nstacks,
              const int position_loc, const int normal_loc) {
-    // Set a rotation matrix for the normals (only rotatiing 180 degrees)
+    // Set a rotation matrix for the sides (only rotatiing 180 degrees)
     Matrix4x4 m;
     m.RotateZ(180.0f / static_cast<float>(nsides));
 
-    // Create a normal at theta = 0 pointing inwards.
-    Vector3 n(-1.0f, 0.0f, 0.0f);
-
-    // Create a vertex list. Note that normals can be computed based
-    // on the difference in bottom and top radius. Note that we 
-    // change radius linearly from the bottom radius to top radius
-    uint32_t i, j;
+    // Create the side at theta = 0 with the normal pointing inwards.
+    uint32_t j;
     float z;
     float dz = 1.0f / nstacks;
-    float theta = 0.0f;
-    float dtheta = (kPi) / static_cast<float>(nsides);
     VertexAndNormal vtx;
-    for (i = 0; i <= nsides; i++, theta += dtheta) {
-      // Compute sin,cos to use in the loop below
-      float cos_theta = cosf(theta);
-      float sin_theta = sinf(theta);
-
-      // Set the normal for this side
-      vtx.normal = n;
-
-      // Form vertices along the side for this angle increment
-      for (j = 0, z = -0.5f; j <= nstacks; j++, z += dz) {
-        vtx.vertex.Set(cos_theta, sin_theta, z);
-        vertices.push_back(vtx);
-      }
-
-      // Rotate the normal for next angle
-      n = m * n;
+    vtx.normal.Set(-1.0f, 0.0f, 0.0f);
+    for (j = 0, z = -0.5f; j <= nstacks; j++, z += dz) {
+      vtx.vertex.Set(1.0f, 0.0f, z);
+      vertices.push_back(vtx);
     }
 
-    // Form triangle strip face indexes.
-    // Note: there are n+1 rows and n+1 columns.
+    // Each further side is the prior side rotated as a batch (vertices
+    // and normals). There are n+1 rows and n+1 columns.
     nrows = nstacks + 1;
     ncols = nsides  + 1;
+    vertices.resize(nrows * ncols);
+    for (uint32_t i = 1; i < ncols; i++) {
+      m.TransformVertices(&vertices[(i - 1) * nrows], &vertices[i * nrows], nrows);
+    }
+
+    // Form triangle strip face indexes.
     for (uint32_t row = 0; row < nrows - 1; row++) {
       // Repeat the first face index (unless the 1st row)
       if (row > 0) {
@@ -96,9 +83,9 @@ public:
   * Draw this geometry node.
   */
   void Draw(SceneState& scene_state) {
-    glBindVertexArray(vao);
+    GLStateCache::Get().BindVertexArray(vao);
     glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)face_count, GL_UNSIGNED_SHORT, (void*)0);
-    glBindVertexArray(0);
+    GLStateCache::Get().ReleaseVertexArray();
   }
 	
 private:
@@ -0,0 +1,1282 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    MathBenchmark.cpp
+//	Purpose: Headless benchmark of the geometry library. Times matrix,
+//          quaternion, vector, fast math, noise, ray, frustum and clipping
+//          operations and the task pool with warmup and repeated runs,
+//          checks the fast paths against the reference ones, and writes
+//          the results as CSV for regression tracking.
+//
+//          Usage: MathBenchmark [--reps n] [--warmup n] [--filter text]
+//                               [--out file.csv] [--baseline file.csv]
+//                               [--tolerance fraction]
+//          Exit code: 0 = pass, 1 = a check failed, 2 = a benchmark is
+//          slower than the baseline by more than the tolerance.
+//
+//============================================================================
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "geometry/geometry.h"
+
+// Logging function used by the geometry library. Messages go to stdout.
+void logmsg(const char *message, ...) {
+  va_list arg;
+  va_start(arg, message);
+  vprintf(message, arg);
+  putchar('\n');
+  va_end(arg);
+}
+
+// Number of items each benchmark processes per repetition. Large enough
+// that the timer resolution does not matter, small enough to stay in cache.
+const size_t kCount = 4096;
+
+// Results are accumulated here so the compiler cannot drop the work
+volatile float g_sink = 0.0f;
+
+/**
+ * Benchmark options (from the command line).
+ */
+struct Options {
+  int         reps      = 31;     // Timed repetitions per benchmark
+  int         warmup    = 3;      // Untimed repetitions first
+  float       tolerance = 0.25f;  // Allowed slowdown of the median vs. baseline
+  std::string filter;             // Run only benchmarks containing this text
+  std::string out       = "MathBenchmark.csv";
+  std::string baseline;
+};
+
+/**
+ * Timing statistics for one benchmark, in nanoseconds per item.
+ */
+struct Result {
+  std::string name;
+  float min;
+  float median;
+  float p90;
+  float p99;
+  float mean;
+};
+
+/**
+ * Gets a percentile of a sorted list (nearest rank).
+ * @param  sorted  Sorted values
+ * @param  pct     Percentile (0 to 100)
+ * @return  Returns the value at the percentile.
+ */
+float Percentile(const std::vector<float>& sorted, const float pct) {
+  size_t rank = static_cast<size_t>(pct / 100.0f * sorted.size() + 0.5f);
+  rank = std::min(std::max(rank, (size_t)1), sorted.size());
+  return sorted[rank - 1];
+}
+
+/**
+ * Runs a benchmark: warmup repetitions, then timed repetitions. Each
+ * repetition calls fn() once; fn processes kCount items and returns a value
+ * that depends on the results.
+ * @param  options  Benchmark options
+ * @param  name     Benchmark name
+ * @param  fn       Function to time
+ * @param  results  (OUT) Result is appended here.
+ */
+template <typename Function>
+void Run(const Options& options, const char* name, Function fn,
+         std::vector<Result>& results) {
+  if (!options.filter.empty() && strstr(name, options.filter.c_str()) == nullptr) {
+    return;
+  }
+
+  float sink = 0.0f;
+  for (int i = 0; i < options.warmup; i++) {
+    sink += fn();
+  }
+  std::vector<float> ns(options.reps);
+  double sum = 0.0;
+  for (int i = 0; i < options.reps; i++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    sink += fn();
+    auto end = std::chrono::high_resolution_clock::now();
+    ns[i] = static_cast<float>(
+        std::chrono::duration<double, std::nano>(end - start).count() / kCount);
+    sum += ns[i];
+  }
+  g_sink = g_sink + sink;
+
+  std::sort(ns.begin(), ns.end());
+  Result r;
+  r.name   = name;
+  r.min    = ns.front();
+  r.median = Percentile(ns, 50.0f);
+  r.p90    = Percentile(ns, 90.0f);
+  r.p99    = Percentile(ns, 99.0f);
+  r.mean   = static_cast<float>(sum / options.reps);
+  results.push_back(r);
+  printf("%-32s %10.2f %10.2f %10.2f %10.2f %10.2f\n", name, r.min, r.median,
+         r.p90, r.p99, r.mean);
+}
+
+// Number of failed checks
+int g_failures = 0;
+
+/**
+ * Checks a condition and reports a failure.
+ * @param  name  Check name
+ * @param  ok    Condition that must be true
+ * @param  error Error value to report
+ */
+void Check(const char* name, const bool ok, const float error) {
+  if (!ok) {
+    printf("FAIL %s (error %g)\n", name, error);
+    g_failures++;
+  }
+}
+
+/**
+ * Random number from lo to hi.
+ */
+float rand_range(const float lo, const float hi) {
+  return lo + (hi - lo) * rand01();
+}
+
+/**
+ * Forms a random affine matrix (rotation, translation and scale).
+ */
+Matrix4x4 RandomAffine() {
+  Matrix4x4 m;
+  m.Translate(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+  m.Rotate(rand_range(0.0f, 360.0f), rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f), 1.0f);
+  m.Scale(rand_range(0.5f, 2.0f), rand_range(0.5f, 2.0f), rand_range(0.5f, 2.0f));
+  return m;
+}
+
+/**
+ * Forms a random general (projective) matrix.
+ */
+Matrix4x4 RandomProjective() {
+  float a[16];
+  for (int i = 0; i < 16; i++) {
+    a[i] = rand_range(-1.0f, 1.0f);
+  }
+  a[0] += 4.0f;
+  a[5] += 4.0f;
+  a[10] += 4.0f;
+  a[15] += 4.0f;
+  Matrix4x4 m;
+  m.Set(a);
+  return m;
+}
+
+/**
+ * Largest element difference between 2 matrices.
+ */
+float MaxDifference(const Matrix4x4& m, const Matrix4x4& n) {
+  float e = 0.0f;
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 4; c++) {
+      e = std::max(e, fabsf(m.m(r, c) - n.m(r, c)));
+    }
+  }
+  return e;
+}
+
+/**
+ * Reference matrix multiply: the original scalar implementation of
+ * Matrix4x4::operator * (row at a time through the accessor functions).
+ */
+Matrix4x4 ReferenceMultiply(const Matrix4x4& m, const Matrix4x4& n) {
+  Matrix4x4 t;
+  for (uint32_t r = 0; r < 4; r++) {
+    float a0 = m.m(r, 0);
+    float a1 = m.m(r, 1);
+    float a2 = m.m(r, 2);
+    float a3 = m.m(r, 3);
+    for (uint32_t c = 0; c < 4; c++) {
+      t.m(r, c) = a0 * n.m(0, c) + a1 * n.m(1, c) + a2 * n.m(2, c) + a3 * n.m(3, c);
+    }
+  }
+  return t;
+}
+
+/**
+ * Matrix multiply, inverse, transpose and point transformation.
+ */
+void MatrixBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<Matrix4x4> affine(kCount), projective(kCount), out(kCount);
+  std::vector<Point3> points(kCount), transformed(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    affine[i] = RandomAffine();
+    projective[i] = RandomProjective();
+    points[i].Set(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+  }
+
+  // Checks: multiply matches the reference multiply (up to the order of
+  // the sums), inverses give the identity, batch transform matches m * p
+  float multiply_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    Matrix4x4 expected = ReferenceMultiply(affine[i], projective[i]);
+    Matrix4x4 composite = affine[i];
+    composite *= projective[i];
+    multiply_error = std::max(multiply_error, MaxDifference(affine[i] * projective[i], expected));
+    multiply_error = std::max(multiply_error, MaxDifference(composite, expected));
+  }
+  Check("Matrix4x4 multiply", multiply_error < 1.0e-4f, multiply_error);
+  Matrix4x4 identity;
+  float inverse_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    inverse_error = std::max(inverse_error, MaxDifference(affine[i] * affine[i].GetInverse(), identity));
+    inverse_error = std::max(inverse_error, MaxDifference(projective[i] * projective[i].GetInverse(), identity));
+  }
+  Check("Matrix4x4 inverse", inverse_error < 1.0e-4f, inverse_error);
+
+  // Check: the rigid inverse (given the kind) and the normal matrix of a
+  // rigid matrix match the affine forms
+  float rigid_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    Matrix4x4 rigid;
+    rigid.Translate(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+    rigid.Rotate(rand_range(0.0f, 360.0f), rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f), 1.0f);
+    rigid_error = std::max(rigid_error, MaxDifference(rigid.GetInverse(MATRIX_RIGID), rigid.GetInverse()));
+    rigid_error = std::max(rigid_error, MaxDifference(rigid.GetNormalMatrix(MATRIX_RIGID), rigid.GetNormalMatrix()));
+  }
+  Check("Matrix4x4 inverse (rigid)", rigid_error < 1.0e-4f, rigid_error);
+  Check("Matrix4x4 kind", Matrix4x4().GetKind() == MATRIX_IDENTITY &&
+        affine[0].GetKind() == MATRIX_AFFINE && projective[0].GetKind() == MATRIX_PROJECTIVE, 0.0f);
+  affine[0].TransformPoints(points.data(), transformed.data(), kCount);
+  float transform_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    Point3 p = affine[0] * points[i];
+    transform_error = std::max(transform_error, (p - transformed[i]).NormSquared());
+  }
+  Check("Matrix4x4 TransformPoints", transform_error < 1.0e-8f, transform_error);
+
+  // Check: batch normals match the normal matrix times each normal
+  std::vector<Vector3> normals(kCount), transformed_normals(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    normals[i].Set(rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f), 1.0f);
+    normals[i].Normalize();
+  }
+  affine[1].TransformNormals(normals.data(), transformed_normals.data(), kCount);
+  Matrix4x4 normal_matrix = affine[1].GetNormalMatrix();
+  float normal_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    Vector3 n = normal_matrix * normals[i];
+    n.Normalize();
+    normal_error = std::max(normal_error, (n - transformed_normals[i]).Norm());
+  }
+  Check("Matrix4x4 TransformNormals", normal_error < 1.0e-5f, normal_error);
+
+  // Check: split across threads (an array large enough to split, not a
+  // multiple of 4) gives the same points as 1 thread
+  std::vector<Point3> many(kCount * 16 + 3), single(many.size()), split(many.size());
+  for (auto& p : many) {
+    p.Set(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+  }
+  affine[0].TransformPoints(many.data(), single.data(), many.size());
+  affine[0].TransformPoints(many.data(), split.data(), many.size(), 0);
+  float split_error = 0.0f;
+  for (size_t i = 0; i < many.size(); i++) {
+    split_error = std::max(split_error, (split[i] - single[i]).Norm());
+  }
+  Check("Matrix4x4 TransformPoints (threads)", split_error == 0.0f, split_error);
+
+  Run(options, "Matrix4x4 multiply", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = affine[i] * projective[kCount - 1 - i];
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Matrix4x4 multiply (reference)", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = ReferenceMultiply(affine[i], projective[kCount - 1 - i]);
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Matrix4x4 *=", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = affine[i];
+      out[i] *= projective[kCount - 1 - i];
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Matrix4x4 inverse (affine)", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = affine[i].GetInverse();
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Matrix4x4 inverse (general)", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = projective[i].GetInverse();
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Matrix4x4 transpose", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = projective[i].GetTranspose();
+    }
+    return out[kCount / 2].m(1, 2);
+  }, results);
+  Run(options, "Matrix4x4 * Point3", [&]() {
+    const Matrix4x4& m = affine[0];
+    for (size_t i = 0; i < kCount; i++) {
+      transformed[i] = m * points[i];
+    }
+    return transformed[kCount / 2].x;
+  }, results);
+  Run(options, "Matrix4x4 TransformPoints", [&]() {
+    affine[0].TransformPoints(points.data(), transformed.data(), kCount);
+    return transformed[kCount / 2].x;
+  }, results);
+  Run(options, "Matrix4x4 TransformNormals", [&]() {
+    affine[1].TransformNormals(normals.data(), transformed_normals.data(), kCount);
+    return transformed_normals[kCount / 2].x;
+  }, results);
+}
+
+/**
+ * Largest component difference between 2 unit quaternions (q and -q are
+ * the same rotation).
+ */
+float MaxDifference(const Quaternion& q, const Quaternion& r) {
+  Quaternion p = (q.Dot(r) < 0.0f) ? -r : r;
+  return std::max(std::max(fabsf(q.x - p.x), fabsf(q.y - p.y)),
+                  std::max(fabsf(q.z - p.z), fabsf(q.w - p.w)));
+}
+
+/**
+ * Reference rotation matrix about an axis (Rodrigues' formula, computed
+ * in double precision).
+ */
+Matrix4x4 ReferenceRotation(const float angle, const Vector3& axis) {
+  double radians = angle * 3.14159265358979323846 / 180.0;
+  double len = sqrt(static_cast<double>(axis.x) * axis.x +
+                    static_cast<double>(axis.y) * axis.y +
+                    static_cast<double>(axis.z) * axis.z);
+  double u[3] = { axis.x / len, axis.y / len, axis.z / len };
+  double c = cos(radians);
+  double s = sin(radians);
+  Matrix4x4 m;
+  for (uint32_t r = 0; r < 3; r++) {
+    for (uint32_t k = 0; k < 3; k++) {
+      double e = (1.0 - c) * u[r] * u[k] + ((r == k) ? c : 0.0);
+      if (r != k) {
+        // Cross product matrix term: +s * u[j] where (r, k, j) is an
+        // even permutation of (0, 1, 2), -s * u[j] for an odd one
+        uint32_t j = 3 - r - k;
+        e += (((k - r + 3) % 3) == 1) ? -s * u[j] : s * u[j];
+      }
+      m.m(r, k) = static_cast<float>(e);
+    }
+  }
+  return m;
+}
+
+/**
+ * Quaternion rotation, interpolation and conversion to a matrix, compared
+ * with matrix rotation.
+ */
+void QuaternionBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<float> angles(kCount), t(kCount);
+  std::vector<Vector3> axes(kCount), v(kCount), rotated(kCount);
+  std::vector<Quaternion> q(kCount), out(kCount);
+  std::vector<Matrix4x4> m(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    angles[i] = rand_range(-170.0f, 170.0f);
+    axes[i].Set(rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f), 1.0f);
+    v[i].Set(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+    t[i] = rand_range(0.0f, 1.0f);
+    q[i].Set(angles[i], axes[i]);
+  }
+
+  // Checks: ToRotation and rotating a vector match the reference rotation
+  // matrix, SetTRS from a quaternion matches Translate, Rotate, Scale
+  float rotation_error = 0.0f;
+  float trs_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    Matrix4x4 expected = ReferenceRotation(angles[i], axes[i]);
+    float r[9];
+    q[i].ToRotation(r);
+    for (uint32_t c = 0; c < 3; c++) {
+      for (uint32_t k = 0; k < 3; k++) {
+        rotation_error = std::max(rotation_error, fabsf(r[c * 3 + k] - expected.m(k, c)));
+      }
+    }
+    rotation_error = std::max(rotation_error, (q[i].Rotate(v[i]) - expected * v[i]).Norm() / 10.0f);
+
+    Point3 position(v[i].x, v[i].y, v[i].z);
+    Vector3 scale(0.5f + t[i], 2.0f - t[i], 1.0f);
+    Matrix4x4 trs;
+    trs.SetTRS(position, q[i], scale);
+    Matrix4x4 composite;
+    composite.Translate(position.x, position.y, position.z);
+    composite *= expected;
+    composite.Scale(scale.x, scale.y, scale.z);
+    trs_error = std::max(trs_error, MaxDifference(trs, composite));
+  }
+  Check("Quaternion ToRotation", rotation_error < 1.0e-5f, rotation_error);
+  Check("Quaternion SetTRS", trs_error < 1.0e-5f, trs_error);
+
+  // Check: Slerp from the identity is the rotation by t times the angle,
+  // and Nlerp follows the same path (equal at t = 0.5)
+  float slerp_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    Quaternion expected(angles[i] * t[i], axes[i]);
+    Quaternion s = Quaternion().Slerp(q[i], t[i]);
+    Quaternion n = Quaternion().Nlerp(q[i], 0.5f);
+    Quaternion half(angles[i] * 0.5f, axes[i]);
+    slerp_error = std::max(slerp_error, MaxDifference(s, expected));
+    slerp_error = std::max(slerp_error, MaxDifference(n, half));
+  }
+  Check("Quaternion Slerp", slerp_error < 1.0e-5f, slerp_error);
+
+  Run(options, "Quaternion Rotate", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      rotated[i] = q[i].Rotate(v[i]);
+    }
+    return rotated[kCount / 2].x;
+  }, results);
+  Run(options, "Quaternion multiply", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = q[i] * q[kCount - 1 - i];
+    }
+    return out[kCount / 2].w;
+  }, results);
+  Run(options, "Quaternion Slerp", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = q[i].Slerp(q[kCount - 1 - i], t[i]);
+    }
+    return out[kCount / 2].w;
+  }, results);
+  Run(options, "Quaternion Nlerp", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = q[i].Nlerp(q[kCount - 1 - i], t[i]);
+    }
+    return out[kCount / 2].w;
+  }, results);
+  Run(options, "Matrix4x4 SetTRS (quaternion)", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      m[i].SetTRS(Point3(v[i].x, v[i].y, v[i].z), q[i], Vector3(2.0f, 2.0f, 2.0f));
+    }
+    return m[kCount / 2].m(0, 1);
+  }, results);
+}
+
+/**
+ * Affine3x4 multiply and inverse compared with Matrix4x4, and conversion
+ * between the 2.
+ */
+void AffineBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<Matrix4x4> full(kCount), full_out(kCount);
+  std::vector<Affine3x4> affine(kCount), out(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    full[i] = RandomAffine();
+    affine[i].Set(full[i]);
+  }
+
+  // Checks: products and inverses match Matrix4x4, round trip is exact
+  float multiply_error = 0.0f;
+  float inverse_error = 0.0f;
+  float round_trip_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    size_t j = kCount - 1 - i;
+    multiply_error = std::max(multiply_error,
+              MaxDifference((affine[i] * affine[j]).ToMatrix4x4(), full[i] * full[j]));
+    inverse_error = std::max(inverse_error,
+              MaxDifference(affine[i].GetInverse().ToMatrix4x4(), full[i].GetInverse()));
+    round_trip_error = std::max(round_trip_error, MaxDifference(affine[i].ToMatrix4x4(), full[i]));
+  }
+  Check("Affine3x4 multiply", multiply_error < 1.0e-3f, multiply_error);
+  Check("Affine3x4 inverse", inverse_error < 1.0e-4f, inverse_error);
+  Check("Affine3x4 round trip", round_trip_error == 0.0f, round_trip_error);
+
+  Run(options, "Affine3x4 multiply", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = affine[i] * affine[kCount - 1 - i];
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Matrix4x4 multiply (affine)", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      full_out[i] = full[i] * full[kCount - 1 - i];
+    }
+    return full_out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Affine3x4 inverse", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = affine[i].GetInverse();
+    }
+    return out[kCount / 2].m(1, 1);
+  }, results);
+  Run(options, "Affine3x4 ToMatrix4x4", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      full_out[i] = affine[i].ToMatrix4x4();
+    }
+    return full_out[kCount / 2].m(1, 1);
+  }, results);
+}
+
+/**
+ * Vector normalize and cross product, one at a time and in packets.
+ */
+void VectorBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<Vector3> v(kCount), w(kCount), out(kCount), packet_out(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    v[i].Set(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+    w[i].Set(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+  }
+  const size_t kWidth = Vector3x8::kWidth;
+
+  // Checks: packets match one vector at a time
+  float normalize_error = 0.0f;
+  float cross_error = 0.0f;
+  for (size_t i = 0; i < kCount; i += kWidth) {
+    Vector3x8::Load(&v[i]).Normalize().Store(&packet_out[i]);
+    for (size_t k = i; k < i + kWidth; k++) {
+      Vector3 n = v[k];
+      normalize_error = std::max(normalize_error, (n.Normalize() - packet_out[k]).Norm());
+    }
+    Vector3x8::Load(&v[i]).Cross(Vector3x8::Load(&w[i])).Store(&packet_out[i]);
+    for (size_t k = i; k < i + kWidth; k++) {
+      cross_error = std::max(cross_error, (v[k].Cross(w[k]) - packet_out[k]).Norm());
+    }
+  }
+  Check("Vector3x8 Normalize", normalize_error < 1.0e-6f, normalize_error);
+  Check("Vector3x8 Cross", cross_error < 1.0e-4f, cross_error);
+
+  Run(options, "Vector3 Normalize", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = v[i];
+      out[i].Normalize();
+    }
+    return out[kCount / 2].x;
+  }, results);
+  Run(options, "Vector3 FastNormalize", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = v[i];
+      out[i].FastNormalize();
+    }
+    return out[kCount / 2].x;
+  }, results);
+  Run(options, "Vector3x8 Normalize", [&]() {
+    for (size_t i = 0; i < kCount; i += kWidth) {
+      Vector3x8::Load(&v[i]).Normalize().Store(&out[i]);
+    }
+    return out[kCount / 2].x;
+  }, results);
+  Run(options, "Vector3x8 FastNormalize", [&]() {
+    for (size_t i = 0; i < kCount; i += kWidth) {
+      Vector3x8::Load(&v[i]).FastNormalize().Store(&out[i]);
+    }
+    return out[kCount / 2].x;
+  }, results);
+  Run(options, "Vector3 Cross", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      out[i] = v[i].Cross(w[i]);
+    }
+    return out[kCount / 2].x;
+  }, results);
+  Run(options, "Vector3x8 Cross", [&]() {
+    for (size_t i = 0; i < kCount; i += kWidth) {
+      Vector3x8::Load(&v[i]).Cross(Vector3x8::Load(&w[i])).Store(&out[i]);
+    }
+    return out[kCount / 2].x;
+  }, results);
+}
+
+/**
+ * Fast sin/cos and 1/sqrt compared with the C library.
+ */
+void FastMathBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<float> angles(kCount), values(kCount), s(kCount), c(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    angles[i] = rand_range(-8192.0f, 8192.0f);
+    values[i] = rand_range(1.0e-6f, 1000.0f);
+  }
+
+  // Checks: absolute error below 3e-7 for |x| <= 8192 and relative error
+  // below 5e-7, for one value and for an array (not a multiple of 4 long)
+  // compared with double precision
+  const size_t partial = kCount - 3;
+  FastSinCos(angles.data(), s.data(), c.data(), partial);
+  float trig_error = 0.0f;
+  for (size_t i = 0; i < partial; i++) {
+    float s1, c1;
+    FastSinCos(angles[i], &s1, &c1);
+    float exact_s = static_cast<float>(sin(static_cast<double>(angles[i])));
+    float exact_c = static_cast<float>(cos(static_cast<double>(angles[i])));
+    trig_error = std::max(trig_error, std::max(fabsf(s[i] - exact_s), fabsf(c[i] - exact_c)));
+    trig_error = std::max(trig_error, std::max(fabsf(s1 - exact_s), fabsf(c1 - exact_c)));
+  }
+  Check("FastSinCos", trig_error < 3.0e-7f, trig_error);
+  FastRsqrt(values.data(), s.data(), partial);
+  float rsqrt_error = 0.0f;
+  for (size_t i = 0; i < partial; i++) {
+    float exact = static_cast<float>(1.0 / sqrt(static_cast<double>(values[i])));
+    rsqrt_error = std::max(rsqrt_error, fabsf(s[i] - exact) / exact);
+    rsqrt_error = std::max(rsqrt_error, fabsf(FastRsqrt(values[i]) - exact) / exact);
+  }
+  Check("FastRsqrt", rsqrt_error < 5.0e-7f, rsqrt_error);
+
+  Run(options, "sinf + cosf", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      s[i] = sinf(angles[i]);
+      c[i] = cosf(angles[i]);
+    }
+    return s[kCount / 2] + c[kCount / 2];
+  }, results);
+  Run(options, "FastSinCos", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      FastSinCos(angles[i], &s[i], &c[i]);
+    }
+    return s[kCount / 2] + c[kCount / 2];
+  }, results);
+  Run(options, "FastSinCos (array)", [&]() {
+    FastSinCos(angles.data(), s.data(), c.data(), kCount);
+    return s[kCount / 2] + c[kCount / 2];
+  }, results);
+  Run(options, "1 / sqrtf", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      s[i] = 1.0f / sqrtf(values[i]);
+    }
+    return s[kCount / 2];
+  }, results);
+  Run(options, "FastRsqrt (array)", [&]() {
+    FastRsqrt(values.data(), s.data(), kCount);
+    return s[kCount / 2];
+  }, results);
+}
+
+/**
+ * Gradient noise and fBm, one sample at a time and in batches.
+ */
+void NoiseBenchmarks(const Options& options, std::vector<Result>& results) {
+  const int kOctaves = 4;
+  Noise noise(1234);
+  std::vector<Point3> p(kCount);
+  std::vector<float> n1(kCount), n2(kCount), n3(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    p[i].Set(rand_range(-100.0f, 100.0f), rand_range(-100.0f, 100.0f), rand_range(-100.0f, 100.0f));
+  }
+
+  // Checks: 0 at lattice points, values in [-1, 1], the same values for
+  // the same seed
+  float lattice_error = 0.0f;
+  float range_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    lattice_error = std::max(lattice_error,
+        fabsf(noise.Perlin(floorf(p[i].x), floorf(p[i].y), floorf(p[i].z))));
+    range_error = std::max(range_error, fabsf(noise.Perlin(p[i])) - 1.0f);
+    range_error = std::max(range_error, fabsf(noise.Simplex(p[i])) - 1.0f);
+  }
+  Check("Noise lattice", lattice_error == 0.0f, lattice_error);
+  Check("Noise range", range_error <= 0.0f, range_error);
+  Check("Noise seed", Noise(1234).Perlin(p[7]) == noise.Perlin(p[7]) &&
+        Noise(4321).Perlin(p[7]) != noise.Perlin(p[7]), 0.0f);
+
+  // Check: the batch fBm (one thread, all threads and a grid, none a
+  // multiple of 4 long) matches one sample at a time
+  const size_t partial = kCount - 3;
+  for (size_t i = 0; i < partial; i++) {
+    n1[i] = noise.Fbm(p[i], kOctaves);
+  }
+  noise.Fbm(p.data(), n2.data(), partial, kOctaves, 2.0f, 0.5f);
+  noise.Fbm(p.data(), n3.data(), partial, kOctaves, 2.0f, 0.5f, 0);
+  float batch_error = 0.0f;
+  for (size_t i = 0; i < partial; i++) {
+    batch_error = std::max(batch_error, fabsf(n2[i] - n1[i]));
+    batch_error = std::max(batch_error, fabsf(n3[i] - n1[i]));
+  }
+  const int kWidth = 97;
+  const int kHeight = 61;
+  const Point3 origin(-3.3f, 5.1f, 0.7f);
+  const float spacing = 0.173f;
+  std::vector<float> grid(kWidth * kHeight);
+  noise.FbmGrid(grid.data(), kWidth, kHeight, origin, spacing, kOctaves);
+  for (int j = 0; j < kHeight; j++) {
+    for (int i = 0; i < kWidth; i++) {
+      Point3 q(origin.x + i * spacing, origin.y + j * spacing, origin.z);
+      batch_error = std::max(batch_error, fabsf(grid[j * kWidth + i] - noise.Fbm(q, kOctaves)));
+    }
+  }
+  Check("Noise Fbm (array)", batch_error < 1.0e-6f, batch_error);
+
+  Run(options, "Noise Perlin", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      n1[i] = noise.Perlin(p[i]);
+    }
+    return n1[kCount / 2];
+  }, results);
+  Run(options, "Noise Simplex", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      n1[i] = noise.Simplex(p[i]);
+    }
+    return n1[kCount / 2];
+  }, results);
+  Run(options, "Noise Fbm", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      n1[i] = noise.Fbm(p[i], kOctaves);
+    }
+    return n1[kCount / 2];
+  }, results);
+  Run(options, "Noise Fbm (array)", [&]() {
+    noise.Fbm(p.data(), n2.data(), kCount, kOctaves, 2.0f, 0.5f);
+    return n2[kCount / 2];
+  }, results);
+}
+
+/**
+ * Ray intersection with spheres, boxes, triangles and polygons.
+ */
+void RayBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<Ray3> rays(kCount);
+  std::vector<BoundingSphere> spheres(kCount);
+  std::vector<AABB> boxes(kCount);
+  std::vector<float> t(kCount), packet_t(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    Point3 o(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f));
+    Point3 target(rand_range(-2.0f, 2.0f), rand_range(-2.0f, 2.0f), rand_range(-2.0f, 2.0f));
+    rays[i] = Ray3(o, target, true);
+    Point3 c(rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f));
+    spheres[i] = BoundingSphere(c, rand_range(0.5f, 2.0f));
+    boxes[i] = AABB(c - Vector3(1.0f, 1.0f, 1.0f), c + Vector3(1.0f, 1.0f, 1.0f));
+  }
+  const size_t kWidth = Float8::kWidth;
+
+  // Triangles in groups of kWidth around a common center, and rays aimed
+  // near the center of their group, so most lanes of a packet hit
+  std::vector<Point3> v0(kCount), v1(kCount), v2(kCount);
+  std::vector<Ray3> tri_rays(kCount);
+  std::vector<float> u(kCount), v(kCount);
+  for (size_t i = 0; i < kCount; i += kWidth) {
+    Point3 c(rand_range(-5.0f, 5.0f), rand_range(-5.0f, 5.0f), rand_range(-5.0f, 5.0f));
+    for (size_t k = i; k < i + kWidth; k++) {
+      v0[k] = c + Vector3(rand_range(-1.0f, 0.0f), rand_range(-1.0f, 0.0f), rand_range(-0.5f, 0.5f));
+      v1[k] = c + Vector3(rand_range(0.5f, 1.5f), rand_range(-1.0f, 0.0f), rand_range(-0.5f, 0.5f));
+      v2[k] = c + Vector3(rand_range(-0.5f, 0.5f), rand_range(0.5f, 1.5f), rand_range(-0.5f, 0.5f));
+      Point3 o(rand_range(-10.0f, 10.0f), rand_range(-10.0f, 10.0f), rand_range(6.0f, 10.0f));
+      Point3 target = c + Vector3(rand_range(-0.5f, 0.5f), rand_range(-0.5f, 0.5f), 0.0f);
+      tri_rays[k] = Ray3(o, target, true);
+    }
+  }
+
+  // Checks: sphere hits lie on the sphere, packet box tests match
+  float sphere_error = 0.0f;
+  float box_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    float ts = rays[i].Intersect(spheres[i]);
+    if (ts > 0.0f) {
+      float d = (rays[i].Intersect(ts) - spheres[i].m_center).Norm();
+      sphere_error = std::max(sphere_error, fabsf(d - spheres[i].m_radius));
+    }
+  }
+  for (size_t i = 0; i < kCount; i += kWidth) {
+    rays[i].Intersect(AABBx8::Load(&boxes[i])).Store(&packet_t[i]);
+    for (size_t k = i; k < i + kWidth; k++) {
+      box_error = std::max(box_error, fabsf(rays[i].Intersect(boxes[k]) - packet_t[k]));
+    }
+  }
+  Check("Ray3 sphere", sphere_error < 1.0e-4f, sphere_error);
+  Check("Ray3 AABBx8", box_error < 1.0e-4f, box_error);
+
+  // Checks: a ray against 8 triangles and 8 rays against a triangle
+  // match one ray and triangle at a time (t, u and v), and hits lie on
+  // the triangle
+  float triangle_error = 0.0f;
+  int triangle_hits = 0;
+  for (size_t i = 0; i < kCount; i += kWidth) {
+    Float8 pu, pv;
+    Float8 pt = tri_rays[i].Intersect(Trianglex8::Load(&v0[i], &v1[i], &v2[i]), pu, pv);
+    Float8 ru, rv;
+    Float8 rt = Ray3x8::Load(&tri_rays[i]).Intersect(v0[i], v1[i], v2[i], ru, rv);
+    for (size_t k = 0; k < kWidth; k++) {
+      float su, sv;
+      float st = tri_rays[i].Intersect(v0[i + k], v1[i + k], v2[i + k], su, sv);
+      triangle_error = std::max(triangle_error, fabsf(pt[k] - st));
+      if (st > 0.0f) {
+        triangle_hits++;
+        triangle_error = std::max(triangle_error, std::max(fabsf(pu[k] - su), fabsf(pv[k] - sv)));
+        Point3 on = v0[i + k] + Vector3(v0[i + k], v1[i + k]) * su + Vector3(v0[i + k], v2[i + k]) * sv;
+        triangle_error = std::max(triangle_error, (tri_rays[i].Intersect(st) - on).Norm());
+      }
+      st = tri_rays[i + k].Intersect(v0[i], v1[i], v2[i], su, sv);
+      triangle_error = std::max(triangle_error, fabsf(rt[k] - st));
+      if (st > 0.0f) {
+        triangle_error = std::max(triangle_error, std::max(fabsf(ru[k] - su), fabsf(rv[k] - sv)));
+      }
+    }
+  }
+  Check("Ray3 triangle", triangle_error < 1.0e-4f && triangle_hits > 0, triangle_error);
+
+  // Check: a ray against a square in a random plane matches the 2
+  // triangles of the square. Targets near an edge or the diagonal are
+  // skipped, where round off may decide the hit differently.
+  float polygon_error = 0.0f;
+  int polygon_tests = 0;
+  std::vector<Point3> square(4);
+  for (size_t i = 0; i < kCount; i++) {
+    Vector3 n(rand_range(-1.0f, 1.0f), rand_range(-1.0f, 1.0f), rand_range(0.5f, 1.0f));
+    n.Normalize();
+    Vector3 a = n.Cross(Vector3(1.0f, 0.0f, 0.0f)).Normalize();
+    Vector3 b = n.Cross(a);
+    Point3 c(rand_range(-5.0f, 5.0f), rand_range(-5.0f, 5.0f), rand_range(-5.0f, 5.0f));
+    square[0] = c - a - b * 1.5f;
+    square[1] = c + a - b * 1.5f;
+    square[2] = c + a + b * 1.5f;
+    square[3] = c - a + b * 1.5f;
+    float x = rand_range(-2.0f, 2.0f);
+    float y = rand_range(-2.5f, 2.5f);
+    if (fabsf(fabsf(x) - 1.0f) < 0.01f || fabsf(fabsf(y) - 1.5f) < 0.01f ||
+        fabsf(y - 1.5f * x) < 0.02f) {
+      continue;
+    }
+    Point3 target = c + a * x + b * y;
+    Vector3 offset = n * rand_range(1.0f, 5.0f) + a * rand_range(-1.0f, 1.0f);
+    Ray3 ray(target + offset, target, true);
+    float su, sv;
+    float pt = ray.Intersect(square, n);
+    float st = ray.Intersect(square[0], square[1], square[2], su, sv);
+    if (st == 0.0f) {
+      st = ray.Intersect(square[0], square[2], square[3], su, sv);
+    }
+    polygon_error = std::max(polygon_error, fabsf(pt - st));
+    polygon_tests++;
+  }
+  Check("Ray3 polygon", polygon_error < 1.0e-4f && polygon_tests > 0, polygon_error);
+
+  Run(options, "Ray3 sphere", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      t[i] = rays[i].Intersect(spheres[i]);
+    }
+    return t[kCount / 2];
+  }, results);
+  Run(options, "Ray3 AABB", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      t[i] = rays[0].Intersect(boxes[i]);
+    }
+    return t[kCount / 2];
+  }, results);
+  Run(options, "Ray3 AABBx8", [&]() {
+    for (size_t i = 0; i < kCount; i += kWidth) {
+      rays[0].Intersect(AABBx8::Load(&boxes[i])).Store(&t[i]);
+    }
+    return t[kCount / 2];
+  }, results);
+  Run(options, "Ray3 triangle", [&]() {
+    for (size_t i = 0; i < kCount; i++) {
+      t[i] = tri_rays[i & ~(kWidth - 1)].Intersect(v0[i], v1[i], v2[i], u[i], v[i]);
+    }
+    return t[kCount / 2];
+  }, results);
+  Run(options, "Ray3 Trianglex8", [&]() {
+    for (size_t i = 0; i < kCount; i += kWidth) {
+      Float8 pu, pv;
+      tri_rays[i].Intersect(Trianglex8::Load(&v0[i], &v1[i], &v2[i]), pu, pv).Store(&t[i]);
+      pu.Store(&u[i]);
+      pv.Store(&v[i]);
+    }
+    return t[kCount / 2];
+  }, results);
+  Run(options, "Ray3x8 triangle", [&]() {
+    for (size_t i = 0; i < kCount; i += kWidth) {
+      Float8 pu, pv;
+      Ray3x8::Load(&tri_rays[i]).Intersect(v0[i], v1[i], v2[i], pu, pv).Store(&t[i]);
+      pu.Store(&u[i]);
+      pv.Store(&v[i]);
+    }
+    return t[kCount / 2];
+  }, results);
+}
+
+/**
+ * View frustum culling of spheres and boxes, one at a time and 8 at a
+ * time. The objects are spread over +-1000 units (like the forest in the
+ * final project) and viewed with a 50 degree field of view.
+ */
+void FrustumBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<BoundingSphere> spheres(kCount);
+  std::vector<AABB> boxes(kCount);
+  std::vector<uint8_t> visible(kCount), packet_visible(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    Point3 c(rand_range(-1000.0f, 1000.0f), rand_range(-1000.0f, 1000.0f), rand_range(0.0f, 40.0f));
+    spheres[i] = BoundingSphere(c, rand_range(5.0f, 20.0f));
+    boxes[i] = AABB(c - Vector3(5.0f, 5.0f, 20.0f), c + Vector3(5.0f, 5.0f, 20.0f));
+  }
+
+  // Camera at (0, -1000, 20) looking along +y (same matrices as CameraNode)
+  const float near_clip = 1.0f;
+  const float far_clip = 3000.0f;
+  float h = near_clip * tanf(DegreesToRadians(25.0f));
+  Matrix4x4 projection;
+  projection.m00() = near_clip / h;
+  projection.m11() = near_clip / h;
+  projection.m22() = -(far_clip + near_clip) / (far_clip - near_clip);
+  projection.m23() = -(2.0f * far_clip * near_clip) / (far_clip - near_clip);
+  projection.m32() = -1.0f;
+  projection.m33() = 0.0f;
+  Matrix4x4 view;
+  view.RotateX(-90.0f);
+  view.Translate(0.0f, 1000.0f, -20.0f);
+  Frustum frustum(projection * view);
+
+  // Check: packets match one object at a time. The sphere count leaves a
+  // partial packet, which is tested one at a time.
+  int mismatches = 0;
+  const size_t partial = kCount - 3;
+  frustum.Cull(spheres.data(), partial, packet_visible.data());
+  for (size_t i = 0; i < partial; i++) {
+    mismatches += (packet_visible[i] != (frustum.Intersects(spheres[i]) ? 1 : 0));
+  }
+  frustum.Cull(boxes.data(), kCount, packet_visible.data());
+  for (size_t i = 0; i < kCount; i++) {
+    mismatches += (packet_visible[i] != (frustum.Intersects(boxes[i]) ? 1 : 0));
+  }
+  Check("Frustum Cull", mismatches == 0, static_cast<float>(mismatches));
+
+  Run(options, "Frustum sphere", [&]() {
+    size_t n = 0;
+    for (size_t i = 0; i < kCount; i++) {
+      visible[i] = frustum.Intersects(spheres[i]) ? 1 : 0;
+      n += visible[i];
+    }
+    return static_cast<float>(n);
+  }, results);
+  Run(options, "Frustum Cull (spheres)", [&]() {
+    return static_cast<float>(frustum.Cull(spheres.data(), kCount, visible.data()));
+  }, results);
+  Run(options, "Frustum AABB", [&]() {
+    size_t n = 0;
+    for (size_t i = 0; i < kCount; i++) {
+      visible[i] = frustum.Intersects(boxes[i]) ? 1 : 0;
+      n += visible[i];
+    }
+    return static_cast<float>(n);
+  }, results);
+  Run(options, "Frustum Cull (boxes)", [&]() {
+    return static_cast<float>(frustum.Cull(boxes.data(), kCount, visible.data()));
+  }, results);
+}
+
+/**
+ * 2D line segment clipping to a rectangle and to a convex polygon.
+ */
+void ClipBenchmarks(const Options& options, std::vector<Result>& results) {
+  std::vector<LineSegment2> segments(kCount), clipped(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    segments[i] = LineSegment2(Point2(rand_range(-2.0f, 2.0f), rand_range(-2.0f, 2.0f)),
+                               Point2(rand_range(-2.0f, 2.0f), rand_range(-2.0f, 2.0f)));
+  }
+  CRectangle r = { -1.0f, 1.0f, -1.0f, 1.0f };
+  std::vector<Point2> square = { Point2(-1.0f, -1.0f), Point2(1.0f, -1.0f),
+                                 Point2(1.0f, 1.0f), Point2(-1.0f, 1.0f) };
+
+  // Check: clipping to the rectangle and to the same square as a polygon
+  // give the same segments
+  float clip_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    LineSegment2 a, b;
+    bool in_a = segments[i].ClipToRectangle(r, a);
+    bool in_b = segments[i].ClipToPolygon(square, b);
+    if (in_a != in_b) {
+      // Segments that touch a corner may be kept by one method only
+      float len = in_a ? (a.b - a.a).NormSquared() : (b.b - b.a).NormSquared();
+      clip_error = std::max(clip_error, len);
+    } else if (in_a) {
+      clip_error = std::max(clip_error, std::max((b.a - a.a).NormSquared(), (b.b - a.b).NormSquared()));
+    }
+  }
+  Check("LineSegment2 clip", clip_error < 1.0e-6f, clip_error);
+
+  // Check: batch clipping keeps the same segments as one at a time
+  std::vector<uint32_t> index(kCount);
+  float batch_error = 0.0f;
+  size_t n = ClipSegmentsToRectangle(segments.data(), kCount, r, clipped.data(), index.data());
+  for (size_t k = 0; k < n; k++) {
+    LineSegment2 c;
+    segments[index[k]].ClipToRectangle(r, c);
+    batch_error = std::max(batch_error, std::max((clipped[k].a - c.a).NormSquared(),
+                                                 (clipped[k].b - c.b).NormSquared()));
+  }
+  size_t expected = 0;
+  for (size_t i = 0; i < kCount; i++) {
+    LineSegment2 c;
+    expected += segments[i].ClipToRectangle(r, c) ? 1 : 0;
+  }
+  Check("ClipSegmentsToRectangle", n == expected && batch_error < 1.0e-8f, batch_error);
+
+  Run(options, "LineSegment2 ClipToRectangle", [&]() {
+    int n = 0;
+    for (size_t i = 0; i < kCount; i++) {
+      n += segments[i].ClipToRectangle(r, clipped[i]) ? 1 : 0;
+    }
+    return static_cast<float>(n);
+  }, results);
+  Run(options, "LineSegment2 ClipToPolygon", [&]() {
+    int n = 0;
+    for (size_t i = 0; i < kCount; i++) {
+      n += segments[i].ClipToPolygon(square, clipped[i]) ? 1 : 0;
+    }
+    return static_cast<float>(n);
+  }, results);
+  Run(options, "ClipSegmentsToRectangle", [&]() {
+    return static_cast<float>(ClipSegmentsToRectangle(segments.data(), kCount, r,
+                                                      clipped.data()));
+  }, results);
+  Run(options, "ClipSegmentsToPolygon", [&]() {
+    return static_cast<float>(ClipSegmentsToPolygon(segments.data(), kCount, square,
+                                                    clipped.data()));
+  }, results);
+}
+
+/**
+ * Task that counts each index of its range once.
+ * @param  counts  Count per index (std::atomic<uint32_t>*)
+ */
+void CountTask(void*, void* counts, size_t begin, size_t end) {
+  std::atomic<uint32_t>* c = static_cast<std::atomic<uint32_t>*>(counts);
+  for (size_t i = begin; i < end; i++) {
+    c[i].fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * Task that splits its range in half until it is small, queueing one half
+ * and waiting for it (nested fork/join), and counts each index once.
+ * @param  pool    Task pool (TaskPool*)
+ * @param  counts  Count per index (std::atomic<uint32_t>*)
+ */
+void ForkJoinTask(void* pool, void* counts, size_t begin, size_t end) {
+  if (end - begin <= 16) {
+    CountTask(pool, counts, begin, end);
+    return;
+  }
+  TaskPool* p = static_cast<TaskPool*>(pool);
+  TaskGroup group;
+  size_t middle = begin + (end - begin) / 2;
+  p->Run(group, ForkJoinTask, pool, counts, middle, end);
+  ForkJoinTask(pool, counts, begin, middle);
+  p->Wait(group);
+}
+
+/**
+ * Queues one task per index from the calling thread and waits for them.
+ */
+void RunEachIndex(TaskPool& pool, std::atomic<uint32_t>* counts, const size_t count) {
+  TaskGroup group;
+  for (size_t i = 0; i < count; i++) {
+    pool.Run(group, CountTask, nullptr, counts, i, i + 1);
+  }
+  pool.Wait(group);
+}
+
+/**
+ * Counts the indexes that did not run exactly once, and clears the counts.
+ */
+int CountErrors(std::atomic<uint32_t>* counts, const size_t count) {
+  int errors = 0;
+  for (size_t i = 0; i < count; i++) {
+    errors += (counts[i].exchange(0) != 1) ? 1 : 0;
+  }
+  return errors;
+}
+
+/**
+ * Task pool: nested fork/join, groups larger than a queue and waits from
+ * threads that are not workers of the pool.
+ */
+void TaskPoolBenchmarks(const Options& options, std::vector<Result>& results) {
+  // More tasks than one queue holds (1024), so some are run by Run itself
+  const size_t kTasks = 3000;
+  std::vector<std::atomic<uint32_t>> counts(kCount);
+  std::vector<std::atomic<uint32_t>> other_counts(kTasks);
+  for (size_t i = 0; i < kCount; i++) {
+    counts[i] = 0;
+  }
+  for (size_t i = 0; i < kTasks; i++) {
+    other_counts[i] = 0;
+  }
+  TaskPool pool(4);
+
+  // Check: nested fork/join from this (non-worker) thread
+  ForkJoinTask(&pool, counts.data(), 0, kCount);
+  int errors = CountErrors(counts.data(), kCount);
+  Check("TaskPool fork/join", errors == 0, static_cast<float>(errors));
+
+  // Check: a group larger than a queue. With 1 thread nothing is run until
+  // Wait, so the queue is sure to overflow.
+  TaskPool single(1);
+  RunEachIndex(single, counts.data(), kTasks);
+  errors = CountErrors(counts.data(), kTasks);
+  RunEachIndex(pool, counts.data(), kTasks);
+  errors += CountErrors(counts.data(), kTasks);
+  Check("TaskPool queue overflow", errors == 0, static_cast<float>(errors));
+
+  // Check: 2 non-worker threads queueing and waiting at once
+  std::thread other([&]() {
+    RunEachIndex(pool, other_counts.data(), kTasks);
+    ForkJoinTask(&pool, other_counts.data(), 0, kTasks);
+  });
+  RunEachIndex(pool, counts.data(), kTasks);
+  ForkJoinTask(&pool, counts.data(), 0, kTasks);
+  other.join();
+  errors = 0;
+  for (size_t i = 0; i < kTasks; i++) {
+    errors += (counts[i].exchange(0) != 2) ? 1 : 0;
+    errors += (other_counts[i].exchange(0) != 2) ? 1 : 0;
+  }
+  Check("TaskPool wait from other threads", errors == 0, static_cast<float>(errors));
+
+  Run(options, "TaskPool fork/join", [&]() {
+    ForkJoinTask(&pool, counts.data(), 0, kCount);
+    return static_cast<float>(counts[kCount / 2].load(std::memory_order_relaxed));
+  }, results);
+}
+
+/**
+ * Writes the results as CSV (one line per benchmark, times in ns per item).
+ * @param  filename  Output file
+ * @param  results   Results to write
+ * @return  Returns true if the file was written.
+ */
+bool WriteResults(const std::string& filename, const std::vector<Result>& results) {
+  FILE* f = fopen(filename.c_str(), "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f, "name,min_ns,median_ns,p90_ns,p99_ns,mean_ns\n");
+  for (const auto& r : results) {
+    fprintf(f, "%s,%.3f,%.3f,%.3f,%.3f,%.3f\n", r.name.c_str(), r.min, r.median,
+            r.p90, r.p99, r.mean);
+  }
+  fclose(f);
+  return true;
+}
+
+/**
+ * Reads the median times of a previous run (a file written by
+ * WriteResults).
+ * @param  filename  Baseline file
+ * @param  medians   (OUT) Median ns per item by benchmark name
+ * @return  Returns true if the file was read.
+ */
+bool ReadBaseline(const std::string& filename, std::map<std::string, float>& medians) {
+  FILE* f = fopen(filename.c_str(), "r");
+  if (f == nullptr) {
+    return false;
+  }
+  char line[256];
+  fgets(line, sizeof(line), f);     // Header
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    char* comma = strchr(line, ',');
+    if (comma != nullptr) {
+      float min_ns, median_ns;
+      if (sscanf(comma + 1, "%f,%f", &min_ns, &median_ns) == 2) {
+        medians[std::string(line, comma)] = median_ns;
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+/**
+ * Parses the command line options.
+ * @return  Returns false if the command line is not valid.
+ */
+bool ParseOptions(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (arg == "--reps") {
+      options.reps = std::max(atoi(value), 1);
+    } else if (arg == "--warmup") {
+      options.warmup = std::max(atoi(value), 0);
+    } else if (arg == "--filter") {
+      options.filter = value;
+    } else if (arg == "--out") {
+      options.out = value;
+    } else if (arg == "--baseline") {
+      options.baseline = value;
+    } else if (arg == "--tolerance") {
+      options.tolerance = static_cast<float>(atof(value));
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  // Fixed seed so every run benchmarks the same data
+  srand(12345);
+
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    printf("Usage: MathBenchmark [--reps n] [--warmup n] [--filter text] "
+           "[--out file.csv] [--baseline file.csv] [--tolerance fraction]\n");
+    return 1;
+  }
+
+  printf("%-32s %10s %10s %10s %10s %10s\n", "ns per item", "min", "median",
+         "p90", "p99", "mean");
+  std::vector<Result> results;
+  MatrixBenchmarks(options, results);
+  QuaternionBenchmarks(options, results);
+  AffineBenchmarks(options, results);
+  VectorBenchmarks(options, results);
+  FastMathBenchmarks(options, results);
+  NoiseBenchmarks(options, results);
+  RayBenchmarks(options, results);
+  FrustumBenchmarks(options, results);
+  ClipBenchmarks(options, results);
+  TaskPoolBenchmarks(options, results);
+
+  if (!WriteResults(options.out, results)) {
+    printf("Cannot write %s\n", options.out.c_str());
+  }
+
+  // Compare medians with the baseline run
+  int regressions = 0;
+  if (!options.baseline.empty()) {
+    std::map<std::string, float> baseline;
+    if (!ReadBaseline(options.baseline, baseline)) {
+      printf("Cannot read baseline %s\n", options.baseline.c_str());
+      return 1;
+    }
+    for (const auto& r : results) {
+      auto b = baseline.find(r.name);
+      if (b != baseline.end() && r.median > b->second * (1.0f + options.tolerance)) {
+        printf("SLOWER %s: %.2f ns, baseline %.2f ns\n", r.name.c_str(), r.median, b->second);
+        regressions++;
+      }
+    }
+  }
+
+  if (g_failures > 0) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  if (regressions > 0) {
+    printf("%d benchmark(s) slower than the baseline\n", regressions);
+    return 2;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
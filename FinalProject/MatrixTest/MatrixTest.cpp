@@ -11,6 +11,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <algorithm>
 
 #include "geometry/geometry.h"
 
@@ -30,6 +31,202 @@ void logmsg(const char *message, ...) {
   va_end(arg);
 }
 
+/**
+ * Reference matrix multiply: the original scalar implementation of
+ * Matrix4x4::operator * (row at a time through the accessor functions).
+ * Used to verify the SIMD multiply.
+ */
+Matrix4x4 ReferenceMultiply(const Matrix4x4& m, const Matrix4x4& n) {
+  Matrix4x4 t;
+  for (uint32_t r = 0; r < 4; r++) {
+    float a0 = m.m(r, 0);
+    float a1 = m.m(r, 1);
+    float a2 = m.m(r, 2);
+    float a3 = m.m(r, 3);
+    for (uint32_t c = 0; c < 4; c++) {
+      t.m(r, c) = a0 * n.m(0, c) + a1 * n.m(1, c) + a2 * n.m(2, c) + a3 * n.m(3, c);
+    }
+  }
+  return t;
+}
+
+/**
+ * Forms a modeling matrix at compile time using quarter turn rotations.
+ */
+constexpr Matrix4x4 CompileTimeTransform() {
+  Matrix4x4 m;
+  m.Translate(0.0f, 10.0f, 0.0f);
+  m.RotateX90(-1);
+  m.RotateZ90(2);
+  m.Scale(2.0f, 2.0f, 1.0f);
+  return m;
+}
+
+// Verify the matrix really is formed at compile time. Rotating -90 about x
+// then 180 about z takes the local z axis to +y.
+constexpr Matrix4x4 kCompileTime = CompileTimeTransform();
+static_assert(kCompileTime.m03() == 0.0f && kCompileTime.m13() == 10.0f,
+              "compile time translation");
+static_assert((kCompileTime * Vector3(0.0f, 0.0f, 1.0f)).y == 1.0f,
+              "compile time rotation");
+
+/**
+ * Checks the library matrix multiply against the reference multiply and
+ * logs the largest difference.
+ */
+void MultiplyTest() {
+  logmsg("\nMatrix multiply test");
+
+  // A small set of typical modeling matrices to multiply
+  const int kMatrixCount = 64;
+  Matrix4x4 m[kMatrixCount];
+  for (int i = 0; i < kMatrixCount; i++) {
+    m[i].Translate(rand01() * 100.0f, rand01() * 100.0f, rand01() * 100.0f);
+    m[i].Rotate(rand01() * 360.0f, rand01(), rand01(), rand01() + 0.1f);
+    m[i].Scale(rand01() + 0.5f, rand01() + 0.5f, rand01() + 0.5f);
+  }
+
+  // The results may differ in the last bit since the SIMD path sums in a
+  // different order.
+  float max_error = 0.0f;
+  for (int i = 0; i < kMatrixCount - 1; i++) {
+    Matrix4x4 p0 = m[i] * m[i + 1];
+    Matrix4x4 p1 = ReferenceMultiply(m[i], m[i + 1]);
+    Matrix4x4 p2 = m[i];
+    p2 *= m[i + 1];
+    for (uint32_t r = 0; r < 4; r++) {
+      for (uint32_t c = 0; c < 4; c++) {
+        max_error = std::max(max_error, fabsf(p0.m(r, c) - p1.m(r, c)));
+        max_error = std::max(max_error, fabsf(p2.m(r, c) - p1.m(r, c)));
+      }
+    }
+  }
+  logmsg("Max. difference from reference multiply = %g", max_error);
+}
+
+/**
+ * Checks the batch transforms against transforming one element at a time
+ * and logs the largest differences.
+ */
+void BatchTransformTest() {
+  logmsg("\nBatch transform test");
+
+  const size_t kCount = 100003;  // Not a multiple of 4 to test the tail
+  std::vector<Point3> points(kCount);
+  std::vector<Vector3> normals(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    points[i].Set(rand01() * 10.0f, rand01() * 10.0f, rand01() * 10.0f);
+    normals[i].Set(rand01() - 0.5f, rand01() - 0.5f, rand01() - 0.5f);
+    normals[i].Normalize();
+  }
+
+  Matrix4x4 m;
+  m.Translate(5.0f, -2.0f, 1.0f);
+  m.Rotate(30.0f, 1.0f, 2.0f, 3.0f);
+  m.Scale(2.0f, 1.0f, 0.5f);
+  Matrix4x4 normal_matrix = m.GetNormalMatrix();
+
+  // One at a time
+  std::vector<Point3> p1(kCount);
+  std::vector<Vector3> n1(kCount);
+  for (size_t i = 0; i < kCount; i++) {
+    p1[i] = (m * points[i]).ToCartesian();
+    n1[i] = normal_matrix * normals[i];
+    n1[i].Normalize();
+  }
+
+  // Batch, single thread and all hardware threads
+  std::vector<Point3> p2(kCount), p3(kCount);
+  std::vector<Vector3> n2(kCount);
+  m.TransformPoints(points.data(), p2.data(), kCount);
+  m.TransformPoints(points.data(), p3.data(), kCount, 0);
+  m.TransformNormals(normals.data(), n2.data(), kCount);
+
+  float max_point_error = 0.0f;
+  float max_normal_error = 0.0f;
+  for (size_t i = 0; i < kCount; i++) {
+    max_point_error = std::max(max_point_error, (p2[i] - p1[i]).Norm());
+    max_point_error = std::max(max_point_error, (p3[i] - p1[i]).Norm());
+    max_normal_error = std::max(max_normal_error, (n2[i] - n1[i]).Norm());
+  }
+  logmsg("Max. point difference from m * p = %g", max_point_error);
+  logmsg("Max. normal difference from normal matrix * n = %g", max_normal_error);
+}
+
+/**
+ * Checks the packet (structure of arrays) vector math against Vector3,
+ * and the packet vertex normal calculation against a face at a time.
+ */
+void PacketTest() {
+  logmsg("\nPacket test");
+
+  const int kCount = 40;
+  Vector3 a[kCount], b[kCount], c[kCount], d[kCount];
+  for (int i = 0; i < kCount; i++) {
+    a[i].Set(rand01() - 0.5f, rand01() - 0.5f, rand01() - 0.5f);
+    b[i].Set(rand01() - 0.5f, rand01() - 0.5f, rand01() - 0.5f);
+  }
+  a[5].Set(0.0f, 0.0f, 0.0f);   // Zero length stays unchanged by Normalize
+
+  float max_error = 0.0f;
+  for (int i = 0; i < kCount; i += Vector3x8::kWidth) {
+    Vector3x8 pa = Vector3x8::Load(&a[i]);
+    Vector3x8 pb = Vector3x8::Load(&b[i]);
+    pa.Cross(pb).Normalize().Store(&c[i]);
+    Float8 dot = pa.Dot(pb);
+    for (int j = 0; j < Vector3x8::kWidth; j++) {
+      Vector3 expected = a[i + j].Cross(b[i + j]);
+      expected.Normalize();
+      max_error = std::max(max_error, (c[i + j] - expected).Norm());
+      max_error = std::max(max_error, fabsf(dot[j] - a[i + j].Dot(b[i + j])));
+    }
+  }
+  for (int i = 0; i < kCount; i += Vector3x4::kWidth) {
+    Min(Vector3x4::Load(&a[i]), Vector3x4::Load(&b[i])).Store(&d[i]);
+    for (int j = 0; j < Vector3x4::kWidth; j++) {
+      max_error = std::max(max_error, fabsf(d[i + j].y - std::min(a[i + j].y, b[i + j].y)));
+    }
+  }
+  logmsg("Max. packet difference from Vector3 = %g", max_error);
+
+  // Vertex normals of a bumpy grid (face count not a multiple of 4)
+  const int kGrid = 7;
+  std::vector<VertexAndNormal> vertices;
+  std::vector<uint16_t> faces;
+  for (int i = 0; i <= kGrid; i++) {
+    for (int j = 0; j <= kGrid; j++) {
+      vertices.push_back(VertexAndNormal(Point3(float(i), float(j), rand01())));
+    }
+  }
+  for (int i = 0; i < kGrid; i++) {
+    for (int j = 0; j < kGrid; j++) {
+      uint16_t v = static_cast<uint16_t>(i * (kGrid + 1) + j);
+      uint16_t quad[6] = { v, uint16_t(v + kGrid + 1), uint16_t(v + 1),
+                           uint16_t(v + 1), uint16_t(v + kGrid + 1), uint16_t(v + kGrid + 2) };
+      faces.insert(faces.end(), quad, quad + 6);
+    }
+  }
+  faces.resize(faces.size() - 3);
+  std::vector<VertexAndNormal> expected = vertices;
+  for (size_t f = 0; f < faces.size(); f += 3) {
+    Vector3 e1(expected[faces[f]].vertex, expected[faces[f + 1]].vertex);
+    Vector3 e2(expected[faces[f]].vertex, expected[faces[f + 2]].vertex);
+    Vector3 n = e1.Cross(e2).Normalize();
+    for (int k = 0; k < 3; k++) {
+      expected[faces[f + k]].normal += n;
+    }
+  }
+  for (auto& v : expected) {
+    v.normal.Normalize();
+  }
+  ComputeVertexNormals(vertices, faces);
+  float max_normal_error = 0.0f;
+  for (size_t i = 0; i < vertices.size(); i++) {
+    max_normal_error = std::max(max_normal_error, (vertices[i].normal - expected[i].normal).Norm());
+  }
+  logmsg("Max. vertex normal difference = %g", max_normal_error);
+}
+
 /**
  * Main - entry point for test application.
  */
@@ -91,6 +288,29 @@ int main(int argc, char* argv[]) {
   M.Scale(10.0f, 10.0f, 10.0f);
   M.Log("After TRS: Composite matrix is");
 
+  // Fused TRS should match as well
+  Matrix4x4 F;
+  F.SetTRS(Point3(-5.0f, 10.0f, 15.0f), 45.0f, Vector3(0.0f, 0.0f, 1.0f),
+           Vector3(10.0f, 10.0f, 10.0f));
+  F.Log("After SetTRS: Composite matrix is");
+
+  // Quarter turn rotations formed at compile time should match the
+  // general rotations (without the round off in cos(90))
+  Matrix4x4 Q;
+  Q.Translate(0.0f, 10.0f, 0.0f);
+  Q.RotateX(-90.0f);
+  Q.RotateZ(180.0f);
+  Q.Scale(2.0f, 2.0f, 1.0f);
+  float max_quarter_error = 0.0f;
+  for (uint32_t r = 0; r < 4; r++) {
+    for (uint32_t c = 0; c < 4; c++) {
+      max_quarter_error = std::max(max_quarter_error,
+                                   fabsf(Q.m(r, c) - kCompileTime.m(r, c)));
+    }
+  }
+  kCompileTime.Log("Compile time quarter turn transform");
+  logmsg("Max. difference from RotateX/RotateZ = %g", max_quarter_error);
+
   // New composite matrix
   C.SetIdentity();
   C.Translate(-10.0f, 20.0f, 3.0f);
@@ -125,6 +345,25 @@ int main(int argc, char* argv[]) {
   Matrix4x4 VerifyInverse = C * CInverse;
   VerifyInverse.Log("Matrix times its Inverse (Should be Identity Matrix)");
 
+  // Closed form affine inverse should match the general inverse
+  logmsg("Matrix kind of M is %d (0 identity, 1 rigid, 2 affine, 3 projective)",
+         M.GetKind());
+  Matrix4x4 MAffineInverse = M.GetInverse();
+  MAffineInverse.Log("Affine inverse of M");
+  Matrix4x4 MGeneralInverse = M.GetGeneralInverse();
+  MGeneralInverse.Log("General inverse of M (Should match affine inverse)");
+  (M * MAffineInverse).Log("M times its affine inverse (Should be Identity Matrix)");
+
+  // Rigid inverse (rotation and translation only)
+  Matrix4x4 rigid;
+  rigid.Translate(3.0f, -2.0f, 7.0f);
+  rigid.Rotate(30.0f, 1.0f, 2.0f, 3.0f);
+  (rigid * rigid.GetInverse(MATRIX_RIGID)).Log("Rigid times its inverse (Should be Identity Matrix)");
+
+  // Normal matrix should match the transpose of the inverse (upper 3x3)
+  M.GetNormalMatrix().Log("Normal matrix of M");
+  M.GetGeneralInverse().Transpose().Log("Transpose of inverse of M (Should match upper 3x3)");
+
   // Test the ability to get the matrix and set it
   logmsg("Verify Set and Get Methods: Result should match rotation matrix");
   const float* mat = R.Get();
@@ -145,11 +384,54 @@ int main(int argc, char* argv[]) {
   general.Rotate(45.0f, 1.0f, 1.0f, 0.0f);
   general.Log("Rotation about a general axis");
 
+  // Quaternions: rotating a point should match the matrix rotation
+  Quaternion q(45.0f, Vector3(1.0f, 1.0f, 0.0f));
+  Point3 qp = q.Rotate(Point3(1.0f, 2.0f, 3.0f));
+  Point3 mp = general * Point3(1.0f, 2.0f, 3.0f);
+  logmsg("Quaternion rotated point is %f %f %f (matrix gives %f %f %f)",
+          qp.x, qp.y, qp.z, mp.x, mp.y, mp.z);
+
+  // Slerp half way from identity should be half the rotation angle. Nlerp
+  // follows the same path so matches at t = 0.5.
+  Quaternion half(22.5f, Vector3(1.0f, 1.0f, 0.0f));
+  Quaternion s = Quaternion().Slerp(q, 0.5f);
+  Quaternion n = Quaternion().Nlerp(q, 0.5f);
+  logmsg("Slerp(0.5) = %f %f %f %f  Nlerp(0.5) = %f %f %f %f  expected %f %f %f %f",
+          s.x, s.y, s.z, s.w, n.x, n.y, n.z, n.w, half.x, half.y, half.z, half.w);
+
+  // TRS from a quaternion should match TRS from the axis angle
+  Matrix4x4 qtrs;
+  qtrs.SetTRS(Point3(-5.0f, 10.0f, 15.0f), Quaternion(45.0f, Vector3(0.0f, 0.0f, 1.0f)),
+              Vector3(10.0f, 10.0f, 10.0f));
+  qtrs.Log("SetTRS from a quaternion: should match SetTRS above");
+
+  // Accumulating 180 steps of 2 degrees: the quaternion is renormalized
+  // each step, the matrix is not
+  Quaternion qstep(2.0f, Vector3(0.0f, 0.0f, 1.0f));
+  Quaternion qacc;
+  Matrix4x4 mstep;
+  mstep.Rotate(2.0f, 0.0f, 0.0f, 1.0f);
+  Matrix4x4 macc;
+  for (int i = 0; i < 180; i++) {
+    qacc = qstep * qacc;
+    qacc.Normalize();
+    macc = mstep * macc;
+  }
+  Vector3 qx = qacc.Rotate(Vector3(1.0f, 0.0f, 0.0f));
+  Vector3 mx = macc * Vector3(1.0f, 0.0f, 0.0f);
+  logmsg("After 180 steps of 2 degrees: quaternion x axis %f %f %f length %f",
+          qx.x, qx.y, qx.z, qx.Norm());
+  logmsg("                              matrix x axis     %f %f %f length %f",
+          mx.x, mx.y, mx.z, mx.Norm());
+
   // Transform a ray
   Ray3 ray1(Point3(5.0f, 0.0f, 0.0f), Vector3(1.0f, 0.0f, 0.0f));
   Ray3 tr = R * ray1;
   logmsg("Transformed Ray Origin is %f %f %f  Ray Direction = %f %f %f",
           tr.o.x, tr.o.y, tr.o.z, tr.d.x, tr.d.y, tr.d.z);
 
+  MultiplyTest();
+  BatchTransformTest();
+  PacketTest();
   return 1;
 }
\ No newline at end of file
@@ -225,11 +225,12 @@ protected:
   // one with arguments
   BallTransform() {}
 
-  // Sets the transformation matrix
+  // Sets the transformation matrix. The version tells the cached world
+  // matrix that it changed.
   void setTransform() {
-    model_matrix.SetIdentity();
-    model_matrix.Translate(position.x, position.y, position.z);
-    model_matrix.Scale(radius, radius, radius);
+    model_matrix.SetTranslateScale(position, Vector3(radius, radius, radius));
+    model_kind = (radius == 1.0f) ? MATRIX_RIGID : MATRIX_AFFINE;
+    matrix_version++;
   }
 
   // Create a random value between a specified minv and maxv.
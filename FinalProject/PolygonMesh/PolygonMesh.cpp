@@ -65,6 +65,13 @@ public:
 		m_nodes[m_current]->Draw(sceneState);
 	}
 
+   // Only the current node is drawn, so a render list draws this node
+   // with Draw rather than flattening all of the choices
+   virtual void Compile(RenderList& list)
+   {
+      list.AddNode(this);
+   }
+
    virtual void SetCurrent(const uint32_t current)
    {
       if (current < m_nodes.size())
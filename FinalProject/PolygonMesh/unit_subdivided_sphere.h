@@ -28,15 +28,15 @@ struct CTriangle {
 	
 	// Normalize - make each vertex a unit radius from the origin
 	void Normalize() {
-		float scale = FastInvSqrt(p1.x*p1.x + p1.y*p1.y + p1.z*p1.z);
+		float scale = FastRsqrt(p1.x*p1.x + p1.y*p1.y + p1.z*p1.z);
 		p1.x *= scale;
 		p1.y *= scale;
 		p1.z *= scale;
-		scale = FastInvSqrt(p2.x*p2.x + p2.y*p2.y + p2.z*p2.z);
+		scale = FastRsqrt(p2.x*p2.x + p2.y*p2.y + p2.z*p2.z);
 		p2.x *= scale;
 		p2.y *= scale;
 		p2.z *= scale;
-		scale = FastInvSqrt(p3.x*p3.x + p3.y*p3.y + p3.z*p3.z);
+		scale = FastRsqrt(p3.x*p3.x + p3.y*p3.y + p3.z*p3.z);
 		p3.x *= scale;
 		p3.y *= scale;
 		p3.z *= scale;
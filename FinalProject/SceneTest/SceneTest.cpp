@@ -0,0 +1,494 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    SceneTest.cpp
+//	Purpose: Headless tests of the scene graph support that does not
+//          need an OpenGL context: the per-frame arena, the transform
+//          snapshot and simulation thread, and the OpenGL state cache
+//          (against a stand-in for OpenGL).
+//
+//          Exit code: 0 = pass, 1 = a check failed.
+//
+//============================================================================
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <GL/gl3w.h>
+
+#include "geometry/geometry.h"
+#include "shader_support/glsl_shader.h"
+#include "scene/scene.h"
+
+// Logging function used by the scene library. Messages go to stdout.
+void logmsg(const char *message, ...) {
+  va_list arg;
+  va_start(arg, message);
+  vprintf(message, arg);
+  putchar('\n');
+  va_end(arg);
+}
+
+// Replace the global allocator so AllocationCounter sees every heap
+// allocation (as FinalProject does with COUNT_ALLOCATIONS).
+void* operator new(size_t bytes) {
+  AllocationCounter::Add(bytes);
+  void* p = malloc(bytes > 0 ? bytes : 1);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+// Number of failed checks
+int g_failures = 0;
+
+/**
+ * Checks a condition and reports a failure.
+ * @param  name  Check name
+ * @param  ok    Condition that must be true
+ */
+void Check(const char* name, const bool ok) {
+  if (!ok) {
+    printf("FAIL %s\n", name);
+    g_failures++;
+  }
+}
+
+/**
+ * Fills memory with a pattern.
+ */
+void Fill(void* p, const size_t bytes, const uint8_t value) {
+  memset(p, value, bytes);
+}
+
+/**
+ * Checks memory still holds a pattern.
+ */
+bool Holds(const void* p, const size_t bytes, const uint8_t value) {
+  const uint8_t* b = static_cast<const uint8_t*>(p);
+  for (size_t i = 0; i < bytes; i++) {
+    if (b[i] != value)
+      return false;
+  }
+  return true;
+}
+
+/**
+ * Per-frame arena: allocation within the capacity, overflow to the heap,
+ * and Reset growing the arena so the next frame does not allocate.
+ */
+void ArenaTests() {
+  const size_t kCapacity = 1024;
+  const size_t kBytes = 200;
+  const uint8_t kCount = 12;    // Frame needs more than the capacity
+  FrameArena arena(kCapacity);
+
+  // Allocations are aligned and do not overlap, in the block and after it
+  // overflows
+  void* p[kCount];
+  bool aligned = true;
+  for (uint8_t i = 0; i < kCount; i++) {
+    size_t alignment = (i % 2 == 0) ? 16 : 64;
+    p[i] = arena.Allocate(kBytes + i, alignment);
+    aligned = aligned && (reinterpret_cast<uintptr_t>(p[i]) % alignment) == 0;
+    Fill(p[i], kBytes + i, i + 1);
+  }
+  bool intact = true;
+  for (uint8_t i = 0; i < kCount; i++)
+    intact = intact && Holds(p[i], kBytes + i, i + 1);
+  Matrix4x4* m = arena.Allocate<Matrix4x4>(3);
+  Check("FrameArena aligned", aligned && reinterpret_cast<uintptr_t>(m) % alignof(Matrix4x4) == 0);
+  Check("FrameArena no overlap", intact);
+  Check("FrameArena overflow", arena.GetUsed() > kCapacity &&
+        arena.GetCapacity() == kCapacity && arena.GetHighWater() == arena.GetUsed());
+
+  // Reset grows the arena to hold the frame. The same frame again fits
+  // without a heap allocation, and Reset then does not grow it.
+  size_t high_water = arena.GetHighWater();
+  arena.Reset();
+  size_t capacity = arena.GetCapacity();
+  Check("FrameArena Reset", arena.GetUsed() == 0 && capacity >= high_water);
+  AllocationCounter::EndFrame();
+  for (uint8_t i = 0; i < kCount; i++)
+    p[i] = arena.Allocate(kBytes + i, (i % 2 == 0) ? 16 : 64);
+  arena.Allocate<Matrix4x4>(3);
+  bool fits = arena.GetUsed() <= capacity;
+  arena.Reset();
+  Check("FrameArena steady state", fits && AllocationCounter::EndFrame() == 0 &&
+        arena.GetCapacity() == capacity);
+}
+
+/**
+ * Gets the step a transform was written in (steps are written as a
+ * translation by the step number in x).
+ */
+uint32_t StepOf(TransformNode* node) {
+  return static_cast<uint32_t>(node->GetMatrix().m03());
+}
+
+/**
+ * Scene node that writes the step number to every slot of a snapshot
+ * each time it is updated.
+ */
+class StepNode : public SceneNode {
+public:
+  StepNode(TransformSnapshot* snapshot, const uint32_t slot_count)
+    : transforms(snapshot),
+      slots(slot_count),
+      step(0) {
+  }
+
+  virtual void Update(SceneState& scene_state) {
+    step++;
+    Matrix4x4 m;
+    m.Translate(static_cast<float>(step), 0.0f, 0.0f);
+    for (uint32_t i = 0; i < slots; i++)
+      transforms->Write(i, m);
+  }
+
+  uint32_t GetStep() const {
+    return step;
+  }
+
+private:
+  TransformSnapshot* transforms;
+  uint32_t           slots;
+  uint32_t           step;
+};
+
+/**
+ * Transform snapshot and simulation thread: publishing and applying on
+ * one thread, publishing and applying on 2 threads, and stopping the
+ * simulation thread.
+ */
+void SnapshotTests() {
+  // Enough slots that a step takes a while to write and apply, so a step
+  // that was not whole would show up
+  const uint32_t kSlots = 1024;
+  std::vector<TransformNode> nodes(kSlots);
+
+  // One thread: nothing to apply until a step is published, then only
+  // the newest step, once
+  {
+    TransformSnapshot snapshot;
+    for (auto& n : nodes)
+      snapshot.AddTransform(&n);
+    Check("Snapshot not fresh before Publish", !snapshot.IsFresh() && !snapshot.Apply());
+    Matrix4x4 m;
+    for (uint32_t step = 1; step <= 2; step++) {
+      m.SetIdentity();
+      m.Translate(static_cast<float>(step), 0.0f, 0.0f);
+      snapshot.Write(0, m);
+      snapshot.Publish();
+    }
+    Check("Snapshot fresh after Publish", snapshot.IsFresh());
+    Check("Snapshot Apply", snapshot.Apply() && StepOf(&nodes[0]) == 2);
+    Check("Snapshot not fresh after Apply", !snapshot.IsFresh());
+    Check("Snapshot Apply without Publish", !snapshot.Apply() && StepOf(&nodes[0]) == 2);
+
+    // Slots not written in a step keep their values
+    m.SetIdentity();
+    m.Translate(3.0f, 0.0f, 0.0f);
+    snapshot.Write(1, m);
+    snapshot.Publish();
+    Check("Snapshot unwritten slot", snapshot.Apply() && StepOf(&nodes[0]) == 2 &&
+          StepOf(&nodes[1]) == 3);
+  }
+
+  // 2 threads: every frame sees a whole step (all slots the same) and
+  // steps only move forward
+  {
+    for (auto& n : nodes)
+      n.LoadIdentity();
+    TransformSnapshot snapshot;
+    for (auto& n : nodes)
+      snapshot.AddTransform(&n);
+    const uint32_t kSteps = 5000;
+    std::thread writer([&]() {
+      Matrix4x4 m;
+      for (uint32_t step = 1; step <= kSteps; step++) {
+        m.SetIdentity();
+        m.Translate(static_cast<float>(step), 0.0f, 0.0f);
+        for (uint32_t i = 0; i < kSlots; i++)
+          snapshot.Write(i, m);
+        snapshot.Publish();
+      }
+    });
+    uint32_t last = 0;
+    uint32_t frames = 0;
+    int torn = 0;
+    int backwards = 0;
+    int stale = 0;
+    while (last < kSteps) {
+      bool applied = snapshot.Apply();
+      uint32_t step = StepOf(&nodes[0]);
+      for (uint32_t i = 1; i < kSlots; i++)
+        torn += (StepOf(&nodes[i]) != step);
+      if (applied) {
+        backwards += (step <= last);
+        frames++;
+      } else {
+        stale += (step != last);
+      }
+      last = step;
+    }
+    writer.join();
+    Check("Snapshot whole steps", torn == 0);
+    Check("Snapshot steps increase", backwards == 0);
+    Check("Snapshot unchanged without Publish", stale == 0);
+    Check("Snapshot frames", frames > 0 && frames <= kSteps && !snapshot.Apply());
+  }
+
+  // Simulation thread: after Stop no more steps are published and the
+  // last one applied is the last one simulated
+  {
+    for (auto& n : nodes)
+      n.LoadIdentity();
+    TransformSnapshot snapshot;
+    for (auto& n : nodes)
+      snapshot.AddTransform(&n);
+    StepNode root(&snapshot, kSlots);
+    SimulationThread simulation(&root, &snapshot, 1000.0f);
+    simulation.Start();
+    uint32_t last = 0;
+    int backwards = 0;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (std::chrono::steady_clock::now() < end) {
+      if (snapshot.Apply()) {
+        backwards += (StepOf(&nodes[kSlots - 1]) <= last);
+        last = StepOf(&nodes[kSlots - 1]);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    simulation.Stop();
+    uint32_t steps = simulation.GetStepCount();
+    Check("Simulation steps increase", backwards == 0);
+    Check("Simulation step count", steps > 0 && steps == root.GetStep());
+    snapshot.Apply();
+    Check("Simulation last step", StepOf(&nodes[0]) == steps && StepOf(&nodes[kSlots - 1]) == steps);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    Check("Simulation stopped", !snapshot.IsFresh() && simulation.GetStepCount() == steps);
+    simulation.Stop();
+  }
+}
+
+// Stand-in for OpenGL: counts the calls that set state and keeps the
+// vertex array object and texture bindings
+struct FakeGL {
+  uint32_t calls;
+  uint32_t uniform_calls;
+  GLuint   vertex_array;
+  GLuint   active_unit;
+  GLuint   textures[8];
+};
+FakeGL g_gl;
+
+void APIENTRY FakeUseProgram(GLuint) {
+  g_gl.calls++;
+}
+void APIENTRY FakeBindVertexArray(GLuint vao) {
+  g_gl.calls++;
+  g_gl.vertex_array = vao;
+}
+void APIENTRY FakeDeleteVertexArrays(GLsizei n, const GLuint* vaos) {
+  for (GLsizei i = 0; i < n; i++) {
+    if (g_gl.vertex_array == vaos[i])
+      g_gl.vertex_array = 0;
+  }
+}
+void APIENTRY FakeActiveTexture(GLenum unit) {
+  g_gl.calls++;
+  g_gl.active_unit = unit - GL_TEXTURE0;
+}
+void APIENTRY FakeBindTexture(GLenum, GLuint texture) {
+  g_gl.calls++;
+  g_gl.textures[g_gl.active_unit] = texture;
+}
+void APIENTRY FakeDeleteTextures(GLsizei n, const GLuint* textures) {
+  for (GLsizei i = 0; i < n; i++) {
+    for (GLuint& t : g_gl.textures) {
+      if (t == textures[i])
+        t = 0;
+    }
+  }
+}
+void APIENTRY FakeCapability(GLenum) {
+  g_gl.calls++;
+}
+void APIENTRY FakeBlendFunc(GLenum, GLenum) {
+  g_gl.calls++;
+}
+void APIENTRY FakeDepthMask(GLboolean) {
+  g_gl.calls++;
+}
+void APIENTRY FakeUniform1i(GLint, GLint) {
+  g_gl.calls++;
+  g_gl.uniform_calls++;
+}
+void APIENTRY FakeUniform1f(GLint, GLfloat) {
+  g_gl.calls++;
+  g_gl.uniform_calls++;
+}
+void APIENTRY FakeUniformfv(GLint, GLsizei, const GLfloat*) {
+  g_gl.calls++;
+  g_gl.uniform_calls++;
+}
+void APIENTRY FakeUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat*) {
+  g_gl.calls++;
+  g_gl.uniform_calls++;
+}
+
+/**
+ * Points the OpenGL functions the state cache calls at the stand-in.
+ */
+void UseFakeGL() {
+  g_gl = FakeGL();
+  gl3wUseProgram = FakeUseProgram;
+  gl3wBindVertexArray = FakeBindVertexArray;
+  gl3wDeleteVertexArrays = FakeDeleteVertexArrays;
+  gl3wActiveTexture = FakeActiveTexture;
+  gl3wBindTexture = FakeBindTexture;
+  gl3wDeleteTextures = FakeDeleteTextures;
+  gl3wEnable = FakeCapability;
+  gl3wDisable = FakeCapability;
+  gl3wBlendFunc = FakeBlendFunc;
+  gl3wDepthMask = FakeDepthMask;
+  gl3wUniform1i = FakeUniform1i;
+  gl3wUniform1f = FakeUniform1f;
+  gl3wUniform3fv = FakeUniformfv;
+  gl3wUniform4fv = FakeUniformfv;
+  gl3wUniformMatrix4fv = FakeUniformMatrix4fv;
+}
+
+/**
+ * Makes the state changes of a frame that draws 2 textured objects with
+ * each of 2 programs, the way the scene nodes do, and checks the stand-in
+ * ends up with the object and texture last bound (or 0 once released
+ * with the cache off).
+ * @return  Returns the calls made through the cache in the frame.
+ */
+GLStateStats DrawFrame(GLStateCache& cache, bool& bound) {
+  const GLuint kVertexArrays[2] = { 3, 4 };
+  const GLuint kTextures[2] = { 7, 8 };
+  const GLfloat kColors[2][4] = { { 1.0f, 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } };
+  Matrix4x4 m;
+  g_gl.calls = 0;
+  g_gl.uniform_calls = 0;
+  cache.Enable(GL_DEPTH_TEST);
+  cache.Enable(GL_CULL_FACE);
+  cache.DepthMask(GL_TRUE);
+  cache.Disable(GL_BLEND);
+  for (GLuint program = 1; program <= 2; program++) {
+    cache.UseProgram(program);
+    cache.Uniform1i(0, 0);
+    cache.UniformMatrix4fv(1, m.Get());
+    cache.Uniform1f(2, 0.5f * program);
+    for (uint32_t i = 0; i < 2; i++) {
+      cache.Uniform4fv(3, kColors[i]);
+      cache.Uniform3fv(4, kColors[i]);
+      cache.BindVertexArray(kVertexArrays[i]);
+      cache.BindTexture(0, kTextures[i]);
+      bound = bound && g_gl.vertex_array == kVertexArrays[i] &&
+              g_gl.textures[0] == kTextures[i];
+      cache.ReleaseTexture(0);
+      cache.ReleaseVertexArray();
+    }
+  }
+  cache.Enable(GL_BLEND);
+  cache.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  cache.DepthMask(GL_FALSE);
+  bound = bound && (cache.IsEnabled() || (g_gl.vertex_array == 0 && g_gl.textures[0] == 0));
+  return cache.EndFrame();
+}
+
+/**
+ * OpenGL state cache: with it off every call is passed on; with it on
+ * calls that would not change the state are skipped and counted, the
+ * uniform values are kept per program, Invalidate forgets the state,
+ * and a deleted vertex array object or texture is not taken as bound.
+ */
+void StateCacheTests() {
+  UseFakeGL();
+  GLStateCache& cache = GLStateCache::Get();
+  bool bound = true;
+
+  // Off: nothing is skipped
+  cache.SetEnabled(false);
+  GLStateStats off = DrawFrame(cache, bound);
+  uint32_t off_calls = g_gl.calls;
+  Check("GLStateCache off", off.elided == 0 && off.issued == off_calls &&
+        DrawFrame(cache, bound).issued == off_calls);
+
+  // On: the first frame only skips what the frame itself repeats, the
+  // next one also what the last frame left set. The counts are of the
+  // calls made to OpenGL.
+  cache.SetEnabled(true);
+  GLStateStats first = DrawFrame(cache, bound);
+  uint32_t first_calls = g_gl.calls;
+  GLStateStats next = DrawFrame(cache, bound);
+  const uint32_t kColorUniforms = 8;  // Only the colors of the objects change
+  uint32_t next_calls = g_gl.calls;
+  Check("GLStateCache issued", first.issued == first_calls && next.issued == next_calls);
+  Check("GLStateCache elided", first.issued < off_calls && next.issued < first.issued &&
+        first.issued + first.elided == next.issued + next.elided);
+  Check("GLStateCache uniforms per program", g_gl.uniform_calls == kColorUniforms);
+  Check("GLStateCache bindings", bound);
+
+  // Invalidate: the next frame passes on what the first frame did
+  cache.Invalidate();
+  GLStateStats invalidated = DrawFrame(cache, bound);
+  Check("GLStateCache Invalidate", invalidated.issued == first.issued &&
+        invalidated.elided == first.elided && g_gl.calls == first_calls);
+
+  // Deleting the bound vertex array object or texture unbinds it, so a
+  // new object given the same name is bound
+  cache.BindVertexArray(5);
+  cache.BindVertexArray(5);
+  cache.BindTexture(0, 9);
+  cache.BindTexture(1, 9);
+  cache.EndFrame();
+  cache.DeleteVertexArray(5);
+  cache.DeleteTexture(9);
+  g_gl.calls = 0;
+  cache.BindVertexArray(5);
+  cache.BindTexture(0, 9);
+  cache.BindTexture(1, 9);
+  GLStateStats rebound = cache.EndFrame();
+  Check("GLStateCache delete vertex array", g_gl.vertex_array == 5);
+  Check("GLStateCache delete texture", g_gl.textures[0] == 9 && g_gl.textures[1] == 9 &&
+        rebound.issued == g_gl.calls);
+
+  // Deleting an object that is not bound leaves the binding known
+  cache.DeleteVertexArray(6);
+  cache.DeleteTexture(10);
+  cache.BindVertexArray(5);
+  cache.BindTexture(1, 9);
+  GLStateStats kept = cache.EndFrame();
+  Check("GLStateCache delete unbound", kept.issued == 0 && kept.elided == 2);
+  cache.SetEnabled(false);
+}
+
+int main(int argc, char* argv[]) {
+  ArenaTests();
+  SnapshotTests();
+  StateCacheTests();
+
+  if (g_failures > 0) {
+    printf("%d check(s) failed\n", g_failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
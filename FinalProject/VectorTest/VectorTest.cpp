@@ -223,6 +223,50 @@ int main(int argc, char* argv[]) {
   else {
     logmsg("seg2d does not intersect seg2");
   }
+
+  // Batch clipping must match clipping one segment at a time. Use enough
+  // segments to be split into blocks across threads.
+  const size_t kSegments = 20011;
+  std::vector<LineSegment2> segments(kSegments), clipped(kSegments);
+  std::vector<uint32_t> clipped_index(kSegments);
+  for (size_t i = 0; i < kSegments; i++) {
+    segments[i] = LineSegment2(Point2((rand01() - 0.5f) * 40.0f, (rand01() - 0.5f) * 40.0f),
+                               Point2((rand01() - 0.5f) * 40.0f, (rand01() - 0.5f) * 40.0f));
+  }
+  segments[0] = LineSegment2({ -20.0f, 12.0f }, { 20.0f, 12.0f });   // Parallel, above
+  segments[1] = LineSegment2({ -20.0f, 5.0f }, { 20.0f, 5.0f });     // Parallel, inside
+  CRectangle clip_rect = { -10.0f, 10.0f, -10.0f, 10.0f };
+  std::vector<Point2> hexagon;
+  for (int i = 0; i < 6; i++) {
+    float angle = DegreesToRadians(60.0f * i);
+    hexagon.push_back(Point2(10.0f * cosf(angle), 10.0f * sinf(angle)));
+  }
+  for (int test = 0; test < 2; test++) {
+    size_t n = (test == 0) ?
+        ClipSegmentsToRectangle(segments.data(), kSegments, clip_rect, clipped.data(),
+                                clipped_index.data(), 0) :
+        ClipSegmentsToPolygon(segments.data(), kSegments, hexagon, clipped.data(),
+                              clipped_index.data(), 0);
+    size_t expected = 0;
+    size_t k = 0;
+    float max_error = 0.0f;
+    for (size_t i = 0; i < kSegments; i++) {
+      LineSegment2 c;
+      bool in = (test == 0) ? segments[i].ClipToRectangle(clip_rect, c) :
+                              segments[i].ClipToPolygon(hexagon, c);
+      if (in) {
+        expected++;
+        if (k < n && clipped_index[k] == i) {
+          max_error = std::max(max_error, std::max((clipped[k].a - c.a).Norm(),
+                                                   (clipped[k].b - c.b).Norm()));
+          k++;
+        }
+      }
+    }
+    logmsg("Batch clip to %s: %u of %u segments (expect %u), max. difference %g",
+           (test == 0) ? "rectangle" : "hexagon", (uint32_t)n, (uint32_t)kSegments,
+           (uint32_t)expected, max_error);
+  }
  
   // ------------ Line segment 3-D tests ---------------//
   logmsg("\n3-D Line Segment Operations\n");
@@ -363,5 +407,159 @@ int main(int argc, char* argv[]) {
   else {
     logmsg("   Ray4 does not intersect sphere");
   }
+
+  // Ray to plane, box, triangle and polygon
+  Plane ground(Point3(0.0f, 0.0f, -1.0f), Vector3(0.0f, 0.0f, 1.0f));
+  Ray3 down(Point3(1.0f, 2.0f, 5.0f), Point3(1.0f, 2.0f, 0.0f), true);
+  logmsg("   Ray down intersects plane z = -1 at t = %f (expect 6)", down.Intersect(ground));
+  AABB box(Point3(-1.0f, -1.0f, -1.0f), Point3(2.0f, 3.0f, 1.0f));
+  logmsg("   Ray down intersects box at t = %f (expect 4)", down.Intersect(box));
+  Ray3 inside(Point3(0.0f, 0.0f, 0.0f), Vector3(1.0f, 0.0f, 0.0f));
+  logmsg("   Ray from inside the box exits at t = %f (expect 2)", inside.Intersect(box));
+  logmsg("   Ray1 intersects box at t = %f (expect 0 - miss)", ray1.Intersect(box));
+  float bu, bv;
+  t = down.Intersect(Point3(0.0f, 0.0f, 0.0f), Point3(4.0f, 0.0f, 0.0f), Point3(0.0f, 4.0f, 0.0f), bu, bv);
+  logmsg("   Ray down intersects triangle at t = %f u = %f v = %f (expect 5 0.25 0.5)", t, bu, bv);
+  t = ray1.Intersect(Point3(0.0f, 0.0f, 0.0f), Point3(4.0f, 0.0f, 0.0f), Point3(0.0f, 4.0f, 0.0f), bu, bv);
+  logmsg("   Ray1 intersects triangle at t = %f (expect 0 - parallel)", t);
+  std::vector<Point3> square = { Point3(0.0f, 0.0f, 0.0f), Point3(2.0f, 0.0f, 0.0f),
+                                 Point3(2.0f, 3.0f, 0.0f), Point3(0.0f, 3.0f, 0.0f) };
+  Vector3 square_normal(0.0f, 0.0f, 1.0f);
+  logmsg("   Ray down intersects square at t = %f (expect 5)", down.Intersect(square, square_normal));
+
+  // Packets: one ray against 8 boxes and 8 triangles, 8 rays against one
+  // box and one triangle. Each lane should match the ray at a time test.
+  const int kLanes = Float8::kWidth;
+  AABB boxes[kLanes];
+  Point3 p0[kLanes], p1[kLanes], p2[kLanes];
+  Ray3 rays[kLanes];
+  for (int i = 0; i < kLanes; i++) {
+    Point3 c(rand01() * 2.0f, rand01() * 2.0f + 1.0f, rand01() * 2.0f - 1.0f);
+    boxes[i] = AABB(c - Vector3(1.0f, 1.0f, 1.0f), c + Vector3(1.0f, 1.0f, 1.0f));
+    p0[i] = c;
+    p1[i] = c + Vector3(rand01(), rand01(), -0.5f);
+    p2[i] = c + Vector3(-rand01(), rand01(), 0.5f);
+    rays[i] = Ray3(Point3(rand01(), rand01(), 5.0f), Vector3(rand01() - 0.5f, rand01() - 0.5f, -1.0f), true);
+  }
+  Float8 pu, pv;
+  Float8 tb = down.Intersect(AABBx8::Load(boxes));
+  Float8 tt = down.Intersect(Trianglex8::Load(p0, p1, p2), pu, pv);
+  Ray3x8 ray_packet = Ray3x8::Load(rays);
+  Float8 rb = ray_packet.Intersect(box);
+  Float8 rt = ray_packet.Intersect(p0[0], p1[0], p2[0], pu, pv);
+  int mismatches = 0;
+  int hits = 0;
+  for (int i = 0; i < kLanes; i++) {
+    float ti = down.Intersect(p0[i], p1[i], p2[i], bu, bv);
+    float ri = rays[i].Intersect(p0[0], p1[0], p2[0], bu, bv);
+    mismatches += (fabsf(tb[i] - down.Intersect(boxes[i])) > 1.0e-4f);
+    mismatches += (fabsf(tt[i] - ti) > 1.0e-4f);
+    mismatches += (fabsf(rb[i] - rays[i].Intersect(box)) > 1.0e-4f);
+    mismatches += (fabsf(rt[i] - ri) > 1.0e-4f);
+    hits += (tb[i] != 0.0f) + (tt[i] != 0.0f) + (rb[i] != 0.0f) + (rt[i] != 0.0f);
+  }
+  logmsg("   Packet intersections: %d hits, %d differ from one at a time (expect 0)", hits, mismatches);
+
+  // ---------- Bounding Volumes ----------------//
+  logmsg("\nBounding Volume Tests\n");
+  std::vector<Point3> cloud;
+  for (int i = 0; i < 1001; i++) {
+    cloud.push_back(Point3(rand01() * 4.0f - 1.0f, rand01() * 2.0f + 3.0f, rand01() - 5.0f));
+  }
+  AABB cloud_box(cloud);
+  AABB slow_box;
+  for (auto& p : cloud) {
+    slow_box.Extend(p);
+  }
+  logmsg("   Box min %f %f %f max %f %f %f (point at a time gives %f %f %f  %f %f %f)",
+         cloud_box.m_min.x, cloud_box.m_min.y, cloud_box.m_min.z,
+         cloud_box.m_max.x, cloud_box.m_max.y, cloud_box.m_max.z,
+         slow_box.m_min.x, slow_box.m_min.y, slow_box.m_min.z,
+         slow_box.m_max.x, slow_box.m_max.y, slow_box.m_max.z);
+
+  BoundingSphere cloud_sphere(cloud);
+  float max_outside = 0.0f;
+  for (auto& p : cloud) {
+    max_outside = std::max(max_outside, (p - cloud_sphere.m_center).Norm() - cloud_sphere.m_radius);
+  }
+  logmsg("   Ritter sphere radius %f (half box diagonal %f), max. distance outside %g",
+         cloud_sphere.m_radius, cloud_box.GetHalfDiagonal().Norm(), max_outside);
+
+  BoundingSphere merged = sphere.Merge(cloud_sphere);
+  logmsg("   Merged sphere center %f %f %f radius %f", merged.m_center.x, merged.m_center.y,
+         merged.m_center.z, merged.m_radius);
+  AABB merged_box = box.Merge(cloud_box);
+  logmsg("   Merged box min %f %f %f max %f %f %f", merged_box.m_min.x, merged_box.m_min.y,
+         merged_box.m_min.z, merged_box.m_max.x, merged_box.m_max.y, merged_box.m_max.z);
+
+  // Transformed box (Arvo) should match the box around the 8 transformed corners
+  Matrix4x4 xform;
+  xform.Translate(3.0f, -2.0f, 1.0f);
+  xform.Rotate(30.0f, 1.0f, 2.0f, 3.0f);
+  xform.Scale(2.0f, 1.0f, 0.5f);
+  AABB arvo = cloud_box.Transform(xform);
+  AABB corners;
+  for (int i = 0; i < 8; i++) {
+    Point3 c((i & 1) ? cloud_box.m_max.x : cloud_box.m_min.x,
+             (i & 2) ? cloud_box.m_max.y : cloud_box.m_min.y,
+             (i & 4) ? cloud_box.m_max.z : cloud_box.m_min.z);
+    corners.Extend(xform * c);
+  }
+  logmsg("   Transformed box min %f %f %f max %f %f %f", arvo.m_min.x, arvo.m_min.y,
+         arvo.m_min.z, arvo.m_max.x, arvo.m_max.y, arvo.m_max.z);
+  logmsg("   Box of 8 corners    %f %f %f max %f %f %f", corners.m_min.x, corners.m_min.y,
+         corners.m_min.z, corners.m_max.x, corners.m_max.y, corners.m_max.z);
+
+  logmsg("\nFrustum Tests\n");
+
+  // Symmetric perspective projection (50 degree fov, near 1, far 1000) with
+  // the camera at (0, 0, 10) looking down -z (same form as CameraNode)
+  float fn = 1.0f;
+  float ff = 1000.0f;
+  float fh = fn * tanf(DegreesToRadians(25.0f));
+  Matrix4x4 proj;
+  proj.m00() = fn / fh;
+  proj.m11() = fn / fh;
+  proj.m22() = -(ff + fn) / (ff - fn);
+  proj.m23() = -(2.0f * ff * fn) / (ff - fn);
+  proj.m32() = -1.0f;
+  proj.m33() = 0.0f;
+  Matrix4x4 view;
+  view.Translate(0.0f, 0.0f, -10.0f);
+  Frustum frustum(proj * view);
+  const Plane& near_plane = frustum.m_planes[FRUSTUM_NEAR];
+  logmsg("   Near plane %f %f %f %f (expect 0 0 -1 -9)", near_plane.a, near_plane.b,
+         near_plane.c, near_plane.d);
+  logmsg("   Point in front of camera inside: %d (expect 1)",
+         frustum.Contains(Point3(0.0f, 0.0f, 0.0f)));
+  logmsg("   Point behind camera inside: %d (expect 0)",
+         frustum.Contains(Point3(0.0f, 0.0f, 20.0f)));
+  logmsg("   Sphere straddling near plane visible: %d (expect 1)",
+         frustum.Intersects(BoundingSphere(Point3(0.0f, 0.0f, 10.0f), 2.0f)));
+  logmsg("   Sphere left of view visible: %d (expect 0)",
+         frustum.Intersects(BoundingSphere(Point3(-100.0f, 0.0f, -10.0f), 5.0f)));
+  logmsg("   Box past far plane visible: %d (expect 0)",
+         frustum.Intersects(AABB(Point3(-1.0f, -1.0f, -1200.0f), Point3(1.0f, 1.0f, -1100.0f))));
+
+  // Packet culling must match one object at a time
+  const size_t kObjects = 1003;
+  std::vector<BoundingSphere> cull_spheres(kObjects);
+  std::vector<AABB> cull_boxes(kObjects);
+  for (size_t i = 0; i < kObjects; i++) {
+    Point3 c((rand01() - 0.5f) * 2000.0f, (rand01() - 0.5f) * 200.0f, (rand01() - 0.5f) * 2000.0f);
+    cull_spheres[i] = BoundingSphere(c, rand01() * 20.0f);
+    cull_boxes[i] = AABB(c - Vector3(5.0f, 10.0f, 5.0f), c + Vector3(5.0f, 10.0f, 5.0f));
+  }
+  std::vector<uint8_t> sphere_visible(kObjects), box_visible(kObjects);
+  size_t sphere_count = frustum.Cull(cull_spheres.data(), kObjects, sphere_visible.data());
+  size_t box_count = frustum.Cull(cull_boxes.data(), kObjects, box_visible.data());
+  int cull_mismatch = 0;
+  for (size_t i = 0; i < kObjects; i++) {
+    cull_mismatch += (sphere_visible[i] != (frustum.Intersects(cull_spheres[i]) ? 1 : 0));
+    cull_mismatch += (box_visible[i] != (frustum.Intersects(cull_boxes[i]) ? 1 : 0));
+  }
+  logmsg("   Visible spheres %u of %u, boxes %u of %u, packet mismatches %d (expect 0)",
+         (uint32_t)sphere_count, (uint32_t)kObjects, (uint32_t)box_count, (uint32_t)kObjects,
+         cull_mismatch);
   return 1;
 }
\ No newline at end of file
@@ -14,20 +14,29 @@
 #ifndef __AABB_H__
 #define __AABB_H__
 
+#include <float.h>
+#include <algorithm>
 #include <vector>
 
-// NOTE - this is not required until 605.767!
+// Forward references
+struct Matrix4x4;
+struct Affine3x4;
 
 /**
  * Axis Aligned Bounding Box.
  */
 struct AABB
 {
+  Point3 m_min;     // Minimum x,y,z
+  Point3 m_max;     // Maximum x,y,z
+
   /**
-   * Default constructor.
+   * Default constructor. The box is empty (min > max) so it can be grown
+   * to contain points.
    */
-  AABB() {
-    // Complete in 605.767
+  AABB()
+    : m_min{ FLT_MAX, FLT_MAX, FLT_MAX },
+      m_max{ -FLT_MAX, -FLT_MAX, -FLT_MAX } {
   }
 
   /**
@@ -35,8 +44,9 @@ struct AABB
    * @param  minPt  Minimum point (x,y,z)
    * @param  maxPt  Maximum point (x,y,z)
    */
-  AABB(const Point3& minPt, const Point3& maxPt) {
-    // Complete in 605.767
+  AABB(const Point3& minPt, const Point3& maxPt)
+    : m_min(minPt),
+      m_max(maxPt) {
   }
 
   /**
@@ -44,7 +54,7 @@ struct AABB
    * @param  vertexList  Vertex list.
    */
   AABB(const std::vector<Point3>& vertexList) {
-    // Complete in 605.767
+    Create(vertexList);
   }
 
   /**
@@ -52,16 +62,90 @@ struct AABB
    * @param  vertexList  Vertex list.
    */
   void Create(const std::vector<Point3>& vertexList) {
-    // Complete in 605.767
+    Create(vertexList.empty() ? nullptr : &vertexList[0].x, sizeof(Point3),
+           vertexList.size());
+  }
+
+  /**
+   * Creates an AABB from a strided array of positions (for example the
+   * vertex member of a VertexAndNormal list). The min/max reduction is
+   * done 8 points at a time with Vector3x8 packets.
+   * @param  xyz     Pointer to the x coordinate of the first position.
+   * @param  stride  Distance in bytes between positions.
+   * @param  count   Number of positions.
+   */
+  void Create(const float* xyz, const size_t stride, const size_t count) {
+    *this = AABB();
+    const size_t kWidth = Vector3x8::kWidth;
+    const char* p = reinterpret_cast<const char*>(xyz);
+    size_t i = 0;
+    if (count >= kWidth) {
+      Vector3x8 lo = Vector3x8::LoadStrided(xyz, stride);
+      Vector3x8 hi = lo;
+      for (i = kWidth; i + kWidth <= count; i += kWidth) {
+        Vector3x8 v = Vector3x8::LoadStrided(
+                  reinterpret_cast<const float*>(p + i * stride), stride);
+        lo = Min(lo, v);
+        hi = Max(hi, v);
+      }
+      for (int k = 0; k < Vector3x8::kWidth; k++) {
+        Extend(Point3(lo.x[k], lo.y[k], lo.z[k]));
+        Extend(Point3(hi.x[k], hi.y[k], hi.z[k]));
+      }
+    }
+    for (; i < count; i++) {
+      const float* v = reinterpret_cast<const float*>(p + i * stride);
+      Extend(Point3(v[0], v[1], v[2]));
+    }
+  }
+
+  /**
+   * Checks if the box is empty (contains no points).
+   * @return  Returns true if the box is empty.
+   */
+  bool IsEmpty() const {
+    return m_min.x > m_max.x;
+  }
+
+  /**
+   * Grows the box to contain a point.
+   * @param  p  Point
+   */
+  void Extend(const Point3& p) {
+    m_min.Set(std::min(m_min.x, p.x), std::min(m_min.y, p.y), std::min(m_min.z, p.z));
+    m_max.Set(std::max(m_max.x, p.x), std::max(m_max.y, p.y), std::max(m_max.z, p.z));
+  }
+
+  /**
+   * Merge this box with another to create the smallest box containing
+   * the 2.
+   * @param  b  Box to merge with this box.
+   * @return  Returns the merged box.
+   */
+  AABB Merge(const AABB& b) const {
+    return AABB(Point3(std::min(m_min.x, b.m_min.x), std::min(m_min.y, b.m_min.y),
+                       std::min(m_min.z, b.m_min.z)),
+                Point3(std::max(m_max.x, b.m_max.x), std::max(m_max.y, b.m_max.y),
+                       std::max(m_max.z, b.m_max.z)));
   }
 
+  /**
+   * Forms the box containing this box after an affine transformation,
+   * in constant time (method by Arvo): the transformed center plus the
+   * half diagonal transformed by the absolute value of the 3x3 part.
+   * Defined after Matrix4x4 (geometry.h).
+   * @param  m  Affine transformation
+   * @return  Returns the transformed box.
+   */
+  AABB Transform(const Matrix4x4& m) const;
+  AABB Transform(const Affine3x4& m) const;
+
   /**
    * Get the point at the minimum x,y,z.
    * @return  Returns the min. point.
    */
   Point3 GetMinPt() const {
-    // Complete in 605.767
-    return Point3();
+    return m_min;
   }
 
   /**
@@ -69,16 +153,49 @@ struct AABB
    * @return  Returns the max. point.
    */
   Point3 GetMaxPt() const {
-    // Complete in 605.767
-    return Point3();
+    return m_max;
+  }
+
+  /**
+   * Get the center of the box.
+   * @return  Returns the center point.
+   */
+  Point3 GetCenter() const {
+    return m_min.MidPoint(m_max);
+  }
+
+  /**
+   * Get the half diagonal (half the extent along each axis).
+   * @return  Returns the vector from the center to the max. point.
+   */
+  Vector3 GetHalfDiagonal() const {
+    return (m_max - m_min) * 0.5f;
   }
+};
+
+/**
+ * Packet of kWidth boxes (structure of arrays) for testing one ray against
+ * several boxes at once (see Ray3::Intersect).
+ */
+template <typename F>
+struct AABBxN {
+  Vector3xN<F> m_min;
+  Vector3xN<F> m_max;
 
   /**
-   * Compute center and half diagonal
+   * Loads kWidth consecutive boxes.
+   * @param  boxes  Pointer to the first box.
+   * @return Returns the packet.
    */
-  void ComputeCenter() {
-    // Complete in 605.767
+  static AABBxN Load(const AABB* boxes) {
+    AABBxN p;
+    p.m_min = Vector3xN<F>::LoadStrided(&boxes->m_min.x, sizeof(AABB));
+    p.m_max = Vector3xN<F>::LoadStrided(&boxes->m_max.x, sizeof(AABB));
+    return p;
   }
 };
 
+typedef AABBxN<Float4> AABBx4;
+typedef AABBxN<Float8> AABBx8;
+
 #endif
@@ -0,0 +1,347 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    affine.h
+//	Purpose: Compact 3x4 affine transformation matrix.
+//          Student should include "geometry.h" to get all class definitions
+//          included in proper order.
+//
+//============================================================================
+
+#ifndef __AFFINE_H__
+#define __AFFINE_H__
+
+/**
+ * Affine transformation stored as the top 3 rows of a 4x4 matrix. The
+ * bottom row of an affine matrix is always (0, 0, 0, 1) so it is not
+ * stored: 12 floats (48 bytes) instead of the 16 floats of a Matrix4x4.
+ * Elements are in row order so each row is one vec4 in a GPU buffer. A
+ * shader transforms a point p with
+ *   vec3(dot(row0, vec4(p, 1)), dot(row1, vec4(p, 1)), dot(row2, vec4(p, 1)))
+ * Use Matrix4x4 for projections and wherever the kind of transformation
+ * matters (inverse and normal matrix shortcuts); use Affine3x4 to store
+ * large numbers of world or instance transforms.
+ */
+struct Affine3x4 {
+  // Elements (row, col) are at m_a[row * 4 + col]. Aligned so each row
+  // fills one SSE register. Rows may still be unaligned inside arrays
+  // allocated before C++17, so the SIMD code uses unaligned loads.
+  alignas(16) float m_a[12];
+
+  /**
+   * Constructor. Sets the matrix to the identity matrix.
+   */
+  constexpr Affine3x4()
+    : m_a{ 1.0f, 0.0f, 0.0f, 0.0f,
+           0.0f, 1.0f, 0.0f, 0.0f,
+           0.0f, 0.0f, 1.0f, 0.0f } {
+  }
+
+  /**
+   * Constructor given a 4x4 matrix. The bottom row of the matrix is
+   * dropped, so m should be affine.
+   * @param  m  Matrix to copy.
+   */
+  explicit Affine3x4(const Matrix4x4& m) {
+    Set(m);
+  }
+
+  /**
+   * Sets the matrix to the top 3 rows of a 4x4 matrix.
+   * @param  m  Matrix to copy (should be affine).
+   */
+  void Set(const Matrix4x4& m) {
+#ifdef GEOMETRY_SSE
+    __m128 c0 = _mm_loadu_ps(m.a);
+    __m128 c1 = _mm_loadu_ps(m.a + 4);
+    __m128 c2 = _mm_loadu_ps(m.a + 8);
+    __m128 c3 = _mm_loadu_ps(m.a + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(m_a, c0);
+    _mm_storeu_ps(m_a + 4, c1);
+    _mm_storeu_ps(m_a + 8, c2);
+#else
+    for (int r = 0; r < 3; r++) {
+      m_a[r * 4]     = m.a[r];
+      m_a[r * 4 + 1] = m.a[4 + r];
+      m_a[r * 4 + 2] = m.a[8 + r];
+      m_a[r * 4 + 3] = m.a[12 + r];
+    }
+#endif
+  }
+
+  /**
+   * Converts to a 4x4 matrix with bottom row (0, 0, 0, 1).
+   * @return  Returns the 4x4 matrix.
+   */
+  Matrix4x4 ToMatrix4x4() const {
+    Matrix4x4 m(Matrix4x4::kNoInit);
+#ifdef GEOMETRY_SSE
+    __m128 r0 = _mm_loadu_ps(m_a);
+    __m128 r1 = _mm_loadu_ps(m_a + 4);
+    __m128 r2 = _mm_loadu_ps(m_a + 8);
+    __m128 r3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(m.a, r0);
+    _mm_storeu_ps(m.a + 4, r1);
+    _mm_storeu_ps(m.a + 8, r2);
+    _mm_storeu_ps(m.a + 12, r3);
+#else
+    for (int r = 0; r < 3; r++) {
+      m.a[r]      = m_a[r * 4];
+      m.a[4 + r]  = m_a[r * 4 + 1];
+      m.a[8 + r]  = m_a[r * 4 + 2];
+      m.a[12 + r] = m_a[r * 4 + 3];
+    }
+    m.a[3] = 0.0f; m.a[7] = 0.0f; m.a[11] = 0.0f; m.a[15] = 1.0f;
+#endif
+    return m;
+  }
+
+  /**
+   * Sets the matrix to the identity matrix.
+   */
+  void SetIdentity() {
+    *this = Affine3x4();
+  }
+
+  /**
+   * Equality operator
+   * @param   n  Matrix to test for equality with this matrix.
+   * @return  Returns true if the matrices are equal.
+   */
+  bool operator == (const Affine3x4& n) const {
+    for (int i = 0; i < 12; i++) {
+      if (m_a[i] != n.m_a[i])
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * Gets the elements (can be copied to a GPU buffer as 3 vec4 rows).
+   * @return  Returns the 12 elements in row order.
+   */
+  constexpr const float* Get() const {
+    return m_a;
+  }
+
+  /**
+   * Gets a matrix element given by row, column.
+   * @param  row  Matrix row (0-2)
+   * @param  col  Matrix column (0-3)
+   * @return  Returns the element.
+   */
+  constexpr float m(const uint32_t row, const uint32_t col) const {
+    return m_a[row * 4 + col];
+  }
+  float& m(const uint32_t row, const uint32_t col) {
+    return m_a[row * 4 + col];
+  }
+
+  /**
+   * Matrix multiplication ( m' = m n ).
+   * @param  n  Matrix to multiply the current matrix by.
+   * @return  Returns the product.
+   */
+  Affine3x4 operator * (const Affine3x4& n) const {
+    Affine3x4 t;
+    Multiply(m_a, n.m_a, t.m_a);
+    return t;
+  }
+
+  /**
+   * Matrix multiplication in place ( m = m n ).
+   * @param  n  Matrix to multiply the current matrix by.
+   * @return  Returns the address of the current matrix.
+   */
+  Affine3x4& operator *= (const Affine3x4& n) {
+    Multiply(m_a, n.m_a, m_a);
+    return *this;
+  }
+
+  /**
+   * Transforms a point by the matrix.
+   * @param  p  Point to transform.
+   * @return  Returns the transformed point.
+   */
+  constexpr Point3 operator * (const Point3& p) const {
+    return Point3(m_a[0] * p.x + m_a[1] * p.y + m_a[2]  * p.z + m_a[3],
+                  m_a[4] * p.x + m_a[5] * p.y + m_a[6]  * p.z + m_a[7],
+                  m_a[8] * p.x + m_a[9] * p.y + m_a[10] * p.z + m_a[11]);
+  }
+
+  /**
+   * Transforms a vector (direction) by the matrix. No translation occurs.
+   * @param  v  Vector to transform.
+   * @return  Returns the transformed vector.
+   */
+  constexpr Vector3 operator * (const Vector3& v) const {
+    return Vector3(m_a[0] * v.x + m_a[1] * v.y + m_a[2]  * v.z,
+                   m_a[4] * v.x + m_a[5] * v.y + m_a[6]  * v.z,
+                   m_a[8] * v.x + m_a[9] * v.y + m_a[10] * v.z);
+  }
+
+  /**
+   * Calculates the inverse: the inverse of [A t] is [inv(A)  -inv(A) t].
+   * If A is singular the identity matrix is returned (as with
+   * Matrix4x4::GetInverse).
+   * @return  Returns the inverse of the current matrix.
+   */
+  Affine3x4 GetInverse() const {
+    const float* a = m_a;
+    Affine3x4 t;
+    float c00 = a[5] * a[10] - a[6] * a[9];
+    float c01 = a[6] * a[8]  - a[4] * a[10];
+    float c02 = a[4] * a[9]  - a[5] * a[8];
+    float det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+    if (det == 0.0f) {
+      return t;
+    }
+    float inv = 1.0f / det;
+    t.m_a[0]  = c00 * inv;
+    t.m_a[4]  = c01 * inv;
+    t.m_a[8]  = c02 * inv;
+    t.m_a[1]  = (a[2] * a[9]  - a[1] * a[10]) * inv;
+    t.m_a[5]  = (a[0] * a[10] - a[2] * a[8])  * inv;
+    t.m_a[9]  = (a[1] * a[8]  - a[0] * a[9])  * inv;
+    t.m_a[2]  = (a[1] * a[6]  - a[2] * a[5])  * inv;
+    t.m_a[6]  = (a[2] * a[4]  - a[0] * a[6])  * inv;
+    t.m_a[10] = (a[0] * a[5]  - a[1] * a[4])  * inv;
+    InvertTranslation(t);
+    return t;
+  }
+
+  /**
+   * Calculates the matrix used to transform normals: the transpose of the
+   * inverse of the 3x3 part, with no translation (as
+   * Matrix4x4::GetNormalMatrix). For a rigid matrix this is simply the
+   * rotation part.
+   * @param  kind  Kind of transformation the matrix holds
+   * @return  Returns the normal transformation matrix.
+   */
+  Affine3x4 GetNormalMatrix(const MatrixKind kind = MATRIX_AFFINE) const {
+    Affine3x4 t;
+    const float* a = m_a;
+    if (kind == MATRIX_IDENTITY || kind == MATRIX_RIGID) {
+      for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++) {
+          t.m_a[r * 4 + c] = a[r * 4 + c];
+        }
+      }
+      return t;
+    }
+
+    // Cofactor matrix over the determinant
+    float c00 = a[5] * a[10] - a[6] * a[9];
+    float c01 = a[6] * a[8]  - a[4] * a[10];
+    float c02 = a[4] * a[9]  - a[5] * a[8];
+    float det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+    if (det == 0.0f) {
+      return t;
+    }
+    float inv = 1.0f / det;
+    t.m_a[0]  = c00 * inv;
+    t.m_a[1]  = c01 * inv;
+    t.m_a[2]  = c02 * inv;
+    t.m_a[4]  = (a[2] * a[9]  - a[1] * a[10]) * inv;
+    t.m_a[5]  = (a[0] * a[10] - a[2] * a[8])  * inv;
+    t.m_a[6]  = (a[1] * a[8]  - a[0] * a[9])  * inv;
+    t.m_a[8]  = (a[1] * a[6]  - a[2] * a[5])  * inv;
+    t.m_a[9]  = (a[2] * a[4]  - a[0] * a[6])  * inv;
+    t.m_a[10] = (a[0] * a[5]  - a[1] * a[4])  * inv;
+    return t;
+  }
+
+  /**
+   * Calculates the inverse of a rigid matrix (rotation and translation
+   * only): the 3x3 part is transposed. Cheaper than GetInverse but wrong
+   * if the matrix includes scaling or shear.
+   * @return  Returns the inverse of the current matrix.
+   */
+  Affine3x4 GetRigidInverse() const {
+    Affine3x4 t;
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        t.m_a[r * 4 + c] = m_a[c * 4 + r];
+      }
+    }
+    InvertTranslation(t);
+    return t;
+  }
+
+  /**
+   * Logs a message followed by the matrix.
+   * @param  str  String to print to log file
+   */
+  void Log(const char* str) const {
+    extern void logmsg(const char *message, ...);
+    logmsg("  %s", str);
+    for (int r = 0; r < 3; r++) {
+      logmsg("%.3f %.3f %.3f %.3f", m_a[r * 4], m_a[r * 4 + 1], m_a[r * 4 + 2], m_a[r * 4 + 3]);
+    }
+  }
+
+  /**
+   * Multiplies 2 row order 3x4 matrices (with implied bottom rows
+   * 0, 0, 0, 1): out = a b. 36 multiplies compared to 64 for Matrix4x4.
+   * The output may be the same array as either input.
+   * @param  a    Left hand matrix (12 floats, row order)
+   * @param  b    Right hand matrix (12 floats, row order)
+   * @param  out  (OUT) Product matrix (12 floats, row order)
+   */
+  static void Multiply(const float* a, const float* b, float* out) {
+#ifdef GEOMETRY_SSE
+    // Row i of the product is a linear combination of the rows of b (and
+    // the implied row 0, 0, 0, 1) weighted by the elements of row i of a.
+    // All rows of b are held in registers and row i of a is read before
+    // row i of out is written, so in-place multiplication is safe.
+    __m128 b0 = _mm_loadu_ps(b);
+    __m128 b1 = _mm_loadu_ps(b + 4);
+    __m128 b2 = _mm_loadu_ps(b + 8);
+    __m128 w = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    for (int i = 0; i < 12; i += 4) {
+      __m128 ai = _mm_loadu_ps(a + i);
+      __m128 r = _mm_mul_ps(b0, _mm_shuffle_ps(ai, ai, 0x00));
+      r = _mm_add_ps(r, _mm_mul_ps(b1, _mm_shuffle_ps(ai, ai, 0x55)));
+      r = _mm_add_ps(r, _mm_mul_ps(b2, _mm_shuffle_ps(ai, ai, 0xAA)));
+      r = _mm_add_ps(r, _mm_mul_ps(w, _mm_shuffle_ps(ai, ai, 0xFF)));
+      _mm_storeu_ps(out + i, r);
+    }
+#else
+    // Copy b first in case out aliases it (m *= m). Row i of the product
+    // only depends on row i of a, so out may alias a.
+    float bc[12];
+    for (int i = 0; i < 12; i++) {
+      bc[i] = b[i];
+    }
+    for (int i = 0; i < 12; i += 4) {
+      float a0 = a[i];
+      float a1 = a[i + 1];
+      float a2 = a[i + 2];
+      float a3 = a[i + 3];
+      out[i]     = a0 * bc[0] + a1 * bc[4] + a2 * bc[8];
+      out[i + 1] = a0 * bc[1] + a1 * bc[5] + a2 * bc[9];
+      out[i + 2] = a0 * bc[2] + a1 * bc[6] + a2 * bc[10];
+      out[i + 3] = a0 * bc[3] + a1 * bc[7] + a2 * bc[11] + a3;
+    }
+#endif
+  }
+
+private:
+  // Sets the translation of t (whose 3x3 part is inv(A)) to -inv(A) t
+  void InvertTranslation(Affine3x4& t) const {
+    for (int r = 0; r < 3; r++) {
+      t.m_a[r * 4 + 3] = -(t.m_a[r * 4] * m_a[3] + t.m_a[r * 4 + 1] * m_a[7] +
+                           t.m_a[r * 4 + 2] * m_a[11]);
+    }
+  }
+};
+
+static_assert(sizeof(Affine3x4) == 12 * sizeof(float),
+              "Affine3x4 must be tightly packed for GPU buffers");
+
+#endif
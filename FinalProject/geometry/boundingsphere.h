@@ -16,6 +16,10 @@
 
 #include <vector>
 
+// Forward references
+struct Matrix4x4;
+struct Affine3x4;
+
 /**
  * Sphere: center and radius.
  */
@@ -40,6 +44,17 @@ struct BoundingSphere {
       m_radius(s.m_radius) {
   }
 
+  /**
+   * Assignment operator
+   * @param   s   Sphere to assign to this sphere.
+   * @return   Returns the address of this sphere.
+   */
+  BoundingSphere& operator = (const BoundingSphere& s) {
+    m_center = s.m_center;
+    m_radius = s.m_radius;
+    return *this;
+  }
+
   /**
    * Constructor given a center point and radius.
    * @param  c  Center point.
@@ -55,18 +70,136 @@ struct BoundingSphere {
    * @param  vertexList  Vertex list to surround with the sphere.
    */
   BoundingSphere(std::vector<Point3>& vertexList) {
-    // Complete in 605.767
+    Create(vertexList.empty() ? nullptr : &vertexList[0].x, sizeof(Point3),
+           vertexList.size());
+  }
+
+  /**
+   * Creates a sphere around a strided array of positions (for example the
+   * vertex member of a VertexAndNormal list). Method by Ritter: start
+   * with the sphere through the pair of extreme points (along x, y or z)
+   * that are farthest apart, then grow it to include any point outside.
+   * The result is within about 5 to 20% of the minimal sphere.
+   * @param  xyz     Pointer to the x coordinate of the first position.
+   * @param  stride  Distance in bytes between positions.
+   * @param  count   Number of positions.
+   */
+  void Create(const float* xyz, const size_t stride, const size_t count) {
+    m_center.Set(0.0f, 0.0f, 0.0f);
+    m_radius = 0.0f;
+    if (count == 0) {
+      return;
+    }
+    const char* base = reinterpret_cast<const char*>(xyz);
+    auto point = [base, stride](const size_t i) {
+      const float* v = reinterpret_cast<const float*>(base + i * stride);
+      return Point3(v[0], v[1], v[2]);
+    };
+
+    // Points with min and max x, y, z
+    size_t lo[3] = { 0, 0, 0 };
+    size_t hi[3] = { 0, 0, 0 };
+    for (size_t i = 1; i < count; i++) {
+      Point3 p = point(i);
+      if (p.x < point(lo[0]).x) lo[0] = i;
+      if (p.x > point(hi[0]).x) hi[0] = i;
+      if (p.y < point(lo[1]).y) lo[1] = i;
+      if (p.y > point(hi[1]).y) hi[1] = i;
+      if (p.z < point(lo[2]).z) lo[2] = i;
+      if (p.z > point(hi[2]).z) hi[2] = i;
+    }
+
+    // Initial sphere through the most distant pair
+    int axis = 0;
+    float d2 = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      float dk = (point(hi[k]) - point(lo[k])).NormSquared();
+      if (dk > d2) {
+        d2 = dk;
+        axis = k;
+      }
+    }
+    m_center = point(lo[axis]).MidPoint(point(hi[axis]));
+    m_radius = 0.5f * sqrtf(d2);
+
+    // Grow the sphere to include each point outside it. The new sphere
+    // touches the far side of the old sphere and the point.
+    float r2 = m_radius * m_radius;
+    for (size_t i = 0; i < count; i++) {
+      Vector3 v = point(i) - m_center;
+      float dist2 = v.NormSquared();
+      if (dist2 > r2) {
+        float dist = sqrtf(dist2);
+        float new_radius = 0.5f * (m_radius + dist);
+        m_center = m_center + v * ((new_radius - m_radius) / dist);
+        m_radius = new_radius;
+        r2 = m_radius * m_radius;
+      }
+    }
   }
 
   /**
    * Merge this bounding sphere with another to create the smallest sphere
    * containing the 2.
    * @param  s2  Sphere to merge with this sphere.
+   * @return  Returns the merged sphere.
+   */
+  BoundingSphere Merge(const BoundingSphere& s2) const {
+    Vector3 v = s2.m_center - m_center;
+    float dist = v.Norm();
+
+    // One sphere contains the other
+    if (dist + s2.m_radius <= m_radius) {
+      return *this;
+    }
+    if (dist + m_radius <= s2.m_radius) {
+      return s2;
+    }
+
+    // The merged sphere spans from the far side of this sphere to the far
+    // side of s2 along the line through the centers
+    float r = 0.5f * (dist + m_radius + s2.m_radius);
+    return BoundingSphere(m_center + v * ((r - m_radius) / dist), r);
+  }
+
+  /**
+   * Forms a sphere containing this sphere after an affine transformation.
+   * The radius is scaled by the largest scaling of the 3 axes. Defined
+   * after Matrix4x4 (geometry.h).
+   * @param  m  Affine transformation
+   * @return  Returns the transformed sphere.
    */
-  BoundingSphere Merge(BoundingSphere& s2) {
-    // Complete in 605.767
-    return BoundingSphere();
+  BoundingSphere Transform(const Matrix4x4& m) const;
+  BoundingSphere Transform(const Affine3x4& m) const;
+};
+
+/**
+ * Packet of kWidth spheres (structure of arrays) for testing several
+ * spheres at once (see Frustum::Intersects).
+ */
+template <typename F>
+struct BoundingSpherexN {
+  Vector3xN<F> m_center;
+  F            m_radius;
+
+  /**
+   * Loads kWidth consecutive spheres.
+   * @param  spheres  Pointer to the first sphere.
+   * @return Returns the packet.
+   */
+  static BoundingSpherexN Load(const BoundingSphere* spheres) {
+    BoundingSpherexN p;
+    p.m_center = Vector3xN<F>::LoadStrided(&spheres->m_center.x, sizeof(BoundingSphere));
+    float r[F::kWidth];
+    for (int i = 0; i < F::kWidth; i++) {
+      r[i] = spheres[i].m_radius;
+    }
+    p.m_radius = F::Load(r);
+    return p;
   }
 };
 
+typedef BoundingSpherexN<Float4> BoundingSpherex4;
+typedef BoundingSpherexN<Float8> BoundingSpherex8;
+
 #endif
@@ -0,0 +1,193 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    fastmath.h
+//	Purpose: Fast approximations of 1/sqrt, sin and cos, one value at a
+//          time, 4 at a time (SSE) and over arrays. Use these where many
+//          values are needed and a few ulps of error are acceptable
+//          (mesh generation, normalizing many vectors).
+//          Student should include "geometry.h" to get all class definitions
+//          included in proper order.
+//
+//============================================================================
+
+#ifndef __FASTMATH_H__
+#define __FASTMATH_H__
+
+// Cody-Waite split of pi/2: the first 2 parts have few enough bits that
+// j * part is exact for |j| < 2^13, so reduction stays accurate to
+// |x| of about 8192 * pi/2
+constexpr float kTwoOverPi    = 0.636619772f;
+constexpr float kPiOver2Part1 = 1.5703125f;
+constexpr float kPiOver2Part2 = 4.837512969970703125e-4f;
+constexpr float kPiOver2Part3 = 7.54978995489188216e-8f;
+
+// Minimax polynomials for sin and cos on [-pi/4, pi/4] (Cephes sinf/cosf)
+constexpr float kSinC1 = -1.6666654611e-1f;
+constexpr float kSinC2 = 8.3321608736e-3f;
+constexpr float kSinC3 = -1.9515295891e-4f;
+constexpr float kCosC1 = 4.166664568298827e-2f;
+constexpr float kCosC2 = -1.388731625493765e-3f;
+constexpr float kCosC3 = 2.443315711809948e-5f;
+
+#ifdef GEOMETRY_SSE
+/**
+ * Approximate 1/sqrt of 4 values: the hardware estimate (12 bits) refined
+ * by one Newton-Raphson step. Relative error is below 5e-7 (about 4
+ * ulps). Values must be positive and finite.
+ * @param  x  Values
+ * @return Returns 1/sqrt(x) of each lane.
+ */
+inline __m128 FastRsqrt(const __m128 x) {
+  __m128 y = _mm_rsqrt_ps(x);
+  __m128 xyy = _mm_mul_ps(_mm_mul_ps(x, y), y);
+  return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), y),
+                    _mm_sub_ps(_mm_set1_ps(3.0f), xyy));
+}
+#endif
+
+/**
+ * Approximate 1/sqrt(x). Replaces the Quake III bit trick (which reads a
+ * float through an int pointer and is undefined behavior) with the
+ * hardware estimate plus a Newton step. Relative error below 5e-7 (exact
+ * 1/sqrtf without SSE). x must be positive and finite.
+ * @param  x  Value to find inverse sqrt for
+ * @return Returns 1/sqrtf(x)
+ */
+inline float FastRsqrt(const float x) {
+#ifdef GEOMETRY_SSE
+  return _mm_cvtss_f32(FastRsqrt(_mm_set_ss(x)));
+#else
+  return 1.0f / sqrtf(x);
+#endif
+}
+
+/**
+ * Sine and cosine of the same angle. Reduces the angle to [-pi/4, pi/4]
+ * and evaluates 2 short polynomials. Absolute error is below 3e-7 for
+ * |x| <= 8192 (the result is meaningless for much larger angles).
+ * @param  x  Angle in radians
+ * @param  s  (OUT) sin(x)
+ * @param  c  (OUT) cos(x)
+ */
+inline void FastSinCos(const float x, float* s, float* c) {
+  // Quadrant j and the reduced angle r = x - j pi/2
+  float q = x * kTwoOverPi;
+  int j = static_cast<int>(q + ((q < 0.0f) ? -0.5f : 0.5f));
+  float jf = static_cast<float>(j);
+  float r = ((x - jf * kPiOver2Part1) - jf * kPiOver2Part2) - jf * kPiOver2Part3;
+  float r2 = r * r;
+  float ps = r + r * r2 * (kSinC1 + r2 * (kSinC2 + r2 * kSinC3));
+  float pc = 1.0f - 0.5f * r2 + r2 * r2 * (kCosC1 + r2 * (kCosC2 + r2 * kCosC3));
+
+  // Odd quadrants swap sin and cos; quadrants 2, 3 negate sin and
+  // quadrants 1, 2 negate cos
+  float sn = (j & 1) ? pc : ps;
+  float cs = (j & 1) ? ps : pc;
+  *s = (j & 2) ? -sn : sn;
+  *c = ((j + 1) & 2) ? -cs : cs;
+}
+
+/**
+ * Fast sine. See FastSinCos for the error bound.
+ * @param  x  Angle in radians
+ * @return Returns sin(x).
+ */
+inline float FastSin(const float x) {
+  float s, c;
+  FastSinCos(x, &s, &c);
+  return s;
+}
+
+/**
+ * Fast cosine. See FastSinCos for the error bound.
+ * @param  x  Angle in radians
+ * @return Returns cos(x).
+ */
+inline float FastCos(const float x) {
+  float s, c;
+  FastSinCos(x, &s, &c);
+  return c;
+}
+
+#ifdef GEOMETRY_SSE2
+/**
+ * Sine and cosine of 4 angles (same method and error as FastSinCos).
+ * @param  x  Angles in radians
+ * @param  s  (OUT) sin of each lane
+ * @param  c  (OUT) cos of each lane
+ */
+inline void FastSinCos(const __m128 x, __m128* s, __m128* c) {
+  // Round to nearest quadrant (default rounding mode)
+  __m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(kTwoOverPi)));
+  __m128 jf = _mm_cvtepi32_ps(j);
+  __m128 r = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(kPiOver2Part1)));
+  r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(kPiOver2Part2)));
+  r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(kPiOver2Part3)));
+  __m128 r2 = _mm_mul_ps(r, r);
+
+  __m128 ps = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(kSinC3)), _mm_set1_ps(kSinC2));
+  ps = _mm_add_ps(_mm_mul_ps(r2, ps), _mm_set1_ps(kSinC1));
+  ps = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), ps));
+  __m128 pc = _mm_add_ps(_mm_mul_ps(r2, _mm_set1_ps(kCosC3)), _mm_set1_ps(kCosC2));
+  pc = _mm_add_ps(_mm_mul_ps(r2, pc), _mm_set1_ps(kCosC1));
+  pc = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+                  _mm_mul_ps(_mm_mul_ps(r2, r2), pc));
+
+  // Swap in odd quadrants, then flip the sign bits
+  __m128i one = _mm_set1_epi32(1);
+  __m128i two = _mm_set1_epi32(2);
+  __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, one), one));
+  __m128 sn = _mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps));
+  __m128 cs = _mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc));
+  __m128 sign_s = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, two), 30));
+  __m128 sign_c = _mm_castsi128_ps(_mm_slli_epi32(
+                      _mm_and_si128(_mm_add_epi32(j, one), two), 30));
+  *s = _mm_xor_ps(sn, sign_s);
+  *c = _mm_xor_ps(cs, sign_c);
+}
+#endif
+
+/**
+ * Sine and cosine of an array of angles, 4 at a time where SSE2 is
+ * available.
+ * @param  x      Angles in radians
+ * @param  s      (OUT) sin of each angle
+ * @param  c      (OUT) cos of each angle
+ * @param  count  Number of angles
+ */
+inline void FastSinCos(const float* x, float* s, float* c, const size_t count) {
+  size_t i = 0;
+#ifdef GEOMETRY_SSE2
+  for (; i + 4 <= count; i += 4) {
+    __m128 vs, vc;
+    FastSinCos(_mm_loadu_ps(x + i), &vs, &vc);
+    _mm_storeu_ps(s + i, vs);
+    _mm_storeu_ps(c + i, vc);
+  }
+#endif
+  for (; i < count; i++)
+    FastSinCos(x[i], s + i, c + i);
+}
+
+/**
+ * Approximate 1/sqrt of an array of values, 4 at a time where SSE is
+ * available.
+ * @param  x      Values (positive)
+ * @param  out    (OUT) 1/sqrt of each value. May be the same as x.
+ * @param  count  Number of values
+ */
+inline void FastRsqrt(const float* x, float* out, const size_t count) {
+  size_t i = 0;
+#ifdef GEOMETRY_SSE
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(out + i, FastRsqrt(_mm_loadu_ps(x + i)));
+#endif
+  for (; i < count; i++)
+    out[i] = FastRsqrt(x[i]);
+}
+
+#endif
@@ -0,0 +1,212 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    frustum.h
+//	Purpose: View frustum (6 planes) and visibility tests of points,
+//          spheres and boxes against it, one at a time or in packets.
+//          Student should include "geometry.h" to get all class definitions
+//          included in proper order.
+//
+//============================================================================
+
+#ifndef __FRUSTUM_H__
+#define __FRUSTUM_H__
+
+// Frustum plane indexes
+enum FrustumPlane {
+  FRUSTUM_LEFT,
+  FRUSTUM_RIGHT,
+  FRUSTUM_BOTTOM,
+  FRUSTUM_TOP,
+  FRUSTUM_NEAR,
+  FRUSTUM_FAR,
+  FRUSTUM_PLANE_COUNT
+};
+
+/**
+ * View frustum: 6 planes with unit normals pointing into the frustum, so
+ * Plane::Solve is the signed distance to each plane and is positive
+ * inside. The tests are conservative: an object that straddles 2 planes
+ * outside a corner of the frustum may be reported as visible, but a
+ * visible object is never rejected.
+ */
+struct Frustum {
+  Plane m_planes[FRUSTUM_PLANE_COUNT];
+
+  /**
+   * Default constructor. The frustum is the canonical view volume
+   * (-1 to 1 along each axis).
+   */
+  Frustum() {
+    Set(Matrix4x4());
+  }
+
+  /**
+   * Constructor given a composite projection and view matrix.
+   * @param  pv  Projection * view matrix
+   */
+  explicit Frustum(const Matrix4x4& pv) {
+    Set(pv);
+  }
+
+  /**
+   * Extracts the planes from a composite projection and view matrix
+   * (method by Gribb and Hartmann). A point p is inside the clip volume
+   * when -w <= x, y, z <= w for the clip coordinates (x, y, z, w) = pv p,
+   * so each plane is the 4th row of pv plus or minus one of the others.
+   * With a projection matrix alone the planes are in view coordinates;
+   * with projection * view they are in world coordinates.
+   * @param  pv  Projection * view matrix
+   */
+  void Set(const Matrix4x4& pv) {
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+      int row = i / 2;
+      float sign = (i & 1) ? -1.0f : 1.0f;
+      Plane& p = m_planes[i];
+      p.a = pv.m(3, 0) + sign * pv.m(row, 0);
+      p.b = pv.m(3, 1) + sign * pv.m(row, 1);
+      p.c = pv.m(3, 2) + sign * pv.m(row, 2);
+      p.d = -(pv.m(3, 3) + sign * pv.m(row, 3));
+      p.Normalize();
+    }
+  }
+
+  /**
+   * Tests if a point is inside the frustum.
+   * @param  p  Point
+   * @return  Returns true if the point is inside or on the frustum.
+   */
+  bool Contains(const Point3& p) const {
+    for (const auto& plane : m_planes) {
+      if (plane.Solve(p) < 0.0f) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Tests if a sphere is at least partly inside the frustum.
+   * @param  s  Sphere
+   * @return  Returns true unless the sphere is fully outside a plane.
+   */
+  bool Intersects(const BoundingSphere& s) const {
+    for (const auto& plane : m_planes) {
+      if (plane.Solve(s.m_center) < -s.m_radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Tests if a box is at least partly inside the frustum. For each plane
+   * the box corner farthest along the plane normal is tested: the center
+   * distance plus the half diagonal projected onto |normal|.
+   * @param  box  Box
+   * @return  Returns true unless the box is fully outside a plane.
+   */
+  bool Intersects(const AABB& box) const {
+    Point3 c = box.GetCenter();
+    Vector3 e = box.GetHalfDiagonal();
+    for (const auto& plane : m_planes) {
+      float r = fabsf(plane.a) * e.x + fabsf(plane.b) * e.y + fabsf(plane.c) * e.z;
+      if (plane.Solve(c) < -r) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Tests kWidth spheres at once.
+   * @param  s  Spheres
+   * @return  Returns a mask with all bits set in the lanes of spheres that
+   *          are at least partly inside (see Float4::Mask).
+   */
+  template <typename F>
+  F Intersects(const BoundingSpherexN<F>& s) const {
+    F neg_r = F(0.0f) - s.m_radius;
+    F inside = Distance(FRUSTUM_LEFT, s.m_center) >= neg_r;
+    for (int i = 1; i < FRUSTUM_PLANE_COUNT; i++) {
+      inside = inside & (Distance(i, s.m_center) >= neg_r);
+    }
+    return inside;
+  }
+
+  /**
+   * Tests kWidth boxes at once (same test as Intersects(const AABB&)).
+   * @param  boxes  Boxes
+   * @return  Returns a mask with all bits set in the lanes of boxes that
+   *          are at least partly inside.
+   */
+  template <typename F>
+  F Intersects(const AABBxN<F>& boxes) const {
+    F half(0.5f);
+    Vector3xN<F> c = (boxes.m_min + boxes.m_max) * half;
+    Vector3xN<F> e = (boxes.m_max - boxes.m_min) * half;
+    F inside;
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+      const Plane& p = m_planes[i];
+      F r = e.x * F(fabsf(p.a)) + e.y * F(fabsf(p.b)) + e.z * F(fabsf(p.c));
+      F in = Distance(i, c) >= (F(0.0f) - r);
+      inside = (i == 0) ? in : (inside & in);
+    }
+    return inside;
+  }
+
+  /**
+   * Tests an array of spheres, 8 at a time.
+   * @param  spheres  Spheres
+   * @param  count    Number of spheres
+   * @param  visible  (OUT) 1 for each sphere at least partly inside, else 0
+   * @return  Returns the number of visible spheres.
+   */
+  size_t Cull(const BoundingSphere* spheres, const size_t count, uint8_t* visible) const {
+    return Cull<BoundingSphere, BoundingSpherex8>(spheres, count, visible);
+  }
+
+  /**
+   * Tests an array of boxes, 8 at a time.
+   * @param  boxes    Boxes
+   * @param  count    Number of boxes
+   * @param  visible  (OUT) 1 for each box at least partly inside, else 0
+   * @return  Returns the number of visible boxes.
+   */
+  size_t Cull(const AABB* boxes, const size_t count, uint8_t* visible) const {
+    return Cull<AABB, AABBx8>(boxes, count, visible);
+  }
+
+private:
+  // Signed distances of kWidth points to plane i
+  template <typename F>
+  F Distance(const int i, const Vector3xN<F>& p) const {
+    const Plane& plane = m_planes[i];
+    return p.x * F(plane.a) + p.y * F(plane.b) + p.z * F(plane.c) - F(plane.d);
+  }
+
+  // Tests full packets of volumes then the remainder one at a time
+  template <typename Volume, typename Packet>
+  size_t Cull(const Volume* volumes, const size_t count, uint8_t* visible) const {
+    const size_t kWidth = Float8::kWidth;
+    const size_t packets = count / kWidth * kWidth;   // Volumes in full packets
+    size_t n = 0;
+    for (size_t i = 0; i < packets; i += kWidth) {
+      int mask = Intersects(Packet::Load(volumes + i)).Mask();
+      for (size_t k = 0; k < kWidth; k++) {
+        visible[i + k] = (mask >> k) & 1;
+        n += visible[i + k];
+      }
+    }
+    for (size_t i = packets; i < count; i++) {
+      visible[i] = Intersects(volumes[i]) ? 1 : 0;
+      n += visible[i];
+    }
+    return n;
+  }
+};
+
+#endif
@@ -18,17 +18,28 @@
 #include <stdint.h>
 #include <vector>
 
-// TODO - Visual Studio 2013 does not support constexpr
-#ifdef _WIN32
-const float kPi = 3.14159265f;
-const float kEpsilon   = 0.000001f;
-const float kDegPerRad = (180.0f / kPi);  // Radians to degrees conversion
-const float kRadPerDeg = (kPi / 180.0f);  // Degrees to radians conversion
-#else
 constexpr float kPi        = 3.14159265f;
 constexpr float kEpsilon   = 0.000001f;
 constexpr float kDegPerRad = (180.0f / kPi);  // Radians to degrees conversion
 constexpr float kRadPerDeg = (kPi / 180.0f);  // Degrees to radians conversion
+
+// SIMD support. SSE is part of every x86/x64 target we build for (MSVC
+// defaults to /arch:SSE2 on Win32); AVX is used only when the compiler is
+// told it may (/arch:AVX or -mavx). Define GEOMETRY_NO_SIMD to force the
+// scalar code paths (useful when comparing results or debugging).
+#if !defined(GEOMETRY_NO_SIMD)
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GEOMETRY_SSE 1
+#include <xmmintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GEOMETRY_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(GEOMETRY_SSE) && defined(__AVX__)
+#define GEOMETRY_AVX 1
+#include <immintrin.h>
+#endif
 #endif
 
 /**
@@ -36,7 +47,7 @@ constexpr float kRadPerDeg = (kPi / 180.0f);  // Degrees to radians conversion
  * @param   d   Angle in degrees.
  * @return  Returns the angle in radians.
  */
-inline float DegreesToRadians(const float d) {
+constexpr float DegreesToRadians(const float d) {
   return d * kRadPerDeg;
 }
 
@@ -45,7 +56,7 @@ inline float DegreesToRadians(const float d) {
  * @param   r   Angle in radians.
  * @return  Returns the angle in degrees.
  */
-inline float RadiansToDegrees(const float r) {
+constexpr float RadiansToDegrees(const float r) {
   return r * kDegPerRad;
 }
 
@@ -58,19 +69,8 @@ inline float rand01() {
   return (float)rand() / (float)RAND_MAX;
 }
 
-/** 
- * Fast inverse sqrt method. Originally used in Quake III 
- * @param  x  Value to find inverse sqrt for
- * @return  Returns 1/sqrtf(x)
- */
-inline float FastInvSqrt(float x) {
-   float xhalf = 0.5f * x;
-   int i = *(int*)&x;            // get bits for floating value
-   i = 0x5f3759df - (i>>1);      // give initial guess y0
-   x = *(float*)&i;              // convert bits back to float
-   return x*(1.5f - xhalf*x*x);  // newton step
-   // x *= 1.5f - xhalf*x*x;     // repeating step increases accuracy
-}
+#include "geometry/fastmath.h"
+#include "geometry/parallel.h"
 
 // Include individual geometry files
 #include "geometry/hpoint2.h"
@@ -79,6 +79,8 @@ inline float FastInvSqrt(float x) {
 #include "geometry/point3.h"
 #include "geometry/vector2.h"
 #include "geometry/vector3.h"
+#include "geometry/quaternion.h"
+#include "geometry/packet.h"
 #include "geometry/segment2.h"
 #include "geometry/segment3.h"
 #include "geometry/plane.h"
@@ -87,6 +89,8 @@ inline float FastInvSqrt(float x) {
 #include "geometry/ray3.h"
 #include "geometry/noise.h"
 #include "geometry/matrix.h"
+#include "geometry/affine.h"
+#include "geometry/frustum.h"
 
 /**
  * Structure to hold a vertex position and normal
@@ -156,30 +160,30 @@ inline Vector2 operator *(float s, const Vector2 &v) {
 // Define the operators in Point3 that allow a vector to be added
 // to and subtracted from a point. Descriptions are in the Point3
 // structure.
-inline Point3 Point3::operator + (const Vector3& w) const {
+constexpr Point3 Point3::operator + (const Vector3& w) const {
   return Point3(x + w.x, y + w.y, z + w.z);
 }
-inline Point3 Point3::operator - (const Vector3 &w) const {
+constexpr Point3 Point3::operator - (const Vector3 &w) const {
   return Point3(x - w.x, y - w.y, z - w.z);
 }
-inline Vector3 Point3::operator - (const Point3& p) const {
+constexpr Vector3 Point3::operator - (const Point3& p) const {
   return Vector3(x - p.x, y - p.y, z - p.z);
 }
 
 /**
  * Overloading: allows float * Vector3
  */
-inline Vector3 operator *(float s, const Vector3 &v) {
+constexpr Vector3 operator *(float s, const Vector3 &v) {
   return Vector3(v.x * s, v.y * s, v.z * s);
 }
 
 // Convert homogeneous point to a cartesian representation
-inline Point3 HPoint3::ToCartesian() const {
+constexpr Point3 HPoint3::ToCartesian() const {
   if (w == 1.0f) {
     return Point3(x, y, z);
   } else {
-    // Perform division through by w
-    float d = (fabs(w) > kEpsilon) ? (1.0f / w) : 1.0f;
+    // Perform division through by w (no fabs so this stays constexpr)
+    float d = (w > kEpsilon || w < -kEpsilon) ? (1.0f / w) : 1.0f;
     return Point3(x * d, y * d, z * d);
   }
 }
@@ -195,6 +199,121 @@ inline Point2 HPoint2::ToCartesian() const {
   }
 }
 
+// Batch transforms of interleaved vertex arrays. Descriptions are in the
+// Matrix4x4 class.
+inline void Matrix4x4::TransformVertices(const VertexAndNormal* in,
+          VertexAndNormal* out, const size_t count, const uint32_t thread_count) const {
+  TransformArray(a, IsAffine() ? kTransformPoint : kTransformProject,
+                 &in->vertex.x, sizeof(VertexAndNormal), &out->vertex.x,
+                 sizeof(VertexAndNormal), count, thread_count);
+  TransformArray(GetNormalMatrix().a, kTransformNormal, &in->normal.x,
+                 sizeof(VertexAndNormal), &out->normal.x, sizeof(VertexAndNormal),
+                 count, thread_count);
+}
+inline void Matrix4x4::TransformVertices(const PNTVertex* in, PNTVertex* out,
+          const size_t count, const uint32_t thread_count) const {
+  TransformArray(a, IsAffine() ? kTransformPoint : kTransformProject,
+                 &in->vertex.x, sizeof(PNTVertex), &out->vertex.x,
+                 sizeof(PNTVertex), count, thread_count);
+  TransformArray(GetNormalMatrix().a, kTransformNormal, &in->normal.x,
+                 sizeof(PNTVertex), &out->normal.x, sizeof(PNTVertex),
+                 count, thread_count);
+  if (out != in) {
+    for (size_t i = 0; i < count; i++) {
+      out[i].s = in[i].s;
+      out[i].t = in[i].t;
+    }
+  }
+}
+
+// Transforms of bounding volumes. Descriptions are in the AABB and
+// BoundingSphere structures.
+template <typename Matrix>
+inline AABB TransformBox(const AABB& box, const Matrix& m) {
+  if (box.IsEmpty()) {
+    return box;
+  }
+  Point3 c = m * box.GetCenter();
+  Vector3 h = box.GetHalfDiagonal();
+  Vector3 e(fabsf(m.m(0, 0)) * h.x + fabsf(m.m(0, 1)) * h.y + fabsf(m.m(0, 2)) * h.z,
+            fabsf(m.m(1, 0)) * h.x + fabsf(m.m(1, 1)) * h.y + fabsf(m.m(1, 2)) * h.z,
+            fabsf(m.m(2, 0)) * h.x + fabsf(m.m(2, 1)) * h.y + fabsf(m.m(2, 2)) * h.z);
+  return AABB(c - e, c + e);
+}
+template <typename Matrix>
+inline BoundingSphere TransformSphere(const BoundingSphere& s, const Matrix& m) {
+  float sx = Vector3(m.m(0, 0), m.m(1, 0), m.m(2, 0)).NormSquared();
+  float sy = Vector3(m.m(0, 1), m.m(1, 1), m.m(2, 1)).NormSquared();
+  float sz = Vector3(m.m(0, 2), m.m(1, 2), m.m(2, 2)).NormSquared();
+  return BoundingSphere(m * s.m_center, s.m_radius * sqrtf(std::max(sx, std::max(sy, sz))));
+}
+inline AABB AABB::Transform(const Matrix4x4& m) const {
+  return TransformBox(*this, m);
+}
+inline AABB AABB::Transform(const Affine3x4& m) const {
+  return TransformBox(*this, m);
+}
+inline BoundingSphere BoundingSphere::Transform(const Matrix4x4& m) const {
+  return TransformSphere(*this, m);
+}
+inline BoundingSphere BoundingSphere::Transform(const Affine3x4& m) const {
+  return TransformSphere(*this, m);
+}
+
+/**
+ * Computes per vertex normals of an indexed triangle mesh: the average of
+ * the unit normals of the faces sharing each vertex. Face normals are
+ * computed 4 faces at a time with Vector3x4 packets and the vertex
+ * normals are normalized 8 at a time with Vector3x8. Works with any
+ * vertex type that has Point3 vertex and Vector3 normal members
+ * (VertexAndNormal, PNTVertex). Assumes faces are in ccw order.
+ * @param  vertices  Vertex list. Normals are overwritten.
+ * @param  faces     Face list (3 indexes per triangle).
+ */
+template <typename VertexType>
+void ComputeVertexNormals(std::vector<VertexType>& vertices,
+                          const std::vector<uint16_t>& faces) {
+  for (auto& v : vertices)
+    v.normal.Set(0.0f, 0.0f, 0.0f);
+
+  // Gather the face corners into packets, form unit face normals, then
+  // add each face normal to the normals of its 3 vertices
+  const int kFaces = Vector3x4::kWidth;
+  size_t face_count = faces.size() / 3;
+  Point3 p0[kFaces], p1[kFaces], p2[kFaces];
+  Vector3 n[kFaces];
+  for (size_t f = 0; f < face_count; f += kFaces) {
+    int count = (face_count - f < kFaces) ? static_cast<int>(face_count - f) : kFaces;
+    const uint16_t* idx = &faces[f * 3];
+    for (int i = 0; i < kFaces; i++) {
+      int j = (i < count) ? i : 0;    // Repeat a face to fill the packet
+      p0[i] = vertices[idx[j * 3]].vertex;
+      p1[i] = vertices[idx[j * 3 + 1]].vertex;
+      p2[i] = vertices[idx[j * 3 + 2]].vertex;
+    }
+    Vector3x4 v0 = Vector3x4::Load(p0);
+    Vector3x4 e1 = Vector3x4::Load(p1) - v0;
+    Vector3x4 e2 = Vector3x4::Load(p2) - v0;
+    e1.Cross(e2).Normalize().Store(n);
+    for (int i = 0; i < count; i++) {
+      vertices[idx[i * 3]].normal     += n[i];
+      vertices[idx[i * 3 + 1]].normal += n[i];
+      vertices[idx[i * 3 + 2]].normal += n[i];
+    }
+  }
+
+  // Normalize the vertex normals - this essentially averages the
+  // adjoining face normals
+  const int kVertices = Vector3x8::kWidth;
+  size_t i = 0;
+  for (; i + kVertices <= vertices.size(); i += kVertices) {
+    Vector3x8 vn = Vector3x8::LoadStrided(&vertices[i].normal.x, sizeof(VertexType));
+    vn.Normalize().StoreStrided(&vertices[i].normal.x, sizeof(VertexType));
+  }
+  for (; i < vertices.size(); i++)
+    vertices[i].normal.Normalize();
+}
+
 /**
  * Test if a point is inside a 3D polygon. Uses the normal to the
  * polygon to project to one of the 2D axis planes and solves in that
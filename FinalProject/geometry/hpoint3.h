@@ -27,7 +27,7 @@ struct HPoint3 {
 	/**
    * Default constructor
    */
-	HPoint3() 
+	constexpr HPoint3() 
     : x(0.0f), 
       y(0.0f), 
       z(0.0f), 
@@ -41,7 +41,7 @@ struct HPoint3 {
    * @param   iz   z coordinate position.
    * @param   iw   Homogeneous factor
    */
-  HPoint3(const float ix, const float iy, const float iz, const float iw)
+  constexpr HPoint3(const float ix, const float iy, const float iz, const float iw)
     : x(ix),
       y(iy), 
       z(iz), 
@@ -52,7 +52,7 @@ struct HPoint3 {
    * Convert to a cartesian representation
    * @return  Returns the cartesian representation of this point.
    */
-  inline Point3 ToCartesian() const;
+  constexpr Point3 ToCartesian() const;
 };
 
 #endif
@@ -14,58 +14,66 @@
 #ifndef __MATRIX4x4_H__
 #define __MATRIX4x4_H__
 
+/**
+ * Kind of transformation a matrix represents. Ordered so that the kind of
+ * a product of 2 matrices is the larger of the 2 kinds.
+ *   MATRIX_IDENTITY   - identity matrix
+ *   MATRIX_RIGID      - rotations and translations only
+ *   MATRIX_AFFINE     - any upper 3x3, bottom row is (0, 0, 0, 1)
+ *   MATRIX_PROJECTIVE - general 4x4 matrix
+ */
+enum MatrixKind : uint8_t { MATRIX_IDENTITY, MATRIX_RIGID, MATRIX_AFFINE, MATRIX_PROJECTIVE };
+
+// Vertex types (defined in geometry.h) used by the batch transforms
+struct VertexAndNormal;
+struct PNTVertex;
+
+// Compact affine matrix (affine.h) converts directly to and from Matrix4x4
+struct Affine3x4;
+
 /**
  * 4x4 matrix. All matrix elements (row, col) are indexed base 0.
+ * The matrix holds only its 16 elements (64 bytes), so arrays of matrices
+ * and the nodes that hold them stay compact. Inverses and normal matrices
+ * use cheaper closed forms for identity and affine matrices, found from
+ * the elements (see GetKind). Code that knows a matrix is rigid (e.g. a
+ * node that built it from rotations and translations) keeps the kind
+ * itself and passes it to GetInverse and GetNormalMatrix.
  */
 class Matrix4x4 {
 public:
   /**
    * Constructor.  Sets the matrix to the identity matrix
    */
-  Matrix4x4() {
-    SetIdentity();
+  constexpr Matrix4x4()
+    : a{ 1.0f, 0.0f, 0.0f, 0.0f,
+         0.0f, 1.0f, 0.0f, 0.0f,
+         0.0f, 0.0f, 1.0f, 0.0f,
+         0.0f, 0.0f, 0.0f, 1.0f } {
   }
 
   /**
    * Sets the matrix to the identity matrix.
    */
-  void SetIdentity() {
+  constexpr void SetIdentity() {
     a[0] = 1.0f; a[4] = 0.0f; a[8] = 0.0f; a[12] = 0.0f;
     a[1] = 0.0f; a[5] = 1.0f; a[9] = 0.0f; a[13] = 0.0f;
     a[2] = 0.0f; a[6] = 0.0f; a[10] = 1.0f; a[14] = 0.0f;
     a[3] = 0.0f; a[7] = 0.0f; a[11] = 0.0f; a[15] = 1.0f;
   }
 
-  /**
-   * Copy constructor
-   * @param  n  Matrix to copy
-   */
-  Matrix4x4(const Matrix4x4& n) {
-    m00() = n.m00(); m01() = n.m01(); m02() = n.m02(); m03() = n.m03();
-    m10() = n.m10(); m11() = n.m11(); m12() = n.m12(); m13() = n.m13();
-    m20() = n.m20(); m21() = n.m21(); m22() = n.m22(); m23() = n.m23();
-    m30() = n.m30(); m31() = n.m31(); m32() = n.m32(); m33() = n.m33();
-  }
-
-  /**
-   * Assignment operator
-   * @param   n  Matrix to assign to this matrix
-   * @return  Returns the address of this matrix.
-   */
-  Matrix4x4& operator = (const Matrix4x4& n) {
-    m00() = n.m00(); m01() = n.m01(); m02() = n.m02(); m03() = n.m03();
-    m10() = n.m10(); m11() = n.m11(); m12() = n.m12(); m13() = n.m13();
-    m20() = n.m20(); m21() = n.m21(); m22() = n.m22(); m23() = n.m23();
-    m30() = n.m30(); m31() = n.m31(); m32() = n.m32(); m33() = n.m33();
-    return *this;
-  }
+  // Copy constructor and assignment. The defaults are trivial copies
+  // (the compiler emits a block move) and are usable in constant 
+  // expressions.
+  constexpr Matrix4x4(const Matrix4x4& n) = default;
+  Matrix4x4& operator = (const Matrix4x4& n) = default;
 
   /**
    * Equality operator
    * @param   n  Matrix to test for equality with this matrix.
    * @return  Returns true if hte matrices are equal, false otherwise..
    */
-  bool operator == (const Matrix4x4& n) const {
+  constexpr bool operator == (const Matrix4x4& n) const {
     return (m00() == n.m00() && m01() == n.m01() && m02() == n.m02() && m03() == n.m03() &&
             m10() == n.m10() && m11() == n.m11() && m12() == n.m12() && m13() == n.m13() &&
             m20() == n.m20() && m21() == n.m21() && m22() == n.m22() && m23() == n.m23() &&
@@ -82,49 +90,74 @@ public:
       a[i] = m[i];
   }
 
+  /**
+   * Gets the kind of transformation this matrix holds, found from the
+   * elements: identity, affine (bottom row 0, 0, 0, 1) or projective.
+   * A rigid matrix cannot be told from the elements cheaply, so it is
+   * reported as affine.
+   * @return  Returns the matrix kind.
+   */
+  constexpr MatrixKind GetKind() const {
+    if (!IsAffine())
+      return MATRIX_PROJECTIVE;
+    for (int i = 0; i < 15; i++) {
+      if (a[i] != ((i % 5 == 0) ? 1.0f : 0.0f))
+        return MATRIX_AFFINE;
+    }
+    return MATRIX_IDENTITY;
+  }
+
+  /**
+   * Checks if the bottom row is (0, 0, 0, 1).
+   * @return  Returns true if the matrix is affine.
+   */
+  constexpr bool IsAffine() const {
+    return a[3] == 0.0f && a[7] == 0.0f && a[11] == 0.0f && a[15] == 1.0f;
+  }
+
   /**
    * Gets the matrix (can be passed to OpenGL - GLSL mat4)
    * @return   Returns the elements of this matrix in column order.
    */
-  const float* Get() const {
+  constexpr const float* Get() const {
     return a;
   }
 
   // Read-only access functions
-  float m00() const { return a[0]; }
-  float m01() const { return a[4]; }
-  float m02() const { return a[8]; }
-  float m03() const { return a[12]; }
-  float m10() const { return a[1]; }
-  float m11() const { return a[5]; }
-  float m12() const { return a[9]; }
-  float m13() const { return a[13]; }
-  float m20() const { return a[2]; }
-  float m21() const { return a[6]; }
-  float m22() const { return a[10]; }
-  float m23() const { return a[14]; }
-  float m30() const { return a[3]; }
-  float m31() const { return a[7]; }
-  float m32() const { return a[11]; }
-  float m33() const { return a[15]; }
+  constexpr float m00() const { return a[0]; }
+  constexpr float m01() const { return a[4]; }
+  constexpr float m02() const { return a[8]; }
+  constexpr float m03() const { return a[12]; }
+  constexpr float m10() const { return a[1]; }
+  constexpr float m11() const { return a[5]; }
+  constexpr float m12() const { return a[9]; }
+  constexpr float m13() const { return a[13]; }
+  constexpr float m20() const { return a[2]; }
+  constexpr float m21() const { return a[6]; }
+  constexpr float m22() const { return a[10]; }
+  constexpr float m23() const { return a[14]; }
+  constexpr float m30() const { return a[3]; }
+  constexpr float m31() const { return a[7]; }
+  constexpr float m32() const { return a[11]; }
+  constexpr float m33() const { return a[15]; }
 
   // Read-write access functions
-  float& m00() { return a[0]; }
-  float& m01() { return a[4]; }
-  float& m02() { return a[8]; }
-  float& m03() { return a[12]; }
-  float& m10() { return a[1]; }
-  float& m11() { return a[5]; }
-  float& m12() { return a[9]; }
-  float& m13() { return a[13]; }
-  float& m20() { return a[2]; }
-  float& m21() { return a[6]; }
-  float& m22() { return a[10]; }
-  float& m23() { return a[14]; }
-  float& m30() { return a[3]; }
-  float& m31() { return a[7]; }
-  float& m32() { return a[11]; }
-  float& m33() { return a[15]; }
+  constexpr float& m00() { return a[0]; }
+  constexpr float& m01() { return a[4]; }
+  constexpr float& m02() { return a[8]; }
+  constexpr float& m03() { return a[12]; }
+  constexpr float& m10() { return a[1]; }
+  constexpr float& m11() { return a[5]; }
+  constexpr float& m12() { return a[9]; }
+  constexpr float& m13() { return a[13]; }
+  constexpr float& m20() { return a[2]; }
+  constexpr float& m21() { return a[6]; }
+  constexpr float& m22() { return a[10]; }
+  constexpr float& m23() { return a[14]; }
+  constexpr float& m30() { return a[3]; }
+  constexpr float& m31() { return a[7]; }
+  constexpr float& m32() { return a[11]; }
+  constexpr float& m33() { return a[15]; }
 
   /**
   * Gets a matrix element given by row,column.
@@ -132,7 +165,7 @@ public:
   * @param  col   Matrix column
   * @return Returns the element at the specified row,col.
   */
-  float m(const uint32_t row, const uint32_t col) const {
+  constexpr float m(const uint32_t row, const uint32_t col) const {
     return (row < 4 && col < 4) ? a[col * 4 + row] : 0.0f;
   }
 
@@ -142,7 +175,7 @@ public:
    * @param  col   Matrix col (0-based)
    * @return Returns the address of the element at the specified row,col.
    */
-  float& m(const uint32_t row, const uint32_t col) {
+  constexpr float& m(const uint32_t row, const uint32_t col) {
     return (row < 4 && col < 4) ? a[col * 4 + row] : a[0];
   }
 
@@ -153,51 +186,20 @@ public:
    * @return  Returns the product of the current matrix and the supplied matrix.
    */
   Matrix4x4 operator * (const Matrix4x4& n) const {
-    // Unroll the loop, do 1 row at a time.
-    Matrix4x4 t;
-    float a0 = m00();
-    float a1 = m01();
-    float a2 = m02();
-    float a3 = m03();
-    t.m00() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m01() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m02() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m03() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
-    a0 = m10();
-    a1 = m11();
-    a2 = m12();
-    a3 = m13();
-    t.m10() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m11() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m12() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m13() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
-    a0 = m20();
-    a1 = m21();
-    a2 = m22();
-    a3 = m23();
-    t.m20() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m21() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m22() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m23() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
-    a0 = m30();
-    a1 = m31();
-    a2 = m32();
-    a3 = m33();
-    t.m30() = a0 * n.m00() + a1 * n.m10() + a2 * n.m20() + a3 * n.m30();
-    t.m31() = a0 * n.m01() + a1 * n.m11() + a2 * n.m21() + a3 * n.m31();
-    t.m32() = a0 * n.m02() + a1 * n.m12() + a2 * n.m22() + a3 * n.m32();
-    t.m33() = a0 * n.m03() + a1 * n.m13() + a2 * n.m23() + a3 * n.m33();
+    Matrix4x4 t(kNoInit);
+    Multiply(a, n.a, t.a);
     return t;
   }
 
   /**
    * Matrix multiplication.  Multiplies the current matrix by the matrix n
-   * ( m = m n ) and stores the result in m.
+   * ( m = m n ) and stores the result in m. The product is written directly
+   * into this matrix - no temporary matrix is created.
    * @param   n  Matrix to multiply the current matrix by
    * @return  Returns the address of the current matrix.
    */
   Matrix4x4& operator *= (const Matrix4x4& n) {
-    *this = *this * n;
+    Multiply(a, n.a, a);
     return *this;
   }
 
@@ -219,7 +221,7 @@ public:
    * @param   v  Homogeneous point.
    * @return  Returns the transformed homogeneous coordinate position.
    */
-  HPoint3 operator *(const HPoint3& v) const {
+  constexpr HPoint3 operator *(const HPoint3& v) const {
     return HPoint3((a[0] * v.x + a[4] * v.y + a[8] * v.z + a[12] * v.w),
                    (a[1] * v.x + a[5] * v.y + a[9] * v.z + a[13] * v.w),
                    (a[2] * v.x + a[6] * v.y + a[10] * v.z + a[14] * v.w),
@@ -232,7 +234,7 @@ public:
    * @param   v  3D point to transform.
    * @return  Returns the transformed point.
    */
-  HPoint3 operator *(const Point3& v) const {
+  constexpr HPoint3 operator *(const Point3& v) const {
     return HPoint3((a[0] * v.x + a[4] * v.y + a[8] * v.z + a[12]),
                    (a[1] * v.x + a[5] * v.y + a[9] * v.z + a[13]),
                    (a[2] * v.x + a[6] * v.y + a[10] * v.z + a[14]),
@@ -245,7 +247,7 @@ public:
    * @param   v  3D vector to transform.
    * @return  Returns the transformed direction.
    */
-  Vector3 operator *(const Vector3& v) const {
+  constexpr Vector3 operator *(const Vector3& v) const {
     return Vector3((a[0] * v.x + a[4] * v.y + a[8] * v.z),
                    (a[1] * v.x + a[5] * v.y + a[9] * v.z),
                    (a[2] * v.x + a[6] * v.y + a[10] * v.z));
@@ -261,6 +263,60 @@ public:
     return Ray3(*this * ray.o, *this * ray.d);
   }
 
+  /**
+   * Transforms an array of points by the matrix. For a projective matrix
+   * the results are divided through by w. Processes 4 points per SIMD
+   * iteration. The output array may be the same as the input array.
+   * @param  in            Points to transform.
+   * @param  out           (OUT) Transformed points.
+   * @param  count         Number of points.
+   * @param  thread_count  Number of threads to split the work across
+   *                       (0 = all hardware threads).
+   */
+  void TransformPoints(const Point3* in, Point3* out, const size_t count,
+                       const uint32_t thread_count = 1) const {
+    TransformArray(a, IsAffine() ? kTransformPoint : kTransformProject,
+                   &in->x, sizeof(Point3), &out->x, sizeof(Point3), count, thread_count);
+  }
+
+  /**
+   * Transforms an array of vectors (directions) by the upper 3x3 of the
+   * matrix. No translation occurs. The output array may be the same as
+   * the input array.
+   * @param  in            Vectors to transform.
+   * @param  out           (OUT) Transformed vectors.
+   * @param  count         Number of vectors.
+   * @param  thread_count  Number of threads (0 = all hardware threads).
+   */
+  void TransformVectors(const Vector3* in, Vector3* out, const size_t count,
+                        const uint32_t thread_count = 1) const {
+    TransformArray(a, kTransformVector, &in->x, sizeof(Vector3), &out->x,
+                   sizeof(Vector3), count, thread_count);
+  }
+
+  /**
+   * Transforms an array of surface normals by the normal matrix (inverse
+   * transpose of the upper 3x3) and renormalizes them. The output array
+   * may be the same as the input array.
+   * @param  in            Normals to transform.
+   * @param  out           (OUT) Transformed, unit length normals.
+   * @param  count         Number of normals.
+   * @param  thread_count  Number of threads (0 = all hardware threads).
+   */
+  void TransformNormals(const Vector3* in, Vector3* out, const size_t count,
+                        const uint32_t thread_count = 1) const {
+    TransformArray(GetNormalMatrix().a, kTransformNormal, &in->x, sizeof(Vector3),
+                   &out->x, sizeof(Vector3), count, thread_count);
+  }
+
+  // Transform arrays of interleaved vertices: positions as points, normals
+  // as normals (see TransformPoints and TransformNormals). Any other
+  // vertex attributes are copied. Defined in geometry.h.
+  void TransformVertices(const VertexAndNormal* in, VertexAndNormal* out,
+                         const size_t count, const uint32_t thread_count = 1) const;
+  void TransformVertices(const PNTVertex* in, PNTVertex* out,
+                         const size_t count, const uint32_t thread_count = 1) const;
+
   /**
    * Transposes the current matrix.
    * @return   Returns the address of the current matrix.
@@ -298,7 +354,10 @@ public:
 
   // The following convenience methods allow creation of a composite 
   // modeling transfomation. Each method postmultiplies the curent
-  // matrix (similar to OpenGL)
+  // matrix (similar to OpenGL). The products are formed in place: a
+  // translation only changes the last column, a scaling scales the first
+  // 3 columns, and a rotation replaces the first 3 columns with linear
+  // combinations of themselves.
 
   /**
    * Applies a translation to the current transformation matrix. 
@@ -307,15 +366,10 @@ public:
    * @param	y	   y translation
    * @param	z	   Z translation
    */
-  void Translate(const float x, const float y, const float z) {
-    // The translation matrix
-    Matrix4x4 t;
-    t.m03() = x;
-    t.m13() = y;
-    t.m23() = z;
-
-    // Postmultiply the current matrix
-    *this *= t;
+  constexpr void Translate(const float x, const float y, const float z) {
+    // Column 3 becomes col0 * x + col1 * y + col2 * z + col3
+    for (int r = 0; r < 4; r++)
+      a[12 + r] += a[r] * x + a[4 + r] * y + a[8 + r] * z;
   }
 
   /**
@@ -325,15 +379,12 @@ public:
    * @param	y	   y scaling
    * @param	z	   Z scaling
    */
-  void Scale(const float x, const float y, const float z) {
-    // The scaling matrix
-    Matrix4x4 s;
-    s.m00() = x;		
-    s.m11() = y;
-    s.m22() = z;
-
-    // Postmultiply the current matrix
-    *this *= s;
+  constexpr void Scale(const float x, const float y, const float z) {
+    for (int r = 0; r < 4; r++) {
+      a[r]     *= x;
+      a[4 + r] *= y;
+      a[8 + r] *= z;
+    }
   }
 
   /**
@@ -358,34 +409,21 @@ public:
       return;
     }
 
-    // Set up the standard rotation using quaternions
-
-    // Scalar part
-    float s = (float)cos(DegreesToRadians(angle * 0.5f));
-
-    // Vector part: a normalized direction vector
-    Vector3 v(x, y, z);
-    v.Normalize();
-    v *= (float)sin(DegreesToRadians(angle * 0.5f));
-    float a = v.x;
-    float b = v.y;
-    float c = v.z;
-
-    // Set the composite rotation matrix
-    Matrix4x4 r;
-    r.m00() = 1.0f - 2.0f * b * b - 2.0f * c * c;
-    r.m01() = 2.0f * a * b - 2.0f * s * c;
-    r.m02() = 2.0f * a * c + 2.0f * s * b;
-    r.m10() = 2.0f * a * b + 2.0f * s * c;
-    r.m11() = 1.0f - 2.0f * a * a - 2.0f * c * c;
-    r.m12() = 2.0f * b * c - 2.0f * s * a;
-    r.m20() = 2.0f * a * c - 2.0f * s * b;
-    r.m21() = 2.0f * b * c + 2.0f * s * a;
-    r.m22() = 1.0f - 2.0f * a * a - 2.0f * b * b;
-    r.m33() = 1.0f;
+    // Set up the rotation and postmultiply the current matrix
+    float r[9];
+    Quaternion(angle, Vector3(x, y, z)).ToRotation(r);
+    PostMultiply3x3(r);
+  }
 
-    // Postmultiply the current matrix
-    *this *= r;
+  /**
+   * Performs a rotation given as a unit quaternion. Postmultiplies the
+   * current matrix.
+   * @param   q   Rotation (unit quaternion)
+   */
+  void Rotate(const Quaternion& q) {
+    float r[9];
+    q.ToRotation(r);
+    PostMultiply3x3(r);
   }
 
   /**
@@ -394,59 +432,250 @@ public:
    * @param   angle    Angle (degrees) for the rotation.
    */
   void RotateX(const float angle) {
-    // The rotation matrix
-    Matrix4x4 r;
+    // Column 1 becomes  cos * col1 + sin * col2
+    // Column 2 becomes -sin * col1 + cos * col2
     float radians = DegreesToRadians(angle);
-    float cosa = cosf(radians);
-    float sina = sinf(radians);
-    r.m11() = cosa;		r.m12() = -sina;
-    r.m21() = sina;		r.m22() = cosa;
-
-    // Postmultiply the current matrix
-    *this *= r;
+    RotateColumns(1, 2, cosf(radians), sinf(radians));
   }
 
   /**
-   * Performs a counterclockwise rotation about the x axis. 
+   * Performs a counterclockwise rotation about the y axis. 
    * Postmultiplies the current matrix.
    * @param   angle    Angle (degrees) for the rotation.
    */
   void RotateY(const float angle) {
-    // The rotation matrix
-    Matrix4x4 r;
+    // Column 2 becomes  cos * col2 + sin * col0
+    // Column 0 becomes -sin * col2 + cos * col0
     float radians = DegreesToRadians(angle);
-    float cosa = cosf(radians);
-    float sina = sinf(radians);
-    r.m00() = cosa;	r.m02() = sina;
-    r.m20() = -sina;	r.m22() = cosa;
-
-    // Postmultiply the current matrix
-    *this *= r;
+    RotateColumns(2, 0, cosf(radians), sinf(radians));
   }
 
   /**
-   * Performs a counterclockwise rotation about the x axis.
+   * Performs a counterclockwise rotation about the z axis.
    * Postmultiplies the current matrix.
    * @param   angle    Angle (degrees) for the rotation.
    */
   void RotateZ(const float angle) {
-    // The rotation matrix
-    Matrix4x4 r;
+    // Column 0 becomes  cos * col0 + sin * col1
+    // Column 1 becomes -sin * col0 + cos * col1
     float radians = DegreesToRadians(angle);
-    float cosa = cosf(radians);
-    float sina = sinf(radians);
-    r.m00() = cosa;		r.m01() = -sina;
-    r.m10() = sina;		r.m11() = cosa;
+    RotateColumns(0, 1, cosf(radians), sinf(radians));
+  }
+
+  // Rotations by a whole number of quarter turns (multiples of 90 degrees)
+  // about the x, y, z axes. The sine and cosine are exactly 0 or +/-1 so no
+  // trig is evaluated and the result has no round off. Usable in constant
+  // expressions, so fixed transforms can be formed at compile time.
+
+  /**
+   * Performs a counterclockwise rotation of quarter_turns * 90 degrees 
+   * about the x axis. Postmultiplies the current matrix.
+   * @param   quarter_turns  Number of quarter turns (may be negative).
+   */
+  constexpr void RotateX90(const int quarter_turns) {
+    RotateColumns(1, 2, QuarterTurnCos(quarter_turns), QuarterTurnSin(quarter_turns));
+  }
+
+  /**
+   * Performs a counterclockwise rotation of quarter_turns * 90 degrees 
+   * about the y axis. Postmultiplies the current matrix.
+   * @param   quarter_turns  Number of quarter turns (may be negative).
+   */
+  constexpr void RotateY90(const int quarter_turns) {
+    RotateColumns(2, 0, QuarterTurnCos(quarter_turns), QuarterTurnSin(quarter_turns));
+  }
+
+  /**
+   * Performs a counterclockwise rotation of quarter_turns * 90 degrees 
+   * about the z axis. Postmultiplies the current matrix.
+   * @param   quarter_turns  Number of quarter turns (may be negative).
+   */
+  constexpr void RotateZ90(const int quarter_turns) {
+    RotateColumns(0, 1, QuarterTurnCos(quarter_turns), QuarterTurnSin(quarter_turns));
+  }
 
-    // Postmultiply the current matrix
-    *this *= r;
+  /**
+   * Sets the matrix to a translation, rotation, scaling composite 
+   * (T R S). Equivalent to SetIdentity, Translate, Rotate, Scale but 
+   * writes each element once.
+   * @param  position  Translation
+   * @param  angle     Angle (degrees) of counterclockwise rotation
+   * @param  axis      Axis of rotation (need not be unit length)
+   * @param  scale     Scale factors along x, y, z
+   */
+  void SetTRS(const Point3& position, const float angle, const Vector3& axis,
+              const Vector3& scale) {
+    if (angle == 0.0f) {
+      SetTranslateScale(position, scale);
+      return;
+    }
+    SetTRS(position, Quaternion(angle, axis), scale);
   }
 
   /**
-   * Calculates the inverse of the current 4x4 matrix and returns it.
+   * Sets the matrix to a translation, rotation, scaling composite 
+   * (T R S) with the rotation given as a unit quaternion.
+   * @param  position  Translation
+   * @param  rotation  Rotation (unit quaternion)
+   * @param  scale     Scale factors along x, y, z
+   */
+  void SetTRS(const Point3& position, const Quaternion& rotation,
+              const Vector3& scale) {
+    float r[9];
+    rotation.ToRotation(r);
+    a[0] = r[0] * scale.x; a[4] = r[3] * scale.y; a[8]  = r[6] * scale.z; a[12] = position.x;
+    a[1] = r[1] * scale.x; a[5] = r[4] * scale.y; a[9]  = r[7] * scale.z; a[13] = position.y;
+    a[2] = r[2] * scale.x; a[6] = r[5] * scale.y; a[10] = r[8] * scale.z; a[14] = position.z;
+    a[3] = 0.0f;           a[7] = 0.0f;           a[11] = 0.0f;           a[15] = 1.0f;
+  }
+
+  /**
+   * Sets the matrix to a translation and scaling composite (T S), the 
+   * common case for particles and other moving objects with no rotation.
+   * @param  position  Translation
+   * @param  scale     Scale factors along x, y, z
+   */
+  void SetTranslateScale(const Point3& position, const Vector3& scale) {
+    a[0] = scale.x; a[4] = 0.0f;    a[8]  = 0.0f;    a[12] = position.x;
+    a[1] = 0.0f;    a[5] = scale.y; a[9]  = 0.0f;    a[13] = position.y;
+    a[2] = 0.0f;    a[6] = 0.0f;    a[10] = scale.z; a[14] = position.z;
+    a[3] = 0.0f;    a[7] = 0.0f;    a[11] = 0.0f;    a[15] = 1.0f;
+  }
+
+  /**
+   * Calculates the inverse of the current 4x4 matrix and returns it. Uses
+   * the matrix kind (see GetKind) to select a closed form inverse for
+   * identity and affine matrices. General (projective) matrices are
+   * inverted with Gauss-Jordan elimination.
    * @return  Returns the inverse of the current matrix.
    */
   Matrix4x4 GetInverse() const {
+    return GetInverse(GetKind());
+  }
+
+  /**
+   * Calculates the inverse of the current 4x4 matrix, given the kind of
+   * transformation it holds (e.g. kept by the caller, which may know the
+   * matrix is rigid).
+   * @param  kind  Kind of transformation the matrix holds.
+   * @return  Returns the inverse of the current matrix.
+   */
+  Matrix4x4 GetInverse(const MatrixKind kind) const {
+    switch (kind) {
+      case MATRIX_IDENTITY:
+        return *this;
+      case MATRIX_RIGID:
+      case MATRIX_AFFINE:
+        return GetAffineInverse(kind);
+      default:
+        return GetGeneralInverse();
+    }
+  }
+
+  /**
+   * Calculates the inverse of an affine matrix (bottom row 0, 0, 0, 1).
+   * The inverse of [A t] is [inv(A)  -inv(A) t]. For a rigid matrix
+   * inv(A) is the transpose of A. If A is singular the identity matrix is
+   * returned (as with GetInverse).
+   * @param  kind  MATRIX_RIGID if the matrix is known to be rigid.
+   * @return  Returns the inverse of the current matrix.
+   */
+  Matrix4x4 GetAffineInverse(const MatrixKind kind = MATRIX_AFFINE) const {
+    Matrix4x4 t(kNoInit);
+    if (kind == MATRIX_RIGID) {
+      t.a[0] = a[0]; t.a[4] = a[1]; t.a[8]  = a[2];
+      t.a[1] = a[4]; t.a[5] = a[5]; t.a[9]  = a[6];
+      t.a[2] = a[8]; t.a[6] = a[9]; t.a[10] = a[10];
+    } else {
+      // Inverse of A is the transpose of the cofactor matrix over the
+      // determinant
+      float c00 = a[5] * a[10] - a[9] * a[6];
+      float c01 = a[6] * a[8]  - a[4] * a[10];
+      float c02 = a[4] * a[9]  - a[8] * a[5];
+      float det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+      if (det == 0.0f) {
+        t.SetIdentity();
+        return t;
+      }
+      float inv = 1.0f / det;
+      t.a[0]  = c00 * inv;
+      t.a[4]  = c01 * inv;
+      t.a[8]  = c02 * inv;
+      t.a[1]  = (a[9] * a[2]  - a[1] * a[10]) * inv;
+      t.a[5]  = (a[0] * a[10] - a[8] * a[2])  * inv;
+      t.a[9]  = (a[8] * a[1]  - a[0] * a[9])  * inv;
+      t.a[2]  = (a[1] * a[6]  - a[5] * a[2])  * inv;
+      t.a[6]  = (a[4] * a[2]  - a[0] * a[6])  * inv;
+      t.a[10] = (a[0] * a[5]  - a[4] * a[1])  * inv;
+    }
+
+    // Translation is -inv(A) t
+    t.a[12] = -(t.a[0] * a[12] + t.a[4] * a[13] + t.a[8]  * a[14]);
+    t.a[13] = -(t.a[1] * a[12] + t.a[5] * a[13] + t.a[9]  * a[14]);
+    t.a[14] = -(t.a[2] * a[12] + t.a[6] * a[13] + t.a[10] * a[14]);
+    t.a[3] = 0.0f; t.a[7] = 0.0f; t.a[11] = 0.0f; t.a[15] = 1.0f;
+    return t;
+  }
+
+  /**
+   * Calculates the matrix used to transform normals: the transpose of the
+   * inverse of the upper 3x3 of this matrix. The translation and bottom
+   * row of the result are those of the identity, so the result can be 
+   * used directly as a GLSL mat4. For a rigid matrix this is simply the
+   * rotation part of the matrix.
+   * @return  Returns the normal transformation matrix.
+   */
+  Matrix4x4 GetNormalMatrix() const {
+    return GetNormalMatrix(GetKind());
+  }
+
+  /**
+   * Calculates the normal matrix (see above), given the kind of
+   * transformation the matrix holds.
+   * @param  kind  Kind of transformation the matrix holds.
+   * @return  Returns the normal transformation matrix.
+   */
+  Matrix4x4 GetNormalMatrix(const MatrixKind kind) const {
+    if (kind == MATRIX_PROJECTIVE)
+      return GetGeneralInverse().Transpose();
+
+    Matrix4x4 t(kNoInit);
+    if (kind == MATRIX_IDENTITY || kind == MATRIX_RIGID) {
+      t.a[0] = a[0]; t.a[4] = a[4]; t.a[8]  = a[8];
+      t.a[1] = a[1]; t.a[5] = a[5]; t.a[9]  = a[9];
+      t.a[2] = a[2]; t.a[6] = a[6]; t.a[10] = a[10];
+    } else {
+      // Cofactor matrix over the determinant
+      float c00 = a[5] * a[10] - a[9] * a[6];
+      float c01 = a[6] * a[8]  - a[4] * a[10];
+      float c02 = a[4] * a[9]  - a[8] * a[5];
+      float det = a[0] * c00 + a[1] * c01 + a[2] * c02;
+      if (det == 0.0f) {
+        t.SetIdentity();
+        return t;
+      }
+      float inv = 1.0f / det;
+      t.a[0]  = c00 * inv;
+      t.a[1]  = c01 * inv;
+      t.a[2]  = c02 * inv;
+      t.a[4]  = (a[9] * a[2]  - a[1] * a[10]) * inv;
+      t.a[5]  = (a[0] * a[10] - a[8] * a[2])  * inv;
+      t.a[6]  = (a[8] * a[1]  - a[0] * a[9])  * inv;
+      t.a[8]  = (a[1] * a[6]  - a[5] * a[2])  * inv;
+      t.a[9]  = (a[4] * a[2]  - a[0] * a[6])  * inv;
+      t.a[10] = (a[0] * a[5]  - a[4] * a[1])  * inv;
+    }
+    t.a[12] = 0.0f; t.a[13] = 0.0f; t.a[14] = 0.0f;
+    t.a[3] = 0.0f; t.a[7] = 0.0f; t.a[11] = 0.0f; t.a[15] = 1.0f;
+    return t;
+  }
+
+  /**
+   * Calculates the inverse of a general 4x4 matrix using Gauss-Jordan 
+   * elimination with pivoting.
+   * @return  Returns the inverse of the current matrix.
+   */
+  Matrix4x4 GetGeneralInverse() const {
     int j, k;
     int ind;
     float v1, v2;
@@ -518,8 +747,271 @@ public:
   }
 
 private:
-  // Elements of the matrix. Column order.
+  friend struct Affine3x4;
+
+  // Elements of the matrix. Column order. Not aligned (that would only
+  // add padding to the nodes and arrays holding matrices); the SIMD
+  // kernels below use unaligned loads and stores, which cost nothing extra
+  // when the data does happen to be aligned.
   float a[16];
+
+  // Tag used to construct a matrix without setting it to identity (when
+  // every element is about to be overwritten).
+  enum NoInit { kNoInit };
+  explicit Matrix4x4(NoInit) { }
+
+  /**
+   * Postmultiplies the current matrix by a 3x3 matrix (padded to 4x4 with
+   * the identity). The first 3 columns are replaced by combinations of 
+   * themselves; the last column is unchanged.
+   * @param  r  9 element matrix (column order)
+   */
+  void PostMultiply3x3(const float* r) {
+    for (int row = 0; row < 4; row++) {
+      float c0 = a[row];
+      float c1 = a[4 + row];
+      float c2 = a[8 + row];
+      a[row]     = c0 * r[0] + c1 * r[1] + c2 * r[2];
+      a[4 + row] = c0 * r[3] + c1 * r[4] + c2 * r[5];
+      a[8 + row] = c0 * r[6] + c1 * r[7] + c2 * r[8];
+    }
+  }
+
+  // How the batch transforms treat each 3 float input:
+  //   kTransformPoint   - point, w = 1 (translation applied)
+  //   kTransformProject - point, w = 1, result divided through by w
+  //   kTransformVector  - direction, w = 0 (no translation)
+  //   kTransformNormal  - direction, w = 0, result renormalized
+  enum TransformMode { kTransformPoint, kTransformProject, kTransformVector,
+                       kTransformNormal };
+
+  /**
+   * Transforms a strided array of 3 float elements, splitting the array
+   * across threads when it is large enough to be worth it.
+   * @param  m             Matrix (16 floats, column order).
+   * @param  mode          How to treat each element.
+   * @param  in            First input element.
+   * @param  in_stride     Distance in bytes between input elements.
+   * @param  out           (OUT) First output element.
+   * @param  out_stride    Distance in bytes between output elements.
+   * @param  count         Number of elements.
+   * @param  thread_count  Number of threads (0 = all hardware threads).
+   */
+  static void TransformArray(const float* m, const TransformMode mode,
+                             const float* in, const size_t in_stride,
+                             float* out, const size_t out_stride,
+                             const size_t count, const uint32_t thread_count) {
+    const size_t kMinPerThread = 4096;
+    const char* src = reinterpret_cast<const char*>(in);
+    char* dst = reinterpret_cast<char*>(out);
+    ParallelFor(count, thread_count, kMinPerThread,
+      [=](const size_t begin, const size_t end) {
+        TransformStrided(m, mode, src + begin * in_stride, in_stride,
+                         dst + begin * out_stride, out_stride, end - begin);
+      });
+  }
+
+  /**
+   * Transforms a strided array of 3 float elements on the calling thread.
+   * The SSE path gathers 4 elements into x, y, z registers, transforms
+   * them together and transposes back for the stores. Each group of 4 is
+   * read before it is written so out may be the same array as in.
+   */
+  static void TransformStrided(const float* m, const TransformMode mode,
+                               const char* in, const size_t in_stride,
+                               char* out, const size_t out_stride,
+                               const size_t count) {
+    const bool translate = (mode == kTransformPoint || mode == kTransformProject);
+    size_t i = 0;
+#ifdef GEOMETRY_SSE
+    const __m128 e00 = _mm_set1_ps(m[0]);
+    const __m128 e01 = _mm_set1_ps(m[4]);
+    const __m128 e02 = _mm_set1_ps(m[8]);
+    const __m128 e03 = _mm_set1_ps(translate ? m[12] : 0.0f);
+    const __m128 e10 = _mm_set1_ps(m[1]);
+    const __m128 e11 = _mm_set1_ps(m[5]);
+    const __m128 e12 = _mm_set1_ps(m[9]);
+    const __m128 e13 = _mm_set1_ps(translate ? m[13] : 0.0f);
+    const __m128 e20 = _mm_set1_ps(m[2]);
+    const __m128 e21 = _mm_set1_ps(m[6]);
+    const __m128 e22 = _mm_set1_ps(m[10]);
+    const __m128 e23 = _mm_set1_ps(translate ? m[14] : 0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 eps = _mm_set1_ps(kEpsilon);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4, in += 4 * in_stride, out += 4 * out_stride) {
+      const float* p0 = reinterpret_cast<const float*>(in);
+      const float* p1 = reinterpret_cast<const float*>(in + in_stride);
+      const float* p2 = reinterpret_cast<const float*>(in + 2 * in_stride);
+      const float* p3 = reinterpret_cast<const float*>(in + 3 * in_stride);
+      __m128 x = _mm_setr_ps(p0[0], p1[0], p2[0], p3[0]);
+      __m128 y = _mm_setr_ps(p0[1], p1[1], p2[1], p3[1]);
+      __m128 z = _mm_setr_ps(p0[2], p1[2], p2[2], p3[2]);
+      __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e00, x), _mm_mul_ps(e01, y)),
+                             _mm_add_ps(_mm_mul_ps(e02, z), e03));
+      __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e10, x), _mm_mul_ps(e11, y)),
+                             _mm_add_ps(_mm_mul_ps(e12, z), e13));
+      __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e20, x), _mm_mul_ps(e21, y)),
+                             _mm_add_ps(_mm_mul_ps(e22, z), e23));
+      __m128 rw = _mm_setzero_ps();
+      if (mode == kTransformProject || mode == kTransformNormal) {
+        // Scale by 1/w (or 1/length), leaving elements where the divisor is
+        // near 0 unscaled
+        __m128 d;
+        if (mode == kTransformProject) {
+          d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[3]), x),
+                                    _mm_mul_ps(_mm_set1_ps(m[7]), y)),
+                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[11]), z),
+                                    _mm_set1_ps(m[15])));
+        } else {
+          d = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx),
+                          _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz)));
+        }
+        __m128 valid = _mm_cmpgt_ps(_mm_andnot_ps(sign, d), eps);
+        __m128 inv = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(one, d)),
+                               _mm_andnot_ps(valid, one));
+        rx = _mm_mul_ps(rx, inv);
+        ry = _mm_mul_ps(ry, inv);
+        rz = _mm_mul_ps(rz, inv);
+      }
+      _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+      StoreXYZ(rx, reinterpret_cast<float*>(out));
+      StoreXYZ(ry, reinterpret_cast<float*>(out + out_stride));
+      StoreXYZ(rz, reinterpret_cast<float*>(out + 2 * out_stride));
+      StoreXYZ(rw, reinterpret_cast<float*>(out + 3 * out_stride));
+    }
+#endif
+    // Remaining elements (all elements when SIMD is disabled)
+    for (; i < count; i++, in += in_stride, out += out_stride) {
+      const float* p = reinterpret_cast<const float*>(in);
+      float x = p[0];
+      float y = p[1];
+      float z = p[2];
+      float rx = m[0] * x + m[4] * y + m[8] * z;
+      float ry = m[1] * x + m[5] * y + m[9] * z;
+      float rz = m[2] * x + m[6] * y + m[10] * z;
+      if (translate) {
+        rx += m[12];
+        ry += m[13];
+        rz += m[14];
+      }
+      float d = 1.0f;
+      if (mode == kTransformProject) {
+        d = m[3] * x + m[7] * y + m[11] * z + m[15];
+      } else if (mode == kTransformNormal) {
+        d = sqrtf(rx * rx + ry * ry + rz * rz);
+      }
+      float inv = (fabs(d) > kEpsilon) ? 1.0f / d : 1.0f;
+      float* o = reinterpret_cast<float*>(out);
+      o[0] = rx * inv;
+      o[1] = ry * inv;
+      o[2] = rz * inv;
+    }
+  }
+
+#ifdef GEOMETRY_SSE
+  // Store the first 3 floats of v. Does not touch the float after them.
+  static void StoreXYZ(const __m128 v, float* p) {
+    _mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+    _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+  }
+#endif
+
+  /**
+   * Postmultiplies the current matrix by a rotation in the plane of 2 
+   * coordinate axes: column i becomes cos * col_i + sin * col_j and 
+   * column j becomes cos * col_j - sin * col_i.
+   * @param  i     First column
+   * @param  j     Second column
+   * @param  cosa  Cosine of the rotation angle
+   * @param  sina  Sine of the rotation angle
+   */
+  constexpr void RotateColumns(const int i, const int j, const float cosa,
+                               const float sina) {
+    for (int r = 0; r < 4; r++) {
+      float ci = a[i * 4 + r];
+      float cj = a[j * 4 + r];
+      a[i * 4 + r] = cosa * ci + sina * cj;
+      a[j * 4 + r] = cosa * cj - sina * ci;
+    }
+  }
+
+  // Exact cosine and sine of a whole number of quarter turns.
+  static constexpr float QuarterTurnCos(const int quarter_turns) {
+    return ((quarter_turns & 3) == 0) ? 1.0f : ((quarter_turns & 3) == 2) ? -1.0f : 0.0f;
+  }
+  static constexpr float QuarterTurnSin(const int quarter_turns) {
+    return ((quarter_turns & 3) == 1) ? 1.0f : ((quarter_turns & 3) == 3) ? -1.0f : 0.0f;
+  }
+
+  /**
+   * Multiplies 2 column order matrices: out = a b. The output may be the 
+   * same array as either input.
+   * @param  a    Left hand matrix (16 floats, column order)
+   * @param  b    Right hand matrix (16 floats, column order)
+   * @param  out  (OUT) Product matrix (16 floats, column order)
+   */
+  static void Multiply(const float* a, const float* b, float* out) {
+#if defined(GEOMETRY_SSE)
+    // Column j of the product is a linear combination of the columns of a,
+    // weighted by the elements of column j of b. All columns of a are held
+    // in registers, and column j of b is read before column j of out is 
+    // written, so in-place multiplication (out == a or out == b) is safe.
+#if defined(GEOMETRY_AVX)
+    // Process 2 product columns per iteration. Each 128 bit lane holds a
+    // copy of a column of a.
+    __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a));
+    __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 4));
+    __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 8));
+    __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(a + 12));
+    for (int j = 0; j < 16; j += 8) {
+      __m256 bj = _mm256_loadu_ps(b + j);
+      __m256 r = _mm256_mul_ps(c0, _mm256_shuffle_ps(bj, bj, 0x00));
+      r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_shuffle_ps(bj, bj, 0x55)));
+      r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_shuffle_ps(bj, bj, 0xAA)));
+      r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_shuffle_ps(bj, bj, 0xFF)));
+      _mm256_storeu_ps(out + j, r);
+    }
+#else
+    __m128 c0 = _mm_loadu_ps(a);
+    __m128 c1 = _mm_loadu_ps(a + 4);
+    __m128 c2 = _mm_loadu_ps(a + 8);
+    __m128 c3 = _mm_loadu_ps(a + 12);
+    for (int j = 0; j < 16; j += 4) {
+      __m128 bj = _mm_loadu_ps(b + j);
+      __m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(bj, bj, 0x00));
+      r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(bj, bj, 0x55)));
+      r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(bj, bj, 0xAA)));
+      r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(bj, bj, 0xFF)));
+      _mm_storeu_ps(out + j, r);
+    }
+#endif
+#else
+    // Scalar version. Unroll the loop, do 1 row at a time. Row i of the 
+    // product only depends on row i of a, so out may alias a. If out 
+    // aliases b (m *= m) copy b first.
+    float bcopy[16];
+    if (out == b) {
+      for (int i = 0; i < 16; i++)
+        bcopy[i] = b[i];
+      b = bcopy;
+    }
+    for (int i = 0; i < 4; i++) {
+      float a0 = a[i];
+      float a1 = a[i + 4];
+      float a2 = a[i + 8];
+      float a3 = a[i + 12];
+      out[i]      = a0 * b[0]  + a1 * b[1]  + a2 * b[2]  + a3 * b[3];
+      out[i + 4]  = a0 * b[4]  + a1 * b[5]  + a2 * b[6]  + a3 * b[7];
+      out[i + 8]  = a0 * b[8]  + a1 * b[9]  + a2 * b[10] + a3 * b[11];
+      out[i + 12] = a0 * b[12] + a1 * b[13] + a2 * b[14] + a3 * b[15];
+    }
+#endif
+  }
 };
 
+// Matrices are held in arrays, nodes and the scene state's matrix stack,
+// so they must not grow past their 16 elements
+static_assert(sizeof(Matrix4x4) == 64, "Matrix4x4 must be 16 floats with no padding");
+
 #endif
@@ -11,45 +11,385 @@
 #ifndef __NOISE_H__
 #define __NOISE_H__
 
-// NOTE - not required until 605.767!
+#include <random>
 
 /**
- * Noise generation methods
+ * Noise generation methods: gradient (Perlin) noise, simplex noise and
+ * fractal sums of octaves (fBm, turbulence). The permutation table is
+ * formed once from a seed, so the same seed gives the same noise on every
+ * platform. Batch methods evaluate arrays or grids of samples 4 at a time
+ * (packets) and can split the work across threads.
  */
 class Noise
 {
 public:
   /**
    * Constructor
+   * @param  seed  Seed for the permutation table
    */
-  Noise() {
+  explicit Noise(const uint32_t seed = 0) {
+    Seed(seed);
   }
 
   /**
-   * Finds the noise at a specific 3D position. Linearly interpolates 
-   * lattice noise.
+   * Forms the permutation table (a shuffle of 0 to 255, repeated so
+   * lookups need no wrap) and the gradient table.
+   * @param  seed  Seed for the permutation table
+   */
+  void Seed(const uint32_t seed) {
+    // Fisher-Yates shuffle. mt19937 output is the same on all platforms
+    // (std::shuffle and the distributions are not).
+    std::mt19937 rng(seed);
+    for (int i = 0; i < 256; i++) {
+      perm[i] = static_cast<uint8_t>(i);
+    }
+    for (int i = 255; i > 0; i--) {
+      std::swap(perm[i], perm[rng() % (i + 1)]);
+    }
+    for (int i = 0; i < 256; i++) {
+      perm[256 + i] = perm[i];
+    }
+
+    // Gradient vectors selected by the low 4 bits of a hash: the 12 edge
+    // midpoints of a cube (4 repeated)
+    for (int h = 0; h < 16; h++) {
+      grad[h][0] = Grad(h, 1.0f, 0.0f, 0.0f);
+      grad[h][1] = Grad(h, 0.0f, 1.0f, 0.0f);
+      grad[h][2] = Grad(h, 0.0f, 0.0f, 1.0f);
+    }
+  }
+
+  /**
+   * Gradient noise (Perlin's improved noise). 0 at lattice points.
+   * @param  x  x coordinate
+   * @param  y  y coordinate
+   * @param  z  z coordinate
+   * @return  Returns the noise value (about -1 to 1).
+   */
+  float Perlin(const float x, const float y, const float z) const {
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float fz = floorf(z);
+    int ix = static_cast<int>(fx) & 255;
+    int iy = static_cast<int>(fy) & 255;
+    int iz = static_cast<int>(fz) & 255;
+    float dx = x - fx;
+    float dy = y - fy;
+    float dz = z - fz;
+
+    // Hash the 8 corners of the cell
+    int a  = perm[ix] + iy;
+    int aa = perm[a] + iz;
+    int ab = perm[a + 1] + iz;
+    int b  = perm[ix + 1] + iy;
+    int ba = perm[b] + iz;
+    int bb = perm[b + 1] + iz;
+
+    // Blend the dot products of the corner gradients with the offsets
+    float u = Fade(dx);
+    float v = Fade(dy);
+    float w = Fade(dz);
+    return Lerp(w, Lerp(v, Lerp(u, Grad(perm[aa], dx, dy, dz),
+                                   Grad(perm[ba], dx - 1.0f, dy, dz)),
+                           Lerp(u, Grad(perm[ab], dx, dy - 1.0f, dz),
+                                   Grad(perm[bb], dx - 1.0f, dy - 1.0f, dz))),
+                   Lerp(v, Lerp(u, Grad(perm[aa + 1], dx, dy, dz - 1.0f),
+                                   Grad(perm[ba + 1], dx - 1.0f, dy, dz - 1.0f)),
+                           Lerp(u, Grad(perm[ab + 1], dx, dy - 1.0f, dz - 1.0f),
+                                   Grad(perm[bb + 1], dx - 1.0f, dy - 1.0f, dz - 1.0f))));
+  }
+  float Perlin(const Point3& p) const {
+    return Perlin(p.x, p.y, p.z);
+  }
+
+  /**
+   * Gradient noise of a packet of points. The arithmetic is done on all
+   * lanes at once; the table lookups are done a lane at a time.
+   * @param  p  Points
+   * @return  Returns the noise value of each lane (same as Perlin).
+   */
+  template <typename F>
+  F Perlin(const Vector3xN<F>& p) const {
+    const int kWidth = F::kWidth;
+    F fx = Floor(p.x);
+    F fy = Floor(p.y);
+    F fz = Floor(p.z);
+    Vector3xN<F> d(p.x - fx, p.y - fy, p.z - fz);
+
+    // Gradients of the 8 corners of each lane's cell (corner bits: x = 1,
+    // y = 2, z = 4)
+    float cx[kWidth], cy[kWidth], cz[kWidth];
+    fx.Store(cx);
+    fy.Store(cy);
+    fz.Store(cz);
+    float g[8][3][kWidth];
+    for (int i = 0; i < kWidth; i++) {
+      int ix = static_cast<int>(cx[i]) & 255;
+      int iy = static_cast<int>(cy[i]) & 255;
+      int iz = static_cast<int>(cz[i]) & 255;
+      int a  = perm[ix] + iy;
+      int b  = perm[ix + 1] + iy;
+      int corner[4] = { perm[a] + iz, perm[b] + iz, perm[a + 1] + iz, perm[b + 1] + iz };
+      for (int c = 0; c < 8; c++) {
+        const float* gc = grad[perm[corner[c & 3] + (c >> 2)] & 15];
+        g[c][0][i] = gc[0];
+        g[c][1][i] = gc[1];
+        g[c][2][i] = gc[2];
+      }
+    }
+
+    F one(1.0f);
+    F dot[8];
+    for (int c = 0; c < 8; c++) {
+      F ox = (c & 1) ? d.x - one : d.x;
+      F oy = (c & 2) ? d.y - one : d.y;
+      F oz = (c & 4) ? d.z - one : d.z;
+      dot[c] = F::Load(g[c][0]) * ox + F::Load(g[c][1]) * oy + F::Load(g[c][2]) * oz;
+    }
+    F u = Fade(d.x);
+    F v = Fade(d.y);
+    F w = Fade(d.z);
+    return Lerp(w, Lerp(v, Lerp(u, dot[0], dot[1]), Lerp(u, dot[2], dot[3])),
+                   Lerp(v, Lerp(u, dot[4], dot[5]), Lerp(u, dot[6], dot[7])));
+  }
+
+  /**
+   * Simplex noise (3D). Sums 4 corner contributions of the simplex
+   * (tetrahedron) containing the point rather than blending 8 cube
+   * corners, so it is cheaper than Perlin and has fewer axis aligned
+   * artifacts.
+   * @param  x  x coordinate
+   * @param  y  y coordinate
+   * @param  z  z coordinate
+   * @return  Returns the noise value (about -1 to 1).
+   */
+  float Simplex(const float x, const float y, const float z) const {
+    const float kSkew   = 1.0f / 3.0f;
+    const float kUnskew = 1.0f / 6.0f;
+
+    // Skew to find the cube cell, then unskew its origin
+    float s = (x + y + z) * kSkew;
+    float fi = floorf(x + s);
+    float fj = floorf(y + s);
+    float fk = floorf(z + s);
+    float t = (fi + fj + fk) * kUnskew;
+    float x0 = x - (fi - t);
+    float y0 = y - (fj - t);
+    float z0 = z - (fk - t);
+
+    // Find which of the 6 simplices of the cube contains the point
+    int i1, j1, k1, i2, j2, k2;
+    if (x0 >= y0) {
+      if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+      else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+      else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+    } else {
+      if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+      else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+      else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+    }
+
+    // Offsets of the point from the other 3 corners
+    float x1 = x0 - i1 + kUnskew,        y1 = y0 - j1 + kUnskew,        z1 = z0 - k1 + kUnskew;
+    float x2 = x0 - i2 + 2.0f * kUnskew, y2 = y0 - j2 + 2.0f * kUnskew, z2 = z0 - k2 + 2.0f * kUnskew;
+    float x3 = x0 - 1.0f + 0.5f,         y3 = y0 - 1.0f + 0.5f,         z3 = z0 - 1.0f + 0.5f;
+
+    int ii = static_cast<int>(fi) & 255;
+    int jj = static_cast<int>(fj) & 255;
+    int kk = static_cast<int>(fk) & 255;
+    float n = Corner(perm[ii + perm[jj + perm[kk]]], x0, y0, z0) +
+              Corner(perm[ii + i1 + perm[jj + j1 + perm[kk + k1]]], x1, y1, z1) +
+              Corner(perm[ii + i2 + perm[jj + j2 + perm[kk + k2]]], x2, y2, z2) +
+              Corner(perm[ii + 1 + perm[jj + 1 + perm[kk + 1]]], x3, y3, z3);
+    return 32.0f * n;
+  }
+  float Simplex(const Point3& p) const {
+    return Simplex(p.x, p.y, p.z);
+  }
+
+  /**
+   * Fractal Brownian motion: a sum of octaves of gradient noise, each at
+   * lacunarity times the frequency and gain times the amplitude of the
+   * previous one. Normalized by the sum of the amplitudes.
+   * @param  p           Position
+   * @param  octaves     Number of octaves
+   * @param  lacunarity  Frequency multiplier per octave
+   * @param  gain        Amplitude multiplier per octave
+   * @return  Returns the fBm value (about -1 to 1).
+   */
+  float Fbm(const Point3& p, const int octaves, const float lacunarity = 2.0f,
+            const float gain = 0.5f) const {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    float frequency = 1.0f;
+    for (int i = 0; i < octaves; i++) {
+      sum += amplitude * Perlin(p.x * frequency, p.y * frequency, p.z * frequency);
+      total += amplitude;
+      amplitude *= gain;
+      frequency *= lacunarity;
+    }
+    return (total > 0.0f) ? sum / total : 0.0f;
+  }
+
+  /**
+   * fBm of a packet of points (same as Fbm for each lane).
+   */
+  template <typename F>
+  F Fbm(const Vector3xN<F>& p, const int octaves, const float lacunarity = 2.0f,
+        const float gain = 0.5f) const {
+    F sum(0.0f);
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    float frequency = 1.0f;
+    for (int i = 0; i < octaves; i++) {
+      sum = sum + Perlin(p * frequency) * F(amplitude);
+      total += amplitude;
+      amplitude *= gain;
+      frequency *= lacunarity;
+    }
+    return (total > 0.0f) ? sum * F(1.0f / total) : F(0.0f);
+  }
+
+  /**
+   * Finds the noise at a specific 3D position. Gradient noise remapped to
+   * the range 0 to 1.
    * @param  p       Position
-   * @param  scale   Scale
-   * @return  Returns linearly interpolated noise value.
+   * @param  scale   Scale (frequency)
+   * @return  Returns the noise value (0 to 1).
    */
-  float noise(const Point3& p, const float scale) {
-    // Complete in 605.767
-    return 1.0f;
+  float noise(const Point3& p, const float scale) const {
+    return 0.5f * (Perlin(p.x * scale, p.y * scale, p.z * scale) + 1.0f);
   }
 
   /**
-   * Find turbelence value.
-   * @param  scale   Scale
+   * Find turbulence value: a sum of 6 octaves of the absolute value of
+   * gradient noise, each at twice the frequency and half the amplitude.
+   * @param  scale   Scale (frequency of the first octave)
    * @param  p       Position
-   * @return  Returns a turbulence value
+   * @return  Returns a turbulence value (0 to about 1)
    */
-  float turbulence(float scale, const Point3& p) {
-    // Complete in 605.767
-    return 1.0f;
+  float turbulence(float scale, const Point3& p) const {
+    float sum = 0.0f;
+    float amplitude = 1.0f;
+    for (int i = 0; i < kTurbulenceOctaves; i++) {
+      sum += amplitude * fabsf(Perlin(p.x * scale, p.y * scale, p.z * scale));
+      amplitude *= 0.5f;
+      scale *= 2.0f;
+    }
+    return sum;
+  }
+
+  /**
+   * Gradient noise of an array of points, 4 at a time.
+   * @param  p             Points
+   * @param  out           (OUT) Noise value of each point
+   * @param  count         Number of points
+   * @param  thread_count  Number of threads (0 = hardware threads)
+   */
+  void Perlin(const Point3* p, float* out, const size_t count,
+              const uint32_t thread_count = 1) const {
+    Fbm(p, out, count, 1, 2.0f, 0.5f, thread_count);
+  }
+
+  /**
+   * fBm of an array of points, 4 at a time.
+   * @param  p             Points
+   * @param  out           (OUT) fBm value of each point
+   * @param  count         Number of points
+   * @param  octaves       Number of octaves
+   * @param  lacunarity    Frequency multiplier per octave
+   * @param  gain          Amplitude multiplier per octave
+   * @param  thread_count  Number of threads (0 = hardware threads)
+   */
+  void Fbm(const Point3* p, float* out, const size_t count, const int octaves,
+           const float lacunarity, const float gain,
+           const uint32_t thread_count = 1) const {
+    ParallelFor(count, thread_count, kMinSamplesPerThread,
+      [=](const size_t begin, const size_t end) {
+        const size_t kWidth = Vector3x4::kWidth;
+        size_t i = begin;
+        for (; i + kWidth <= end; i += kWidth) {
+          Fbm(Vector3x4::Load(p + i), octaves, lacunarity, gain).Store(out + i);
+        }
+        for (; i < end; i++) {
+          out[i] = Fbm(p[i], octaves, lacunarity, gain);
+        }
+      });
+  }
+
+  /**
+   * Fills a grid of fBm samples in a plane of constant z (for example a
+   * terrain heightfield). Sample (i, j) is at origin + (i, j, 0) * spacing
+   * and is stored at out[j * width + i]. Rows are split across threads.
+   * @param  out           (OUT) width * height samples
+   * @param  width         Number of samples along x
+   * @param  height        Number of samples along y
+   * @param  origin        Position of sample (0, 0)
+   * @param  spacing       Distance between samples
+   * @param  octaves       Number of octaves
+   * @param  lacunarity    Frequency multiplier per octave
+   * @param  gain          Amplitude multiplier per octave
+   * @param  thread_count  Number of threads (0 = hardware threads)
+   */
+  void FbmGrid(float* out, const int width, const int height, const Point3& origin,
+               const float spacing, const int octaves, const float lacunarity = 2.0f,
+               const float gain = 0.5f, const uint32_t thread_count = 1) const {
+    size_t min_rows = std::max(kMinSamplesPerThread / std::max(width, 1), 1);
+    ParallelFor(height, thread_count, min_rows,
+      [=](const size_t begin, const size_t end) {
+        std::vector<Point3> row(width);
+        for (size_t j = begin; j < end; j++) {
+          for (int i = 0; i < width; i++) {
+            row[i].Set(origin.x + i * spacing, origin.y + j * spacing, origin.z);
+          }
+          Fbm(row.data(), out + j * width, width, octaves, lacunarity, gain, 1);
+        }
+      });
   }
 
 private:
+  static const int kTurbulenceOctaves = 6;
+  static const int kMinSamplesPerThread = 1024;
+
+  uint8_t perm[512];      // Permutation table (repeated)
+  float   grad[16][3];    // Gradient for the low 4 bits of a hash
+
+  // Quintic fade curve 6t^5 - 15t^4 + 10t^3 (continuous 2nd derivative)
+  static float Fade(const float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+  }
+  template <typename F>
+  static F Fade(const F& t) {
+    return t * t * t * (t * (t * F(6.0f) - F(15.0f)) + F(10.0f));
+  }
+
+  static float Lerp(const float t, const float a, const float b) {
+    return a + t * (b - a);
+  }
+  template <typename F>
+  static F Lerp(const F& t, const F& a, const F& b) {
+    return a + t * (b - a);
+  }
+
+  // Dot product of the gradient selected by a hash with an offset
+  static float Grad(const int hash, const float x, const float y, const float z) {
+    int h = hash & 15;
+    float u = (h < 8) ? x : y;
+    float v = (h < 4) ? y : ((h == 12 || h == 14) ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+  }
+
+  // Contribution of one simplex corner
+  float Corner(const int hash, const float x, const float y, const float z) const {
+    float t = 0.6f - x * x - y * y - z * z;
+    if (t < 0.0f) {
+      return 0.0f;
+    }
+    t *= t;
+    const float* g = grad[hash & 15];
+    return t * t * (g[0] * x + g[1] * y + g[2] * z);
+  }
 };
 
 #endif
-
@@ -0,0 +1,426 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    packet.h
+//	Purpose: Packets of 4 or 8 floats and 3D vectors processed together
+//          (structure of arrays). Used by the hot loops that work on many
+//          points, normals or rays at once.
+//          Student should include "geometry.h" to get all class definitions
+//          included in proper order.
+//
+//============================================================================
+
+#ifndef __PACKET_H__
+#define __PACKET_H__
+
+#include <string.h>
+
+/**
+ * 4 floats processed together (one SSE register). Comparisons return a
+ * mask with all bits of a lane set where the comparison is true; use
+ * Select to pick between 2 packets with a mask and Mask to get one bit
+ * per lane.
+ */
+struct Float4 {
+  static const int kWidth = 4;
+
+#ifdef GEOMETRY_SSE
+  __m128 v;
+
+  Float4() : v(_mm_setzero_ps()) { }
+  explicit Float4(const float s) : v(_mm_set1_ps(s)) { }
+  Float4(const float a, const float b, const float c, const float d)
+    : v(_mm_setr_ps(a, b, c, d)) { }
+  explicit Float4(const __m128 m) : v(m) { }
+
+  // Load or store 4 floats (no alignment needed)
+  static Float4 Load(const float* p) { return Float4(_mm_loadu_ps(p)); }
+  void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+  Float4 operator + (const Float4& b) const { return Float4(_mm_add_ps(v, b.v)); }
+  Float4 operator - (const Float4& b) const { return Float4(_mm_sub_ps(v, b.v)); }
+  Float4 operator * (const Float4& b) const { return Float4(_mm_mul_ps(v, b.v)); }
+  Float4 operator / (const Float4& b) const { return Float4(_mm_div_ps(v, b.v)); }
+  Float4 operator < (const Float4& b) const { return Float4(_mm_cmplt_ps(v, b.v)); }
+  Float4 operator <= (const Float4& b) const { return Float4(_mm_cmple_ps(v, b.v)); }
+  Float4 operator > (const Float4& b) const { return Float4(_mm_cmpgt_ps(v, b.v)); }
+  Float4 operator >= (const Float4& b) const { return Float4(_mm_cmpge_ps(v, b.v)); }
+  Float4 operator & (const Float4& b) const { return Float4(_mm_and_ps(v, b.v)); }
+  Float4 operator | (const Float4& b) const { return Float4(_mm_or_ps(v, b.v)); }
+
+  // One bit per lane: bit i is set if lane i of a mask is true
+  int Mask() const { return _mm_movemask_ps(v); }
+
+  friend Float4 Min(const Float4& a, const Float4& b) { return Float4(_mm_min_ps(a.v, b.v)); }
+  friend Float4 Max(const Float4& a, const Float4& b) { return Float4(_mm_max_ps(a.v, b.v)); }
+  friend Float4 Sqrt(const Float4& a) { return Float4(_mm_sqrt_ps(a.v)); }
+  friend Float4 Rsqrt(const Float4& a) { return Float4(FastRsqrt(a.v)); }
+  friend Float4 Floor(const Float4& a) {
+#ifdef GEOMETRY_SSE2
+    // Truncate, then subtract 1 where truncation rounded up (negative
+    // values). Valid for |a| < 2^31.
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    return Float4(_mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f))));
+#else
+    float t[4];
+    a.Store(t);
+    return Float4(floorf(t[0]), floorf(t[1]), floorf(t[2]), floorf(t[3]));
+#endif
+  }
+  friend Float4 Abs(const Float4& a) {
+    return Float4(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+  }
+  // Lanes of a where mask is true, lanes of b elsewhere
+  friend Float4 Select(const Float4& mask, const Float4& a, const Float4& b) {
+    return Float4(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+  }
+#else
+  float v[4];
+
+  Float4() : v{ 0.0f, 0.0f, 0.0f, 0.0f } { }
+  explicit Float4(const float s) : v{ s, s, s, s } { }
+  Float4(const float a, const float b, const float c, const float d)
+    : v{ a, b, c, d } { }
+
+  static Float4 Load(const float* p) { return Float4(p[0], p[1], p[2], p[3]); }
+  void Store(float* p) const {
+    for (int i = 0; i < 4; i++) p[i] = v[i];
+  }
+
+  Float4 operator + (const Float4& b) const { return Apply(b, [](float x, float y) { return x + y; }); }
+  Float4 operator - (const Float4& b) const { return Apply(b, [](float x, float y) { return x - y; }); }
+  Float4 operator * (const Float4& b) const { return Apply(b, [](float x, float y) { return x * y; }); }
+  Float4 operator / (const Float4& b) const { return Apply(b, [](float x, float y) { return x / y; }); }
+  Float4 operator < (const Float4& b) const { return Apply(b, [](float x, float y) { return Lane(x < y); }); }
+  Float4 operator <= (const Float4& b) const { return Apply(b, [](float x, float y) { return Lane(x <= y); }); }
+  Float4 operator > (const Float4& b) const { return Apply(b, [](float x, float y) { return Lane(x > y); }); }
+  Float4 operator >= (const Float4& b) const { return Apply(b, [](float x, float y) { return Lane(x >= y); }); }
+  Float4 operator & (const Float4& b) const { return Apply(b, [](float x, float y) { return Bits(Bits(x) & Bits(y)); }); }
+  Float4 operator | (const Float4& b) const { return Apply(b, [](float x, float y) { return Bits(Bits(x) | Bits(y)); }); }
+
+  int Mask() const {
+    int m = 0;
+    for (int i = 0; i < 4; i++)
+      m |= (Bits(v[i]) >> 31) << i;
+    return m;
+  }
+
+  friend Float4 Min(const Float4& a, const Float4& b) { return a.Apply(b, [](float x, float y) { return (y < x) ? y : x; }); }
+  friend Float4 Max(const Float4& a, const Float4& b) { return a.Apply(b, [](float x, float y) { return (y > x) ? y : x; }); }
+  friend Float4 Sqrt(const Float4& a) { return a.Apply(a, [](float x, float) { return sqrtf(x); }); }
+  friend Float4 Rsqrt(const Float4& a) { return a.Apply(a, [](float x, float) { return FastRsqrt(x); }); }
+  friend Float4 Floor(const Float4& a) { return a.Apply(a, [](float x, float) { return floorf(x); }); }
+  friend Float4 Abs(const Float4& a) { return a.Apply(a, [](float x, float) { return fabsf(x); }); }
+  friend Float4 Select(const Float4& mask, const Float4& a, const Float4& b) {
+    Float4 r;
+    for (int i = 0; i < 4; i++)
+      r.v[i] = (Bits(mask.v[i]) != 0) ? a.v[i] : b.v[i];
+    return r;
+  }
+
+private:
+  // Per lane operation
+  template <typename Op>
+  Float4 Apply(const Float4& b, Op op) const {
+    return Float4(op(v[0], b.v[0]), op(v[1], b.v[1]), op(v[2], b.v[2]), op(v[3], b.v[3]));
+  }
+  // Bit pattern of a float and back (mask lanes are all 0 or all 1 bits)
+  static uint32_t Bits(const float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+  static float Bits(const uint32_t u) { float f; memcpy(&f, &u, 4); return f; }
+  static float Lane(const bool b) { return Bits(b ? 0xFFFFFFFFu : 0u); }
+#endif
+
+  /**
+   * Gets one lane.
+   * @param  i  Lane (0 to 3)
+   * @return Returns the value in lane i.
+   */
+  float operator [] (const int i) const {
+    float t[4];
+    Store(t);
+    return t[i];
+  }
+};
+
+/**
+ * 8 floats processed together: one AVX register when AVX is enabled,
+ * otherwise 2 Float4 packets. Same interface as Float4.
+ */
+struct Float8 {
+  static const int kWidth = 8;
+
+#ifdef GEOMETRY_AVX
+  __m256 v;
+
+  Float8() : v(_mm256_setzero_ps()) { }
+  explicit Float8(const float s) : v(_mm256_set1_ps(s)) { }
+  explicit Float8(const __m256 m) : v(m) { }
+
+  static Float8 Load(const float* p) { return Float8(_mm256_loadu_ps(p)); }
+  void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+  Float8 operator + (const Float8& b) const { return Float8(_mm256_add_ps(v, b.v)); }
+  Float8 operator - (const Float8& b) const { return Float8(_mm256_sub_ps(v, b.v)); }
+  Float8 operator * (const Float8& b) const { return Float8(_mm256_mul_ps(v, b.v)); }
+  Float8 operator / (const Float8& b) const { return Float8(_mm256_div_ps(v, b.v)); }
+  Float8 operator < (const Float8& b) const { return Float8(_mm256_cmp_ps(v, b.v, _CMP_LT_OQ)); }
+  Float8 operator <= (const Float8& b) const { return Float8(_mm256_cmp_ps(v, b.v, _CMP_LE_OQ)); }
+  Float8 operator > (const Float8& b) const { return Float8(_mm256_cmp_ps(v, b.v, _CMP_GT_OQ)); }
+  Float8 operator >= (const Float8& b) const { return Float8(_mm256_cmp_ps(v, b.v, _CMP_GE_OQ)); }
+  Float8 operator & (const Float8& b) const { return Float8(_mm256_and_ps(v, b.v)); }
+  Float8 operator | (const Float8& b) const { return Float8(_mm256_or_ps(v, b.v)); }
+
+  int Mask() const { return _mm256_movemask_ps(v); }
+
+  friend Float8 Min(const Float8& a, const Float8& b) { return Float8(_mm256_min_ps(a.v, b.v)); }
+  friend Float8 Max(const Float8& a, const Float8& b) { return Float8(_mm256_max_ps(a.v, b.v)); }
+  friend Float8 Sqrt(const Float8& a) { return Float8(_mm256_sqrt_ps(a.v)); }
+  friend Float8 Rsqrt(const Float8& a) {
+    // Hardware estimate plus one Newton step (as FastRsqrt)
+    __m256 y = _mm256_rsqrt_ps(a.v);
+    __m256 xyy = _mm256_mul_ps(_mm256_mul_ps(a.v, y), y);
+    return Float8(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), y),
+                                _mm256_sub_ps(_mm256_set1_ps(3.0f), xyy)));
+  }
+  friend Float8 Abs(const Float8& a) {
+    return Float8(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v));
+  }
+  friend Float8 Floor(const Float8& a) { return Float8(_mm256_floor_ps(a.v)); }
+  friend Float8 Select(const Float8& mask, const Float8& a, const Float8& b) {
+    // and/andnot rather than blendv: some compilers split a blendv of a
+    // compare result into per-lane branches
+    return Float8(_mm256_or_ps(_mm256_and_ps(mask.v, a.v), _mm256_andnot_ps(mask.v, b.v)));
+  }
+#else
+  Float4 lo;
+  Float4 hi;
+
+  Float8() { }
+  explicit Float8(const float s) : lo(s), hi(s) { }
+  Float8(const Float4& l, const Float4& h) : lo(l), hi(h) { }
+
+  static Float8 Load(const float* p) { return Float8(Float4::Load(p), Float4::Load(p + 4)); }
+  void Store(float* p) const { lo.Store(p); hi.Store(p + 4); }
+
+  Float8 operator + (const Float8& b) const { return Float8(lo + b.lo, hi + b.hi); }
+  Float8 operator - (const Float8& b) const { return Float8(lo - b.lo, hi - b.hi); }
+  Float8 operator * (const Float8& b) const { return Float8(lo * b.lo, hi * b.hi); }
+  Float8 operator / (const Float8& b) const { return Float8(lo / b.lo, hi / b.hi); }
+  Float8 operator < (const Float8& b) const { return Float8(lo < b.lo, hi < b.hi); }
+  Float8 operator <= (const Float8& b) const { return Float8(lo <= b.lo, hi <= b.hi); }
+  Float8 operator > (const Float8& b) const { return Float8(lo > b.lo, hi > b.hi); }
+  Float8 operator >= (const Float8& b) const { return Float8(lo >= b.lo, hi >= b.hi); }
+  Float8 operator & (const Float8& b) const { return Float8(lo & b.lo, hi & b.hi); }
+  Float8 operator | (const Float8& b) const { return Float8(lo | b.lo, hi | b.hi); }
+
+  int Mask() const { return lo.Mask() | (hi.Mask() << 4); }
+
+  friend Float8 Min(const Float8& a, const Float8& b) { return Float8(Min(a.lo, b.lo), Min(a.hi, b.hi)); }
+  friend Float8 Max(const Float8& a, const Float8& b) { return Float8(Max(a.lo, b.lo), Max(a.hi, b.hi)); }
+  friend Float8 Sqrt(const Float8& a) { return Float8(Sqrt(a.lo), Sqrt(a.hi)); }
+  friend Float8 Rsqrt(const Float8& a) { return Float8(Rsqrt(a.lo), Rsqrt(a.hi)); }
+  friend Float8 Abs(const Float8& a) { return Float8(Abs(a.lo), Abs(a.hi)); }
+  friend Float8 Floor(const Float8& a) { return Float8(Floor(a.lo), Floor(a.hi)); }
+  friend Float8 Select(const Float8& mask, const Float8& a, const Float8& b) {
+    return Float8(Select(mask.lo, a.lo, b.lo), Select(mask.hi, a.hi, b.hi));
+  }
+#endif
+
+  /**
+   * Gets one lane.
+   * @param  i  Lane (0 to 7)
+   * @return Returns the value in lane i.
+   */
+  float operator [] (const int i) const {
+    float t[8];
+    Store(t);
+    return t[i];
+  }
+};
+
+/**
+ * Sine and cosine of each lane (see FastSinCos for the error bound).
+ * @param  x  Angles in radians
+ * @param  s  (OUT) sin of each lane
+ * @param  c  (OUT) cos of each lane
+ */
+inline void SinCos(const Float4& x, Float4* s, Float4* c) {
+#ifdef GEOMETRY_SSE2
+  FastSinCos(x.v, &s->v, &c->v);
+#else
+  float t[4], ts[4], tc[4];
+  x.Store(t);
+  FastSinCos(t, ts, tc, 4);
+  *s = Float4::Load(ts);
+  *c = Float4::Load(tc);
+#endif
+}
+inline void SinCos(const Float8& x, Float8* s, Float8* c) {
+  float t[8], ts[8], tc[8];
+  x.Store(t);
+  FastSinCos(t, ts, tc, 8);
+  *s = Float8::Load(ts);
+  *c = Float8::Load(tc);
+}
+
+/**
+ * Packet of 3D vectors (or points) stored as structure of arrays: one
+ * packet of x values, one of y and one of z. Each operation works on all
+ * lanes at once. Use Vector3x4 (SSE) or Vector3x8 (AVX where available).
+ * Load and Store convert from and to arrays of Vector3 / Point3 (or any
+ * strided array of 3 floats, such as the normals in a vertex list).
+ */
+template <typename F>
+struct Vector3xN {
+  static const int kWidth = F::kWidth;
+
+  F x;
+  F y;
+  F z;
+
+  /**
+   * Default constructor - all lanes (0, 0, 0).
+   */
+  Vector3xN() { }
+
+  /**
+   * Constructor from packets of x, y, z.
+   */
+  Vector3xN(const F& ix, const F& iy, const F& iz)
+    : x(ix),
+      y(iy),
+      z(iz) {
+  }
+
+  /**
+   * Constructor that copies one vector into all lanes.
+   * @param  v  Vector
+   */
+  explicit Vector3xN(const Vector3& v)
+    : x(v.x),
+      y(v.y),
+      z(v.z) {
+  }
+
+  /**
+   * Loads kWidth consecutive elements of a strided array of 3 floats.
+   * @param  p       Pointer to the x coordinate of the first element.
+   * @param  stride  Distance in bytes between elements.
+   * @return Returns the packet.
+   */
+  static Vector3xN LoadStrided(const float* p, const size_t stride) {
+    float tx[kWidth], ty[kWidth], tz[kWidth];
+    const char* src = reinterpret_cast<const char*>(p);
+    for (int i = 0; i < kWidth; i++, src += stride) {
+      const float* e = reinterpret_cast<const float*>(src);
+      tx[i] = e[0];
+      ty[i] = e[1];
+      tz[i] = e[2];
+    }
+    return Vector3xN(F::Load(tx), F::Load(ty), F::Load(tz));
+  }
+  static Vector3xN Load(const Vector3* v) { return LoadStrided(&v->x, sizeof(Vector3)); }
+  static Vector3xN Load(const Point3* p) { return LoadStrided(&p->x, sizeof(Point3)); }
+
+  /**
+   * Stores the lanes to kWidth consecutive elements of a strided array.
+   * @param  p       Pointer to the x coordinate of the first element.
+   * @param  stride  Distance in bytes between elements.
+   */
+  void StoreStrided(float* p, const size_t stride) const {
+    float tx[kWidth], ty[kWidth], tz[kWidth];
+    x.Store(tx);
+    y.Store(ty);
+    z.Store(tz);
+    char* dst = reinterpret_cast<char*>(p);
+    for (int i = 0; i < kWidth; i++, dst += stride) {
+      float* e = reinterpret_cast<float*>(dst);
+      e[0] = tx[i];
+      e[1] = ty[i];
+      e[2] = tz[i];
+    }
+  }
+  void Store(Vector3* v) const { StoreStrided(&v->x, sizeof(Vector3)); }
+  void Store(Point3* p) const { StoreStrided(&p->x, sizeof(Point3)); }
+
+  /**
+   * Gets one lane as a vector.
+   * @param  i  Lane
+   * @return Returns the vector in lane i.
+   */
+  Vector3 Get(const int i) const {
+    return Vector3(x[i], y[i], z[i]);
+  }
+
+  Vector3xN operator + (const Vector3xN& w) const { return Vector3xN(x + w.x, y + w.y, z + w.z); }
+  Vector3xN operator - (const Vector3xN& w) const { return Vector3xN(x - w.x, y - w.y, z - w.z); }
+  Vector3xN operator * (const F& s) const { return Vector3xN(x * s, y * s, z * s); }
+  Vector3xN operator * (const float s) const { return *this * F(s); }
+  Vector3xN& operator += (const Vector3xN& w) { *this = *this + w; return *this; }
+
+  /**
+   * Dot product of each lane.
+   * @param  w  Vectors
+   * @return Returns a packet of the dot products.
+   */
+  F Dot(const Vector3xN& w) const {
+    return x * w.x + y * w.y + z * w.z;
+  }
+
+  /**
+   * Cross product of each lane.
+   * @param  w  Vectors
+   * @return Returns a packet of the cross products.
+   */
+  Vector3xN Cross(const Vector3xN& w) const {
+    return Vector3xN(y * w.z - z * w.y, z * w.x - x * w.z, x * w.y - y * w.x);
+  }
+
+  F NormSquared() const { return Dot(*this); }
+  F Norm() const { return Sqrt(Dot(*this)); }
+
+  /**
+   * Normalizes each lane. As with Vector3::Normalize, lanes with length
+   * near 0 are left unchanged.
+   * @return Returns the address of this packet.
+   */
+  Vector3xN& Normalize() {
+    F n = Norm();
+    F one(1.0f);
+    F inv = Select(n > F(kEpsilon), one / n, one);
+    x = x * inv;
+    y = y * inv;
+    z = z * inv;
+    return *this;
+  }
+
+  /**
+   * Normalizes each lane using the approximate 1/sqrt (relative error
+   * below 5e-7). Lanes with length near 0 are left unchanged.
+   * @return Returns the address of this packet.
+   */
+  Vector3xN& FastNormalize() {
+    F n2 = NormSquared();
+    F inv = Select(n2 > F(kEpsilon * kEpsilon), Rsqrt(n2), F(1.0f));
+    x = x * inv;
+    y = y * inv;
+    z = z * inv;
+    return *this;
+  }
+
+  // Component-wise minimum and maximum of each lane
+  friend Vector3xN Min(const Vector3xN& a, const Vector3xN& b) {
+    return Vector3xN(Min(a.x, b.x), Min(a.y, b.y), Min(a.z, b.z));
+  }
+  friend Vector3xN Max(const Vector3xN& a, const Vector3xN& b) {
+    return Vector3xN(Max(a.x, b.x), Max(a.y, b.y), Max(a.z, b.z));
+  }
+};
+
+typedef Vector3xN<Float4> Vector3x4;
+typedef Vector3xN<Float8> Vector3x8;
+
+#endif
@@ -0,0 +1,287 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    parallel.h
+//	Purpose: Simple fork/join helper for splitting loops over large arrays
+//          across threads, and a work-stealing task pool.
+//          Student should include "geometry.h" to get all
+//          class definitions included in proper order.
+//
+//============================================================================
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Gets the number of threads to use for a thread count request. A request
+ * of 0 means use all hardware threads.
+ * @param  thread_count  Requested number of threads (0 = hardware threads).
+ * @return  Returns the number of threads to use (at least 1).
+ */
+inline uint32_t ResolveThreadCount(const uint32_t thread_count) {
+  if (thread_count != 0)
+    return thread_count;
+  uint32_t n = std::thread::hardware_concurrency();
+  return (n > 0) ? n : 1;
+}
+
+/**
+ * Calls fn(begin, end) over contiguous ranges that cover [0, count). The
+ * ranges are run on up to thread_count threads (the calling thread does
+ * the first range). Each thread is given at least min_per_thread items so
+ * small arrays do not pay for thread startup. The call returns once every
+ * range is complete.
+ * @param  count           Number of items.
+ * @param  thread_count    Maximum number of threads (0 = hardware threads).
+ * @param  min_per_thread  Minimum number of items per thread.
+ * @param  fn              Function called as fn(size_t begin, size_t end).
+ */
+template <typename Function>
+void ParallelFor(const size_t count, const uint32_t thread_count,
+                 const size_t min_per_thread, Function fn) {
+  size_t max_threads = count / std::max(min_per_thread, (size_t)1);
+  size_t n = std::min((size_t)ResolveThreadCount(thread_count), max_threads);
+  if (n <= 1) {
+    fn((size_t)0, count);
+    return;
+  }
+
+  size_t chunk = (count + n - 1) / n;
+  std::vector<std::thread> threads;
+  threads.reserve(n - 1);
+  for (size_t begin = chunk; begin < count; begin += chunk) {
+    threads.emplace_back(fn, begin, std::min(begin + chunk, count));
+  }
+  fn((size_t)0, chunk);
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+/**
+ * A set of tasks run on a TaskPool that are waited for together.
+ */
+struct TaskGroup {
+  std::atomic<uint32_t> pending;    // Tasks not yet complete
+
+  TaskGroup() : pending(0) { }
+};
+
+/**
+ * Work-stealing task pool. Each thread has its own queue of tasks: a
+ * thread runs the tasks it queued newest first, and an idle thread
+ * steals the oldest task from another thread's queue. A thread waiting
+ * for a group runs queued tasks instead of blocking, so tasks may queue
+ * and wait for tasks of their own (nested fork/join). Threads other
+ * than the workers share one queue.
+ * A task is a function pointer and its arguments, and queues are fixed
+ * size, so running tasks does not allocate. If a queue is full the task
+ * is run at once by the thread queueing it.
+ */
+class TaskPool {
+public:
+  /**
+   * Task function, called as fn(a, b, begin, end).
+   */
+  typedef void (*TaskFunction)(void* a, void* b, size_t begin, size_t end);
+
+  /**
+   * Constructor. Starts the worker threads.
+   * @param  thread_count  Number of threads that run tasks, including the
+   *                       thread that waits for them (0 = hardware threads).
+   */
+  explicit TaskPool(const uint32_t thread_count = 0)
+    : stop(false),
+      queued(0) {
+    uint32_t n = ResolveThreadCount(thread_count);
+    for (uint32_t i = 0; i < n; i++)
+      queues.emplace_back(new Queue());
+    for (uint32_t i = 1; i < n; i++)
+      workers.emplace_back(&TaskPool::WorkerLoop, this, i);
+  }
+
+  /**
+   * Destructor. Stops the worker threads (queued tasks are not run).
+   */
+  ~TaskPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_lock);
+      stop = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers)
+      t.join();
+  }
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator = (const TaskPool&) = delete;
+
+  /**
+   * Gets the number of threads that run tasks (workers and the caller).
+   * @return  Returns the thread count.
+   */
+  uint32_t GetThreadCount() const {
+    return static_cast<uint32_t>(queues.size());
+  }
+
+  /**
+   * Queues a task. It may run on any thread of the pool.
+   * @param  group  Group the task belongs to (see Wait)
+   * @param  fn     Task function
+   * @param  a      First argument
+   * @param  b      Second argument
+   * @param  begin  Start of the range
+   * @param  end    End of the range
+   */
+  void Run(TaskGroup& group, TaskFunction fn, void* a, void* b,
+           const size_t begin, const size_t end) {
+    Task task = { fn, a, b, begin, end, &group };
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+
+    // Count the task before it can be stolen, so the count never drops
+    // below 0
+    queued.fetch_add(1, std::memory_order_release);
+    if (!queues[ThreadQueue()]->Push(task)) {
+      queued.fetch_sub(1, std::memory_order_relaxed);
+      Execute(task);
+      return;
+    }
+    {
+      // Serialize with a worker checking for work before it sleeps
+      std::lock_guard<std::mutex> lock(sleep_lock);
+    }
+    wake.notify_one();
+  }
+
+  /**
+   * Waits for all tasks of a group to complete, running queued tasks
+   * (of any group) in the meantime.
+   * @param  group  Group to wait for
+   */
+  void Wait(TaskGroup& group) {
+    uint32_t index = ThreadQueue();
+    while (group.pending.load(std::memory_order_acquire) > 0) {
+      if (!RunOne(index))
+        std::this_thread::yield();
+    }
+  }
+
+private:
+  // A queued task
+  struct Task {
+    TaskFunction fn;
+    void*        a;
+    void*        b;
+    size_t       begin;
+    size_t       end;
+    TaskGroup*   group;
+  };
+
+  // A thread's queue: a ring of tasks. The owner pushes and pops at the
+  // back, other threads steal from the front.
+  struct Queue {
+    static const size_t kCapacity = 1024;
+    std::mutex lock;
+    Task       tasks[kCapacity];
+    size_t     front;
+    size_t     count;
+
+    Queue() : front(0), count(0) { }
+
+    bool Push(const Task& task) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (count == kCapacity)
+        return false;
+      tasks[(front + count) % kCapacity] = task;
+      count++;
+      return true;
+    }
+
+    bool PopBack(Task& task) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (count == 0)
+        return false;
+      count--;
+      task = tasks[(front + count) % kCapacity];
+      return true;
+    }
+
+    bool PopFront(Task& task) {
+      std::lock_guard<std::mutex> guard(lock);
+      if (count == 0)
+        return false;
+      task = tasks[front];
+      front = (front + 1) % kCapacity;
+      count--;
+      return true;
+    }
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;   // Queue 0 is for other threads
+  std::vector<std::thread>            workers;
+  std::mutex                          sleep_lock;
+  std::condition_variable             wake;
+  bool                                stop;
+  std::atomic<uint32_t>               queued;   // Tasks in all queues
+
+  // Index of the calling thread's queue. Set for the workers of a pool;
+  // 0 for any other thread.
+  uint32_t ThreadQueue() const {
+    return (WorkerPool() == this) ? WorkerIndex() : 0;
+  }
+  static const TaskPool*& WorkerPool() {
+    static thread_local const TaskPool* pool = nullptr;
+    return pool;
+  }
+  static uint32_t& WorkerIndex() {
+    static thread_local uint32_t index = 0;
+    return index;
+  }
+
+  void Execute(const Task& task) {
+    task.fn(task.a, task.b, task.begin, task.end);
+    task.group->pending.fetch_sub(1, std::memory_order_release);
+  }
+
+  // Runs one task: the newest of this thread's queue, or else the oldest
+  // of another queue. Returns false if all queues are empty.
+  bool RunOne(const uint32_t index) {
+    Task task;
+    bool found = queues[index]->PopBack(task);
+    for (size_t i = 1; !found && i < queues.size(); i++)
+      found = queues[(index + i) % queues.size()]->PopFront(task);
+    if (!found)
+      return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    Execute(task);
+    return true;
+  }
+
+  void WorkerLoop(const uint32_t index) {
+    WorkerPool() = this;
+    WorkerIndex() = index;
+    for (;;) {
+      if (RunOne(index))
+        continue;
+      std::unique_lock<std::mutex> lock(sleep_lock);
+      wake.wait(lock, [this]() {
+        return stop || queued.load(std::memory_order_acquire) > 0;
+      });
+      if (stop)
+        return;
+    }
+  }
+};
+
+#endif
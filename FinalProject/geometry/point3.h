@@ -26,7 +26,7 @@ struct Point3 {
 	/**
    * Default constructor
    */
-  Point3() 
+  constexpr Point3() 
     : x(0.0f),
       y(0.0f), 
       z(0.0f) { 
@@ -38,7 +38,7 @@ struct Point3 {
    * @param   iy   y coordinate position.
    * @param   iz   z coordinate position.
    */
-  Point3(const float ix, const float iy, const float iz)
+  constexpr Point3(const float ix, const float iy, const float iz)
     : x(ix),
       y(iy),
       z(iz) { 
@@ -48,7 +48,7 @@ struct Point3 {
    * Copy constructor.
    * @param   p   Point to copy to the new point.
    */
-  Point3(const Point3& p) 
+  constexpr Point3(const Point3& p) 
     : x(p.x),
       y(p.y), 
       z(p.z) { 
@@ -58,8 +58,8 @@ struct Point3 {
    * Convert a homogeneous coordinate into a cartesian coordinate.
    * @param   p   Homogenous point
    */
-  Point3(const HPoint3& p) { 
-    *this = p.ToCartesian();
+  constexpr Point3(const HPoint3& p)
+    : Point3(p.ToCartesian()) {
   }
 
   /**
@@ -67,7 +67,7 @@ struct Point3 {
    * @param   p   Point to assign to this point.
    * @return   Returns the address of this point.
    */
-  Point3& operator = (const Point3& p) {
+  constexpr Point3& operator = (const Point3& p) {
     x = p.x;
     y = p.y;
     z = p.z;
@@ -80,7 +80,7 @@ struct Point3 {
    * @param   iy   y coordinate position.
    * @param   iz   z coordinate position.
    */
-  void Set(const float ix, const float iy, const float iz) {
+  constexpr void Set(const float ix, const float iy, const float iz) {
     x = ix;
     y = iy;
     z = iz;
@@ -91,7 +91,7 @@ struct Point3 {
    * @param   p  Point to compare to the current point.
    * @return  Returns true if two points are equal, false otherwise.
    */
-  bool operator == (const Point3& p) const {
+  constexpr bool operator == (const Point3& p) const {
     return (x == p.x && y == p.y && z == p.z);
   }
 
@@ -102,7 +102,7 @@ struct Point3 {
    * @param  a1  Scalar for p1
    * @param  p1  Point 1
    */
-  Point3 AffineCombination(const float a0, const float a1, const Point3& p1) const {
+  constexpr Point3 AffineCombination(const float a0, const float a1, const Point3& p1) const {
     return Point3(a0*x + a1*p1.x, a0*y + a1*p1.y, a0*z + a1*p1.z);
   }
 
@@ -111,7 +111,7 @@ struct Point3 {
    * @param  p1  Point
    * @return  Returns the midpoint between this point and p1.
    */
-  Point3 MidPoint(const Point3& p1) {
+  constexpr Point3 MidPoint(const Point3& p1) const {
     return Point3(0.5f*x + 0.5f*p1.x, 0.5f*y + 0.5f*p1.y, 0.5f*z + 0.5f * p1.z);
   }
 
@@ -135,7 +135,7 @@ struct Point3 {
    * @return  Returns a new point: the result of the current point
    *          plus the specified vector.
    */
-  Point3 operator + (const Vector3& v) const;
+  constexpr Point3 operator + (const Vector3& v) const;
 
   /**
    * Subtract a vector from the current point.
@@ -143,14 +143,14 @@ struct Point3 {
    * @return  Returns a new point: the result of the current point
    *          minus the specified vector.
    */
-	Point3 operator - (const Vector3& v) const;
+	constexpr Point3 operator - (const Vector3& v) const;
    
   /**
    * Subtraction of a point from the current point.
    * @param   Point to subtract from the current point.
    * @return  Returns a vector.
    */
-	Vector3 operator - (const Point3& p) const;
+	constexpr Vector3 operator - (const Point3& p) const;
 
 protected:
   // Test if point is inside polygon: drop the z component when making the
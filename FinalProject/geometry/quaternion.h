@@ -0,0 +1,237 @@
+//============================================================================
+//	Johns Hopkins University Engineering for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:  David W. Nesbitt
+//	File:    quaternion.h
+//	Purpose: Unit quaternion used to represent rotations.
+//          Student should include "geometry.h" to get all class definitions
+//          included in proper order.
+//
+//============================================================================
+
+#ifndef __QUATERNION_H__
+#define __QUATERNION_H__
+
+/**
+ * Quaternion (x, y, z) vector part, w scalar part. Rotations are held as
+ * unit quaternions. Composing 2 rotations costs 16 multiplies (vs. 27 for
+ * the upper 3x3 of a matrix) and a quaternion is cheaply renormalized, so
+ * accumulated rotations do not drift away from a rotation.
+ */
+struct Quaternion {
+  float x;
+  float y;
+  float z;
+  float w;
+
+  /**
+   * Default constructor - the identity rotation.
+   */
+  constexpr Quaternion()
+    : x(0.0f),
+      y(0.0f),
+      z(0.0f),
+      w(1.0f) {
+  }
+
+  /**
+   * Constructor with initial values for the components.
+   * @param   ix   x component of the vector part.
+   * @param   iy   y component of the vector part.
+   * @param   iz   z component of the vector part.
+   * @param   iw   Scalar part.
+   */
+  constexpr Quaternion(const float ix, const float iy, const float iz, const float iw)
+    : x(ix),
+      y(iy),
+      z(iz),
+      w(iw) {
+  }
+
+  /**
+   * Constructor for a counterclockwise rotation about an axis.
+   * @param   angle  Angle (degrees) of the rotation.
+   * @param   axis   Axis of rotation (need not be unit length).
+   */
+  Quaternion(const float angle, const Vector3& axis) {
+    Set(angle, axis);
+  }
+
+  /**
+   * Sets the quaternion to a counterclockwise rotation about an axis.
+   * @param   angle  Angle (degrees) of the rotation.
+   * @param   axis   Axis of rotation (need not be unit length).
+   */
+  void Set(const float angle, const Vector3& axis) {
+    float half_angle = DegreesToRadians(angle * 0.5f);
+    Vector3 v = axis;
+    v.Normalize();
+    v *= sinf(half_angle);
+    x = v.x;
+    y = v.y;
+    z = v.z;
+    w = cosf(half_angle);
+  }
+
+  /**
+   * Quaternion product. The result rotates by q, then by this rotation.
+   * @param   q  Quaternion to multiply by.
+   * @return  Returns the product of this quaternion and q.
+   */
+  constexpr Quaternion operator * (const Quaternion& q) const {
+    return Quaternion(w * q.x + x * q.w + y * q.z - z * q.y,
+                      w * q.y - x * q.z + y * q.w + z * q.x,
+                      w * q.z + x * q.y - y * q.x + z * q.w,
+                      w * q.w - x * q.x - y * q.y - z * q.z);
+  }
+
+  /**
+   * Multiplies this quaternion by q (this = this * q).
+   * @param   q  Quaternion to multiply by.
+   * @return  Returns the address of this quaternion.
+   */
+  constexpr Quaternion& operator *= (const Quaternion& q) {
+    *this = *this * q;
+    return *this;
+  }
+
+  /**
+   * Scales all 4 components.
+   * @param   s  Scalar.
+   * @return  Returns the scaled quaternion.
+   */
+  constexpr Quaternion operator * (const float s) const {
+    return Quaternion(x * s, y * s, z * s, w * s);
+  }
+
+  /**
+   * Component-wise sum (used when interpolating).
+   * @param   q  Quaternion to add.
+   * @return  Returns the sum.
+   */
+  constexpr Quaternion operator + (const Quaternion& q) const {
+    return Quaternion(x + q.x, y + q.y, z + q.z, w + q.w);
+  }
+
+  /**
+   * Negation. -q represents the same rotation as q.
+   * @return  Returns the negated quaternion.
+   */
+  constexpr Quaternion operator - () const {
+    return Quaternion(-x, -y, -z, -w);
+  }
+
+  /**
+   * Dot product of 4 components.
+   * @param   q  Quaternion.
+   * @return  Returns the dot product of this quaternion and q.
+   */
+  constexpr float Dot(const Quaternion& q) const {
+    return x * q.x + y * q.y + z * q.z + w * q.w;
+  }
+
+  /**
+   * Gets the conjugate. For a unit quaternion this is the inverse rotation.
+   * @return  Returns the conjugate of this quaternion.
+   */
+  constexpr Quaternion Conjugate() const {
+    return Quaternion(-x, -y, -z, w);
+  }
+
+  /**
+   * Normalizes the quaternion to unit length (if the length is not 0).
+   * @return  Returns the address of this quaternion.
+   */
+  Quaternion& Normalize() {
+    float n = sqrtf(Dot(*this));
+    if (n > kEpsilon && n != 1.0f) {
+      float inv = 1.0f / n;
+      x *= inv;
+      y *= inv;
+      z *= inv;
+      w *= inv;
+    }
+    return *this;
+  }
+
+  /**
+   * Rotates a vector by this (unit) quaternion. Uses
+   * v' = v + w t + u x t, where u is the vector part and t = 2 (u x v).
+   * @param   v  Vector to rotate.
+   * @return  Returns the rotated vector.
+   */
+  constexpr Vector3 Rotate(const Vector3& v) const {
+    Vector3 u(x, y, z);
+    Vector3 t = u.Cross(v) * 2.0f;
+    return v + t * w + u.Cross(t);
+  }
+
+  /**
+   * Rotates a point about the origin by this (unit) quaternion.
+   * @param   p  Point to rotate.
+   * @return  Returns the rotated point.
+   */
+  constexpr Point3 Rotate(const Point3& p) const {
+    Vector3 v = Rotate(Vector3(p));
+    return Point3(v.x, v.y, v.z);
+  }
+
+  /**
+   * Forms the 3x3 rotation matrix (column order) for this (unit)
+   * quaternion.
+   * @param  r  (OUT) 9 element rotation matrix (column order)
+   */
+  constexpr void ToRotation(float* r) const {
+    r[0] = 1.0f - 2.0f * y * y - 2.0f * z * z;
+    r[3] = 2.0f * x * y - 2.0f * w * z;
+    r[6] = 2.0f * x * z + 2.0f * w * y;
+    r[1] = 2.0f * x * y + 2.0f * w * z;
+    r[4] = 1.0f - 2.0f * x * x - 2.0f * z * z;
+    r[7] = 2.0f * y * z - 2.0f * w * x;
+    r[2] = 2.0f * x * z - 2.0f * w * y;
+    r[5] = 2.0f * y * z + 2.0f * w * x;
+    r[8] = 1.0f - 2.0f * x * x - 2.0f * y * y;
+  }
+
+  /**
+   * Normalized linear interpolation from this rotation to q. Takes the
+   * shorter way around. Cheaper than Slerp; the angular speed is not
+   * constant but the path is the same.
+   * @param   q  Rotation at t = 1.
+   * @param   t  Interpolation parameter (0 to 1).
+   * @return  Returns the interpolated unit quaternion.
+   */
+  Quaternion Nlerp(const Quaternion& q, const float t) const {
+    Quaternion end = (Dot(q) < 0.0f) ? -q : q;
+    Quaternion r = *this * (1.0f - t) + end * t;
+    return r.Normalize();
+  }
+
+  /**
+   * Spherical linear interpolation from this rotation to q (constant
+   * angular speed). Takes the shorter way around. Falls back to Nlerp
+   * when the rotations are nearly the same.
+   * @param   q  Rotation at t = 1.
+   * @param   t  Interpolation parameter (0 to 1).
+   * @return  Returns the interpolated unit quaternion.
+   */
+  Quaternion Slerp(const Quaternion& q, const float t) const {
+    float cos_omega = Dot(q);
+    Quaternion end = q;
+    if (cos_omega < 0.0f) {
+      cos_omega = -cos_omega;
+      end = -q;
+    }
+    if (cos_omega > 0.9995f)
+      return Nlerp(end, t);
+
+    float omega = acosf(cos_omega);
+    float inv_sin = 1.0f / sinf(omega);
+    return *this * (sinf((1.0f - t) * omega) * inv_sin) +
+           end * (sinf(t * omega) * inv_sin);
+  }
+};
+
+#endif
@@ -14,8 +14,99 @@
 #define __RAY_H__
 
 #include <math.h>
+#include <algorithm>
 #include <vector>
 
+/**
+ * Slab test of rays against axis aligned boxes, one lane per ray / box
+ * pair. Either side may be a broadcast (one ray against kWidth boxes or
+ * kWidth rays against one box).
+ * @param  o      Ray origins
+ * @param  inv_d  Reciprocals of the ray directions (per component)
+ * @param  bmin   Box minimum points
+ * @param  bmax   Box maximum points
+ * @return Returns the parameter t of the nearest intersection in front of
+ *         the origin (the exit point if the origin is inside the box) or 0
+ *         in lanes with no intersection.
+ */
+template <typename F>
+F IntersectRayBox(const Vector3xN<F>& o, const Vector3xN<F>& inv_d,
+                  const Vector3xN<F>& bmin, const Vector3xN<F>& bmax) {
+  F tx0 = (bmin.x - o.x) * inv_d.x;
+  F tx1 = (bmax.x - o.x) * inv_d.x;
+  F ty0 = (bmin.y - o.y) * inv_d.y;
+  F ty1 = (bmax.y - o.y) * inv_d.y;
+  F tz0 = (bmin.z - o.z) * inv_d.z;
+  F tz1 = (bmax.z - o.z) * inv_d.z;
+  F tmin = Max(Max(Min(tx0, tx1), Min(ty0, ty1)), Min(tz0, tz1));
+  F tmax = Min(Min(Max(tx0, tx1), Max(ty0, ty1)), Max(tz0, tz1));
+  F zero(0.0f);
+  F hit = (tmax >= tmin) & (tmax > zero);
+  return Select(hit, Select(tmin > zero, tmin, tmax), zero);
+}
+
+/**
+ * Moller-Trumbore test of rays against triangles, one lane per ray /
+ * triangle pair. Either side may be a broadcast. Triangles are given as
+ * a vertex and the 2 edges from it. Both sides of a triangle are hit.
+ * @param  o   Ray origins
+ * @param  d   Ray directions
+ * @param  v0  First vertex of each triangle
+ * @param  e1  Edge v1 - v0 of each triangle
+ * @param  e2  Edge v2 - v0 of each triangle
+ * @param  u   (OUT) barycentric coordinate (weight of v1) of the hit
+ * @param  v   (OUT) barycentric coordinate (weight of v2) of the hit
+ * @return Returns the parameter t of the intersection or 0 in lanes with
+ *         no intersection in front of the origin.
+ */
+template <typename F>
+F IntersectRayTriangle(const Vector3xN<F>& o, const Vector3xN<F>& d,
+                       const Vector3xN<F>& v0, const Vector3xN<F>& e1,
+                       const Vector3xN<F>& e2, F& u, F& v) {
+  Vector3xN<F> p = d.Cross(e2);
+  F det = e1.Dot(p);
+  F zero(0.0f);
+  F one(1.0f);
+  F valid = Abs(det) > F(kEpsilon);
+  F inv_det = one / Select(valid, det, one);
+  Vector3xN<F> s = o - v0;
+  u = s.Dot(p) * inv_det;
+  Vector3xN<F> q = s.Cross(e1);
+  v = d.Dot(q) * inv_det;
+  F t = e2.Dot(q) * inv_det;
+  valid = valid & (u >= zero) & (v >= zero) & (u + v <= one) & (t > F(kEpsilon));
+  return Select(valid, t, zero);
+}
+
+/**
+ * Packet of kWidth triangles (structure of arrays), stored as a vertex and
+ * 2 edges, for testing one ray against several triangles at once.
+ */
+template <typename F>
+struct TrianglexN {
+  Vector3xN<F> v0;
+  Vector3xN<F> e1;
+  Vector3xN<F> e2;
+
+  /**
+   * Loads kWidth triangles from 3 arrays of vertices.
+   * @param  p0  First vertex of each triangle
+   * @param  p1  Second vertex of each triangle
+   * @param  p2  Third vertex of each triangle
+   * @return Returns the packet.
+   */
+  static TrianglexN Load(const Point3* p0, const Point3* p1, const Point3* p2) {
+    TrianglexN tri;
+    tri.v0 = Vector3xN<F>::Load(p0);
+    tri.e1 = Vector3xN<F>::Load(p1) - tri.v0;
+    tri.e2 = Vector3xN<F>::Load(p2) - tri.v0;
+    return tri;
+  }
+};
+
+typedef TrianglexN<Float4> Trianglex4;
+typedef TrianglexN<Float8> Trianglex8;
+
 /**
  * 3D ray
  */
@@ -37,8 +128,12 @@ struct Ray3 {
    * @param   p2    End point of the ray (at t = 1).
    * @param   norm  If true normalize the direction vector
    */
-  Ray3(const Point3& p1, const Point3& p2, bool normalize) {
-    // Student to define
+  Ray3(const Point3& p1, const Point3& p2, bool normalize)
+    : o(p1),
+      d(p1, p2) {
+    if (normalize) {
+      d.Normalize();
+    }
   }
 
   /**
@@ -108,8 +203,15 @@ struct Ray3 {
    *          0.0f if no intersection occurs.
    */
   float Intersect(const Plane& p) const {
-    // Required in 605.767
-    return 0.0f; 
+    // Solve n.(o + t d) = plane d for t. No intersection if the ray is
+    // parallel to the plane or the plane is behind the origin.
+    Vector3 n = p.GetNormal();
+    float denom = n.Dot(d);
+    if (fabsf(denom) < kEpsilon) {
+      return 0.0f;
+    }
+    float t = (p.d - n.Dot(Vector3(o))) / denom;
+    return (t > 0.0f) ? t : 0.0f;
   }
 
   /**
@@ -161,8 +263,39 @@ struct Ray3 {
    *          0.0f if no intersection occurs.
    */
   float Intersect(const AABB& box) const {
-    // Required in 605.767
-    return 0.0f; 
+    // Slab method: intersect the ray with the 3 pairs of planes bounding
+    // the box. The ray hits the box if the latest entry is before the 
+    // earliest exit. Division by a zero direction component gives +/- inf,
+    // which the min/max handle (unless the origin lies exactly on one of
+    // the 2 planes of that axis).
+    float tx0 = (box.m_min.x - o.x) / d.x;
+    float tx1 = (box.m_max.x - o.x) / d.x;
+    float ty0 = (box.m_min.y - o.y) / d.y;
+    float ty1 = (box.m_max.y - o.y) / d.y;
+    float tz0 = (box.m_min.z - o.z) / d.z;
+    float tz1 = (box.m_max.z - o.z) / d.z;
+    float tmin = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)),
+                          std::min(tz0, tz1));
+    float tmax = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)),
+                          std::max(tz0, tz1));
+    if (tmax < tmin || tmax <= 0.0f) {
+      return 0.0f;
+    }
+
+    // Origin inside the box: the exit point is the nearest intersection
+    return (tmin > 0.0f) ? tmin : tmax;
+  }
+
+  /**
+   * Intersection of the ray with kWidth boxes at once.
+   * @param   boxes  Packet of boxes
+   * @return  Returns the parameter t for each box (0 where the ray misses).
+   */
+  template <typename F>
+  F Intersect(const AABBxN<F>& boxes) const {
+    Vector3 inv_d(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+    return IntersectRayBox(Vector3xN<F>(Vector3(o)), Vector3xN<F>(inv_d),
+                           boxes.m_min, boxes.m_max);
   }
 
   /**
@@ -173,8 +306,16 @@ struct Ray3 {
    *          0.0f if no intersection occurs.
    */
   float Intersect(std::vector<Point3>& polygon, Vector3& normal) const {
-    // Required in 605.767
-    return 0.0f;
+    // Intersect the plane of the polygon then test if the intersection
+    // point is inside the polygon
+    if (polygon.size() < 3) {
+      return 0.0f;
+    }
+    float t = Intersect(Plane(polygon[0], normal));
+    if (t == 0.0f) {
+      return 0.0f;
+    }
+    return Intersect(t).IsInPolygon(polygon, normal) ? t : 0.0f;
   }
 
   /**
@@ -189,9 +330,96 @@ struct Ray3 {
    */
   float Intersect(const Point3& v0, const Point3& v1, const Point3& v2,
                   float& u, float& v) const {
-    // Required in 605.767
-    return 0.0f;
+    // Moller-Trumbore: solve o + t d = (1 - u - v) v0 + u v1 + v v2 using 
+    // Cramer's rule with scalar triple products
+    Vector3 e1(v0, v1);
+    Vector3 e2(v0, v2);
+    Vector3 p = d.Cross(e2);
+    float det = e1.Dot(p);
+    if (fabsf(det) < kEpsilon) {
+      return 0.0f;        // Ray is parallel to the triangle
+    }
+    float inv_det = 1.0f / det;
+    Vector3 s(v0, o);
+    u = s.Dot(p) * inv_det;
+    if (u < 0.0f || u > 1.0f) {
+      return 0.0f;
+    }
+    Vector3 q = s.Cross(e1);
+    v = d.Dot(q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f) {
+      return 0.0f;
+    }
+    float t = e2.Dot(q) * inv_det;
+    return (t > kEpsilon) ? t : 0.0f;
+  }
+
+  /**
+   * Intersection of the ray with kWidth triangles at once.
+   * @param   tris  Packet of triangles
+   * @param   u     (OUT) barycentric coordinate of each intersection
+   * @param   v     (OUT) barycentric coordinate of each intersection
+   * @return  Returns the parameter t for each triangle (0 where the ray
+   *          misses).
+   */
+  template <typename F>
+  F Intersect(const TrianglexN<F>& tris, F& u, F& v) const {
+    return IntersectRayTriangle(Vector3xN<F>(Vector3(o)), Vector3xN<F>(d),
+                                tris.v0, tris.e1, tris.e2, u, v);
+  }
+};
+
+/**
+ * Packet of kWidth rays (structure of arrays) for testing several rays
+ * against one box or triangle at once.
+ */
+template <typename F>
+struct Ray3xN {
+  Vector3xN<F> o;     // Ray origins
+  Vector3xN<F> d;     // Ray directions
+
+  /**
+   * Loads kWidth consecutive rays.
+   * @param  rays  Pointer to the first ray
+   * @return Returns the packet.
+   */
+  static Ray3xN Load(const Ray3* rays) {
+    Ray3xN r;
+    r.o = Vector3xN<F>::LoadStrided(&rays->o.x, sizeof(Ray3));
+    r.d = Vector3xN<F>::LoadStrided(&rays->d.x, sizeof(Ray3));
+    return r;
+  }
+
+  /**
+   * Intersection of each ray with a box.
+   * @param   box  Box to test intersection with
+   * @return  Returns the parameter t for each ray (0 where it misses).
+   */
+  F Intersect(const AABB& box) const {
+    F one(1.0f);
+    Vector3xN<F> inv_d(one / d.x, one / d.y, one / d.z);
+    return IntersectRayBox(o, inv_d, Vector3xN<F>(Vector3(box.m_min)),
+                           Vector3xN<F>(Vector3(box.m_max)));
+  }
+
+  /**
+   * Intersection of each ray with a triangle.
+   * @param   v0  Vertex of the triangle
+   * @param   v1  Vertex of the triangle
+   * @param   v2  Vertex of the triangle
+   * @param   u   (OUT) barycentric coordinate of each intersection
+   * @param   v   (OUT) barycentric coordinate of each intersection
+   * @return  Returns the parameter t for each ray (0 where it misses).
+   */
+  F Intersect(const Point3& v0, const Point3& v1, const Point3& v2,
+              F& u, F& v) const {
+    return IntersectRayTriangle(o, d, Vector3xN<F>(Vector3(v0)),
+                                Vector3xN<F>(Vector3(v0, v1)),
+                                Vector3xN<F>(Vector3(v0, v2)), u, v);
   }
 };
 
+typedef Ray3xN<Float4> Ray3x4;
+typedef Ray3xN<Float8> Ray3x8;
+
 #endif
@@ -173,12 +173,17 @@ struct LineSegment2 {
       // with the ray
       float n_dot_c = n.Dot(c);
 
-      // Check for parallel line
+      // Check for parallel line. It is outside if a is outside this edge
+      w = *pt1 - a;
       if (std::abs(n_dot_c) < kEpsilon) {
+        if (n.Dot(w) < 0.0f) {
+          clip_segment.a.Set(0.0f, 0.0f);
+          clip_segment.b.Set(0.0f, 0.0f);
+          return false;
+        }
         continue;
       }
 
-      w = *pt1 - a;
       t_hit = n.Dot(w) / n_dot_c;
 
       // Ray is exit_ing P
@@ -284,4 +289,275 @@ struct LineSegment2 {
   }
 };
 
+/**
+ * Packet of kWidth line segments (structure of arrays) for clipping
+ * several segments at once. Clipping is done parametrically: the result
+ * of a clip is the interval [t0, t1] of the segment a + t (b - a) that
+ * remains.
+ */
+template <typename F>
+struct Segment2xN {
+  F ax, ay;
+  F bx, by;
+
+  /**
+   * Loads kWidth consecutive segments.
+   * @param  s  Pointer to the first segment.
+   * @return Returns the packet.
+   */
+  static Segment2xN Load(const LineSegment2* s) {
+    float t[4][F::kWidth];
+    for (int i = 0; i < F::kWidth; i++) {
+      t[0][i] = s[i].a.x;
+      t[1][i] = s[i].a.y;
+      t[2][i] = s[i].b.x;
+      t[3][i] = s[i].b.y;
+    }
+    Segment2xN p;
+    p.ax = F::Load(t[0]);
+    p.ay = F::Load(t[1]);
+    p.bx = F::Load(t[2]);
+    p.by = F::Load(t[3]);
+    return p;
+  }
+
+  /**
+   * Clips each segment to a rectangle (Liang-Barsky). Outcodes of the end
+   * points are formed first: if every lane is trivially accepted or
+   * rejected no intersections are computed.
+   * @param  r   Rectangle
+   * @param  t0  (OUT) Start of the remaining interval of each segment
+   * @param  t1  (OUT) End of the remaining interval of each segment
+   * @return  Returns the lane mask (see Float4::Mask) of segments with
+   *          some part inside the rectangle.
+   */
+  int ClipToRectangle(const CRectangle& r, F& t0, F& t1) const {
+    F left(r.left), right(r.right), bottom(r.bottom), top(r.top);
+    F outside_a = (ax < left) | (ax > right) | (ay < bottom) | (ay > top);
+    F outside_b = (bx < left) | (bx > right) | (by < bottom) | (by > top);
+    F reject = ((ax < left) & (bx < left)) | ((ax > right) & (bx > right)) |
+               ((ay < bottom) & (by < bottom)) | ((ay > top) & (by > top));
+    t0 = F(0.0f);
+    t1 = F(1.0f);
+    int full = (1 << F::kWidth) - 1;
+    int reject_mask = reject.Mask();
+    int clip_mask = (outside_a | outside_b).Mask() & ~reject_mask;
+    if (clip_mask != 0) {
+      ClipSlab(ax, bx - ax, left, right, t0, t1);
+      ClipSlab(ay, by - ay, bottom, top, t0, t1);
+      reject_mask |= (t0 > t1).Mask();
+    }
+    return full & ~reject_mask;
+  }
+
+  /**
+   * Clips each segment to a convex polygon (Cyrus-Beck). Same result as
+   * LineSegment2::ClipToPolygon.
+   * @param  poly  A counter-clockwise oriented polygon.
+   * @param  t0    (OUT) Start of the remaining interval of each segment
+   * @param  t1    (OUT) End of the remaining interval of each segment
+   * @return  Returns the lane mask of segments with some part inside.
+   */
+  int ClipToPolygon(const std::vector<Point2>& poly, F& t0, F& t1) const {
+    F cx = bx - ax;
+    F cy = by - ay;
+    F eps(kEpsilon);
+    F neg_eps(-kEpsilon);
+    F zero(0.0f);
+    F reject = zero < zero;
+    t0 = zero;
+    t1 = F(1.0f);
+    auto pt1 = poly.end() - 1;
+    auto pt2 = poly.begin();
+    for (; pt2 != poly.end(); pt1 = pt2, pt2++) {
+      // Outward normal and its dot products with the segment and with the
+      // vector from a to the edge
+      F nx(pt2->y - pt1->y);
+      F ny(pt1->x - pt2->x);
+      F n_dot_c = nx * cx + ny * cy;
+      F n_dot_w = nx * (F(pt1->x) - ax) + ny * (F(pt1->y) - ay);
+      F t_hit = n_dot_w / n_dot_c;
+      F exiting = n_dot_c >= eps;
+      F entering = n_dot_c <= neg_eps;
+      t1 = Select(exiting, Min(t1, t_hit), t1);
+      t0 = Select(entering, Max(t0, t_hit), t0);
+      reject = reject | ((Abs(n_dot_c) < eps) & (n_dot_w < zero));
+    }
+    return (t0 <= t1).Mask() & ~reject.Mask();
+  }
+
+  /**
+   * Writes the clipped segments of the lanes in a mask to consecutive
+   * elements of an array.
+   * @param  mask   Lanes to write
+   * @param  t0     Start of the interval of each lane
+   * @param  t1     End of the interval of each lane
+   * @param  first  Index of the segment in lane 0 (written to index)
+   * @param  out    (OUT) Clipped segments
+   * @param  index  (OUT) Index of each clipped segment. May be null.
+   * @return  Returns the number of segments written.
+   */
+  size_t Store(const int mask, const F& t0, const F& t1, const uint32_t first,
+               LineSegment2* out, uint32_t* index) const {
+    // The end points are a + t0 (b - a) and b - (1 - t1) (b - a) so
+    // unclipped ends are exact
+    F dx = bx - ax;
+    F dy = by - ay;
+    F s1 = F(1.0f) - t1;
+    float c[4][F::kWidth];
+    (ax + dx * t0).Store(c[0]);
+    (ay + dy * t0).Store(c[1]);
+    (bx - dx * s1).Store(c[2]);
+    (by - dy * s1).Store(c[3]);
+    size_t n = 0;
+    for (int i = 0; i < F::kWidth; i++) {
+      if (mask & (1 << i)) {
+        out[n].a.Set(c[0][i], c[1][i]);
+        out[n].b.Set(c[2][i], c[3][i]);
+        if (index != nullptr) {
+          index[n] = first + i;
+        }
+        n++;
+      }
+    }
+    return n;
+  }
+
+private:
+  // Limits [t0, t1] to the part of a + t d between lo and hi
+  static void ClipSlab(const F& a, const F& d, const F& lo, const F& hi,
+                       F& t0, F& t1) {
+    // Where d is 0 the segment is parallel to the slab and inside it
+    // (trivial reject removed the ones outside): keep the interval
+    F zero(0.0f);
+    F parallel = (d >= zero) & (d <= zero);
+    F inv = F(1.0f) / Select(parallel, F(1.0f), d);
+    F t_lo = (lo - a) * inv;
+    F t_hi = (hi - a) * inv;
+    t0 = Select(parallel, t0, Max(t0, Min(t_lo, t_hi)));
+    t1 = Select(parallel, t1, Min(t1, Max(t_lo, t_hi)));
+  }
+};
+
+typedef Segment2xN<Float4> Segment2x4;
+typedef Segment2xN<Float8> Segment2x8;
+
+/**
+ * Clips an array of segments, 8 at a time, and writes the parts that
+ * remain to consecutive elements of an output array (in input order).
+ * Large arrays are split into blocks that are clipped across threads and
+ * then compacted.
+ * @param  in            Segments to clip
+ * @param  count         Number of segments
+ * @param  out           (OUT) Clipped segments. Must hold count segments.
+ * @param  index         (OUT) Input index of each clipped segment (may be
+ *                       null). Must hold count values.
+ * @param  thread_count  Number of threads (0 = hardware threads)
+ * @param  clip          Called as clip(packet, t0, t1) and returns the
+ *                       lane mask of segments that remain
+ * @return  Returns the number of clipped segments written.
+ */
+template <typename Clip>
+size_t ClipSegments(const LineSegment2* in, const size_t count, LineSegment2* out,
+                    uint32_t* index, const uint32_t thread_count, Clip clip) {
+  const size_t kBlockSize = 4096;
+  const size_t kWidth = Float8::kWidth;
+  auto clip_block = [=](const size_t begin, const size_t end) {
+    size_t n = 0;
+    size_t i = begin;
+    Float8 t0, t1;
+    for (; i + kWidth <= end; i += kWidth) {
+      Segment2x8 p = Segment2x8::Load(in + i);
+      int mask = clip(p, t0, t1);
+      if (mask != 0) {
+        n += p.Store(mask, t0, t1, static_cast<uint32_t>(i), out + begin + n,
+                     (index != nullptr) ? index + begin + n : nullptr);
+      }
+    }
+    if (i < end) {
+      // Pad the last packet by repeating the last segment
+      LineSegment2 tail[kWidth];
+      for (size_t k = 0; k < kWidth; k++) {
+        tail[k] = in[std::min(i + k, end - 1)];
+      }
+      Segment2x8 p = Segment2x8::Load(tail);
+      int mask = clip(p, t0, t1) & ((1 << (end - i)) - 1);
+      n += p.Store(mask, t0, t1, static_cast<uint32_t>(i), out + begin + n,
+                   (index != nullptr) ? index + begin + n : nullptr);
+    }
+    return n;
+  };
+  if (count <= kBlockSize) {
+    return clip_block(0, count);
+  }
+
+  // Each block writes to its own range of out (the same range as its
+  // input), then the blocks are moved together
+  size_t block_count = (count + kBlockSize - 1) / kBlockSize;
+  std::vector<size_t> block_n(block_count);
+  ParallelFor(block_count, thread_count, 4, [&](const size_t begin, const size_t end) {
+    for (size_t b = begin; b < end; b++) {
+      block_n[b] = clip_block(b * kBlockSize, std::min((b + 1) * kBlockSize, count));
+    }
+  });
+  // The destination is never after the source. If every earlier segment
+  // survived they are the same, and the block is already in place
+  // (std::copy does not allow the destination inside the source).
+  size_t n = block_n[0];
+  for (size_t b = 1; b < block_count; b++) {
+    if (n < b * kBlockSize) {
+      std::copy(out + b * kBlockSize, out + b * kBlockSize + block_n[b], out + n);
+      if (index != nullptr) {
+        std::copy(index + b * kBlockSize, index + b * kBlockSize + block_n[b], index + n);
+      }
+    }
+    n += block_n[b];
+  }
+  return n;
+}
+
+/**
+ * Clips an array of segments to a rectangle (see ClipSegments). The
+ * segments match LineSegment2::ClipToRectangle up to rounding.
+ * @param  in            Segments to clip
+ * @param  count         Number of segments
+ * @param  r             Rectangle
+ * @param  out           (OUT) Clipped segments. Must hold count segments.
+ * @param  index         (OUT) Input index of each clipped segment (may be
+ *                       null).
+ * @param  thread_count  Number of threads (0 = hardware threads)
+ * @return  Returns the number of clipped segments written.
+ */
+inline size_t ClipSegmentsToRectangle(const LineSegment2* in, const size_t count,
+                                      const CRectangle& r, LineSegment2* out,
+                                      uint32_t* index = nullptr,
+                                      const uint32_t thread_count = 1) {
+  return ClipSegments(in, count, out, index, thread_count,
+    [&r](const Segment2x8& p, Float8& t0, Float8& t1) {
+      return p.ClipToRectangle(r, t0, t1);
+    });
+}
+
+/**
+ * Clips an array of segments to a convex polygon (see ClipSegments). The
+ * segments match LineSegment2::ClipToPolygon up to rounding.
+ * @param  in            Segments to clip
+ * @param  count         Number of segments
+ * @param  poly          A counter-clockwise oriented polygon.
+ * @param  out           (OUT) Clipped segments. Must hold count segments.
+ * @param  index         (OUT) Input index of each clipped segment (may be
+ *                       null).
+ * @param  thread_count  Number of threads (0 = hardware threads)
+ * @return  Returns the number of clipped segments written.
+ */
+inline size_t ClipSegmentsToPolygon(const LineSegment2* in, const size_t count,
+                                    const std::vector<Point2>& poly, LineSegment2* out,
+                                    uint32_t* index = nullptr,
+                                    const uint32_t thread_count = 1) {
+  return ClipSegments(in, count, out, index, thread_count,
+    [&poly](const Segment2x8& p, Float8& t0, Float8& t1) {
+      return p.ClipToPolygon(poly, t0, t1);
+    });
+}
+
 #endif
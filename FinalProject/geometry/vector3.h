@@ -25,7 +25,7 @@ struct Vector3 {
   /**
    * Default constructor
    */
-  Vector3() 
+  constexpr Vector3() 
     : x(0.0f), 
       y(0.0f), 
       z(0.0f) {
@@ -36,7 +36,7 @@ struct Vector3 {
    * origin to the point.
    * @param   p  Point.
    */
-  Vector3(const Point3& p) 
+  constexpr Vector3(const Point3& p) 
     : x(p.x), 
       y(p.y), 
       z(p.z) {
@@ -48,7 +48,7 @@ struct Vector3 {
    * @param   iy   y component of the vector.
    * @param   iz   z component of the vector.     
    */
-  Vector3(const float ix, const float iy, const float iz)
+  constexpr Vector3(const float ix, const float iy, const float iz)
     : x(ix), 
       y(iy), 
       z(iz) {
@@ -59,7 +59,7 @@ struct Vector3 {
    * @param   from  Point at origin of the vector.
    * @param   to    Point at end of vector
    */
-  Vector3(const Point3& from, const Point3& to)  
+  constexpr Vector3(const Point3& from, const Point3& to)  
     : x(to.x - from.x), 
       y(to.y - from.y), 
       z(to.z - from.z) {
@@ -69,7 +69,7 @@ struct Vector3 {
    * Copy constructor.
    * @param   w  Vector to copy to the new vector.
    */
-  Vector3(const Vector3& w) 
+  constexpr Vector3(const Vector3& w) 
     : x(w.x), 
       y(w.y), 
       z(w.z) { 
@@ -80,7 +80,7 @@ struct Vector3 {
    * @param   w  Vector to copy to the current vector.
    * @return  Returns the address of the current vector.
    */
-  Vector3& operator = (const Vector3& w) {
+  constexpr Vector3& operator = (const Vector3& w) {
     x = w.x;
     y = w.y;
     z = w.z;
@@ -93,7 +93,7 @@ struct Vector3 {
    * @param   iy   y component of the vector.
    * @param   iz   z component of the vector.
    */
-  void Set(const float ix, const float iy, const float iz) {
+  constexpr void Set(const float ix, const float iy, const float iz) {
     x = ix;
     y = iy; 
     z = iz; 
@@ -104,7 +104,7 @@ struct Vector3 {
    * vector from the origin to the point.
    * @param   p  Point.
    */
-  void Set(const Point3& p) {
+  constexpr void Set(const Point3& p) {
     x = p.x;
     y = p.y;
     z = p.z;
@@ -115,7 +115,7 @@ struct Vector3 {
    * @param   from  Point at origin of the vector.
    * @param   to    Point at end of vector
    */
-  void Set(const Point3& from, const Point3& to) {
+  constexpr void Set(const Point3& from, const Point3& to) {
     x = to.x - from.x;
     y = to.y - from.y;
     z = to.z - from.z;
@@ -127,7 +127,7 @@ struct Vector3 {
    * @param   w  Vector to add to the current vector.
    * @return   Returns the resulting vector.
    */
-  Vector3 operator + (const Vector3& w) const {
+  constexpr Vector3 operator + (const Vector3& w) const {
     return Vector3(x + w.x, y + w.y, z + w.z);
   }
 
@@ -136,7 +136,7 @@ struct Vector3 {
    * @param   w  Vector to add to the current vector.
    * @return  Returns the address of the current vector.
    */
-  Vector3& operator += (const Vector3& w) {
+  constexpr Vector3& operator += (const Vector3& w) {
     x += w.x;
     y += w.y;
     z += w.z;
@@ -149,7 +149,7 @@ struct Vector3 {
    * @param   w  Vector to subtract from the current vector.
    * @return   Returns the resulting vector.
    */
-  Vector3 operator - (const Vector3& w) const {
+  constexpr Vector3 operator - (const Vector3& w) const {
     return Vector3(x - w.x, y - w.y, z - w.z);
   }
 
@@ -158,7 +158,7 @@ struct Vector3 {
    * @param   w  Vector to subtract from the current vector.
    * @return  Returns the address of the current vector.
    */
-  Vector3& operator -= (const Vector3& w) {
+  constexpr Vector3& operator -= (const Vector3& w) {
     x -= w.x;
     y -= w.y;
     z -= w.z;
@@ -171,7 +171,7 @@ struct Vector3 {
    * @param   scalar   Scalar to muliply the vector with.
    * @return  Returns the resulting vector
    */
-  Vector3 operator * (const float scalar) const {
+  constexpr Vector3 operator * (const float scalar) const {
 		return Vector3(x * scalar, y * scalar, z * scalar);
 	}
 
@@ -180,7 +180,7 @@ struct Vector3 {
    * @param   scalar   Scalar to muliply the vector with.
    * @return  Returns the address of the current vector.
    */
-  Vector3& operator *= (const float scalar) {
+  constexpr Vector3& operator *= (const float scalar) {
     x *= scalar;
     y *= scalar;
     z *= scalar;
@@ -193,7 +193,7 @@ struct Vector3 {
    * @return  Returns true if vector w equals the current vector,
    *          false otherwise.
    */
-  bool operator == (const Vector3& w) const {
+  constexpr bool operator == (const Vector3& w) const {
     return (x == w.x && y == w.y && z == w.z);
   }
 
@@ -203,7 +203,7 @@ struct Vector3 {
    * @param   w  Vector
    * @return  Returns the dot product (a scalar).
    */
-  float Dot(const Vector3& w) const {
+  constexpr float Dot(const Vector3& w) const {
     return (x * w.x + y * w.y + z * w.z);
   }
 
@@ -212,7 +212,7 @@ struct Vector3 {
    * @param   w  Vector to take the cross product with (current X w)
    * @return  Returns the resulting vector.
    */
-  Vector3 Cross(const Vector3& w) const {
+  constexpr Vector3 Cross(const Vector3& w) const {
     return Vector3(y * w.z - z * w.y,
                    z * w.x - x * w.z,
                    x * w.y - y * w.x);
@@ -231,7 +231,7 @@ struct Vector3 {
    * (Useful when absolute distance is not required)
    * @return  Returns the length squared of the vector.
    */
-	float NormSquared() const {
+	constexpr float NormSquared() const {
     return (Dot(*this));
 	}
 
@@ -251,13 +251,29 @@ struct Vector3 {
     return *this;
 	}
 
+	/**
+   * Normalizes the vector using the approximate 1/sqrt (FastRsqrt,
+   * relative error below 5e-7). Use where many vectors are normalized.
+   * @return  Returns the address of the current vector.
+   */
+	Vector3& FastNormalize() {
+    float n2 = NormSquared();
+    if (n2 > kEpsilon * kEpsilon) {
+      float inv = FastRsqrt(n2);
+      x *= inv;
+      y *= inv;
+      z *= inv;
+    }
+    return *this;
+	}
+
 	/**
    * Calculates the component of the current vector along the 
    * specified vector
    * @param   w  Vector to determine component along.
    * @return  Returns the component of the current vector along w.
    */
-	float Component(const Vector3& w) const {
+	constexpr float Component(const Vector3& w) const {
     float n = w.Dot(w);
     return (n != 0.0f) ? (Dot(w) / n) : 0.0f;
 	}
@@ -268,7 +284,7 @@ struct Vector3 {
    * @param   w  Vector to determine projection along.
    * @return  Returns the new vector.
    */
-	Vector3 Projection(const Vector3& w) const {
+	constexpr Vector3 Projection(const Vector3& w) const {
     return w * Component(w);
 	}
 
@@ -290,7 +306,7 @@ struct Vector3 {
    * @param   normal   unit length normal to the plane where reflection occurs
    * @return  Returns the reflected vector
    */
-  Vector3 Reflect(const Vector3& normal) const {
+  constexpr Vector3 Reflect(const Vector3& normal) const {
     Vector3 d = *this;
     return (d - (normal * (2.0f * (d.Dot(normal)))));
   }
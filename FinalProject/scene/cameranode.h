@@ -40,26 +40,47 @@ public:
     v = Vector3(0.0f, 1.0f, 0.0f);
   }
 
+  // Camera state is set per frame by Draw, so a render list draws this
+  // node and its subtree with Draw. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
   /**
    * Draw the scene node and its children. The base class just draws the
    * children. Derived classes can use this (SceneNode::Draw()) to draw
    * all children without having to duplicate this code.
    */
   void Draw(SceneState& scene_state) {
-    // Copy the current composite projection and viewing matrix to the scene state
+    // Copy the current composite projection and viewing matrix and the
+    // view frustum to the scene state
     scene_state.pv = projection * view;
+    scene_state.frustum = frustum;
+
+    if (scene_state.UsesUniformBlocks()) {
+      // Camera part of the frame block, and a draw block with no modeling
+      // transform for children drawn without a TransformNode
+      FrameUniforms& f = scene_state.frame_uniforms;
+      memcpy(f.viewMatrix, view.Get(), sizeof(f.viewMatrix));
+      memcpy(f.projectionMatrix, projection.Get(), sizeof(f.projectionMatrix));
+      f.cameraPosition = vrp;
+      scene_state.UploadFrameUniforms();
+      Matrix4x4 identity;
+      scene_state.UploadDrawUniforms(identity, identity, scene_state.pv, 1.0f);
+      SceneNode::Draw(scene_state);
+      return;
+    }
 
     // Set the shader PVM matrix - this will allow drawing children without a TransformNode
-    glUniformMatrix4fv(scene_state.pvm_loc, 1, GL_FALSE, scene_state.pv.Get());
+    GLStateCache& gl = GLStateCache::Get();
+    gl.UniformMatrix4fv(scene_state.pvm_loc, scene_state.pv.Get());
 
 	// Set the projection matrix
-	glUniformMatrix4fv(scene_state.projectmatrix_loc, 1, GL_FALSE, projection.Get());
+	gl.UniformMatrix4fv(scene_state.projectmatrix_loc, projection.Get());
 
 	// Set the view matrix
-	glUniformMatrix4fv(scene_state.viewmatrix_loc, 1, GL_FALSE, view.Get());
+	gl.UniformMatrix4fv(scene_state.viewmatrix_loc, view.Get());
 
     // Set the camera position
-    glUniform3fv(scene_state.cameraposition_loc, 1, &vrp.x);
+    gl.Uniform3fv(scene_state.cameraposition_loc, &vrp.x);
  
     // Draw children
     SceneNode::Draw(scene_state);
@@ -261,6 +282,15 @@ public:
     return view;
   }
 
+  /**
+   * Gets the view frustum in world coordinates. The planes are updated
+   * whenever the view or the projection changes.
+   * @return  Returns the view frustum.
+   */
+  const Frustum& GetFrustum() const {
+    return frustum;
+  }
+
   /**
    * Sets a symmetric perspective projection
    * @param  fv  Field of view angle y (degrees)
@@ -324,6 +354,7 @@ private:
   // Matrices
   Matrix4x4 view;	      // Viewing matrix
   Matrix4x4 projection; // Projection matrix
+  Frustum   frustum;    // View frustum (world coordinates)
 
   // Sets the view axes
   void LookAt() {
@@ -367,6 +398,7 @@ private:
     projection.m31() = 0.0f;
     projection.m32() = -1.0f;
     projection.m33() = 0.0f;
+    UpdateFrustum();
   }
 
   // Create viewing transformation matrix by composing the translation 
@@ -392,6 +424,12 @@ private:
     view.m31() = 0.0f;
     view.m32() = 0.0f;
     view.m33() = 1.0f;
+    UpdateFrustum();
+  }
+
+  // Extracts the frustum planes from the current projection and view
+  void UpdateFrustum() {
+    frustum.Set(projection * view);
   }
 };
 
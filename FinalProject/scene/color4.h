@@ -95,6 +95,15 @@ struct Color4 {
     return *this;
   }
 
+  /**
+   * Equality operator.
+   * @param  c  Color to compare with.
+   * @return  Returns true if all 4 components are equal.
+   */
+  bool operator == (const Color4& c) const {
+    return r == c.r && g == c.g && b == c.b && a == c.a;
+  }
+
   /**
    *	Set the color to the specified RGB values.
 	 * @param	ir		Red intensity
@@ -40,7 +40,7 @@ public:
     nrows = nstacks + 1;
     ncols = nsides + 1;
 
-    // Set a rotation matrix for the normals
+    // Set a rotation matrix for the sides
     Matrix4x4 m;
     m.RotateZ(360.0f / static_cast<float>(nsides));
 
@@ -50,34 +50,27 @@ public:
     Vector3 n(1.0f, 0.0f, (bottom_radius - top_radius));
     n.Normalize();
 
-    // Create a vertex list. We change radius linearly from the top
-    // radius to bottom radius
-    uint32_t i, j;
+    // Create the side at theta = 0. We change radius linearly from the top
+    // radius to bottom radius. Iterate from top to bottom so we create ccw
+    // triangles
+    uint32_t j;
     float z, r;
     float dz = 1.0f / nstacks;
     float dr = (bottom_radius - top_radius) / nstacks;
-    float theta = 0.0f;
-    float dtheta = (2.0f * kPi) / static_cast<float>(nsides);
-    float cosTheta, sinTheta;
     VertexAndNormal vtx;
-    for (i = 0; i < nsides; i++, theta += dtheta) {
-      // Compute sin,cos to use in the loop below
-      cosTheta = cosf(theta);
-      sinTheta = sinf(theta);
-
-      // Set the normal for this side
-      vtx.normal = n;
-
-      // Form vertices along the side for this angle increment
-      // Iterate from top to bottom so we create ccw triangles
-      for (j = 0, z = 0.5f, r = top_radius; j <= nstacks; 
-                     j++, z -= dz, r += dr) {
-        vtx.vertex.Set(r * cosTheta, r * sinTheta, z);
-        vertices.push_back(vtx);
-      }
+    vtx.normal = n;
+    for (j = 0, z = 0.5f, r = top_radius; j <= nstacks; 
+                   j++, z -= dz, r += dr) {
+      vtx.vertex.Set(r, 0.0f, z);
+      vertices.push_back(vtx);
+    }
 
-      // Rotate the normal
-      n = m * n;
+    // Each further side is the prior side rotated as a batch (vertices
+    // and normals)
+    vertices.reserve(nrows * ncols);
+    vertices.resize(nrows * nsides);
+    for (uint32_t i = 1; i < nsides; i++) {
+      m.TransformVertices(&vertices[(i - 1) * nrows], &vertices[i * nrows], nrows);
     }
 
     // Copy the first column of vertices
@@ -129,7 +122,7 @@ public:
     nrows = nstacks + 1;
     ncols = nsides + 1;
 
-    // Set a rotation matrix for the normals
+    // Set a rotation matrix for the sides
     Matrix4x4 m;
     m.RotateZ(360.0f / static_cast<float>(nsides));
 
@@ -139,39 +132,37 @@ public:
     Vector3 n(1.0f, 0.0f, (bottom_radius - top_radius));
     n.Normalize();
 
-    // Create a vertex list. We change radius linearly from the top
-    // radius to bottom radius
-    uint32_t i, j;
+    // Create the side at theta = 0 (texture s = 0). We change radius
+    // linearly from the top radius to bottom radius. Iterate from top to
+    // bottom so we create ccw triangles
+    uint32_t j;
     float s, t;
     float z, r;
     float dz = 1.0f / nstacks;
     float dr = (bottom_radius - top_radius) / nstacks;
-    float theta = 0.0f;
-    float dtheta = (2.0f * kPi) / static_cast<float>(nsides);
-    float cosTheta, sinTheta;
     float ds = 1.0f / static_cast<float>(nsides);
     float dt = 1.0f / static_cast<float>(nstacks);
     PNTVertex vtx;
-    for (i = 0, s = 0.0f; i < nsides; i++, theta += dtheta, s += ds) {
-      // Compute sin,cos to use in the loop below
-      cosTheta = cosf(theta);
-      sinTheta = sinf(theta);
-
-      // Set the normal and texture s for this side
-      vtx.s = s;
-      vtx.normal = n;
-
-      // Form vertices along the side for this angle increment
-      // Iterate from top to bottom so we create ccw triangles
-      for (j = 0, z = 0.5f, t = 1.0f, r = top_radius; j <= nstacks;
-        j++, z -= dz, r += dr, t -= dt) {
-        vtx.vertex.Set(r * cosTheta, r * sinTheta, z);
-        vtx.t = t;
-        vertices.push_back(vtx);
-      }
+    vtx.s = 0.0f;
+    vtx.normal = n;
+    for (j = 0, z = 0.5f, t = 1.0f, r = top_radius; j <= nstacks;
+      j++, z -= dz, r += dr, t -= dt) {
+      vtx.vertex.Set(r, 0.0f, z);
+      vtx.t = t;
+      vertices.push_back(vtx);
+    }
 
-      // Rotate the normal
-      n = m * n;
+    // Each further side is the prior side rotated as a batch (t is
+    // copied), then s is set for the side
+    vertices.reserve(nrows * ncols);
+    vertices.resize(nrows * nsides);
+    s = ds;
+    for (uint32_t i = 1; i < nsides; i++, s += ds) {
+      PNTVertex* column = &vertices[i * nrows];
+      m.TransformVertices(&vertices[(i - 1) * nrows], column, nrows);
+      for (j = 0; j < nrows; j++) {
+        column[j].s = s;
+      }
     }
 
     // Copy the first column of vertices
@@ -0,0 +1,207 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:	David W. Nesbitt
+//	File:    framearena.h
+//	Purpose:	Per-frame linear memory arena for scene traversal temporaries
+//          and a heap allocation counter for finding per-frame allocations.
+//
+//============================================================================
+
+#ifndef __FRAMEARENA_H
+#define __FRAMEARENA_H
+
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+/**
+ * Linear (bump pointer) arena for memory that lives for one frame.
+ * Allocation is a pointer increment and nothing is freed individually:
+ * Reset at the start of each frame releases everything at once. If a
+ * frame needs more than the capacity the extra requests go to the heap,
+ * and the next Reset grows the arena to the frame's high water mark, so
+ * a steady state frame makes no heap allocations.
+ */
+class FrameArena {
+public:
+  /**
+   * Constructor.
+   * @param  capacity  Initial size of the arena in bytes.
+   */
+  explicit FrameArena(const size_t capacity = 64 * 1024)
+    : block(nullptr),
+      capacity(0),
+      used(0),
+      high_water(0),
+      overflow(nullptr) {
+    Grow(capacity);
+  }
+
+  /**
+   * Destructor. Frees the arena.
+   */
+  ~FrameArena() {
+    FreeOverflow();
+    ::operator delete(block);
+  }
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator = (const FrameArena&) = delete;
+
+  /**
+   * Allocates memory that stays valid until the next Reset.
+   * @param  bytes      Number of bytes
+   * @param  alignment  Alignment (power of 2)
+   * @return  Returns the memory.
+   */
+  void* Allocate(const size_t bytes, const size_t alignment = 16) {
+    // Offset of the next aligned address in the block. Once the block has
+    // overflowed used keeps counting so the high water mark is the total
+    // the frame needed.
+    uintptr_t base = reinterpret_cast<uintptr_t>(block);
+    size_t offset = ((base + used + alignment - 1) & ~(alignment - 1)) - base;
+    used = offset + bytes;
+    high_water = (used > high_water) ? used : high_water;
+    if (used <= capacity)
+      return block + offset;
+
+    // Out of space: take the request from the heap for this frame
+    OverflowBlock* b = static_cast<OverflowBlock*>(
+                  ::operator new(sizeof(OverflowBlock) + bytes + alignment));
+    b->next = overflow;
+    overflow = b;
+    uintptr_t p = reinterpret_cast<uintptr_t>(b + 1);
+    return reinterpret_cast<void*>((p + alignment - 1) & ~(alignment - 1));
+  }
+
+  /**
+   * Allocates an uninitialized array that stays valid until the next
+   * Reset. Elements are never destroyed, so T must be trivially
+   * destructible.
+   * @param  count  Number of elements
+   * @return  Returns the first element.
+   */
+  template <typename T>
+  T* Allocate(const size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "FrameArena does not run destructors");
+    return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+  }
+
+  /**
+   * Releases all memory allocated since the last Reset. Call at the start
+   * of each frame. Grows the arena if the last frame overflowed it.
+   */
+  void Reset() {
+    if (overflow != nullptr) {
+      FreeOverflow();
+      Grow(high_water + high_water / 2);
+    }
+    used = 0;
+  }
+
+  /**
+   * Gets the number of bytes allocated since the last Reset (including
+   * alignment padding and any requests that overflowed the arena).
+   * @return  Returns the bytes used.
+   */
+  size_t GetUsed() const {
+    return used;
+  }
+
+  /**
+   * Gets the size of the arena.
+   * @return  Returns the capacity in bytes.
+   */
+  size_t GetCapacity() const {
+    return capacity;
+  }
+
+  /**
+   * Gets the most memory any frame has needed.
+   * @return  Returns the high water mark in bytes.
+   */
+  size_t GetHighWater() const {
+    return high_water;
+  }
+
+private:
+  // Header of a heap block used when the arena is full
+  struct OverflowBlock {
+    OverflowBlock* next;
+  };
+
+  char*          block;
+  size_t         capacity;
+  size_t         used;
+  size_t         high_water;
+  OverflowBlock* overflow;
+
+  void Grow(const size_t new_capacity) {
+    // Allocated with operator new so AllocationCounter sees it
+    ::operator delete(block);
+    block = nullptr;
+    block = static_cast<char*>(::operator new(new_capacity));
+    capacity = new_capacity;
+  }
+
+  void FreeOverflow() {
+    while (overflow != nullptr) {
+      OverflowBlock* next = overflow->next;
+      ::operator delete(overflow);
+      overflow = next;
+    }
+  }
+};
+
+/**
+ * Counts heap allocations (debug builds). The counts are only updated if
+ * the application replaces the global operator new with one that calls
+ * AllocationCounter::Add (FinalProject does when COUNT_ALLOCATIONS is
+ * defined). Call EndFrame once per frame to get the allocations made
+ * during the frame.
+ */
+struct AllocationCounter {
+  /**
+   * Records one allocation. Safe to call from any thread.
+   * @param  bytes  Size of the allocation
+   */
+  static void Add(const size_t bytes) {
+    Count().fetch_add(1, std::memory_order_relaxed);
+    Bytes().fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  /**
+   * Ends a frame.
+   * @param  bytes  (OUT) Bytes allocated during the frame (optional)
+   * @return  Returns the number of allocations made since the last call.
+   */
+  static size_t EndFrame(size_t* bytes = nullptr) {
+    static size_t last_count = 0;
+    static size_t last_bytes = 0;
+    size_t count = Count().load(std::memory_order_relaxed);
+    size_t total = Bytes().load(std::memory_order_relaxed);
+    size_t n = count - last_count;
+    if (bytes != nullptr)
+      *bytes = total - last_bytes;
+    last_count = count;
+    last_bytes = total;
+    return n;
+  }
+
+  // Running totals
+  static std::atomic<size_t>& Count() {
+    static std::atomic<size_t> count(0);
+    return count;
+  }
+  static std::atomic<size_t>& Bytes() {
+    static std::atomic<size_t> bytes(0);
+    return bytes;
+  }
+};
+
+#endif
@@ -30,12 +30,56 @@ public:
    */
   virtual ~GeometryNode() { }
 
+  /**
+   * Geometry does not change in Update, so it may be updated in
+   * parallel.
+   * @return  Returns true.
+   */
+  virtual bool IsUpdateThreadSafe() const {
+    return true;
+  }
+
   /**
    * Draw this geometry node. Geometry nodes are leaf nodes and have no children.
    * @param  sceneState  Current scene state
    */
   virtual void Draw(SceneState& sceneState) {
   }
+
+  // Geometry nodes that do not override this are drawn by a render list
+  // with Draw. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
+  /**
+   * Gets the bounding box of the geometry (in modeling coordinates).
+   * @return  Returns the bounding box. Empty if not computed.
+   */
+  const AABB& GetBoundingBox() const {
+    return bounding_box;
+  }
+
+  /**
+   * Gets the bounding sphere of the geometry (in modeling coordinates).
+   * @return  Returns the bounding sphere.
+   */
+  const BoundingSphere& GetBoundingSphere() const {
+    return bounding_sphere;
+  }
+
+protected:
+  AABB           bounding_box;      // Bounds, set when the geometry is
+  BoundingSphere bounding_sphere;   // constructed
+
+  /**
+   * Computes the bounds from a strided array of positions.
+   * @param  xyz     Pointer to the x coordinate of the first position.
+   * @param  stride  Distance in bytes between positions.
+   * @param  count   Number of positions.
+   */
+  void ComputeBounds(const float* xyz, const size_t stride, const size_t count) {
+    bounding_box.Create(xyz, stride, count);
+    bounding_sphere.Create(xyz, stride, count);
+  }
 };
 
 #endif
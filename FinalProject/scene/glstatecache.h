@@ -0,0 +1,354 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:	David W. Nesbitt
+//	File:    glstatecache.h
+//	Purpose:	Shadow copy of OpenGL state used to skip calls that would not
+//          change it.
+//
+//============================================================================
+
+#ifndef __GLSTATECACHE_H
+#define __GLSTATECACHE_H
+
+#include <string.h>
+#include <vector>
+
+/**
+ * Counts of the calls made through a GLStateCache.
+ */
+struct GLStateStats {
+  uint32_t issued;    // Calls passed on to OpenGL
+  uint32_t elided;    // Calls skipped because the state was already set
+};
+
+/**
+ * OpenGL state cache. Keeps a copy of the state the scene nodes set -
+ * the program, vertex array object, the 2D texture bound to each texture
+ * unit, blend, cull face and depth test state, and the uniform values of
+ * each program - and skips calls that would set a value already in
+ * effect.
+ * The copy is only right if all changes to that state go through the
+ * cache, so it is off by default and every call is passed on. An
+ * application that makes its state changes through the cache turns it
+ * on with SetEnabled. Invalidate forgets the copy (after OpenGL state
+ * was changed directly).
+ * With the cache on, ReleaseVertexArray and ReleaseTexture leave the
+ * object bound (the next bind replaces it) instead of binding 0. Vertex
+ * array and texture objects must be deleted with DeleteVertexArray and
+ * DeleteTexture, so a new object given the same name is bound.
+ * There is one cache for the OpenGL context, returned by Get.
+ */
+class GLStateCache {
+public:
+  /**
+   * Gets the cache of the current OpenGL context.
+   * @return  Returns the cache.
+   */
+  static GLStateCache& Get() {
+    static GLStateCache cache;
+    return cache;
+  }
+
+  /**
+   * Turns the cache on or off. Turning it on starts with nothing known.
+   * @param  enable  True to skip redundant calls
+   */
+  void SetEnabled(const bool enable) {
+    enabled = enable;
+    Invalidate();
+  }
+
+  /**
+   * Checks if the cache is on.
+   * @return  Returns true if redundant calls are skipped.
+   */
+  bool IsEnabled() const {
+    return enabled;
+  }
+
+  /**
+   * Forgets all cached state, so the next call of each kind is passed on.
+   */
+  void Invalidate() {
+    program = kUnknown;
+    vertex_array = kUnknown;
+    active_unit = kUnknown;
+    for (uint32_t i = 0; i < kMaxTextureUnits; i++)
+      textures[i] = kUnknown;
+    for (uint32_t i = 0; i < kCapabilityCount; i++)
+      capabilities[i] = kUnknown;
+    blend_src = kUnknown;
+    blend_dst = kUnknown;
+    depth_mask = kUnknown;
+    current_uniforms = kNoProgram;
+    generation++;
+  }
+
+  /**
+   * Ends a frame.
+   * @return  Returns the calls made through the cache since the last call.
+   */
+  GLStateStats EndFrame() {
+    GLStateStats frame = stats;
+    stats = GLStateStats();
+    return frame;
+  }
+
+  /**
+   * Makes a program current (glUseProgram).
+   * @param  p  Program object
+   */
+  void UseProgram(const GLuint p) {
+    if (Same(program, p))
+      return;
+    glUseProgram(p);
+
+    // Find the uniform values of the program
+    current_uniforms = kNoProgram;
+    if (enabled) {
+      for (size_t i = 0; i < programs.size() && current_uniforms == kNoProgram; i++) {
+        if (programs[i].program == p)
+          current_uniforms = i;
+      }
+      if (current_uniforms == kNoProgram) {
+        programs.push_back(ProgramUniforms());
+        programs.back().program = p;
+        current_uniforms = programs.size() - 1;
+      }
+    }
+  }
+
+  /**
+   * Binds a vertex array object (glBindVertexArray).
+   * @param  vao  Vertex array object (0 to unbind)
+   */
+  void BindVertexArray(const GLuint vao) {
+    if (!Same(vertex_array, vao))
+      glBindVertexArray(vao);
+  }
+
+  /**
+   * Ends use of the bound vertex array object after drawing. With the
+   * cache off it is unbound. Code that binds GL_ELEMENT_ARRAY_BUFFER or
+   * changes vertex attributes outside of a vertex array object it owns
+   * must call BindVertexArray(0) first.
+   */
+  void ReleaseVertexArray() {
+    if (!enabled)
+      BindVertexArray(0);
+  }
+
+  /**
+   * Binds a 2D texture to a texture unit, making it the active unit if
+   * the texture changes (glActiveTexture, glBindTexture).
+   * @param  unit     Texture unit (0 for GL_TEXTURE0)
+   * @param  texture  Texture object (0 to unbind)
+   */
+  void BindTexture(const uint32_t unit, const GLuint texture) {
+    if (unit >= kMaxTextureUnits)
+      stats.issued++;
+    else if (Same(textures[unit], texture))
+      return;
+    if (!Same(active_unit, unit))
+      glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+  }
+
+  /**
+   * Ends use of the texture bound to a unit. With the cache off it is
+   * unbound.
+   * @param  unit  Texture unit
+   */
+  void ReleaseTexture(const uint32_t unit) {
+    if (!enabled)
+      BindTexture(unit, 0);
+  }
+
+  /**
+   * Deletes a vertex array object (glDeleteVertexArrays). OpenGL binds 0
+   * in place of a deleted object that is bound, and so does the cache.
+   * @param  vao  Vertex array object
+   */
+  void DeleteVertexArray(const GLuint vao) {
+    glDeleteVertexArrays(1, &vao);
+    if (vertex_array == vao)
+      vertex_array = 0;
+  }
+
+  /**
+   * Deletes a texture object (glDeleteTextures). OpenGL binds 0 in its
+   * place on each texture unit it is bound to, and so does the cache.
+   * @param  texture  Texture object
+   */
+  void DeleteTexture(const GLuint texture) {
+    glDeleteTextures(1, &texture);
+    for (uint32_t i = 0; i < kMaxTextureUnits; i++) {
+      if (textures[i] == texture)
+        textures[i] = 0;
+    }
+  }
+
+  /**
+   * Enables an OpenGL capability (glEnable). GL_BLEND, GL_CULL_FACE and
+   * GL_DEPTH_TEST are cached; others are always passed on.
+   * @param  cap  Capability
+   */
+  void Enable(const GLenum cap) {
+    int i = CapabilityIndex(cap);
+    if (i < 0)
+      stats.issued++;
+    else if (Same(capabilities[i], 1))
+      return;
+    glEnable(cap);
+  }
+
+  /**
+   * Disables an OpenGL capability (glDisable).
+   * @param  cap  Capability
+   */
+  void Disable(const GLenum cap) {
+    int i = CapabilityIndex(cap);
+    if (i < 0)
+      stats.issued++;
+    else if (Same(capabilities[i], 0))
+      return;
+    glDisable(cap);
+  }
+
+  /**
+   * Sets the blend function (glBlendFunc).
+   * @param  src  Source factor
+   * @param  dst  Destination factor
+   */
+  void BlendFunc(const GLenum src, const GLenum dst) {
+    if (enabled && blend_src == src && blend_dst == dst) {
+      stats.elided++;
+      return;
+    }
+    stats.issued++;
+    blend_src = src;
+    blend_dst = dst;
+    glBlendFunc(src, dst);
+  }
+
+  /**
+   * Enables or disables writing to the depth buffer (glDepthMask).
+   * @param  flag  GL_TRUE to write depth
+   */
+  void DepthMask(const GLboolean flag) {
+    if (!Same(depth_mask, flag))
+      glDepthMask(flag);
+  }
+
+  /**
+   * Sets uniforms of the current program. Values are cached per program,
+   * so only when the program was made current with UseProgram.
+   * @param  loc  Uniform location
+   */
+  void Uniform1i(const GLint loc, const GLint v) {
+    if (!SameUniform(loc, &v, sizeof(v)))
+      glUniform1i(loc, v);
+  }
+  void Uniform1f(const GLint loc, const GLfloat v) {
+    if (!SameUniform(loc, &v, sizeof(v)))
+      glUniform1f(loc, v);
+  }
+  void Uniform3fv(const GLint loc, const GLfloat* v) {
+    if (!SameUniform(loc, v, 3 * sizeof(GLfloat)))
+      glUniform3fv(loc, 1, v);
+  }
+  void Uniform4fv(const GLint loc, const GLfloat* v) {
+    if (!SameUniform(loc, v, 4 * sizeof(GLfloat)))
+      glUniform4fv(loc, 1, v);
+  }
+  void UniformMatrix4fv(const GLint loc, const GLfloat* m) {
+    if (!SameUniform(loc, m, 16 * sizeof(GLfloat)))
+      glUniformMatrix4fv(loc, 1, GL_FALSE, m);
+  }
+
+private:
+  static const uint32_t kUnknown = 0xFFFFFFFF;
+  static const size_t   kNoProgram = ~(size_t)0;
+  static const uint32_t kMaxTextureUnits = 8;
+  static const uint32_t kCapabilityCount = 3;
+
+  // A uniform value, current if set in this generation
+  struct UniformValue {
+    uint32_t generation;
+    uint32_t bytes;
+    GLfloat  value[16];
+  };
+
+  // The uniform values of a program, indexed by location
+  struct ProgramUniforms {
+    GLuint                    program;
+    std::vector<UniformValue> values;
+  };
+
+  GLStateCache()
+    : enabled(false),
+      generation(0) {
+    stats = GLStateStats();
+    Invalidate();
+  }
+
+  bool         enabled;
+  GLStateStats stats;
+  uint32_t     program;
+  uint32_t     vertex_array;
+  uint32_t     active_unit;
+  uint32_t     textures[kMaxTextureUnits];
+  uint32_t     capabilities[kCapabilityCount];   // 0, 1 or unknown
+  uint32_t     blend_src;
+  uint32_t     blend_dst;
+  uint32_t     depth_mask;
+  uint32_t     generation;         // Uniform values of older ones are unknown
+  size_t       current_uniforms;   // Index in programs of the current program
+  std::vector<ProgramUniforms> programs;
+
+  // Checks a cached value against a new one, and updates it and the
+  // counts. Returns true if the call can be skipped.
+  bool Same(uint32_t& cached, const uint32_t value) {
+    if (enabled && cached == value) {
+      stats.elided++;
+      return true;
+    }
+    stats.issued++;
+    cached = value;
+    return false;
+  }
+
+  bool SameUniform(const GLint loc, const void* value, const uint32_t bytes) {
+    if (!enabled || loc < 0 || current_uniforms == kNoProgram) {
+      stats.issued++;
+      return false;
+    }
+    std::vector<UniformValue>& values = programs[current_uniforms].values;
+    if ((size_t)loc >= values.size())
+      values.resize(loc + 1, UniformValue());
+    UniformValue& u = values[loc];
+    if (u.generation == generation && u.bytes == bytes && memcmp(u.value, value, bytes) == 0) {
+      stats.elided++;
+      return true;
+    }
+    stats.issued++;
+    u.generation = generation;
+    u.bytes = bytes;
+    memcpy(u.value, value, bytes);
+    return false;
+  }
+
+  static int CapabilityIndex(const GLenum cap) {
+    switch (cap) {
+      case GL_BLEND:      return 0;
+      case GL_CULL_FACE:  return 1;
+      case GL_DEPTH_TEST: return 2;
+      default:            return -1;
+    }
+  }
+};
+
+#endif
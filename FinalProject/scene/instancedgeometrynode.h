@@ -0,0 +1,214 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:	David W. Nesbitt
+//	File:    instancedgeometrynode.h
+//	Purpose:	Scene graph geometry node that draws many copies of one mesh
+//          with a single instanced draw call.
+//
+//============================================================================
+
+#ifndef __INSTANCEDGEOMETRYNODE_H
+#define __INSTANCEDGEOMETRYNODE_H
+
+/**
+ * Per-instance vertex data: the instance's modeling transform (3 rows)
+ * and the scale factors used by the billboard shader.
+ */
+struct InstanceData {
+  Affine3x4 transform;
+  float     scale[2];
+};
+static_assert(sizeof(InstanceData) == 64, "InstanceData is 4 rows of 16 bytes");
+
+/**
+ * Instanced geometry node. Draws a textured mesh once for each instance
+ * with one glDrawElementsInstanced call, in place of a transform node
+ * per copy. Each instance has a modeling transform (applied after the
+ * current model matrix) and billboard scale factors. These are kept in
+ * an instance vertex buffer read by the shader through attributes with
+ * a divisor of 1; the shader uses them when the enableInstancing uniform
+ * is set. The buffer is uploaded on the next Draw after any change.
+ * The mesh is held as the node's child so it stays alive, but it is not
+ * drawn on its own.
+ */
+class InstancedGeometryNode : public GeometryNode {
+public:
+  /**
+   * Constructor. Creates a vertex array object that reads the mesh's
+   * vertex and face buffers and the instance buffer.
+   * @param  mesh          Mesh to draw
+   * @param  position_loc  Location of the vertex position attribute
+   * @param  normal_loc    Location of the vertex normal attribute
+   * @param  texture_loc   Location of the vertex texture attribute
+   * @param  instance_loc  Location of the instance transform attribute
+   *                       (a mat3x4: 3 consecutive locations)
+   * @param  scale_loc     Location of the instance scale attribute
+   */
+  InstancedGeometryNode(TexturedTriSurface* mesh, const int position_loc,
+                        const int normal_loc, const int texture_loc,
+                        const int instance_loc, const int scale_loc)
+    : face_count(mesh->GetFaceCount()),
+      instance_capacity(0),
+      instances_changed(false) {
+    AddChild(mesh);
+
+    // Distance from the mesh origin to the farthest corner of its box.
+    // Instance bounds hold the mesh in any orientation, since the
+    // billboard shader turns it to face the camera.
+    const AABB& box = mesh->GetBoundingBox();
+    Vector3 v(std::max(fabsf(box.m_min.x), fabsf(box.m_max.x)),
+              std::max(fabsf(box.m_min.y), fabsf(box.m_max.y)),
+              std::max(fabsf(box.m_min.z), fabsf(box.m_max.z)));
+    mesh_radius = v.Norm();
+
+    glGenBuffers(1, &instance_vbo);
+    glGenVertexArrays(1, &vao);
+    GLStateCache::Get().BindVertexArray(vao);
+
+    // Mesh vertices
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->GetVertexBuffer());
+    glVertexAttribPointer(position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(PNTVertex), (void*)0);
+    glVertexAttribPointer(normal_loc, 3, GL_FLOAT, GL_FALSE, sizeof(PNTVertex), (void*)(sizeof(Point3)));
+    glVertexAttribPointer(texture_loc, 2, GL_FLOAT, GL_FALSE, sizeof(PNTVertex),
+      (void*)(sizeof(Point3) + sizeof(Vector3)));
+    glEnableVertexAttribArray(position_loc);
+    glEnableVertexAttribArray(normal_loc);
+    glEnableVertexAttribArray(texture_loc);
+
+    // Instance data: advance once per instance rather than per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    for (int row = 0; row < 3; row++) {
+      glVertexAttribPointer(instance_loc + row, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+        (void*)(row * 4 * sizeof(float)));
+      glEnableVertexAttribArray(instance_loc + row);
+      glVertexAttribDivisor(instance_loc + row, 1);
+    }
+    glVertexAttribPointer(scale_loc, 2, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+      (void*)sizeof(Affine3x4));
+    glEnableVertexAttribArray(scale_loc);
+    glVertexAttribDivisor(scale_loc, 1);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->GetFaceBuffer());
+    GLStateCache::Get().BindVertexArray(0);
+  }
+
+  /**
+   * Destructor.
+   */
+  virtual ~InstancedGeometryNode() {
+    glDeleteBuffers(1, &instance_vbo);
+    GLStateCache::Get().DeleteVertexArray(vao);
+  }
+
+  /**
+   * Adds an instance. The billboard scale is the length of the first
+   * column of the matrix (as TransformNode::LoadMatrix sets it).
+   * @param  m  Modeling transform (affine)
+   * @return  Returns the index of the instance.
+   */
+  size_t AddInstance(const Matrix4x4& m) {
+    float s = Vector3(m.m00(), m.m10(), m.m20()).Norm();
+    return AddInstance(m, s, s);
+  }
+
+  /**
+   * Adds an instance.
+   * @param  m       Modeling transform (affine)
+   * @param  scalex  Billboard x scale
+   * @param  scaley  Billboard y scale
+   * @return  Returns the index of the instance.
+   */
+  size_t AddInstance(const Matrix4x4& m, const float scalex, const float scaley) {
+    instances.push_back(InstanceData());
+    SetInstance(instances.size() - 1, m, scalex, scaley);
+    return instances.size() - 1;
+  }
+
+  /**
+   * Replaces the transform and scale of an instance.
+   * @param  i       Index of the instance
+   * @param  m       Modeling transform (affine)
+   * @param  scalex  Billboard x scale
+   * @param  scaley  Billboard y scale
+   */
+  void SetInstance(const size_t i, const Matrix4x4& m, const float scalex,
+                   const float scaley) {
+    InstanceData& instance = instances[i];
+    instance.transform.Set(m);
+    instance.scale[0] = scalex;
+    instance.scale[1] = scaley;
+    instances_changed = true;
+
+    // The bounds only grow. Render lists copy them when compiled, so one
+    // that has compiled this node is recompiled when they do.
+    AABB box = bounding_box;
+    BoundingSphere s = BoundingSphere(Point3(0.0f, 0.0f, 0.0f), mesh_radius).Transform(m);
+    Vector3 e(s.m_radius, s.m_radius, s.m_radius);
+    bounding_box = bounding_box.Merge(AABB(s.m_center - e, s.m_center + e));
+    if (!(bounding_box.m_min == box.m_min) || !(bounding_box.m_max == box.m_max))
+      GraphVersion()++;
+    bounding_sphere = BoundingSphere(bounding_box.GetCenter(),
+                                     bounding_box.GetHalfDiagonal().Norm());
+  }
+
+  /**
+   * Gets the number of instances.
+   * @return  Returns the instance count.
+   */
+  size_t GetInstanceCount() const {
+    return instances.size();
+  }
+
+  /**
+   * Draws all instances with one draw call.
+   * @param  scene_state  Current scene state
+   */
+  virtual void Draw(SceneState& scene_state) {
+    if (instances.empty())
+      return;
+    if (instances_changed)
+      UploadInstances();
+
+    GLStateCache& gl = GLStateCache::Get();
+    gl.Uniform1i(scene_state.enableinstancing_loc, 1);
+    gl.BindVertexArray(vao);
+    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)face_count, GL_UNSIGNED_SHORT, (void*)0,
+                            (GLsizei)instances.size());
+    gl.ReleaseVertexArray();
+    gl.Uniform1i(scene_state.enableinstancing_loc, 0);
+  }
+
+  // Adds the node to a render list, drawn with Draw and culled with the
+  // bounds of all instances. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
+protected:
+  uint32_t  face_count;
+  float     mesh_radius;
+  GLuint    vao;
+  GLuint    instance_vbo;
+  size_t    instance_capacity;    // Instances the buffer has room for
+  bool      instances_changed;
+  std::vector<InstanceData> instances;
+
+  // Copies the instances to the instance buffer, growing it if needed
+  void UploadInstances() {
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    if (instances.size() > instance_capacity) {
+      glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData),
+                   (void*)&instances[0], GL_DYNAMIC_DRAW);
+      instance_capacity = instances.size();
+    }
+    else {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData),
+                      (void*)&instances[0]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    instances_changed = false;
+  }
+};
+
+#endif
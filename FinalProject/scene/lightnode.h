@@ -133,6 +133,10 @@ public:
     atten2 = quadratic;
   }
 
+  // Lights are scoped to their subtree, so a render list draws this node
+  // and its subtree with Draw. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
 	/**
 	 * Draw. Sets the light properties if enabled. Note that only position
    * is set within the Draw method - since it needs to be transformed by
@@ -140,27 +144,34 @@ public:
    * @param  scene_state  Current scene state.
 	 */
 	void Draw(SceneState& scene_state) {
-    glUniform1i(scene_state.lights[index].enabled, static_cast<int>(enabled));
+    if (scene_state.UsesUniformBlocks()) {
+      DrawBlock(scene_state);
+      return;
+    }
+
+    GLStateCache& gl = GLStateCache::Get();
+    const LightUniforms& loc = scene_state.lights[index];
+    gl.Uniform1i(loc.enabled, static_cast<int>(enabled));
 		if (enabled){
-      glUniform1i(scene_state.lights[index].spotlight, static_cast<int>(is_spotlight));
-      glUniform4fv(scene_state.lights[index].position, 1, &position.x);
-      glUniform4fv(scene_state.lights[index].ambient, 1, &ambient.r);
-      glUniform4fv(scene_state.lights[index].diffuse, 1, &diffuse.r);
-      glUniform4fv(scene_state.lights[index].specular, 1, &specular.r);
-      glUniform1f(scene_state.lights[index].att_constant, atten0);
-      glUniform1f(scene_state.lights[index].att_linear, atten1);
-      glUniform1f(scene_state.lights[index].att_quadratic, atten2);
+      gl.Uniform1i(loc.spotlight, static_cast<int>(is_spotlight));
+      gl.Uniform4fv(loc.position, &position.x);
+      gl.Uniform4fv(loc.ambient, &ambient.r);
+      gl.Uniform4fv(loc.diffuse, &diffuse.r);
+      gl.Uniform4fv(loc.specular, &specular.r);
+      gl.Uniform1f(loc.att_constant, atten0);
+      gl.Uniform1f(loc.att_linear, atten1);
+      gl.Uniform1f(loc.att_quadratic, atten2);
       if (is_spotlight) {
         // Note we use cos of the spotlight cutoff angle so we don't have
         // to compute cos in the shader
-        glUniform1f(scene_state.lights[index].spot_cutoffcos, spot_cutoffcos);
-        glUniform3fv(scene_state.lights[index].spot_direction, 1, &spot_direction.x);
-        glUniform1f(scene_state.lights[index].spot_exponent, spot_exponent);
+        gl.Uniform1f(loc.spot_cutoffcos, spot_cutoffcos);
+        gl.Uniform3fv(loc.spot_direction, &spot_direction.x);
+        gl.Uniform1f(loc.spot_exponent, spot_exponent);
       }
 
       // Track the maximum light index that is enabled
       if (index >= (uint32_t)scene_state.max_enabled_light) {
-        glUniform1i(scene_state.lightcount_loc, index + 1);
+        gl.Uniform1i(scene_state.lightcount_loc, index + 1);
         scene_state.max_enabled_light = index;
       }
     }
@@ -169,9 +180,52 @@ public:
     SceneNode::Draw(scene_state);
 
     // To be proper we should disable this light so it does not impact any nodes that 
-    // are not descended from this node
-    glUniform1i(scene_state.lights[index].enabled, 0);
+    // are not descended from this node (the state cache skips
+    // this if the light was off)
+    gl.Uniform1i(loc.enabled, 0);
 	}
+
+protected:
+  // Draw using the frame uniform block: the light is set in the block,
+  // which is written once before and once after the children
+  void DrawBlock(SceneState& scene_state) {
+    if (index >= kMaxBlockLights) {
+      SceneNode::Draw(scene_state);
+      return;
+    }
+    FrameUniforms& f = scene_state.frame_uniforms;
+    LightBlock& light = f.lights[index];
+    light.enabled = static_cast<int32_t>(enabled);
+    if (enabled) {
+      light.spotlight = static_cast<int32_t>(is_spotlight);
+      light.position = position;
+      light.ambient = ambient;
+      light.diffuse = diffuse;
+      light.specular = specular;
+      light.constantAttenuation = atten0;
+      light.linearAttenuation = atten1;
+      light.quadraticAttenuation = atten2;
+      if (is_spotlight) {
+        light.spotCosCutoff = spot_cutoffcos;
+        light.spotDirection = spot_direction;
+        light.spotExponent = spot_exponent;
+      }
+      if (index >= (uint32_t)scene_state.max_enabled_light) {
+        f.numLights = index + 1;
+        scene_state.max_enabled_light = index;
+      }
+    }
+    scene_state.UploadFrameUniforms();
+
+    SceneNode::Draw(scene_state);
+
+    // Disable the light for nodes not descended from this node. The block
+    // is unchanged if the light was not enabled.
+    if (enabled) {
+      f.lights[index].enabled = 0;
+      scene_state.UploadFrameUniforms();
+    }
+  }
 	
 protected:
   bool     enabled;
@@ -12,8 +12,8 @@
 #ifndef __MESHTEAPOT_H__
 #define __MESHTEAPOT_H__
 
-typedef float point[3];
-static point TeapotVertexList[] = {
+// Teapot vertices. Formed at compile time.
+static constexpr Point3 TeapotVertexList[] = {
          {1.4f , 0.0f , 2.4f},
          {1.4f , -0.784f , 2.4f},
          {0.784f , -1.4f , 2.4f},
@@ -323,7 +323,7 @@ static point TeapotVertexList[] = {
 
 // 32 patches are each defined by 16 vertices, arranged in a 4 x 4 array
 // Numbering scheme for teapot has vertices labeled from 1 to 306
-static int PatchIndices[32][4][4]=  {
+static constexpr int PatchIndices[32][4][4]=  {
    { {1, 2, 3, 4}, { 5, 6, 7, 8}, {9, 10, 11, 12}, {13, 14, 15, 16}},
    {{4, 17, 18, 19}, {8, 20, 21, 22}, {12, 23, 24, 25}, {16, 26, 27, 28}},
    {{19, 29, 30, 31}, {22, 32, 33, 34}, {25, 35, 36, 37}, {28, 38, 39, 40}},
@@ -372,7 +372,7 @@ public:
   MeshTeapot(int level, const int position_loc, const int normal_loc) {
     subdivision_count = level;
 
-    // Data is 32 patches, each with a 4x4 array of point[3].
+    // Data is 32 patches, each with a 4x4 array of Point3.
     //Convert array data into Point3 array.
     int m, patch;
     Point3 data[32][4][4];
@@ -381,9 +381,7 @@ public:
         for (int k = 0; k < 4; k++) {
           // Put teapot data into single array for subdivision
           m = PatchIndices[patch][j][k];
-          data[patch][j][k].x = TeapotVertexList[m - 1][0];
-          data[patch][j][k].y = TeapotVertexList[m - 1][1];
-          data[patch][j][k].z = TeapotVertexList[m - 1][2];
+          data[patch][j][k] = TeapotVertexList[m - 1];
         }
       }
     }
@@ -69,9 +69,9 @@ public:
         glDeleteBuffers(1, &meshes[n].normal_vbo);
       if (meshes[n].texture_vbo > 0)
         glDeleteBuffers(1, &meshes[n].texture_vbo);
-      glDeleteVertexArrays(1, &meshes[n].vao);
+      GLStateCache::Get().DeleteVertexArray(meshes[n].vao);
       if (meshes[n].has_texture) {
-        glDeleteTextures(1, &meshes[n].texture_id);
+        GLStateCache::Get().DeleteTexture(meshes[n].texture_id);
       }
     }
   }
@@ -83,26 +83,41 @@ public:
   void Draw(SceneState& scene_state) {
     // Draw all meshes assigned to this node
     for (uint32_t n = 0; n < meshes.size(); ++n) {
-      if (meshes[n].has_texture) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, meshes[n].texture_id);
-        glUniform1i(scene_state.usetexture_loc, 1);   // Tell shader we are using textures
-        glUniform1i(scene_state.textureunit_loc, 0);  // Texture unit 0
-      }
-      else {
-        glUniform1i(scene_state.usetexture_loc, 0);
-      }
-      glBindVertexArray(meshes[n].vao);
+      if (meshes[n].has_texture)
+        GLStateCache::Get().BindTexture(0, meshes[n].texture_id);
+      scene_state.SetUseTexture(meshes[n].has_texture);
+      GLStateCache::Get().BindVertexArray(meshes[n].vao);
       glDrawElements(GL_TRIANGLES, meshes[n].numFaces * 3, GL_UNSIGNED_INT, 0);
     }
   }
 
+  // Adds a draw record for each mesh. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
+  /**
+   * Gets the bounding box of all meshes (in modeling coordinates).
+   * @return  Returns the bounding box.
+   */
+  const AABB& GetBoundingBox() const {
+    return bounding_box;
+  }
+
+  /**
+   * Gets the bounding sphere of all meshes (in modeling coordinates).
+   * @return  Returns the bounding sphere.
+   */
+  const BoundingSphere& GetBoundingSphere() const {
+    return bounding_sphere;
+  }
+
 protected:
   std::vector<ModelMesh> meshes;
   const aiScene* scene;
   Assimp::Importer importer;
   std::string model_filename;
   std::string model_directory;
+  AABB           bounding_box;
+  BoundingSphere bounding_sphere;
 
   /**
   * Import the model into a Assimp scene
@@ -167,13 +182,24 @@ protected:
 
       // Generate Vertex Array Object for mesh
       glGenVertexArrays(1, &(model_mesh.vao));
-      glBindVertexArray(model_mesh.vao);
+      GLStateCache::Get().BindVertexArray(model_mesh.vao);
 
       // Buffer for faces
       glGenBuffers(1, &buffer);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
       glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint32_t) * mesh->mNumFaces * 3, faceArray, GL_STATIC_DRAW);
 
+      // Bounds: merge the box and sphere of each mesh
+      if (mesh->HasPositions()) {
+        AABB box;
+        BoundingSphere sphere;
+        const float* xyz = reinterpret_cast<const float*>(mesh->mVertices);
+        box.Create(xyz, sizeof(aiVector3D), mesh->mNumVertices);
+        sphere.Create(xyz, sizeof(aiVector3D), mesh->mNumVertices);
+        bounding_sphere = bounding_box.IsEmpty() ? sphere : bounding_sphere.Merge(sphere);
+        bounding_box = bounding_box.Merge(box);
+      }
+
       // buffer for vertex positions
       if (mesh->HasPositions()) {
         glGenBuffers(1, &buffer);
@@ -208,7 +234,7 @@ protected:
       }
 
       // unbind buffers
-      glBindVertexArray(0);
+      GLStateCache::Get().BindVertexArray(0);
       glBindBuffer(GL_ARRAY_BUFFER, 0);
       glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
@@ -259,7 +285,7 @@ protected:
 
         // Open GL stuff to generate texture ID, bind texture, load image data, generate mipmaps, set wrapping and filter modes...
         glGenTextures(1, &model_mesh.texture_id);
-        glBindTexture(GL_TEXTURE_2D, model_mesh.texture_id);
+        GLStateCache::Get().BindTexture(0, model_mesh.texture_id);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -25,6 +25,9 @@ public:
 	float _age = 0.0f;
 	float _lifeTime = 0.0f;
 	float _fps;
+	uint32_t _seed;           // State of the particle's random number generator
+	TransformSnapshot* _snapshot = nullptr;   // Where the simulation writes the transform
+	uint32_t _slot = 0;       // Slot of the particle in the snapshot
   
 
   /**
@@ -34,6 +37,10 @@ public:
   ParticleNode(float fps) 
   {
 	  _fps = fps;
+
+	  // Each particle has its own generator so particles can be updated
+	  // in parallel. Seeded from rand() so srand still sets the sequence.
+	  _seed = (uint32_t)rand() * 2654435761u + 1u;
 	  InitializeParticle(fps);
   }
 
@@ -81,6 +88,18 @@ public:
    */
   virtual ~ParticleNode() { }
 
+  /**
+   * Has Update write the particle's transform to a snapshot (when it is
+   * updated on a simulation thread) rather than set it directly. Call
+   * before the simulation starts.
+   * @param snapshot  Snapshot read by the render thread
+   */
+  void SetSnapshot(TransformSnapshot* snapshot)
+  {
+	  _snapshot = snapshot;
+	  _slot = snapshot->AddTransform(this);
+  }
+
   /**
   * Update the particle node 
   * @param  scene_state  Current scene state
@@ -102,22 +121,33 @@ public:
 	  SceneNode::Update(sceneState);
   }
 
+  /**
+   * Particles only change themselves, so they may be updated in parallel.
+   * @return  Returns true.
+   */
+  virtual bool IsUpdateThreadSafe() const {
+	  return true;
+  }
+
   // Create a random value between a specified minv and maxv.
   float getRandom(const float minv, const float maxv) {
-	  return minv + ((maxv - minv) * (float)rand() / (float)RAND_MAX);
+	  return minv + ((maxv - minv) * getRand01());
   }
 
-  // Get a random number
-  float getRand01() const {
-	  return (float)rand() / (float)RAND_MAX;
+  // Get a random number in [0, 1] (linear congruential generator)
+  float getRand01() {
+	  _seed = _seed * 1664525u + 1013904223u;
+	  return (float)(_seed >> 8) / (float)0xFFFFFF;
   }
 
   // Sets the transformation matrix
   void setTransform(bool setIdentity) {
-	  
-	  model_matrix.SetIdentity();
-	  model_matrix.Translate(_position.x, _position.y, _position.z);
-	  model_matrix.Scale(_size, _size, _size);
+	  Matrix4x4 m;
+	  m.SetTranslateScale(_position, Vector3(_size, _size, _size));
+	  if (_snapshot != nullptr)
+		  _snapshot->Write(_slot, m);
+	  else
+		  LoadMatrix(m);
   }
 };
 
@@ -29,6 +29,7 @@ public:
     material_shininess = 1.0f;
     texture_id = 0;             // Default to no texture
 	isBillboard = false;
+    alpha_tested = false;
 
     // Note: color constructors default rgb to 0 and alpha to 1
   }
@@ -49,11 +50,21 @@ public:
       material_emission(me),
       material_shininess(s),
       texture_id(0),
-      isBillboard(false) {
+      isBillboard(false),
+      alpha_tested(false) {
     node_type = SCENE_PRESENTATION;
     reference_count = 0;
   }
 
+  /**
+   * Materials do not change in Update, so they may be updated in
+   * parallel.
+   * @return  Returns true.
+   */
+  virtual bool IsUpdateThreadSafe() const {
+    return true;
+  }
+
   /**
    * Set material ambient reflection coefficient.
    * @param  c  Ambient reflection coefficients (color).
@@ -159,9 +170,16 @@ public:
       return;
     }
 
+    // The fragment shader discards texels with 0 alpha. Note if there
+    // are any so render lists can draw this material after opaque ones.
+    alpha_tested = false;
+    for (int i = 0; i < w * h && !alpha_tested; i++) {
+      alpha_tested = (data[i * 4 + 3] == 0);
+    }
+
     // Generate an OpenGL textureID, bind it
     glGenTextures(1, &texture_id);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GLStateCache::Get().BindTexture(0, texture_id);
 
     // Load image data and generate mipmaps
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h,
@@ -177,7 +195,7 @@ public:
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
 
     // Bind null texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::Get().BindTexture(0, 0);
   }
 
   void CreateBillboard()
@@ -185,6 +203,40 @@ public:
 	  this->isBillboard = true;
   }
 
+  /**
+   * Checks if geometry with this material is drawn as a billboard (turned
+   * to face the camera in the vertex shader).
+   * @return  Returns true if this is a billboard material.
+   */
+  bool IsBillboard() const {
+    return isBillboard;
+  }
+
+  /**
+   * Gets the texture.
+   * @return  Returns the texture object (0 if none).
+   */
+  GLuint GetTexture() const {
+    return texture_id;
+  }
+
+  /**
+   * Checks if the texture has texels the shader discards (0 alpha).
+   * @return  Returns true if geometry with this material is alpha tested.
+   */
+  bool IsAlphaTested() const {
+    return alpha_tested;
+  }
+
+  /**
+   * Checks if another material sets the same uniforms and texture.
+   * @param  m  Material to compare with
+   * @return  Returns true if drawing with either looks the same.
+   */
+  bool SameAppearance(const PresentationNode& m) const {
+    return SameColors(m) && texture_id == m.texture_id && isBillboard == m.isBillboard;
+  }
+
   /**
    * Update texture filtering for this material
    * @param  min_filter  OpenGL filter to use for minification
@@ -192,7 +244,7 @@ public:
    */
   void UpdateTextureFilters(GLuint min_filter, GLuint mag_filter) {
     if (texture_id) {
-      glBindTexture(GL_TEXTURE_2D, texture_id);
+      GLStateCache::Get().BindTexture(0, texture_id);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
       glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
     }
@@ -203,45 +255,140 @@ public:
    * @param  scene_state  Scene state (holds material uniform locations)
    */
   void Draw(SceneState& scene_state) {
+    SetUniforms(scene_state);
+
+    // Draw children of this node
+    SceneNode::Draw(scene_state);
+
+    ResetUniforms(scene_state);
+  }
+
+  // Adds this material to a render list, then the children under it.
+  // Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
+  /**
+   * Sets the material uniforms, enables billboarding and binds the
+   * texture if this material has them.
+   * @param  scene_state  Scene state (holds material uniform locations)
+   */
+  void SetUniforms(SceneState& scene_state) const {
+    if (scene_state.UsesUniformBlocks()) {
+      MaterialUniforms& m = scene_state.material_uniforms;
+      SetBlockColors(m);
+      if (isBillboard)
+        m.enableBillboard = 1;
+      m.useTexture = texture_id ? 1 : 0;
+      if (texture_id)
+        GLStateCache::Get().BindTexture(0, texture_id);
+      scene_state.UploadMaterialUniforms();
+      return;
+    }
+
     // Set the material uniform values
-    glUniform4fv(scene_state.materialambient_loc, 1, &material_ambient.r);
-    glUniform4fv(scene_state.materialdiffuse_loc, 1, &material_diffuse.r);
-    glUniform4fv(scene_state.materialspecular_loc, 1, &material_specular.r);
-    glUniform4fv(scene_state.materialemission_loc, 1, &material_emission.r);
-    glUniform1f(scene_state.materialshininess_loc, material_shininess);
+    SetColorUniforms(scene_state);
 
 	// Enable billboarding
+	GLStateCache& gl = GLStateCache::Get();
 	if (this->isBillboard)
 	{
-        glUniform1i(scene_state.enablebillboard_loc, 1);
+        gl.Uniform1i(scene_state.enablebillboard_loc, 1);
 	}
 
     // Enable texture mapping and bind the texture
     if (texture_id) {
-      glUniform1i(scene_state.usetexture_loc, 1);   // Tell shader we are using textures
-      glUniform1i(scene_state.textureunit_loc, 0);  // Texture unit 0
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, texture_id);
+      gl.Uniform1i(scene_state.usetexture_loc, 1);   // Tell shader we are using textures
+      gl.Uniform1i(scene_state.textureunit_loc, 0);  // Texture unit 0
+      gl.BindTexture(0, texture_id);
     }
     else {
       // Set a special value to tell the shader we are not using textures
-      glUniform1i(scene_state.usetexture_loc, 0); 
+      gl.Uniform1i(scene_state.usetexture_loc, 0); 
     }
+  }
 
-    // Draw children of this node
-    SceneNode::Draw(scene_state);
+  /**
+   * Sets the uniforms of this material in place of those of the current
+   * material. Only the values that differ are set, and ResetUniforms of
+   * the current material is not needed.
+   * @param  scene_state  Scene state (holds material uniform locations)
+   * @param  current      Material whose uniforms are set
+   */
+  void SetUniforms(SceneState& scene_state, const PresentationNode& current) const {
+    if (scene_state.UsesUniformBlocks()) {
+      // The material block is written once if anything in it differs
+      MaterialUniforms& m = scene_state.material_uniforms;
+      bool changed = !SameColors(current) || isBillboard != current.isBillboard ||
+                     (texture_id != 0) != (current.texture_id != 0);
+      if (texture_id != current.texture_id) {
+        if (texture_id)
+          GLStateCache::Get().BindTexture(0, texture_id);
+        else
+          GLStateCache::Get().ReleaseTexture(0);
+      }
+      if (changed) {
+        SetBlockColors(m);
+        m.enableBillboard = isBillboard ? 1 : 0;
+        m.useTexture = texture_id ? 1 : 0;
+        scene_state.UploadMaterialUniforms();
+      }
+      return;
+    }
+
+    GLStateCache& gl = GLStateCache::Get();
+    if (!SameColors(current)) {
+      SetColorUniforms(scene_state);
+    }
+    if (isBillboard != current.isBillboard) {
+      gl.Uniform1i(scene_state.enablebillboard_loc, isBillboard ? 1 : 0);
+    }
+    if (texture_id != current.texture_id) {
+      if (texture_id) {
+        gl.Uniform1i(scene_state.usetexture_loc, 1);
+        gl.Uniform1i(scene_state.textureunit_loc, 0);
+        gl.BindTexture(0, texture_id);
+      }
+      else {
+        gl.Uniform1i(scene_state.usetexture_loc, 0);
+        gl.ReleaseTexture(0);
+      }
+    }
+  }
 
-    // Enable billboarding
+  /**
+   * Turns off billboarding and texture mapping (if this material enabled
+   * them) for any nodes not descended from this presentation node.
+   * @param  scene_state  Scene state (holds material uniform locations)
+   */
+  void ResetUniforms(SceneState& scene_state) const {
+    if (scene_state.UsesUniformBlocks()) {
+      if (isBillboard || texture_id) {
+        MaterialUniforms& m = scene_state.material_uniforms;
+        if (isBillboard)
+          m.enableBillboard = 0;
+        if (texture_id) {
+          m.useTexture = 0;
+          GLStateCache::Get().ReleaseTexture(0);
+        }
+        scene_state.UploadMaterialUniforms();
+      }
+      return;
+    }
+
+    // Disable billboarding
+    GLStateCache& gl = GLStateCache::Get();
     if (this->isBillboard)
     {
-        glUniform1i(scene_state.enablebillboard_loc, 0);
+        gl.Uniform1i(scene_state.enablebillboard_loc, 0);
     }
 
-    // Turn off texture mapping for any nodes not descended from this presentation node
+    // Turn off texture mapping for any nodes not descended from this
+    // presentation node. The texture stays bound if the state cache is on:
+    // the shader ignores it and the next material may bind it again.
     if (texture_id) {
       // Disable texture mapping
-      glUniform1i(scene_state.usetexture_loc, 0);
-      glBindTexture(GL_TEXTURE_2D, 0);
+      gl.Uniform1i(scene_state.usetexture_loc, 0);
+      gl.ReleaseTexture(0);
     }
   }
 
@@ -253,6 +400,35 @@ protected:
   GLfloat material_shininess;
   GLuint  texture_id;
   bool    isBillboard;
+  bool    alpha_tested;   // Texture has texels with 0 alpha
+
+  // True if the material colors and shininess equal those of m
+  bool SameColors(const PresentationNode& m) const {
+    return material_ambient == m.material_ambient &&
+           material_diffuse == m.material_diffuse &&
+           material_specular == m.material_specular &&
+           material_emission == m.material_emission &&
+           material_shininess == m.material_shininess;
+  }
+
+  // Sets the material color and shininess uniforms
+  void SetColorUniforms(SceneState& scene_state) const {
+    GLStateCache& gl = GLStateCache::Get();
+    gl.Uniform4fv(scene_state.materialambient_loc, &material_ambient.r);
+    gl.Uniform4fv(scene_state.materialdiffuse_loc, &material_diffuse.r);
+    gl.Uniform4fv(scene_state.materialspecular_loc, &material_specular.r);
+    gl.Uniform4fv(scene_state.materialemission_loc, &material_emission.r);
+    gl.Uniform1f(scene_state.materialshininess_loc, material_shininess);
+  }
+
+  // Copies the material colors and shininess to the material block
+  void SetBlockColors(MaterialUniforms& m) const {
+    m.materialAmbient = material_ambient;
+    m.materialDiffuse = material_diffuse;
+    m.materialSpecular = material_specular;
+    m.materialEmission = material_emission;
+    m.materialShininess = material_shininess;
+  }
 };
 
 #endif
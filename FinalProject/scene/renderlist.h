@@ -0,0 +1,851 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:	David W. Nesbitt
+//	File:    renderlist.h
+//	Purpose:	Flattened render list compiled from a scene graph subtree,
+//          and the scene node that draws a subtree through one.
+//
+//============================================================================
+
+#ifndef __RENDERLIST_H
+#define __RENDERLIST_H
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * One draw call of a render list. Geometry is drawn with the world
+ * transform and material that were in effect where it sits in the scene
+ * graph. A record with a node is a subtree that could not be flattened;
+ * it is drawn by calling the node's Draw.
+ */
+struct DrawRecord {
+  uint32_t          transform;    // Index of the world transform
+  PresentationNode* material;     // Nearest enclosing material (or null)
+  GLuint            vao;          // Vertex array object
+  GLsizei           index_count;  // Number of indexes to draw
+  GLenum            index_type;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  GLuint            texture;      // Texture set by the geometry itself
+  bool              own_texture;  // True if the geometry sets the texture
+  SceneNode*        node;         // Subtree drawn with Draw, or null
+  uint64_t          sort_key;     // State bits of the sort key
+};
+
+/**
+ * View frustum culling statistics of the last frame a render list drew.
+ */
+struct CullStats {
+  uint32_t visited;   // Bounding volumes tested against the frustum
+  uint32_t culled;    // Subtrees found outside the frustum (not drawn)
+  uint32_t drawn;     // Records drawn
+};
+
+/**
+ * State change statistics of the last frame a render list drew. A state
+ * change is a new transform, material, texture or vertex array object
+ * between consecutive records, or a subtree drawn with Draw. The
+ * difference between the 2 counts is the number saved by sorting.
+ */
+struct SortStats {
+  uint32_t state_changes;            // Drawing in sorted order
+  uint32_t unsorted_state_changes;   // Drawing in scene graph order
+};
+
+/**
+ * Render list: the scene graph flattened into a linear array of draw
+ * records. Compiling walks the graph once (SceneNode::Compile) and is
+ * repeated only when the structure of the graph changes (see
+ * SceneNode::GraphVersion). Each frame the transforms are brought up to
+ * date in one pass over a flat array (parents come before their
+ * children): world and normal matrices are formed again only below a
+ * transform whose matrix changed, and pvm matrices only for those or if
+ * the camera moved (see WorldTransform). Then the records are drawn in
+ * order. Matrix and material uniforms are only set when they differ
+ * from those of the previous record. With uniform blocks the draw
+ * blocks of all transforms drawn are written to the uniform ring in one
+ * upload, and a transform change binds its range.
+ * The transforms also form a bounding volume hierarchy: each has the
+ * world space box of all geometry below it, refit bottom-up only where a
+ * world matrix changed. Subtrees whose box is outside the view frustum
+ * are skipped with all their records. Nodes drawn with Draw are never
+ * culled unless they were added with bounds.
+ * The records that are drawn are sorted each frame by a packed 64 bit
+ * key so records sharing a texture, material and vertex array object are
+ * drawn together, and a material change sets only the uniforms that
+ * differ. From the most significant bits:
+ *   2 bits   bucket: opaque, then alpha tested (textures with 0 alpha)
+ *   12 bits  texture
+ *   12 bits  material (materials that look the same share an id)
+ *   14 bits  vertex array object
+ *   24 bits  view depth (front to back)
+ * The ids are assigned when the list is compiled. A list is drawn with
+ * one shader program, so the key has no shader bits; nodes that are not
+ * geometry (which may change the program) are not moved.
+ */
+class RenderList {
+public:
+  /**
+   * Constructor. The list is empty and out of date.
+   */
+  RenderList()
+    : version(0),
+      compiled(false),
+      culling(true),
+      sorting(true),
+      draw_block_base(0),
+      draw_block_stride(0),
+      current_transform(0) {
+    stats = CullStats();
+    sort_stats = SortStats();
+  }
+
+  /**
+   * Checks if the list was compiled since the last structural change to
+   * the scene graph.
+   * @return  Returns true if the list is up to date.
+   */
+  bool IsCurrent() const {
+    return compiled && version == SceneNode::GraphVersion();
+  }
+
+  /**
+   * Compiles a set of subtrees (the children of a RenderListNode) into
+   * the list, replacing its contents.
+   * @param  roots  Root nodes of the subtrees.
+   */
+  void Compile(const std::vector<SceneNode*>& roots) {
+    version = SceneNode::GraphVersion();
+    records.clear();
+    record_bounds.clear();
+    transforms.clear();
+    material_stack.clear();
+
+    // Transform 0 is the model matrix in effect where the list is drawn
+    transforms.push_back(TransformEntry(nullptr, 0));
+    current_transform = 0;
+    for (auto r : roots) {
+      r->Compile(*this);
+    }
+    EndTransform(transforms[0]);
+    AssignSortKeys();
+    compiled = true;
+  }
+
+  /**
+   * Adds a transform node. Geometry added until the matching
+   * PopTransform uses the node's matrix postmultiplied onto the current
+   * world transform.
+   * @param  node  Transform node
+   */
+  void PushTransform(TransformNode* node) {
+    transforms.push_back(TransformEntry(node, current_transform));
+    transforms.back().record_begin = static_cast<uint32_t>(records.size());
+    current_transform = static_cast<uint32_t>(transforms.size() - 1);
+  }
+
+  /**
+   * Reverts to the world transform in effect before the last
+   * PushTransform.
+   */
+  void PopTransform() {
+    TransformEntry& t = transforms[current_transform];
+    EndTransform(t);
+    current_transform = t.parent;
+  }
+
+  /**
+   * Sets the material for geometry added until the matching PopMaterial.
+   * @param  material  Presentation node
+   */
+  void PushMaterial(PresentationNode* material) {
+    material_stack.push_back(material);
+  }
+
+  /**
+   * Reverts to the material in effect before the last PushMaterial.
+   */
+  void PopMaterial() {
+    material_stack.pop_back();
+  }
+
+  /**
+   * Adds a draw record for indexed triangles.
+   * @param  vao          Vertex array object
+   * @param  index_count  Number of indexes
+   * @param  index_type   Type of the indexes (GL_UNSIGNED_SHORT or INT)
+   * @param  bounds       Bounding box in modeling coordinates (an empty
+   *                      box means the geometry is never culled)
+   */
+  void AddDraw(const GLuint vao, const GLsizei index_count, const GLenum index_type,
+               const AABB& bounds) {
+    AddRecord(vao, index_count, index_type, 0, false, nullptr, bounds);
+  }
+
+  /**
+   * Adds a draw record for indexed triangles that set their own texture
+   * (0 for none) rather than using the material's.
+   * @param  vao          Vertex array object
+   * @param  index_count  Number of indexes
+   * @param  index_type   Type of the indexes (GL_UNSIGNED_SHORT or INT)
+   * @param  texture      Texture object (0 = no texture)
+   * @param  bounds       Bounding box in modeling coordinates
+   */
+  void AddDraw(const GLuint vao, const GLsizei index_count, const GLenum index_type,
+               const GLuint texture, const AABB& bounds) {
+    AddRecord(vao, index_count, index_type, texture, true, nullptr, bounds);
+  }
+
+  /**
+   * Adds a node that is drawn with its own Draw method (together with
+   * its children) under the current transform and material.
+   * @param  node  Scene node
+   */
+  void AddNode(SceneNode* node) {
+    AddRecord(0, 0, GL_UNSIGNED_SHORT, 0, false, node, AABB());
+  }
+
+  /**
+   * Adds a node that is drawn with its own Draw method and is culled
+   * with the given bounds. The bounds must hold everything the node
+   * draws, in any orientation a billboard material gives it.
+   * @param  node    Scene node
+   * @param  bounds  Bounding box in modeling coordinates
+   */
+  void AddNode(SceneNode* node, const AABB& bounds) {
+    AddRecord(0, 0, GL_UNSIGNED_SHORT, 0, false, node, bounds);
+  }
+
+  /**
+   * Turns view frustum culling on or off (on by default).
+   * @param  enable  True to cull
+   */
+  void SetCulling(const bool enable) {
+    culling = enable;
+  }
+
+  /**
+   * Gets the culling statistics of the last Draw.
+   * @return  Returns the statistics.
+   */
+  const CullStats& GetCullStats() const {
+    return stats;
+  }
+
+  /**
+   * Draws the list. The model matrix in the scene state is the parent
+   * transform of the whole list.
+   * @param  scene_state  Current scene state
+   */
+  void Draw(SceneState& scene_state) {
+    if (UpdateTransforms(scene_state.model_matrix, scene_state.pv))
+      UpdateBounds();
+    Cull();
+
+    // Gather the records that were not culled, with their sort keys, in
+    // per-frame memory
+    DrawItem* items = nullptr;
+    if (scene_state.arena != nullptr) {
+      items = scene_state.arena->Allocate<DrawItem>(records.size());
+    }
+    else {
+      item_storage.resize(records.size());
+      items = item_storage.data();
+    }
+    size_t count = 0;
+    size_t hole = 0;
+    size_t k = 0;
+    while (k < records.size()) {
+      // Skip the records of culled subtrees
+      if (hole < holes.size() && k == holes[hole].begin) {
+        k = holes[hole].end;
+        hole++;
+        continue;
+      }
+      items[count].key = records[k].sort_key | Depth(k);
+      items[count].record = static_cast<uint32_t>(k);
+      count++;
+      k++;
+    }
+    stats.drawn = static_cast<uint32_t>(count);
+
+    // Sort by state. Nodes that are not geometry (they may set any state,
+    // such as a camera or shader) keep their place: only the runs of
+    // records between them are sorted.
+    sort_stats.unsorted_state_changes = CountStateChanges(items, count);
+    if (sorting) {
+      size_t begin = 0;
+      for (size_t i = 0; i <= count; i++) {
+        if (i == count || IsBarrier(records[items[i].record])) {
+          std::sort(items + begin, items + i, [](const DrawItem& a, const DrawItem& b) {
+            return a.key < b.key || (a.key == b.key && a.record < b.record);
+          });
+          begin = i + 1;
+        }
+      }
+    }
+    sort_stats.state_changes = CountStateChanges(items, count);
+    if (scene_state.UsesUniformBlocks())
+      UploadDrawBlocks(scene_state, items, count);
+
+    const uint32_t kNoTransform = 0xFFFFFFFF;
+    GLStateCache& gl = GLStateCache::Get();
+    uint32_t transform = kNoTransform;
+    PresentationNode* material = nullptr;
+    bool material_stale = false;
+    for (size_t i = 0; i < count; i++) {
+      const DrawRecord& r = records[items[i].record];
+      if (r.transform != transform) {
+        SetTransform(scene_state, r.transform);
+        transform = r.transform;
+      }
+      if (material_stale) {
+        // Geometry or a subtree set uniforms of its own
+        if (material != nullptr)
+          material->ResetUniforms(scene_state);
+        if (r.material != nullptr)
+          r.material->SetUniforms(scene_state);
+        material_stale = false;
+      }
+      else if (r.material != material) {
+        if (material != nullptr && r.material != nullptr)
+          r.material->SetUniforms(scene_state, *material);
+        else if (material != nullptr)
+          material->ResetUniforms(scene_state);
+        else
+          r.material->SetUniforms(scene_state);
+      }
+      material = r.material;
+
+      if (r.node != nullptr) {
+        // The subtree may set any matrix or material uniforms
+        scene_state.model_matrix = transforms[r.transform].cache.GetWorldMatrix();
+        r.node->Draw(scene_state);
+        transform = kNoTransform;
+        material_stale = true;
+        continue;
+      }
+
+      if (r.own_texture) {
+        if (r.texture)
+          gl.BindTexture(0, r.texture);
+        scene_state.SetUseTexture(r.texture != 0);
+        material_stale = true;
+      }
+      gl.BindVertexArray(r.vao);
+      glDrawElements(GL_TRIANGLES, r.index_count, r.index_type, (void*)0);
+    }
+    gl.ReleaseVertexArray();
+    if (material != nullptr)
+      material->ResetUniforms(scene_state);
+    scene_state.model_matrix = transforms[0].cache.GetWorldMatrix();
+  }
+
+  /**
+   * Turns sorting of records by state on or off (on by default). When
+   * off the records are drawn in scene graph order.
+   * @param  enable  True to sort
+   */
+  void SetSorting(const bool enable) {
+    sorting = enable;
+  }
+
+  /**
+   * Gets the state change statistics of the last Draw.
+   * @return  Returns the statistics.
+   */
+  const SortStats& GetSortStats() const {
+    return sort_stats;
+  }
+
+  /**
+   * Gets the draw records.
+   * @return  Returns the records in drawing order.
+   */
+  const std::vector<DrawRecord>& GetRecords() const {
+    return records;
+  }
+
+  /**
+   * Gets the number of world transforms (including the root transform).
+   * @return  Returns the number of transforms.
+   */
+  size_t GetTransformCount() const {
+    return transforms.size();
+  }
+
+protected:
+  // A transform node, the index of its parent transform and its cached
+  // world matrices. A node reached along several paths of the graph has
+  // an entry (and a cache) for each. The scale is the node's billboard
+  // scale, read each frame. The records and transforms below the node
+  // are contiguous (the list is compiled depth first), so the subtree is
+  // the index ranges up to record_end and transform_end.
+  struct TransformEntry {
+    TransformNode* node;
+    uint32_t       parent;
+    float          scale;
+    bool           changed;   // World matrix changed this frame
+    WorldTransform cache;
+
+    uint32_t record_begin;    // First record of the subtree
+    uint32_t record_end;      // One past the last record of the subtree
+    uint32_t transform_end;   // One past the last transform of the subtree
+    AABB     bounds;          // World bounds of the subtree
+    bool     unbounded;       // Subtree has geometry without bounds
+    bool     dirty;           // Bounds are refit this frame
+
+    TransformEntry(TransformNode* n, const uint32_t p)
+      : node(n),
+        parent(p),
+        scale(1.0f),
+        changed(false),
+        record_begin(0),
+        record_end(0),
+        transform_end(0),
+        unbounded(false),
+        dirty(false) {
+    }
+  };
+
+  // Bounds of a draw record. Billboards are turned to face the camera in
+  // the vertex shader, so their world box must hold any rotation of the
+  // geometry about its origin.
+  struct RecordBounds {
+    AABB local;         // Modeling coordinates
+    AABB world;         // World coordinates
+    bool unbounded;     // No bounds: never culled
+    bool billboard;
+  };
+
+  // Range of records in a culled subtree
+  struct RecordRange {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  // A record to draw this frame and its sort key
+  struct DrawItem {
+    uint64_t key;
+    uint32_t record;
+  };
+
+  // Sort key fields (see the class description)
+  static const int kBucketShift   = 62;
+  static const int kTextureShift  = 50;
+  static const int kMaterialShift = 38;
+  static const int kVaoShift      = 24;
+  static const uint64_t kIdMask   = 0xFFF;
+  static const uint64_t kVaoMask  = 0x3FFF;
+
+  uint32_t version;     // Scene graph version the list was compiled from
+  bool     compiled;
+  bool     culling;
+  bool     sorting;
+  std::vector<DrawRecord>     records;
+  std::vector<RecordBounds>   record_bounds;   // Parallel to records
+  std::vector<TransformEntry> transforms;
+  Matrix4x4                   pv;   // Camera the pvm matrices were formed with
+  Frustum                     frustum;   // View frustum of pv (world)
+  std::vector<RecordRange>    holes;     // Culled this frame, in order
+  CullStats                   stats;
+  SortStats                   sort_stats;
+  std::vector<DrawItem>       item_storage;   // Items if there is no frame arena
+
+  // Draw blocks of this frame in the uniform ring: the block of transform
+  // i is at draw_block_base + draw_block_slot[i] * draw_block_stride
+  std::vector<uint32_t>       draw_block_slot;
+  size_t                      draw_block_base;
+  size_t                      draw_block_stride;
+
+  // Compile state
+  uint32_t current_transform;
+  std::vector<PresentationNode*> material_stack;
+
+  void AddRecord(const GLuint vao, const GLsizei index_count, const GLenum index_type,
+                 const GLuint texture, const bool own_texture, SceneNode* node,
+                 const AABB& bounds) {
+    // Skip geometry that has no vertex buffers yet
+    if (node == nullptr && index_count == 0)
+      return;
+
+    DrawRecord r;
+    r.transform   = current_transform;
+    r.material    = material_stack.empty() ? nullptr : material_stack.back();
+    r.vao         = vao;
+    r.index_count = index_count;
+    r.index_type  = index_type;
+    r.texture     = texture;
+    r.own_texture = own_texture;
+    r.node        = node;
+    records.push_back(r);
+
+    RecordBounds b;
+    b.local = bounds;
+    b.unbounded = bounds.IsEmpty();
+    b.billboard = node == nullptr && r.material != nullptr && r.material->IsBillboard();
+    record_bounds.push_back(b);
+  }
+
+  // Sets the state bits of the sort key of each record. Ids are indexes
+  // into lists of the distinct textures, materials and vertex arrays.
+  void AssignSortKeys() {
+    std::vector<GLuint> textures;
+    std::vector<PresentationNode*> materials;
+    std::vector<GLuint> vaos;
+    for (auto& r : records) {
+      GLuint texture = r.own_texture ? r.texture :
+                       (r.material != nullptr ? r.material->GetTexture() : 0);
+      uint64_t texture_id = std::find(textures.begin(), textures.end(), texture) - textures.begin();
+      if (texture_id == textures.size())
+        textures.push_back(texture);
+
+      // Materials are compared by appearance (null is id 0)
+      uint64_t material_id = 0;
+      if (r.material != nullptr) {
+        while (material_id < materials.size() &&
+               !materials[material_id]->SameAppearance(*r.material))
+          material_id++;
+        if (material_id == materials.size())
+          materials.push_back(r.material);
+        material_id++;
+      }
+
+      uint64_t vao_id = std::find(vaos.begin(), vaos.end(), r.vao) - vaos.begin();
+      if (vao_id == vaos.size())
+        vaos.push_back(r.vao);
+
+      uint64_t bucket = (!r.own_texture && r.material != nullptr &&
+                         r.material->IsAlphaTested()) ? 1 : 0;
+      r.sort_key = (bucket << kBucketShift) |
+                   ((texture_id & kIdMask) << kTextureShift) |
+                   ((material_id & kIdMask) << kMaterialShift) |
+                   ((vao_id & kVaoMask) << kVaoShift);
+    }
+  }
+
+  // Depth bits of the sort key of record k: the w clip coordinate (view
+  // depth) of the center of its bounds. The bits of a positive float
+  // sort in the same order as its value.
+  uint64_t Depth(const size_t k) const {
+    const RecordBounds& b = record_bounds[k];
+    if (b.unbounded)
+      return 0;
+    Point3 c = b.world.GetCenter();
+    float w = pv.m(3, 0) * c.x + pv.m(3, 1) * c.y + pv.m(3, 2) * c.z + pv.m(3, 3);
+    if (!(w > 0.0f))
+      return 0;
+    uint32_t bits;
+    memcpy(&bits, &w, sizeof(bits));
+    return bits >> 8;
+  }
+
+  // Records that must be drawn in place: subtrees that are not geometry
+  static bool IsBarrier(const DrawRecord& r) {
+    return r.node != nullptr && r.node->GetNodeType() != SCENE_GEOMETRY;
+  }
+
+  // Counts the state changes (see SortStats) of drawing items in order
+  uint32_t CountStateChanges(const DrawItem* items, const size_t count) const {
+    const uint64_t kNone = ~0ull;
+    uint32_t changes = 0;
+    uint32_t transform = 0xFFFFFFFF;
+    uint64_t texture = kNone;
+    uint64_t material = kNone;
+    uint64_t vao = kNone;
+    for (size_t i = 0; i < count; i++) {
+      const DrawRecord& r = records[items[i].record];
+      if (r.transform != transform) {
+        changes++;
+        transform = r.transform;
+      }
+      if (r.node != nullptr) {
+        changes++;
+        transform = 0xFFFFFFFF;
+        texture = material = vao = kNone;
+        continue;
+      }
+      uint64_t t = (r.sort_key >> kTextureShift) & kIdMask;
+      uint64_t m = (r.sort_key >> kMaterialShift) & kIdMask;
+      uint64_t v = (r.sort_key >> kVaoShift) & kVaoMask;
+      changes += (t != texture) + (m != material) + (v != vao);
+      texture = t;
+      material = m;
+      vao = v;
+    }
+    return changes;
+  }
+
+  // Records the end of the subtree of a transform
+  void EndTransform(TransformEntry& t) {
+    t.record_end = static_cast<uint32_t>(records.size());
+    t.transform_end = static_cast<uint32_t>(transforms.size());
+  }
+
+  // Brings the cached matrices of all transforms up to date. Parents are
+  // always earlier in the array than their children, so their changed
+  // flags are set first. Returns true if any world matrix changed.
+  bool UpdateTransforms(const Matrix4x4& root, const Matrix4x4& camera_pv) {
+    bool pv_changed = !(pv == camera_pv);
+    if (pv_changed) {
+      pv = camera_pv;
+      frustum.Set(pv);
+    }
+
+    // The root transform is the model matrix in effect above the list
+    TransformEntry& r = transforms[0];
+    r.changed = r.cache.Set(root);
+    if (r.changed || pv_changed)
+      r.cache.pvm = pv * root;
+
+    bool any_changed = r.changed;
+    for (size_t i = 1; i < transforms.size(); i++) {
+      TransformEntry& t = transforms[i];
+      const TransformEntry& parent = transforms[t.parent];
+      const Matrix4x4& local = t.node->GetMatrix();
+      t.changed = t.cache.Update(parent.cache.world, parent.cache.kind, parent.changed, local,
+                                 t.node->GetMatrixKind(), t.node->GetMatrixVersion(),
+                                 pv, pv_changed);
+      t.scale = t.node->GetBillboardScale();
+      any_changed = any_changed || t.changed;
+    }
+    return any_changed;
+  }
+
+  // Refits the bounds of the transforms whose world matrix changed and of
+  // their ancestors. Other subtrees keep their bounds from earlier frames.
+  void UpdateBounds() {
+    // Mark the transforms to refit. Children come after their parents,
+    // so a reverse pass reaches every ancestor.
+    for (auto& t : transforms) {
+      t.dirty = t.changed;
+    }
+    for (size_t i = transforms.size() - 1; i > 0; i--) {
+      if (transforms[i].dirty)
+        transforms[transforms[i].parent].dirty = true;
+    }
+    for (auto& t : transforms) {
+      if (t.dirty) {
+        t.bounds = AABB();
+        t.unbounded = false;
+      }
+    }
+
+    // Geometry directly below each transform. Only records whose
+    // transform moved are transformed again.
+    for (size_t k = 0; k < records.size(); k++) {
+      TransformEntry& t = transforms[records[k].transform];
+      if (!t.dirty)
+        continue;
+      RecordBounds& b = record_bounds[k];
+      if (b.unbounded) {
+        t.unbounded = true;
+        continue;
+      }
+      if (t.changed)
+        b.world = WorldBounds(b, t.cache.world);
+      t.bounds = t.bounds.Merge(b.world);
+    }
+
+    // Merge each subtree into its parent, deepest first
+    for (size_t i = transforms.size() - 1; i > 0; i--) {
+      const TransformEntry& t = transforms[i];
+      TransformEntry& parent = transforms[t.parent];
+      if (parent.dirty) {
+        parent.bounds = parent.bounds.Merge(t.bounds);
+        parent.unbounded = parent.unbounded || t.unbounded;
+      }
+    }
+  }
+
+  // World bounds of a record
+  static AABB WorldBounds(const RecordBounds& b, const Affine3x4& world) {
+    if (!b.billboard)
+      return b.local.Transform(world);
+
+    // Box around the sphere (centered at the origin) that holds the
+    // geometry in any orientation
+    Vector3 v(std::max(fabsf(b.local.m_min.x), fabsf(b.local.m_max.x)),
+              std::max(fabsf(b.local.m_min.y), fabsf(b.local.m_max.y)),
+              std::max(fabsf(b.local.m_min.z), fabsf(b.local.m_max.z)));
+    BoundingSphere s = BoundingSphere(Point3(0.0f, 0.0f, 0.0f), v.Norm()).Transform(world);
+    Vector3 e(s.m_radius, s.m_radius, s.m_radius);
+    return AABB(s.m_center - e, s.m_center + e);
+  }
+
+  // Tests the subtrees against the view frustum, top down, and lists the
+  // records of those outside. The subtree of a culled transform is not
+  // visited.
+  void Cull() {
+    holes.clear();
+    stats = CullStats();
+    if (!culling)
+      return;
+
+    size_t i = 0;
+    while (i < transforms.size()) {
+      const TransformEntry& t = transforms[i];
+      if (!t.unbounded) {
+        // An empty box has no geometry below it
+        if (t.bounds.IsEmpty()) {
+          i = t.transform_end;
+          continue;
+        }
+        stats.visited++;
+        if (!frustum.Intersects(t.bounds)) {
+          stats.culled++;
+          if (t.record_begin < t.record_end)
+            holes.push_back(RecordRange{ t.record_begin, t.record_end });
+          i = t.transform_end;
+          continue;
+        }
+      }
+      i++;
+    }
+  }
+
+  // Writes the draw blocks of the transforms drawn this frame to the
+  // uniform ring with one upload, so SetTransform only binds a range
+  void UploadDrawBlocks(SceneState& scene_state, const DrawItem* items, const size_t count) {
+    const uint32_t kNoSlot = 0xFFFFFFFF;
+    draw_block_slot.assign(transforms.size(), kNoSlot);
+    uint32_t slots = 0;
+    for (size_t i = 0; i < count; i++) {
+      uint32_t t = records[items[i].record].transform;
+      if (draw_block_slot[t] == kNoSlot)
+        draw_block_slot[t] = slots++;
+    }
+    if (slots == 0)
+      return;
+
+    UniformRing& ring = *scene_state.uniform_ring;
+    draw_block_stride = ring.Align(sizeof(DrawUniforms));
+    size_t bytes = (slots - 1) * draw_block_stride + sizeof(DrawUniforms);
+    char* blocks = static_cast<char*>(ring.Reserve(bytes, draw_block_base));
+    for (size_t t = 0; t < transforms.size(); t++) {
+      if (draw_block_slot[t] != kNoSlot) {
+        const WorldTransform& w = transforms[t].cache;
+        DrawUniforms* d = reinterpret_cast<DrawUniforms*>(blocks +
+                                                         draw_block_slot[t] * draw_block_stride);
+        d->Set(w.GetWorldMatrix(), w.GetNormalMatrix(), w.pvm, transforms[t].scale);
+      }
+    }
+    ring.Commit(draw_block_base, bytes);
+  }
+
+  // Sets the matrix uniforms for transform i (as TransformNode::Draw does).
+  // With uniform blocks this binds its draw block.
+  void SetTransform(SceneState& scene_state, const uint32_t i) {
+    if (scene_state.UsesUniformBlocks()) {
+      scene_state.uniform_ring->Bind(kDrawBlockBinding,
+        draw_block_base + draw_block_slot[i] * draw_block_stride, sizeof(DrawUniforms));
+      return;
+    }
+    const WorldTransform& t = transforms[i].cache;
+    GLStateCache& gl = GLStateCache::Get();
+    gl.UniformMatrix4fv(scene_state.modelmatrix_loc, t.GetWorldMatrix().Get());
+    gl.UniformMatrix4fv(scene_state.normalmatrix_loc, t.GetNormalMatrix().Get());
+    gl.UniformMatrix4fv(scene_state.pvm_loc, t.pvm.Get());
+    gl.Uniform1f(scene_state.scaley_loc, transforms[i].scale);
+    gl.Uniform1f(scene_state.scalex_loc, transforms[i].scale);
+  }
+};
+
+/**
+ * Render list node. Draws its children through a RenderList, which is
+ * compiled on the first Draw and again after any structural change to
+ * the scene graph. Nodes above this one (shaders, cameras, lights) are
+ * drawn normally, so it should be placed at the top of the geometry.
+ */
+class RenderListNode : public SceneNode {
+public:
+  /**
+   * Constructor.
+   */
+  RenderListNode() {
+    node_type = SCENE_BASE;
+    reference_count = 0;
+  }
+
+  /**
+   * Destructor.
+   */
+  virtual ~RenderListNode() { }
+
+  /**
+   * Draws the children through the render list, recompiling it first if
+   * the scene graph changed.
+   * @param  scene_state  Current scene state
+   */
+  virtual void Draw(SceneState& scene_state) {
+    if (!render_list.IsCurrent())
+      render_list.Compile(children);
+    render_list.Draw(scene_state);
+  }
+
+  /**
+   * A render list inside another is drawn with Draw.
+   * @param  list  Render list being built
+   */
+  virtual void Compile(RenderList& list) {
+    list.AddNode(this);
+  }
+
+  /**
+   * Gets the render list (compiled on the next Draw if out of date).
+   * @return  Returns the render list.
+   */
+  const RenderList& GetRenderList() const {
+    return render_list;
+  }
+  RenderList& GetRenderList() {
+    return render_list;
+  }
+
+protected:
+  RenderList render_list;
+};
+
+// Compile methods of the scene nodes. Descriptions are in the node
+// classes.
+inline void TransformNode::Compile(RenderList& list) {
+  list.PushTransform(this);
+  SceneNode::Compile(list);
+  list.PopTransform();
+}
+inline void PresentationNode::Compile(RenderList& list) {
+  list.PushMaterial(this);
+  SceneNode::Compile(list);
+  list.PopMaterial();
+}
+inline void GeometryNode::Compile(RenderList& list) {
+  list.AddNode(this);
+}
+inline void TriSurface::Compile(RenderList& list) {
+  list.AddDraw(vao, (GLsizei)face_count, GL_UNSIGNED_SHORT, bounding_box);
+}
+inline void TexturedTriSurface::Compile(RenderList& list) {
+  list.AddDraw(vao, (GLsizei)face_count, GL_UNSIGNED_SHORT, bounding_box);
+}
+inline void ModelNode::Compile(RenderList& list) {
+  for (const auto& mesh : meshes) {
+    list.AddDraw(mesh.vao, mesh.numFaces * 3, GL_UNSIGNED_INT,
+                 mesh.has_texture ? mesh.texture_id : 0, bounding_box);
+  }
+}
+inline void InstancedGeometryNode::Compile(RenderList& list) {
+  list.AddNode(this, bounding_box);
+}
+inline void CameraNode::Compile(RenderList& list) {
+  list.AddNode(this);
+}
+inline void LightNode::Compile(RenderList& list) {
+  list.AddNode(this);
+}
+inline void ShaderNode::Compile(RenderList& list) {
+  list.AddNode(this);
+}
+
+#endif
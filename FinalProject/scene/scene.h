@@ -34,6 +34,9 @@ inline std::vector<Point3> FormTriangle(const Point3& v0, const Point3& v1,
 #include <stdint.h>
 #include "scene/color3.h"
 #include "scene/color4.h"
+#include "scene/framearena.h"
+#include "scene/uniformring.h"
+#include "scene/glstatecache.h"
 #include "scene/scenestate.h"
 #include "scene/scenenode.h"
 #include "scene/transformnode.h"
@@ -44,6 +47,7 @@ inline std::vector<Point3> FormTriangle(const Point3& v0, const Point3& v1,
 #include "scene/cameranode.h"
 #include "scene/trisurface.h"
 #include "scene/textured_trisurface.h"
+#include "scene/instancedgeometrynode.h"
 #include "scene/meshteapot.h"
 #include "scene/conic.h"
 #include "scene/unitsquare.h"
@@ -52,7 +56,9 @@ inline std::vector<Point3> FormTriangle(const Point3& v0, const Point3& v1,
 #include "scene/torus.h"
 #include "scene/modelnode.h"
 #include "scene/unittriangle.h"
+#include "scene/simulation.h"
 #include "scene/particlenode.h"
 #include "scene/extrudedsquare.h"
+#include "scene/renderlist.h"
 
 #endif
@@ -15,6 +15,13 @@
 
 #include <vector>
 #include <string>
+#include <typeinfo>
+
+// Flattened draw list compiled from the scene graph (renderlist.h)
+class RenderList;
+
+// Smallest subtree (in nodes updated) worth giving to another thread
+const uint32_t kMinParallelUpdateCost = 64;
 
 /**
  * Scene graph node: base class
@@ -26,7 +33,10 @@ public:
 	 */
   SceneNode() 
     : node_type(SCENE_BASE),
-      reference_count(0) {
+      reference_count(0),
+      update_version(0xFFFFFFFF),
+      update_cost(1),
+      update_safe(false) {
   } 
 
 	/**
@@ -61,15 +71,55 @@ public:
 	}
 	
 	/**
-	 * Update the scene node and its children
+	 * Compile the scene node and its children into a flattened render list
+   * (see RenderList). The base class just compiles the children. Nodes
+   * that cannot be flattened add themselves to the list as a whole
+   * subtree, which the list draws by calling Draw.
+   * @param  list  Render list being built
+	 */
+	virtual void Compile(RenderList& list) {
+    for (auto c : children) {
+      c->Compile(list);
+    }
+	}
+
+	/**
+	 * Update the scene node and its children. If the scene state has a
+   * task pool, children whose subtrees are thread safe (see
+   * IsUpdateThreadSafe) are updated on the pool in batches of at least
+   * kMinParallelUpdateCost nodes. The call returns once all children are
+   * updated, so the graph can be drawn after the root's Update returns.
+   * Nodes must not be added or removed during Update.
    * @param  scene_state  Current scene state
 	 */
 	virtual void Update(SceneState& scene_state) {
+    if (scene_state.task_pool != nullptr && scene_state.task_pool->GetThreadCount() > 1) {
+      PrepareUpdate();
+      if (update_cost >= kMinParallelUpdateCost) {
+        UpdateChildrenParallel(scene_state);
+        return;
+      }
+    }
+
 		// Loop through the list and update the children
     for (auto c : children) {
 			c->Update(scene_state);
     }
 	}	
+
+  /**
+   * Checks if the node's Update may run on a worker thread at the same
+   * time as the Update of other nodes (including other paths to this
+   * node, if it is shared). Node types declare this by overriding it to
+   * return true once their Update has been checked; others are updated
+   * on the thread that called the root's Update, with no other updates
+   * running. A plain grouping node (a SceneNode itself) only updates its
+   * children, so it is safe.
+   * @return  Returns true if Update is thread safe.
+   */
+  virtual bool IsUpdateThreadSafe() const {
+    return typeid(*this) == typeid(SceneNode);
+  }
 	
 	/**
 	 * Destroy all the children
@@ -78,6 +128,9 @@ public:
     for (auto c : children) {
       c->Release();
     }
+    if (!children.empty()) {
+      GraphVersion()++;
+    }
     children.clear();
 	}
 
@@ -88,8 +141,20 @@ public:
 	void AddChild(SceneNode* node) {
 		children.push_back(node);
 		node->reference_count++;
+    GraphVersion()++;
 	}
 
+  /**
+   * Gets the structure version of the scene graph. Incremented whenever a
+   * child is added to or removed from any node, so compiled render lists
+   * can tell when they are out of date.
+   * @return  Returns the address of the version counter.
+   */
+  static uint32_t& GraphVersion() {
+    static uint32_t version = 0;
+    return version;
+  }
+
   /**
 	 * Get the type of scene node
    * @return  Returns the type of hte scene node.
@@ -119,6 +184,68 @@ protected:
 	SceneNodeType           node_type;
 	int                     reference_count;
 	std::vector<SceneNode*> children;
+
+  // Size and thread safety of the subtree, for parallel update. Valid
+  // when update_version is the graph version.
+  uint32_t                update_version;
+  uint32_t                update_cost;    // Nodes updated (shared nodes once per path)
+  bool                    update_safe;    // All nodes are thread safe
+
+  // Finds the size and thread safety of the subtree, if the graph has
+  // changed since they were last found
+  void PrepareUpdate() {
+    if (update_version == GraphVersion())
+      return;
+    update_cost = 1;
+    update_safe = IsUpdateThreadSafe();
+    for (auto c : children) {
+      c->PrepareUpdate();
+      update_cost += c->update_cost;
+      update_safe = update_safe && c->update_safe;
+    }
+    update_version = GraphVersion();
+  }
+
+  // Updates the children, giving runs of thread safe children that add
+  // up to kMinParallelUpdateCost nodes to the task pool. The last run
+  // is updated on this thread. Unsafe children are updated on this
+  // thread once the runs before them are complete.
+  void UpdateChildrenParallel(SceneState& scene_state) {
+    TaskPool* pool = scene_state.task_pool;
+    TaskGroup group;
+    size_t begin = 0;
+    uint32_t cost = 0;
+    for (size_t i = 0; i < children.size(); i++) {
+      SceneNode* c = children[i];
+      if (!c->update_safe) {
+        if (cost > 0)
+          UpdateChildRange(this, &scene_state, begin, i);
+        cost = 0;
+        pool->Wait(group);
+        c->Update(scene_state);
+        continue;
+      }
+      if (cost == 0)
+        begin = i;
+      cost += c->update_cost;
+      if (cost >= kMinParallelUpdateCost) {
+        pool->Run(group, UpdateChildRange, this, &scene_state, begin, i + 1);
+        cost = 0;
+      }
+    }
+    if (cost > 0)
+      UpdateChildRange(this, &scene_state, begin, children.size());
+    pool->Wait(group);
+  }
+
+  // Task that updates the thread safe children in [begin, end)
+  static void UpdateChildRange(void* node, void* scene_state, size_t begin, size_t end) {
+    std::vector<SceneNode*>& c = static_cast<SceneNode*>(node)->children;
+    for (size_t i = begin; i < end; i++) {
+      if (c[i]->update_safe)
+        c[i]->Update(*static_cast<SceneState*>(scene_state));
+    }
+  }
 };
 
 #endif
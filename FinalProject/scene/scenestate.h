@@ -12,10 +12,11 @@
 #ifndef __SCENESTATE_H
 #define __SCENESTATE_H
 
-#include <list>
-
 const uint32_t kMaxLights = 8;
 
+// Deepest nesting of transform nodes the model matrix stack holds
+const uint32_t kMaxTransformDepth = 64;
+
 // Simple structure to hold light uniform locations
 struct LightUniforms {
   GLint enabled;
@@ -73,6 +74,9 @@ struct SceneState {
   GLint scalex_loc;
   GLint scaley_loc;
 
+  // Instanced drawing uniform location (see InstancedGeometryNode)
+  GLint enableinstancing_loc;
+
   // Lights
   int    max_enabled_light;    // Index of the maximum enabled light index
   GLint  lightcount_loc;       // Number of lights uniform
@@ -83,9 +87,27 @@ struct SceneState {
   Matrix4x4 ortho_matrix;   // Orthographic projection matrix (2-D)
   Matrix4x4 pv;             // Current composite projection and view matrix
   Matrix4x4 model_matrix;   // Current model matrix
+  Frustum   frustum;        // View frustum (world coordinates)
+
+  // Retained state to push/pop modeling matrix. A fixed size array so
+  // traversal does not allocate.
+  Matrix4x4 modelmatrix_stack[kMaxTransformDepth];
+  uint32_t  modelmatrix_depth;
 
-  // Retained state to push/pop modeling matrix
-  std::list<Matrix4x4> modelmatrix_stack;
+  // Per-frame memory for traversal temporaries (may be null)
+  FrameArena* arena;
+
+  // Uniform blocks. Set by a shader that reads its uniforms from blocks
+  // (see LightingShaderNode), otherwise null and the uniform locations
+  // above are used. The current block contents are kept here and written
+  // to the ring when they change.
+  UniformRing*     uniform_ring;
+  FrameUniforms    frame_uniforms;
+  MaterialUniforms material_uniforms;
+
+  // Pool that Update runs independent subtrees on (null to update on the
+  // calling thread only)
+  TaskPool* task_pool;
 
   /**
   * Initialize scene state prior to drawing.
@@ -93,14 +115,79 @@ struct SceneState {
   void Init() {
     max_enabled_light = 0;
     model_matrix.SetIdentity();
-    modelmatrix_stack.clear();
+    modelmatrix_depth = 0;
+    arena = nullptr;
+    uniform_ring = nullptr;
+    task_pool = nullptr;
+  }
+
+  /**
+  * Checks if uniforms are set through uniform blocks.
+  * @return  Returns true if a uniform ring is in use.
+  */
+  bool UsesUniformBlocks() const {
+    return uniform_ring != nullptr;
+  }
+
+  /**
+  * Writes the frame block (camera, lights, fog) and binds it.
+  */
+  void UploadFrameUniforms() {
+    uniform_ring->Write(kFrameBlockBinding, &frame_uniforms, sizeof(FrameUniforms));
+  }
+
+  /**
+  * Writes the material block and binds it.
+  */
+  void UploadMaterialUniforms() {
+    uniform_ring->Write(kMaterialBlockBinding, &material_uniforms, sizeof(MaterialUniforms));
+  }
+
+  /**
+  * Turns texture mapping on or off (for geometry that binds its own
+  * texture).
+  * @param  use  True if a texture is bound to texture unit 0
+  */
+  void SetUseTexture(const bool use) {
+    if (UsesUniformBlocks()) {
+      int32_t value = use ? 1 : 0;
+      if (material_uniforms.useTexture != value) {
+        material_uniforms.useTexture = value;
+        UploadMaterialUniforms();
+      }
+    }
+    else if (use) {
+      GLStateCache::Get().Uniform1i(usetexture_loc, 1);   // Tell shader we are using textures
+      GLStateCache::Get().Uniform1i(textureunit_loc, 0);  // Texture unit 0
+    }
+    else {
+      GLStateCache::Get().Uniform1i(usetexture_loc, 0);
+    }
+  }
+
+  /**
+  * Writes a draw block (the transform of the geometry drawn) and binds it.
+  * @param  model   Model matrix
+  * @param  normal  Normal transformation matrix
+  * @param  pvm     Composite projection, view, model matrix
+  * @param  scale   Billboard scale
+  */
+  void UploadDrawUniforms(const Matrix4x4& model, const Matrix4x4& normal,
+                          const Matrix4x4& pvm, const float scale) {
+    DrawUniforms d;
+    d.Set(model, normal, pvm, scale);
+    uniform_ring->Write(kDrawBlockBinding, &d, sizeof(DrawUniforms));
   }
 
   /**
   * Copy current matrix onto stack
   */
   void PushTransforms() {
-    modelmatrix_stack.push_back(model_matrix);
+    if (modelmatrix_depth < kMaxTransformDepth)
+      modelmatrix_stack[modelmatrix_depth] = model_matrix;
+    else if (modelmatrix_depth == kMaxTransformDepth)
+      printf("SceneState: transforms nested deeper than %u\n", kMaxTransformDepth);
+    modelmatrix_depth++;
   }
 
   /**
@@ -109,11 +196,13 @@ struct SceneState {
   */
   void PopTransforms() {
     // If there are any matrices on the stack, retrieve the last one and
-    // remove it from the stack
-    if (modelmatrix_stack.size() > 0)
+    // remove it from the stack. Levels past the end of the stack were not
+    // saved and leave the matrix as is.
+    if (modelmatrix_depth > 0)
     {
-      model_matrix = modelmatrix_stack.back();
-      modelmatrix_stack.pop_back();
+      modelmatrix_depth--;
+      if (modelmatrix_depth < kMaxTransformDepth)
+        model_matrix = modelmatrix_stack[modelmatrix_depth];
     }
     else
       model_matrix.SetIdentity();
@@ -88,6 +88,10 @@ public:
     return true;
   }
 
+  // The program and its locations are set by Draw, so a render list draws
+  // this node and its subtree with Draw. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
   // Derived classes must add this to set all internal uniforms and attribute locations
   virtual bool GetLocations() = 0;
 
@@ -0,0 +1,216 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:	David W. Nesbitt
+//	File:    simulation.h
+//	Purpose:	Simulation thread that updates the scene graph apart from
+//          drawing, and the buffered transforms it hands to the renderer.
+//
+//============================================================================
+
+#ifndef __SIMULATION_H
+#define __SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/**
+ * Transforms written by a simulation thread and read by the render
+ * thread. Each animated transform node is given a slot with AddTransform
+ * before the simulation starts. The simulation writes the slots during a
+ * step and calls Publish at the end of it; the render thread calls Apply
+ * at the start of a frame to load the transforms of the newest complete
+ * step into the nodes, so a frame never sees part of a step.
+ * There are 3 copies of the slots: the render thread reads one, the
+ * simulation writes one and the newest complete step waits in the third.
+ * Publish and Apply each exchange copies with a single atomic operation,
+ * so neither thread ever waits for the other. Steps that complete between
+ * two frames are skipped (only the newest is drawn), and frames drawn
+ * between two steps draw the same step.
+ */
+class TransformSnapshot {
+public:
+  /**
+   * Constructor.
+   */
+  TransformSnapshot()
+    : front(0),
+      back(1),
+      ready(2) {
+  }
+
+  TransformSnapshot(const TransformSnapshot&) = delete;
+  TransformSnapshot& operator = (const TransformSnapshot&) = delete;
+
+  /**
+   * Adds a node whose transform the simulation sets. Call before the
+   * simulation thread starts.
+   * @param  node  Transform node
+   * @return  Returns the slot of the node.
+   */
+  uint32_t AddTransform(TransformNode* node) {
+    nodes.push_back(node);
+    for (auto& b : buffers)
+      b.push_back(node->GetMatrix());
+    return static_cast<uint32_t>(nodes.size() - 1);
+  }
+
+  /**
+   * Sets a transform for the step being simulated (simulation thread).
+   * Different slots may be written by different threads at once.
+   * @param  slot  Slot of the node
+   * @param  m     Modeling matrix
+   */
+  void Write(const uint32_t slot, const Matrix4x4& m) {
+    buffers[back][slot] = m;
+  }
+
+  /**
+   * Ends a step (simulation thread). The step becomes the one the next
+   * Apply loads. Slots not written in the next step keep their values.
+   */
+  void Publish() {
+    uint32_t published = back;
+    back = ready.exchange(published | kFresh, std::memory_order_acq_rel) & kIndexMask;
+
+    // Start the next step from this one. Same size, so no allocation.
+    buffers[back] = buffers[published];
+  }
+
+  /**
+   * Checks if a step was published since the last Apply.
+   * @return  Returns true if Apply would change the transforms.
+   */
+  bool IsFresh() const {
+    return (ready.load(std::memory_order_acquire) & kFresh) != 0;
+  }
+
+  /**
+   * Loads the transforms of the newest published step into the nodes
+   * (render thread). Call before drawing a frame.
+   * @return  Returns true if a new step was loaded.
+   */
+  bool Apply() {
+    if (!IsFresh())
+      return false;
+    front = ready.exchange(front, std::memory_order_acq_rel) & kIndexMask;
+    const std::vector<Matrix4x4>& b = buffers[front];
+    for (size_t i = 0; i < nodes.size(); i++)
+      nodes[i]->LoadMatrix(b[i]);
+    return true;
+  }
+
+private:
+  static const uint32_t kFresh = 4;         // Set in ready when a step is waiting
+  static const uint32_t kIndexMask = 3;
+
+  std::vector<TransformNode*> nodes;
+  std::vector<Matrix4x4>      buffers[3];
+  uint32_t                    front;        // Copy the render thread reads
+  uint32_t                    back;         // Copy the simulation writes
+  std::atomic<uint32_t>       ready;        // Newest complete step
+};
+
+/**
+ * Simulation thread. Calls Update on the scene graph at a fixed rate and
+ * publishes each step to a transform snapshot, so the simulation rate
+ * does not depend on how long frames take to draw and drawing does not
+ * wait for the simulation. Nodes that change state the renderer reads
+ * must write it through the snapshot (see ParticleNode::SetSnapshot)
+ * rather than change it directly, and nodes must not be added to or
+ * removed from the graph while the thread runs.
+ */
+class SimulationThread {
+public:
+  /**
+   * Constructor. The thread is started with Start.
+   * @param  root          Root of the scene graph to update
+   * @param  snapshot      Snapshot the steps are published to
+   * @param  steps_per_second  Simulation rate
+   * @param  pool          Task pool for the update (may be null)
+   */
+  SimulationThread(SceneNode* root, TransformSnapshot* snapshot,
+                   const float steps_per_second, TaskPool* pool = nullptr)
+    : scene_root(root),
+      transforms(snapshot),
+      task_pool(pool),
+      step_time(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<float>(1.0f / steps_per_second))),
+      stop(false),
+      steps(0) {
+  }
+
+  /**
+   * Destructor. Stops the thread.
+   */
+  ~SimulationThread() {
+    Stop();
+  }
+
+  SimulationThread(const SimulationThread&) = delete;
+  SimulationThread& operator = (const SimulationThread&) = delete;
+
+  /**
+   * Starts the thread.
+   */
+  void Start() {
+    if (thread.joinable())
+      return;
+    stop = false;
+    thread = std::thread(&SimulationThread::Run, this);
+  }
+
+  /**
+   * Stops the thread, waiting for the current step to complete.
+   */
+  void Stop() {
+    if (!thread.joinable())
+      return;
+    stop = true;
+    thread.join();
+  }
+
+  /**
+   * Gets the number of steps simulated.
+   * @return  Returns the step count.
+   */
+  uint32_t GetStepCount() const {
+    return steps.load(std::memory_order_relaxed);
+  }
+
+private:
+  SceneNode*                           scene_root;
+  TransformSnapshot*                   transforms;
+  TaskPool*                            task_pool;
+  std::chrono::steady_clock::duration  step_time;
+  std::atomic<bool>                    stop;
+  std::atomic<uint32_t>                steps;
+  std::thread                          thread;
+
+  void Run() {
+    // Kept across steps: the scene state holds the transform stack
+    SceneState scene_state;
+    auto next = std::chrono::steady_clock::now();
+    while (!stop) {
+      scene_state.Init();
+      scene_state.task_pool = task_pool;
+      scene_root->Update(scene_state);
+      transforms->Publish();
+      steps.fetch_add(1, std::memory_order_relaxed);
+
+      // Keep a fixed rate. If steps fall behind by more than a few, start
+      // over from now rather than running a burst of steps to catch up.
+      next += step_time;
+      auto now = std::chrono::steady_clock::now();
+      if (now > next + 4 * step_time)
+        next = now;
+      std::this_thread::sleep_until(next);
+    }
+  }
+};
+
+#endif
@@ -66,16 +66,12 @@ public:
     Matrix4x4 m;
     m.RotateZ(360.0f / static_cast<float>(n));
 
-    // Rotate the prior "edge" vertices
-    uint32_t index = 0;  // Index to the prior edge at this row
+    // Rotate the prior "edge" vertices. Each new column is the prior column
+    // transformed as a batch.
+    vertices.reserve(nrows * (n + 2));
+    vertices.resize(nrows * (n + 1));
     for (uint32_t i = 0; i < n; i++) {
-      for (uint32_t j = 0; j < nrows; j++) {
-        // Rotate the vertex and the normal
-        vtx.vertex = m * vertices[index].vertex;
-        vtx.normal = m * vertices[index].normal;
-        vertices.push_back(vtx);
-        index++;
-      }
+      m.TransformVertices(&vertices[i * nrows], &vertices[(i + 1) * nrows], nrows);
     }
 
     // Copy the first column of vertices
@@ -162,19 +158,17 @@ public:
     Matrix4x4 m;
     m.RotateZ(360.0f / static_cast<float>(n));
 
-    // Rotate the prior "edge" vertices
+    // Rotate the prior "edge" vertices. Each new column is the prior column
+    // transformed as a batch (t is copied), then s is set for the column.
     float ds = 1.0f / static_cast<float>(n);
     float s = ds;
-    uint32_t index = 0;  // Index to the prior edge at this row
+    vertices.reserve(nrows * (n + 2));
+    vertices.resize(nrows * (n + 1));
     for (uint32_t i = 0; i < n; i++, s += ds) {
-      vtx.s = s;
+      PNTVertex* column = &vertices[(i + 1) * nrows];
+      m.TransformVertices(&vertices[i * nrows], column, nrows);
       for (uint32_t j = 0; j < nrows; j++) {
-        // Rotate the vertex and the normal
-        vtx.vertex = m * vertices[index].vertex;
-        vtx.normal = m * vertices[index].normal;
-        vtx.t = vertices[index].t;
-        vertices.push_back(vtx);
-        index++;
+        column[j].s = s;
       }
     }
 
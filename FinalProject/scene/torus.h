@@ -14,6 +14,26 @@
 
 #include "geometry/geometry.h"
 
+/**
+ * Forms tables of sin and cos of n + 1 evenly spaced angles from 0 to 2 pi
+ * (inclusive, so the last angle wraps to meet the first). Uses the batch
+ * FastSinCos.
+ * @param  n        Number of divisions
+ * @param  sines    (OUT) sin of each angle
+ * @param  cosines  (OUT) cos of each angle
+ */
+inline void AngleTable(const int n, std::vector<float>& sines,
+                       std::vector<float>& cosines) {
+  std::vector<float> angles(n + 1);
+  float d = (2.0f * kPi) / (float)n;
+  for (int i = 0; i <= n; i++) {
+    angles[i] = i * d;
+  }
+  sines.resize(n + 1);
+  cosines.resize(n + 1);
+  FastSinCos(angles.data(), sines.data(), cosines.data(), angles.size());
+}
+
 class TorusSurface : public TriSurface {
 public:
 	/**
@@ -30,25 +50,27 @@ public:
   TorusSurface(const float ringradius, const float tuberadius, 
                const int nring, const int ntube, const int position_loc, 
                const int normal_loc) {
-    // Use <= so we wrap around to make the last vertices meet the first
-    int i, j;
-    float v, phi, theta; 
-    float dphi   = (2.0f * kPi) / (float)ntube;
-    float dtheta = (2.0f * kPi) / (float)nring;
+    // Use <= so we wrap around to make the last vertices meet the first.
+    // The sin and cos of each ring and tube angle are computed once, as
+    // a batch, rather than 6 times per vertex.
+    std::vector<float> sin_theta, cos_theta, sin_phi, cos_phi;
+    AngleTable(nring, sin_theta, cos_theta);
+    AngleTable(ntube, sin_phi, cos_phi);
     VertexAndNormal vtx;
-    for (phi = 0.0f, j = 0; j <= ntube; j++, phi += dphi) {
-      for (theta = 0.0f, i = 0; i <= nring; i++, theta += dtheta) {
+    vertices.reserve((ntube + 1) * (nring + 1));
+    for (int j = 0; j <= ntube; j++) {
+      float v = ringradius + tuberadius * cos_phi[j];
+      for (int i = 0; i <= nring; i++) {
         // Compute vertex
-        v = (ringradius + tuberadius * cos(phi));
-        vtx.vertex.Set(v * cosf(theta), v * sinf(theta), tuberadius * sinf(phi));
+        vtx.vertex.Set(v * cos_theta[i], v * sin_theta[i], tuberadius * sin_phi[j]);
 
         // Compute normal. It is the cross product of the two tangents (one  
         // with respect to the ring rotation and one with repect to the tube
         // rotation). These are found by taking the derivative of the 
-        // parametric equation with respect to theta and phi.
-        Vector3 tan1(-sinf(theta), cosf(theta), 0.0f);
-        Vector3 tan2(cosf(theta) * (-sinf(phi)), sinf(theta) * (-sinf(phi)), cosf(phi));
-        vtx.normal = (tan1.Cross(tan2)).Normalize();
+        // parametric equation with respect to theta and phi:
+        // (-sin(theta), cos(theta), 0) x (-cos(theta) sin(phi), 
+        // -sin(theta) sin(phi), cos(phi)), which is already unit length.
+        vtx.normal.Set(cos_theta[i] * cos_phi[j], sin_theta[i] * cos_phi[j], sin_phi[j]);
         vertices.push_back(vtx);
       }
     }
@@ -82,28 +104,24 @@ public:
   TexturedTorusSurface(const float ringradius, const float tuberadius,
                   const int nring, const int ntube, const int position_loc,
                   const int normal_loc, const int texture_loc)  {
-    // Use <= so we wrap around to make the last vertices meet the first
-    int i, j;
-    float v, phi, theta;
-    float dphi = (2.0f * kPi) / (float)ntube;
-    float dtheta = (2.0f * kPi) / (float)nring;
-    Vector3 tan1;               // Tangent vector with respect to ring
-    Vector3 tan2;               // Tangent vector with respect to tube
+    // Use <= so we wrap around to make the last vertices meet the first.
+    // The sin and cos of each angle are computed once (see TorusSurface).
+    std::vector<float> sin_theta, cos_theta, sin_phi, cos_phi;
+    AngleTable(nring, sin_theta, cos_theta);
+    AngleTable(ntube, sin_phi, cos_phi);
     float ds = 1.0f / (float)nring;
     float dt = 1.0f / (float)ntube;
     PNTVertex vtx;
-    for (vtx.t = 0.0f, phi = 0.0f, j = 0; j <= ntube; j++, phi += dphi, vtx.t += dt) {
-      for (vtx.s = 0.0f, theta = 0.0f, i = 0; i <= nring; i++, theta += dtheta, vtx.s += ds) {
-        // Compute vertex
-        v = (ringradius + tuberadius * cos(phi));
-        vtx.vertex.Set(v * cosf(theta), v * sinf(theta), tuberadius * sinf(phi));
-
-        // Compute normal. It is the cross product of the two tangents (one with respect to the ring 
-        // rotation and one with repect to the tube rotation). These are found by taking the derivative
-        // of the parametric equation with respect to theta and phi.
-        tan1.Set(-sinf(theta), cosf(theta), 0.0f);
-        tan2.Set(cosf(theta) * (-sinf(phi)), sinf(theta) * (-sinf(phi)), cosf(phi));
-        vtx.normal = (tan1.Cross(tan2)).Normalize();
+    vertices.reserve((ntube + 1) * (nring + 1));
+    for (int j = 0; j <= ntube; j++) {
+      float v = ringradius + tuberadius * cos_phi[j];
+      vtx.t = j * dt;
+      for (int i = 0; i <= nring; i++) {
+        // Compute vertex, normal (unit length, the cross product of the
+        // ring and tube tangents) and texture coordinate
+        vtx.vertex.Set(v * cos_theta[i], v * sin_theta[i], tuberadius * sin_phi[j]);
+        vtx.normal.Set(cos_theta[i] * cos_phi[j], sin_theta[i] * cos_phi[j], sin_phi[j]);
+        vtx.s = i * ds;
         vertices.push_back(vtx);
       }
     }
@@ -14,9 +14,106 @@
 
 #include "geometry/geometry.h"
 
+/**
+ * World transform and the matrices derived from it, cached between
+ * frames. The world and normal matrices are formed again only when the
+ * local transform or the parent world transform changed; when only the
+ * camera moved just the composite pvm matrix is formed.
+ * World and normal matrices are affine, so they are stored as Affine3x4
+ * (48 bytes each) and composed with the 3x4 product; the kind of the
+ * world transform is kept for the normal matrix shortcuts. The pvm
+ * matrix includes the projection, so it is a Matrix4x4.
+ */
+struct WorldTransform {
+  Affine3x4  world;     // Parent world matrix * local matrix
+  Affine3x4  normal;    // Normal matrix of world
+  Matrix4x4  pvm;       // Projection * view * world
+  MatrixKind kind;      // Kind of transformation world holds
+  uint32_t   version;   // Version of the local matrix used
+  bool       valid;     // False until the matrices are first formed
+
+  /**
+   * Constructor. The matrices are formed on the first Update.
+   */
+  WorldTransform()
+    : kind(MATRIX_IDENTITY),
+      version(0),
+      valid(false) {
+  }
+
+  /**
+   * Brings the cached matrices up to date.
+   * @param  parent          Parent world matrix
+   * @param  parent_kind     Kind of transformation the parent holds
+   * @param  parent_changed  True if the parent world matrix changed
+   * @param  local           Local modeling matrix (affine)
+   * @param  local_kind      Kind of transformation the local matrix holds
+   * @param  local_version   Version of the local matrix (changes whenever
+   *                         the local matrix does)
+   * @param  pv              Composite projection and view matrix
+   * @param  pv_changed      True if pv changed
+   * @return  Returns true if the world matrix changed.
+   */
+  bool Update(const Affine3x4& parent, const MatrixKind parent_kind,
+              const bool parent_changed, const Matrix4x4& local,
+              const MatrixKind local_kind, const uint32_t local_version,
+              const Matrix4x4& pv, const bool pv_changed) {
+    bool changed = !valid || parent_changed || version != local_version;
+    if (changed) {
+      world = parent * Affine3x4(local);
+      kind = (parent_kind > local_kind) ? parent_kind : local_kind;
+      normal = world.GetNormalMatrix(kind);
+      version = local_version;
+      valid = true;
+    }
+    if (changed || pv_changed)
+      pvm = pv * GetWorldMatrix();
+    return changed;
+  }
+
+  /**
+   * Sets the world matrix directly (a root with no parent).
+   * @param  m  World matrix (affine)
+   * @return  Returns true if the world matrix changed.
+   */
+  bool Set(const Matrix4x4& m) {
+    Affine3x4 w(m);
+    if (valid && w == world)
+      return false;
+    world = w;
+    kind = m.GetKind();
+    normal = world.GetNormalMatrix(kind);
+    valid = true;
+    return true;
+  }
+
+  /**
+   * Gets the world matrix as a 4x4 matrix (for the scene state and
+   * matrix uniforms).
+   * @return  Returns the world matrix.
+   */
+  Matrix4x4 GetWorldMatrix() const {
+    return world.ToMatrix4x4();
+  }
+
+  /**
+   * Gets the normal matrix as a 4x4 matrix (for matrix uniforms).
+   * @return  Returns the normal matrix.
+   */
+  Matrix4x4 GetNormalMatrix() const {
+    return normal.ToMatrix4x4();
+  }
+};
+
 /**
  * Transform node. Applies a transformation. This class allows OpenGL style 
- * transforms applied to the scene graph.
+ * transforms applied to the scene graph. Alternatively the transform can 
+ * be given as a position, rotation (quaternion) and scale (TRS mode). This
+ * is the better choice for animated nodes: each update changes 40 bytes of
+ * TRS state with no matrix products, and the matrix is composed once, in
+ * Draw, only if the TRS changed.
+ * The world, normal and pvm matrices are cached (see WorldTransform) so
+ * frames where nothing moved do no matrix products or inverses.
  */
 class TransformNode : public SceneNode {
 public:
@@ -26,9 +123,9 @@ public:
   TransformNode() {
     node_type = SCENE_TRANSFORM;
     reference_count = 0;
+    scale.Set(1.0f, 1.0f, 1.0f);
+    matrix_version = 0;
     LoadIdentity();
-    scaleX = 1;
-    scaleY = 1;
   }
 
   /**
@@ -36,13 +133,43 @@ public:
    */
   virtual ~TransformNode() { }
 
+  /**
+   * A transform node's Update only updates the children, so it may be
+   * updated in parallel. Derived nodes that animate the transform in
+   * Update must declare their own.
+   * @return  Returns true for a TransformNode itself.
+   */
+  virtual bool IsUpdateThreadSafe() const {
+    return typeid(*this) == typeid(TransformNode);
+  }
+
   /**
    * Set the identity matrix
    */
   void LoadIdentity() {
     model_matrix.SetIdentity();
+    model_kind = MATRIX_IDENTITY;
+    matrix_version++;
     scaleX = 1;
     scaleY = 1;
+    trs_mode = false;
+    trs_changed = false;
+  }
+
+  /**
+   * Replace the modeling transform with the specified matrix (for example
+   * one formed at compile time). The billboard scale factors are taken
+   * from the lengths of the first 2 columns.
+   * @param  m  Modeling matrix
+   */
+  void LoadMatrix(const Matrix4x4& m) {
+    trs_mode = false;
+    trs_changed = false;
+    model_matrix = m;
+    model_kind = m.GetKind();
+    matrix_version++;
+    scaleX = Vector3(m.m00(), m.m10(), m.m20()).Norm();
+    scaleY = Vector3(m.m01(), m.m11(), m.m21()).Norm();
   }
 
   /**
@@ -52,7 +179,10 @@ public:
    * @param  z  z translation
    */
   void Translate(const float x, const float y, const float z) {
+    EndTRS();
     model_matrix.Translate(x, y, z);
+    WidenKind(MATRIX_RIGID);
+    matrix_version++;
   }
 
   /**
@@ -61,7 +191,10 @@ public:
   * @param  v    Rotation axis
   */
   void Rotate(const float deg, Vector3& v) {
+    EndTRS();
     model_matrix.Rotate(deg, v.x, v.y, v.z);
+    WidenKind(MATRIX_RIGID);
+    matrix_version++;
   }
 
   /**
@@ -69,7 +202,10 @@ public:
    * @param  deg  Degrees counter-clockwise rotation.
    */
   void RotateX(const float deg) {
+    EndTRS();
     model_matrix.RotateX(deg);
+    WidenKind(MATRIX_RIGID);
+    matrix_version++;
   }
 
   /**
@@ -77,7 +213,10 @@ public:
    * @param  deg  Degrees counter-clockwise rotation.
    */
   void RotateY(const float deg) {
+    EndTRS();
     model_matrix.RotateY(deg);
+    WidenKind(MATRIX_RIGID);
+    matrix_version++;
   }
 
   /**
@@ -85,7 +224,10 @@ public:
    * @param  deg  Degrees counter-clockwise rotation.
    */
   void RotateZ(const float deg) {
+    EndTRS();
     model_matrix.RotateZ(deg);
+    WidenKind(MATRIX_RIGID);
+    matrix_version++;
   }
 
   /**
@@ -95,37 +237,184 @@ public:
    * @param  z  z scaling factor
    */
   void Scale(const float x, const float y, const float z) {
+    EndTRS();
     model_matrix.Scale(x, y, z);
+    if (x != 1.0f || y != 1.0f || z != 1.0f)
+      WidenKind(MATRIX_AFFINE);
+    matrix_version++;
     scaleX *= x;
     scaleY *= y;
   }
 
+  /**
+   * Sets the transform from a position, rotation and scale (T R S) and
+   * switches the node to TRS mode.
+   * @param  p  Position (translation)
+   * @param  q  Rotation (unit quaternion)
+   * @param  s  Scale factors along x, y, z
+   */
+  void SetTRS(const Point3& p, const Quaternion& q, const Vector3& s) {
+    position = p;
+    rotation = q;
+    scale = s;
+    trs_mode = true;
+    trs_changed = true;
+  }
+
+  /**
+   * Sets the position (TRS mode).
+   * @param  p  Position (translation)
+   */
+  void SetPosition(const Point3& p) {
+    BeginTRS();
+    position = p;
+  }
+
+  /**
+   * Sets the rotation (TRS mode).
+   * @param  q  Rotation (unit quaternion)
+   */
+  void SetRotation(const Quaternion& q) {
+    BeginTRS();
+    rotation = q;
+  }
+
+  /**
+   * Sets the scale (TRS mode).
+   * @param  s  Scale factors along x, y, z
+   */
+  void SetScale(const Vector3& s) {
+    BeginTRS();
+    scale = s;
+  }
+
+  /**
+   * Sets the rotation to an interpolation between 2 rotations (TRS mode).
+   * Uses spherical linear interpolation, or the cheaper normalized linear
+   * interpolation when constant angular speed is not needed.
+   * @param  q0      Rotation at t = 0
+   * @param  q1      Rotation at t = 1
+   * @param  t       Interpolation parameter (0 to 1)
+   * @param  slerp   Use Slerp if true, Nlerp if false
+   */
+  void InterpolateRotation(const Quaternion& q0, const Quaternion& q1,
+                           const float t, const bool slerp = true) {
+    BeginTRS();
+    rotation = slerp ? q0.Slerp(q1, t) : q0.Nlerp(q1, t);
+  }
+
+  /**
+   * Gets the position (TRS mode).
+   * @return  Returns the position.
+   */
+  const Point3& GetPosition() const {
+    return position;
+  }
+
+  /**
+   * Gets the rotation (TRS mode).
+   * @return  Returns the rotation.
+   */
+  const Quaternion& GetRotation() const {
+    return rotation;
+  }
+
+  /**
+   * Gets the scale (TRS mode).
+   * @return  Returns the scale factors.
+   */
+  const Vector3& GetScale() const {
+    return scale;
+  }
+
+  /**
+   * Gets the modeling matrix, composing the TRS first if it changed.
+   * @return  Returns the local modeling matrix.
+   */
+  const Matrix4x4& GetMatrix() {
+    if (trs_changed)
+      ComposeTRS();
+    return model_matrix;
+  }
+
+  /**
+   * Gets the kind of transformation the modeling matrix holds. Kept by
+   * the node (the matrix does not store it), so a matrix built from
+   * rotations and translations is known to be rigid.
+   * @return  Returns the matrix kind.
+   */
+  MatrixKind GetMatrixKind() const {
+    return model_kind;
+  }
+
+  /**
+   * Gets the version of the modeling matrix. The version changes whenever
+   * the matrix does, so cached world matrices can tell they are out of
+   * date. Call after GetMatrix, which may compose the TRS.
+   * @return  Returns the matrix version.
+   */
+  uint32_t GetMatrixVersion() const {
+    return matrix_version;
+  }
+
+  /**
+   * Gets the x scale factor used by the billboard shader.
+   * @return  Returns the x scale.
+   */
+  float GetBillboardScale() const {
+    return scaleX;
+  }
+
+  // Adds this transform to a render list, then the children under it.
+  // Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
 	/**
 	 * Draw this transformation node and its children
    * @param  scene_state   Current scene state
 	 */
   virtual void Draw(SceneState& scene_state) {
+    // Compose the TRS into the modeling matrix if it changed
+    if (trs_changed)
+      ComposeTRS();
+
     // Copy current transforms onto stack
     scene_state.PushTransforms();
 
     // Apply this modeling transform to the current modeling matrix. 
     // Note the postmultiply - this allows hierarchical transformations
-    // in the scene
-    scene_state.model_matrix *= model_matrix;
-    glUniformMatrix4fv(scene_state.modelmatrix_loc, 1, GL_FALSE, scene_state.model_matrix.Get());
+    // in the scene. The products are cached: a node shared by several
+    // parents re-forms them whenever the parent matrix differs.
+    Affine3x4 parent(scene_state.model_matrix);
+    bool parent_changed = !(parent_world == parent);
+    if (parent_changed)
+      parent_world = parent;
+    bool pv_changed = !(world_pv == scene_state.pv);
+    if (pv_changed)
+      world_pv = scene_state.pv;
+    world_transform.Update(parent_world, scene_state.model_matrix.GetKind(), parent_changed,
+                           model_matrix, model_kind, matrix_version, world_pv, pv_changed);
+    scene_state.model_matrix = world_transform.GetWorldMatrix();
+    if (scene_state.UsesUniformBlocks()) {
+      // All the transform uniforms in one draw block
+      scene_state.UploadDrawUniforms(scene_state.model_matrix, world_transform.GetNormalMatrix(),
+                                     world_transform.pvm, scaleX);
+    }
+    else {
+      GLStateCache& gl = GLStateCache::Get();
+      gl.UniformMatrix4fv(scene_state.modelmatrix_loc, scene_state.model_matrix.Get());
 
-    // Set the normal transform matrix (transpose of the inverse of the model matrix).
-    // This transforms normals into view coordinates
-    Matrix4x4 normal_matrix = scene_state.model_matrix.GetInverse().Transpose();
-    glUniformMatrix4fv(scene_state.normalmatrix_loc, 1, GL_FALSE, normal_matrix.Get());
+      // Set the normal transform matrix (transpose of the inverse of the model matrix).
+      // This transforms normals into view coordinates.
+      gl.UniformMatrix4fv(scene_state.normalmatrix_loc, world_transform.GetNormalMatrix().Get());
 
-    // Set the composite projection, view, modeling matrix
-    Matrix4x4 pvm = scene_state.pv * scene_state.model_matrix;
-    glUniformMatrix4fv(scene_state.pvm_loc, 1, GL_FALSE, pvm.Get());
+      // Set the composite projection, view, modeling matrix
+      gl.UniformMatrix4fv(scene_state.pvm_loc, world_transform.pvm.Get());
 
-    // Set scale uniforms
-    glUniform1f(scene_state.scaley_loc, scaleX);
-    glUniform1f(scene_state.scalex_loc, scaleX);
+      // Set scale uniforms
+      gl.Uniform1f(scene_state.scaley_loc, scaleX);
+      gl.Uniform1f(scene_state.scalex_loc, scaleX);
+    }
 
     // Draw all children
     SceneNode::Draw(scene_state);
@@ -135,11 +424,62 @@ public:
 	}
 
 protected:
-  Matrix4x4 model_matrix;   // Local modeling transformation
+  Matrix4x4  model_matrix;    // Local modeling transformation
+  uint32_t   matrix_version;  // Incremented when model_matrix changes
+  MatrixKind model_kind;      // Kind of transformation model_matrix holds
+
+  // Cached world matrices (Draw) and the parent and pv matrices they
+  // were formed from
+  WorldTransform world_transform;
+  Affine3x4      parent_world;
+  Matrix4x4      world_pv;
 
   // Current scale, for billboard fix in the shader
   float scaleX;
   float scaleY;
+
+  // TRS mode: the modeling matrix is composed from these
+  Point3     position;
+  Quaternion rotation;
+  Vector3    scale;
+  bool trs_mode;        // True if the TRS is the source of the transform
+  bool trs_changed;     // True if the TRS changed since it was composed
+
+  // Switch to TRS mode. The TRS starts as the identity; a matrix formed
+  // by OpenGL style calls is discarded.
+  void BeginTRS() {
+    if (!trs_mode) {
+      position.Set(0.0f, 0.0f, 0.0f);
+      rotation = Quaternion();
+      scale.Set(1.0f, 1.0f, 1.0f);
+      trs_mode = true;
+    }
+    trs_changed = true;
+  }
+
+  // Leave TRS mode so OpenGL style calls postmultiply the composed matrix.
+  void EndTRS() {
+    if (trs_changed)
+      ComposeTRS();
+    trs_mode = false;
+  }
+
+  // Widen the kind of the modeling matrix to at least k
+  void WidenKind(const MatrixKind k) {
+    if (k > model_kind)
+      model_kind = k;
+  }
+
+  // Compose the TRS into the modeling matrix
+  void ComposeTRS() {
+    model_matrix.SetTRS(position, rotation, scale);
+    model_kind = (scale.x == 1.0f && scale.y == 1.0f && scale.z == 1.0f) ?
+                    MATRIX_RIGID : MATRIX_AFFINE;
+    matrix_version++;
+    scaleX = scale.x;
+    scaleY = scale.y;
+    trs_changed = false;
+  }
 };
 
 #endif
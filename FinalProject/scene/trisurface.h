@@ -36,18 +36,21 @@ public:
     // Delete vertex buffer objects
     glDeleteBuffers(1, &vbo);
     glDeleteBuffers(1, &facebuffer);
-    glDeleteVertexArrays(1, &vao);
+    GLStateCache::Get().DeleteVertexArray(vao);
   }
 	
   /**
    * Draw this geometry node.
    */
   virtual void Draw(SceneState& scene_state) {
-    glBindVertexArray(vao);
+    GLStateCache::Get().BindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, (GLsizei)face_count, GL_UNSIGNED_SHORT, (void*)0);
-    glBindVertexArray(0);
+    GLStateCache::Get().ReleaseVertexArray();
   }
 	
+  // Adds a draw record for the mesh. Defined in renderlist.h.
+  virtual void Compile(RenderList& list);
+
   /**
    * Construct triangle surface by passing in vertex list and face list
    * @param  v  List of vertices (position and normal)
@@ -108,37 +111,9 @@ public:
    * Marks the end of a triangle mesh. Calculates the vertex normals.
    */
   void End(const int position_loc, const int normal_loc) {
-    // Iterate through the face list and calculate the normals for each 
-    // face and add the normal to each vertex in the face list. This 
-    // assumes the vertex normals are initilaized to 0 (in constructor
-    // of VertexAndNormal)
-    uint32_t v0, v1, v2;
-    Vector3 e1, e2, face_normal;
-    auto face_vertex = faces.begin();
-    while (face_vertex != faces.end()) {
-      // Get the vertices of the face (assumes ccw order)
-      v0 = *face_vertex++;
-      v1 = *face_vertex++;
-      v2 = *face_vertex++;
-
-      // Calculate surface normal. Normalize it since cross products
-      // do not ensure unit length normals. We need to make sure normals
-      // are same length so averaging works properly
-      e1.Set(vertices[v0].vertex, vertices[v1].vertex);
-      e2.Set(vertices[v0].vertex, vertices[v2].vertex);
-      face_normal = (e1.Cross(e2)).Normalize();
-
-      // Add the face normal to the vertex normals of the triangle
-      vertices[v0].normal += face_normal;
-      vertices[v1].normal += face_normal;
-      vertices[v2].normal += face_normal;
-    }
-		
-    // Normalize the vertex normals - this essentially averages the 
-    // adjoining face normals.
-    for (auto v : vertices) {
-      v.normal.Normalize();
-    }
+    // Calculate the unit normal of each face and average the normals of
+    // the faces adjoining each vertex
+    ComputeVertexNormals(vertices, faces);
 		
     // Create the vertex and face buffers
     CreateVertexBuffers(position_loc, normal_loc);
@@ -148,7 +123,13 @@ public:
   * Creates vertex buffers for this object.
   */
   void CreateVertexBuffers(const int position_loc, const int normal_loc) {
-    // Generate vertex buffers for the vertex list and the face list
+    // Bounds of the (final) vertex list, for culling and collision
+    if (!vertices.empty())
+      ComputeBounds(&vertices[0].vertex.x, sizeof(VertexAndNormal), vertices.size());
+
+    // Generate vertex buffers for the vertex list and the face list. No
+    // vertex array object may be bound when the face list is bound.
+    GLStateCache::Get().BindVertexArray(0);
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &facebuffer);
 
@@ -167,7 +148,7 @@ public:
 
     // Allocate a VAO, enable it and set the vertex attribute arrays and pointers
     glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    GLStateCache::Get().BindVertexArray(vao);
 
     // Bind the vertex buffer, set the vertex position attribute and the vertex normal attribute
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
@@ -180,7 +161,7 @@ public:
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, facebuffer);
 
     // Make sure changes to this VAO are local
-    glBindVertexArray(0);
+    GLStateCache::Get().BindVertexArray(0);
 
     // We could clear any local memory as it is now in the VBO. However there may be
     // cases where we want to keep it (e.g. collision detection, picking) so I am not
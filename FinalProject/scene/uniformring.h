@@ -0,0 +1,250 @@
+//============================================================================
+//	Johns Hopkins University Engineering Programs for Professionals
+//	605.467 Computer Graphics and 605.767 Applied Computer Graphics
+//	Instructor:	David W. Nesbitt
+//
+//	Author:	David W. Nesbitt
+//	File:    uniformring.h
+//	Purpose:	Uniform buffer ring and the std140 uniform block layouts of
+//          the lighting shader.
+//
+//============================================================================
+
+#ifndef __UNIFORMRING_H
+#define __UNIFORMRING_H
+
+#include <string.h>
+#include <vector>
+
+// Uniform block binding points of the lighting shader
+const GLuint kFrameBlockBinding    = 0;   // Camera, lights and fog
+const GLuint kMaterialBlockBinding = 1;   // Material
+const GLuint kDrawBlockBinding     = 2;   // Transform of the geometry drawn
+
+// Number of lights in the frame block (MAX_LIGHTS in the shaders)
+const uint32_t kMaxBlockLights = 3;
+
+/**
+ * One light source of the frame block (struct LightSource, std140).
+ */
+struct LightBlock {
+  int32_t enabled;
+  int32_t spotlight;
+  float   pad0[2];
+  HPoint3 position;
+  Color4  ambient;
+  Color4  diffuse;
+  Color4  specular;
+  float   constantAttenuation;
+  float   linearAttenuation;
+  float   quadraticAttenuation;
+  float   spotCosCutoff;
+  float   spotExponent;
+  float   pad1[3];
+  Vector3 spotDirection;
+  float   pad2;
+};
+static_assert(sizeof(LightBlock) == 128, "LightBlock must match the std140 layout");
+
+/**
+ * Per-frame uniforms (uniform block FrameBlock, std140): camera, lights
+ * and fog. Written when the camera or a light is drawn.
+ */
+struct FrameUniforms {
+  float      viewMatrix[16];
+  float      projectionMatrix[16];
+  Point3     cameraPosition;
+  float      pad0;
+  Color4     globalLightAmbient;
+  Color4     fogColor;
+  int32_t    numLights;
+  int32_t    useFog;
+  int32_t    pad1[2];
+  LightBlock lights[kMaxBlockLights];
+};
+static_assert(sizeof(FrameUniforms) == 192 + 128 * kMaxBlockLights,
+              "FrameUniforms must match the std140 layout");
+
+/**
+ * Material uniforms (uniform block MaterialBlock, std140). Written when
+ * the material changes.
+ */
+struct MaterialUniforms {
+  Color4  materialAmbient;
+  Color4  materialDiffuse;
+  Color4  materialSpecular;
+  Color4  materialEmission;
+  float   materialShininess;
+  int32_t useTexture;
+  int32_t enableBillboard;
+  int32_t pad0;
+};
+static_assert(sizeof(MaterialUniforms) == 80, "MaterialUniforms must match the std140 layout");
+
+/**
+ * Per-draw uniforms (uniform block DrawBlock, std140): the transform of
+ * the geometry drawn.
+ */
+struct DrawUniforms {
+  float pvm[16];
+  float modelMatrix[16];
+  float normalMatrix[16];
+  float scaleX;
+  float scaleY;
+  float pad0[2];
+
+  /**
+   * Sets the matrices and billboard scale.
+   * @param  model   Model matrix
+   * @param  normal  Normal transformation matrix
+   * @param  pvmat   Composite projection, view, model matrix
+   * @param  scale   Billboard scale (x and y)
+   */
+  void Set(const Matrix4x4& model, const Matrix4x4& normal, const Matrix4x4& pvmat,
+           const float scale) {
+    memcpy(pvm, pvmat.Get(), sizeof(pvm));
+    memcpy(modelMatrix, model.Get(), sizeof(modelMatrix));
+    memcpy(normalMatrix, normal.Get(), sizeof(normalMatrix));
+    scaleX = scale;
+    scaleY = scale;
+  }
+};
+static_assert(sizeof(DrawUniforms) == 208, "DrawUniforms must match the std140 layout");
+
+/**
+ * Ring of uniform block data in one uniform buffer. Each block written
+ * takes the next range of the buffer (aligned as the implementation
+ * requires) and is bound to its binding point with glBindBufferRange, so
+ * a block costs 2 calls however many uniforms it holds, and a range
+ * written earlier is bound again with 1. Data is written linearly
+ * through a frame; at the start of a frame the ring goes back to the
+ * beginning once past the middle, so consecutive frames use different
+ * parts of the buffer. If a frame needs more than the rest of the buffer
+ * it grows, keeping the offsets of everything written.
+ * The buffer stays bound to the generic GL_UNIFORM_BUFFER binding point
+ * (glBindBufferRange binds it there too), so nothing else should use
+ * that binding point while the ring is in use.
+ */
+class UniformRing {
+public:
+  /**
+   * Constructor. The buffer is created with Create.
+   */
+  UniformRing()
+    : buffer(0),
+      alignment(256),
+      head(0) {
+  }
+
+  /**
+   * Destructor. Deletes the buffer.
+   */
+  ~UniformRing() {
+    if (buffer != 0)
+      glDeleteBuffers(1, &buffer);
+  }
+
+  UniformRing(const UniformRing&) = delete;
+  UniformRing& operator = (const UniformRing&) = delete;
+
+  /**
+   * Creates the uniform buffer. Requires a current OpenGL context.
+   * @param  capacity  Size of the buffer in bytes
+   */
+  void Create(const size_t capacity = 256 * 1024) {
+    GLint align = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    alignment = (align > 0) ? static_cast<size_t>(align) : 256;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    Grow(capacity);
+  }
+
+  /**
+   * Starts a frame. Call before any block of the frame is written.
+   */
+  void BeginFrame() {
+    if (head > shadow.size() / 2)
+      head = 0;
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  }
+
+  /**
+   * Reserves a range of the ring. Fill it through the returned pointer,
+   * then upload it with Commit.
+   * @param  bytes   Size of the range
+   * @param  offset  (OUT) Offset of the range in the buffer
+   * @return  Returns the memory to fill.
+   */
+  void* Reserve(const size_t bytes, size_t& offset) {
+    offset = Align(head);
+    if (offset + bytes > shadow.size())
+      Grow(std::max(shadow.size() * 2, Align(offset + bytes)));
+    head = offset + bytes;
+    return &shadow[offset];
+  }
+
+  /**
+   * Uploads a reserved range.
+   * @param  offset  Offset of the range
+   * @param  bytes   Size of the range
+   */
+  void Commit(const size_t offset, const size_t bytes) {
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, bytes, &shadow[offset]);
+  }
+
+  /**
+   * Writes a block and binds it.
+   * @param  binding  Uniform block binding point
+   * @param  data     Block data
+   * @param  bytes    Size of the block
+   */
+  void Write(const GLuint binding, const void* data, const size_t bytes) {
+    size_t offset;
+    memcpy(Reserve(bytes, offset), data, bytes);
+    Commit(offset, bytes);
+    Bind(binding, offset, bytes);
+  }
+
+  /**
+   * Binds a range written earlier in the frame.
+   * @param  binding  Uniform block binding point
+   * @param  offset   Offset of the range
+   * @param  bytes    Size of the range
+   */
+  void Bind(const GLuint binding, const size_t offset, const size_t bytes) {
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, offset, bytes);
+  }
+
+  /**
+   * Rounds a size or offset up to the offset alignment of the buffer.
+   * @param  bytes  Size or offset
+   * @return  Returns the aligned value.
+   */
+  size_t Align(const size_t bytes) const {
+    return (bytes + alignment - 1) / alignment * alignment;
+  }
+
+  /**
+   * Gets the size of the buffer.
+   * @return  Returns the capacity in bytes.
+   */
+  size_t GetCapacity() const {
+    return shadow.size();
+  }
+
+private:
+  GLuint            buffer;
+  size_t            alignment;   // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+  size_t            head;        // Offset after the last range reserved
+  std::vector<char> shadow;      // Copy of the buffer contents
+
+  // Reallocates the buffer with the contents so far, so ranges that are
+  // bound stay valid
+  void Grow(const size_t new_capacity) {
+    shadow.resize(new_capacity);
+    glBufferData(GL_UNIFORM_BUFFER, shadow.size(), shadow.data(), GL_STREAM_DRAW);
+  }
+};
+
+#endif